@@ -0,0 +1,757 @@
+#include "Batch.hpp"
+#include "Jit.hpp"	// Jit_slowRead / Jit_slowWrite
+#include "Semihost.hpp"
+#include "Clock.hpp"
+#include "Fastmem.hpp"
+#include <stdlib.h>	// malloc / free, getenv
+#include <string.h>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define BATCH_HAS_AVX2 1
+#define BATCH_AVX2_FN __attribute__((target("avx2")))
+#elif defined(_MSC_VER) && defined(__AVX2__)
+#include <immintrin.h>
+#define BATCH_HAS_AVX2 1
+#define BATCH_AVX2_FN
+#else
+#define BATCH_HAS_AVX2 0
+#endif
+
+struct Batch_soa Batch_var_soa;
+struct Batch_lane Batch_var_lanes[BATCH_LANES];
+uint32 Batch_var_nlanes = 0;
+uint32 Batch_var_enabled = 0;
+uint32 Batch_var_avx2 = 0;
+
+uint32 Batch_var_groupblocks = 0;
+uint32 Batch_var_scalarblocks = 0;
+uint32 Batch_var_splits = 0;
+uint32 Batch_var_joins = 0;
+
+alignas(32) static uint32_t Batch_var_T[IR_MAX_INST][BATCH_LANES];	// temps, one row per IR temp
+alignas(32) static uint32_t Batch_var_imm[BATCH_LANES];
+alignas(32) static uint32_t Batch_var_zero[BATCH_LANES];
+static uint32 Batch_var_spent[BATCH_LANES];	// cycles of the last group block per lane
+static uint8* Batch_var_shared[MEMORY_MAP_MAX_SECTIONS];	// section data while no lane is bound
+static IR_block Batch_var_block;
+
+#define BATCH_LANE_IN(mask, l) (((mask) >> (l)) & 0x1)
+
+/*
+* lane state in / out of the soa
+*/
+static void Batch_soa_in(uint32 l) {
+	Batch_lane* lane = &Batch_var_lanes[l];
+	for (uint32 r = 0; r < 16; r++) {
+		Batch_var_soa.R[r][l] = (uint32_t)lane->reg.R[r];
+	}
+	Batch_var_soa.N[l] = lane->reg.xPSR.APSR.N;
+	Batch_var_soa.Z[l] = lane->reg.xPSR.APSR.Z;
+	Batch_var_soa.C[l] = lane->reg.xPSR.APSR.C;
+	Batch_var_soa.V[l] = lane->reg.xPSR.APSR.V;
+}
+
+static void Batch_soa_out(uint32 l) {
+	Batch_lane* lane = &Batch_var_lanes[l];
+	for (uint32 r = 0; r < 16; r++) {
+		lane->reg.R[r] = Batch_var_soa.R[r][l];
+	}
+	lane->reg.xPSR.APSR.N = Batch_var_soa.N[l];
+	lane->reg.xPSR.APSR.Z = Batch_var_soa.Z[l];
+	lane->reg.xPSR.APSR.C = Batch_var_soa.C[l];
+	lane->reg.xPSR.APSR.V = Batch_var_soa.V[l];
+}
+
+static void Batch_join(uint32 l) {
+	Batch_soa_in(l);
+	Batch_var_lanes[l].grouped = 1;
+	Batch_var_joins += 1;
+}
+
+static void Batch_leave(uint32 l) {
+	Batch_soa_out(l);
+	Batch_var_lanes[l].grouped = 0;
+}
+
+/*
+* lane memory
+*/
+
+// point the sections at the lane's copies, for code that goes through Memory_read / Memory_write
+static void Batch_bind(Batch_lane* lane) {
+	for (uint32 i = 0; i < Memory_var_arrlen; i++) {
+		if (lane->data[i] != NULL) {
+			Memory_var_arr[i].data = lane->data[i];
+		}
+	}
+}
+
+static void Batch_unbind() {
+	for (uint32 i = 0; i < Memory_var_arrlen; i++) {
+		if (Batch_var_shared[i] != NULL) {
+			Memory_var_arr[i].data = Batch_var_shared[i];
+		}
+	}
+}
+
+// host pointer to [addr, addr + size) in the lane's memory, NULL if it is not plain memory of one section
+static uint8* Batch_direct(Batch_lane* lane, uint32 addr, uint32 size, uint32 attrib) {
+	Memory_map_elem* thismap = Memory_getMap(addr);
+	if (thismap == NULL || !MEMORY_IS_DIRECT(thismap) || (thismap->attrib & attrib) == 0
+		|| addr + size > thismap->base + thismap->size || addr + size < addr) {
+		return NULL;
+	}
+	uint8* data = lane->data[thismap - Memory_var_arr];
+	return &((data != NULL) ? data : thismap->data)[addr - thismap->base];
+}
+
+static uint32 Batch_load(Batch_lane* lane, uint32 addr, uint32 sizetype) {
+	uint8* p = MPU_var_active ? NULL : Batch_direct(lane, addr, 1 << sizetype, MEMORY_ATTRIB_S_R);
+	if (p != NULL) {
+		switch (sizetype) {
+		case Memory_enum_size::u8: return p[0];
+		case Memory_enum_size::u16: return p[0] | (p[1] << 8);
+		default: return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32)p[3] << 24);
+		}
+	}
+	Batch_bind(lane);
+	uint32 value = Jit_slowRead(addr, sizetype, MEMORY_ATTRIB_S_R);
+	Batch_unbind();
+	return value;
+}
+
+static void Batch_store(Batch_lane* lane, uint32 addr, uint32 data, uint32 sizetype) {
+	uint8* p = MPU_var_active ? NULL : Batch_direct(lane, addr, 1 << sizetype, MEMORY_ATTRIB_S_W);
+	if (p != NULL) {
+		p[0] = (uint8)data;
+		if (sizetype >= Memory_enum_size::u16) {
+			p[1] = (uint8)(data >> 8);
+		}
+		if (sizetype == Memory_enum_size::u32) {
+			p[2] = (uint8)(data >> 16);
+			p[3] = (uint8)(data >> 24);
+		}
+		return;
+	}
+	Batch_bind(lane);
+	Jit_slowWrite(addr, data, sizetype, MEMORY_ATTRIB_S_W);
+	Batch_unbind();
+}
+
+void Batch_write(uint32 lane, uint32 addr, const uint8* src, uint32 size) {
+	uint8* dest = Batch_direct(&Batch_var_lanes[lane], addr, size, MEMORY_ATTRIB_ALL);
+	if (dest != NULL) {
+		memcpy(dest, src, size);
+		return;
+	}
+	for (uint32 i = 0; i < size; i++) {
+		Batch_store(&Batch_var_lanes[lane], addr + i, src[i], Memory_enum_size::u8);
+	}
+}
+
+void Batch_read(uint32 lane, uint32 addr, uint8* dest, uint32 size) {
+	uint8* src = Batch_direct(&Batch_var_lanes[lane], addr, size, MEMORY_ATTRIB_ALL);
+	if (src != NULL) {
+		memcpy(dest, src, size);
+		return;
+	}
+	for (uint32 i = 0; i < size; i++) {
+		dest[i] = (uint8)Batch_load(&Batch_var_lanes[lane], addr + i, Memory_enum_size::u8);
+	}
+}
+
+/*
+* vector kernels
+*/
+
+// every lane through the scalar alu
+static void Batch_alu_lanes(uint32 op, uint32_t* t, const uint32_t* a, const uint32_t* b, const uint32_t* c) {
+	for (uint32 l = 0; l < BATCH_LANES; l++) {
+		t[l] = (uint32_t)IR_alu(op, a[l], b[l], c[l]);
+	}
+}
+
+#if BATCH_HAS_AVX2
+// 8 lanes per instruction. returns 0 for ops without a kernel
+BATCH_AVX2_FN static uint32 Batch_alu_avx2(uint32 op, uint32_t* t, const uint32_t* a, const uint32_t* b) {
+	const __m256i amount = _mm256_set1_epi32(0xFF);
+	for (uint32 l = 0; l < BATCH_LANES; l += 8) {
+		__m256i va = _mm256_load_si256((const __m256i*)(a + l));
+		__m256i vb = _mm256_load_si256((const __m256i*)(b + l));
+		__m256i vt;
+		switch (op) {
+		case IR_ADD: vt = _mm256_add_epi32(va, vb); break;
+		case IR_SUB: vt = _mm256_sub_epi32(va, vb); break;
+		case IR_AND: vt = _mm256_and_si256(va, vb); break;
+		case IR_OR: vt = _mm256_or_si256(va, vb); break;
+		case IR_XOR: vt = _mm256_xor_si256(va, vb); break;
+		case IR_BIC: vt = _mm256_andnot_si256(vb, va); break;
+		case IR_MUL: vt = _mm256_mullo_epi32(va, vb); break;
+		// variable shifts give 0 (lsl, lsr) or the sign (asr) for amounts of 32 and up, like the arm rules
+		case IR_LSL: vt = _mm256_sllv_epi32(va, _mm256_and_si256(vb, amount)); break;
+		case IR_LSR: vt = _mm256_srlv_epi32(va, _mm256_and_si256(vb, amount)); break;
+		case IR_ASR: vt = _mm256_srav_epi32(va, _mm256_and_si256(vb, amount)); break;
+		default: return 0;
+		}
+		_mm256_store_si256((__m256i*)(t + l), vt);
+	}
+	return 1;
+}
+#endif
+
+static void Batch_alu(uint32 op, uint32_t* t, const uint32_t* a, const uint32_t* b, const uint32_t* c) {
+#if BATCH_HAS_AVX2
+	if (Batch_var_avx2 && Batch_alu_avx2(op, t, a, b)) {
+		return;
+	}
+#endif
+	Batch_alu_lanes(op, t, a, b, c);
+}
+
+// IR_do_setflags for the running lanes
+static void Batch_flags(IR_inst* inst, const uint32_t* a, const uint32_t* b, const uint32_t* c, uint32 running) {
+	Batch_soa* soa = &Batch_var_soa;
+	uint32 mask = inst->flags;
+
+	for (uint32 l = 0; l < BATCH_LANES; l++) {
+		if (!BATCH_LANE_IN(running, l)) {
+			continue;
+		}
+		uint32_t x = a[l], y = b[l], result = x, carry = 0, overflow = 0;
+
+		switch (inst->op) {
+		case IR_FLAGS_ADD:
+		case IR_FLAGS_SUB: {
+			uint32_t cin = (inst->c != IR_NOTEMP) ? c[l] : (inst->op == IR_FLAGS_SUB);
+			if (inst->op == IR_FLAGS_SUB) {
+				y = ~y;
+			}
+			result = x + y + cin;
+			carry = cin ? (result <= x) : (result < x);
+			overflow = ((~(x ^ y) & (x ^ result)) >> 31) & 0x1;
+			break;
+		}
+		case IR_FLAGS_NZ:
+			break;
+		case IR_FLAGS_SHIFTC:
+			if ((y & 0xFF) != 0) {
+				// carry out is the bit shifted out last, the same as the scalar helper
+				uint32 amount = y & 0xFF;
+				switch (inst->size) {
+				case IR_LSL: soa->C[l] = (amount > 32) ? 0 : (uint32_t)(((uint64_t)x << amount) >> 32) & 0x1; break;
+				case IR_LSR: soa->C[l] = (amount > 32) ? 0 : (x >> (amount - 1)) & 0x1; break;
+				case IR_ASR: soa->C[l] = (amount >= 32) ? (x >> 31) : (x >> (amount - 1)) & 0x1; break;
+				case IR_ROR: soa->C[l] = (uint32_t)(IR_alu(IR_ROR, x, amount, 0) >> 31) & 0x1; break;
+				default: break;
+				}
+			}
+			continue;
+		default:
+			continue;
+		}
+
+		if (mask & IR_FLAG_N) soa->N[l] = result >> 31;
+		if (mask & IR_FLAG_Z) soa->Z[l] = (result == 0);
+		if (mask & IR_FLAG_C) soa->C[l] = carry;
+		if (mask & IR_FLAG_V) soa->V[l] = overflow;
+	}
+}
+
+// ConditionPassed() of one lane
+static uint32 Batch_cond(uint32 cond, uint32 l) {
+	uint32 n = Batch_var_soa.N[l], z = Batch_var_soa.Z[l], c = Batch_var_soa.C[l], v = Batch_var_soa.V[l];
+	uint32 result;
+
+	switch (cond >> 1) {
+	case 0: result = z; break;
+	case 1: result = c; break;
+	case 2: result = n; break;
+	case 3: result = v; break;
+	case 4: result = c && !z; break;
+	case 5: result = (n == v); break;
+	case 6: result = (n == v) && !z; break;
+	default: return 1;
+	}
+	if ((cond & 0x1) && cond != 0xF) {
+		result = !result;
+	}
+	return result;
+}
+
+// a lane exited through semihosting: keep its code, the emulator keeps running the others.
+// one that faulted (nothing is armed here, Fault.hpp) halted the clock: it stops without an exit code
+static void Batch_exited(Batch_lane* lane) {
+	if (Semihost_var_exited) {
+		lane->halted = 1;
+		lane->exitcode = Semihost_var_exitcode;
+		Semihost_var_exited = 0;
+		Semihost_var_exitcode = 0;
+		Clock_var_halt = 0;
+	}
+	else if (Clock_var_halt) {
+		lane->halted = 1;
+		lane->exitcode = BATCH_FAULTED;
+		Clock_var_halt = 0;
+	}
+}
+
+// IR_INTERP for one lane: the handler runs on the lane's scalar state and memory
+static void Batch_interp(uint32 l, IR_inst* inst) {
+	Batch_lane* lane = &Batch_var_lanes[l];
+	CPU_struct_reg* saved = CPU_var_reg;
+
+	Batch_soa_out(l);
+	CPU_var_reg = &lane->reg;
+	Batch_bind(lane);
+	IR_interp(inst->a, inst->imm, inst->pc, inst->b);
+	Batch_unbind();
+	CPU_var_reg = saved;
+	Batch_exited(lane);
+	Batch_soa_in(l);
+}
+
+// IR_execute over the soa. lanes leave 'running' at their exit, pc and cycles per lane
+static void Batch_execute(IR_block* block, uint32 running) {
+	uint32_t (*T)[BATCH_LANES] = Batch_var_T;
+	Batch_soa* soa = &Batch_var_soa;
+
+	for (uint32 i = 0; i < block->count && running != 0; i++) {
+		IR_inst* inst = &block->inst[i];
+		const uint32_t* b = Batch_var_zero;
+		if (inst->bimm) {
+			for (uint32 l = 0; l < BATCH_LANES; l++) {
+				Batch_var_imm[l] = (uint32_t)inst->imm;
+			}
+			b = Batch_var_imm;
+		}
+		else if (inst->b != IR_NOTEMP) {
+			b = T[inst->b];
+		}
+
+		switch (inst->op) {
+		case IR_NOP:
+			break;
+		case IR_CONST:
+			for (uint32 l = 0; l < BATCH_LANES; l++) {
+				T[inst->t][l] = (uint32_t)inst->imm;
+			}
+			break;
+		case IR_GETREG:
+			memcpy(T[inst->t], soa->R[inst->reg], sizeof(T[0]));
+			break;
+		case IR_SETREG:
+			for (uint32 l = 0; l < BATCH_LANES; l++) {
+				soa->R[inst->reg][l] = BATCH_LANE_IN(running, l) ? T[inst->a][l] : soa->R[inst->reg][l];
+			}
+			break;
+		case IR_SETREGI:
+			for (uint32 l = 0; l < BATCH_LANES; l++) {
+				soa->R[inst->reg][l] = BATCH_LANE_IN(running, l) ? (uint32_t)inst->imm : soa->R[inst->reg][l];
+			}
+			break;
+		case IR_ADDREGI:
+			for (uint32 l = 0; l < BATCH_LANES; l++) {
+				soa->R[inst->reg][l] += BATCH_LANE_IN(running, l) ? (uint32_t)inst->imm : 0;
+			}
+			break;
+
+		case IR_ADD:
+		case IR_SUB:
+		case IR_AND:
+		case IR_OR:
+		case IR_XOR:
+		case IR_BIC:
+		case IR_MUL:
+		case IR_LSL:
+		case IR_LSR:
+		case IR_ASR:
+		case IR_ROR:
+		case IR_ADC:
+		case IR_SBC:
+		case IR_NOT:
+			Batch_alu(inst->op, T[inst->t], T[inst->a], b, (inst->c != IR_NOTEMP) ? T[inst->c] : Batch_var_zero);
+			break;
+		case IR_GETC:
+			memcpy(T[inst->t], soa->C, sizeof(T[0]));
+			break;
+
+		case IR_FLAGS_ADD:
+		case IR_FLAGS_SUB:
+		case IR_FLAGS_NZ:
+		case IR_FLAGS_SHIFTC:
+			Batch_flags(inst, T[inst->a], b, (inst->c != IR_NOTEMP) ? T[inst->c] : Batch_var_zero, running);
+			break;
+
+		case IR_LOAD:
+			for (uint32 l = 0; l < BATCH_LANES; l++) {
+				if (BATCH_LANE_IN(running, l)) {
+					uint32 value = Batch_load(&Batch_var_lanes[l], T[inst->a][l], inst->size);
+					if (inst->sign) {
+						uint32 shift = 32 - (8 << inst->size);
+						value = (uint32)(uint32_t)((int32_t)(value << shift) >> shift);
+					}
+					T[inst->t][l] = (uint32_t)value;
+				}
+			}
+			break;
+		case IR_STORE:
+			for (uint32 l = 0; l < BATCH_LANES; l++) {
+				if (BATCH_LANE_IN(running, l)) {
+					Batch_store(&Batch_var_lanes[l], T[inst->a][l], b[l], inst->size);
+				}
+			}
+			break;
+
+		case IR_EXIT:
+		case IR_BRANCH:
+			for (uint32 l = 0; l < BATCH_LANES; l++) {
+				if (BATCH_LANE_IN(running, l)) {
+					soa->R[15][l] = (inst->op == IR_EXIT) ? (uint32_t)inst->imm : T[inst->a][l];
+					Batch_var_spent[l] = inst->cycles;
+				}
+			}
+			running = 0;
+			break;
+		case IR_BCOND:
+			for (uint32 l = 0; l < BATCH_LANES; l++) {
+				if (BATCH_LANE_IN(running, l) && Batch_cond(inst->size, l)) {
+					soa->R[15][l] = (uint32_t)inst->imm;
+					Batch_var_spent[l] = inst->cycles;
+					running &= ~(0x1 << l);
+				}
+			}
+			break;
+		case IR_INTERP:
+			for (uint32 l = 0; l < BATCH_LANES; l++) {
+				if (BATCH_LANE_IN(running, l)) {
+					Batch_interp(l, inst);
+					Batch_var_spent[l] = inst->cycles;
+				}
+			}
+			running = 0;
+			break;
+		}
+	}
+}
+
+/*
+* scheduling
+*/
+
+static uint32 Batch_itstate(Batch_lane* lane) {
+	return (lane->reg.xPSR.EPSR.ICIT0 << 2) | lane->reg.xPSR.EPSR.ICIT1;
+}
+
+static uint32 Batch_leader(uint32 group) {
+	uint32 l = 0;
+	while (!BATCH_LANE_IN(group, l)) {
+		l++;
+	}
+	return l;
+}
+
+// one block for the whole group, then split off the lanes that left the leader
+static uint32 Batch_group(uint32 group) {
+	uint32 leader = Batch_leader(group);
+
+	Batch_bind(&Batch_var_lanes[leader]);
+	IR_lower(&Batch_var_block, Batch_var_soa.R[15][leader], 0);
+	IR_optimize(&Batch_var_block);
+	Batch_unbind();
+
+	// same pc, same code: nobody can fetch it
+	if (Clock_var_halt) {
+		for (uint32 l = 0; l < BATCH_LANES; l++) {
+			if (BATCH_LANE_IN(group, l)) {
+				Batch_var_lanes[l].halted = 1;
+				Batch_var_lanes[l].exitcode = BATCH_FAULTED;
+			}
+		}
+		Clock_var_halt = 0;
+	}
+
+	Batch_execute(&Batch_var_block, group);
+	Batch_var_groupblocks += 1;
+
+	for (uint32 l = 0; l < BATCH_LANES; l++) {
+		if (BATCH_LANE_IN(group, l)) {
+			Batch_var_lanes[l].cycles += Batch_var_spent[l];
+			if (Batch_var_lanes[l].halted) {
+				Batch_leave(l);
+				group &= ~(0x1 << l);
+			}
+		}
+	}
+	if (group == 0) {
+		return 0;
+	}
+
+	leader = Batch_leader(group);
+	for (uint32 l = leader + 1; l < BATCH_LANES; l++) {
+		if (BATCH_LANE_IN(group, l) && Batch_var_soa.R[15][l] != Batch_var_soa.R[15][leader]) {
+			Batch_leave(l);
+			group &= ~(0x1 << l);
+			Batch_var_splits += 1;
+		}
+	}
+	return group;
+}
+
+static void Batch_scalar(uint32 l) {
+	Batch_lane* lane = &Batch_var_lanes[l];
+	CPU_struct_reg* saved = CPU_var_reg;
+
+	CPU_var_reg = &lane->reg;
+	Batch_bind(lane);
+	lane->cycles += CPU_interpret(&lane->reg);
+	Batch_unbind();
+	CPU_var_reg = saved;
+	Batch_exited(lane);
+	Batch_var_scalarblocks += 1;
+}
+
+// no group: the scalar lanes at the most common pc start a new one
+static uint32 Batch_regroup(uint32 live) {
+	uint32 best = 0, bestcount = 0;
+
+	for (uint32 l = 0; l < BATCH_LANES; l++) {
+		if (!BATCH_LANE_IN(live, l) || Batch_itstate(&Batch_var_lanes[l]) != 0) {
+			continue;
+		}
+		uint32 count = 0;
+		for (uint32 k = 0; k < BATCH_LANES; k++) {
+			count += BATCH_LANE_IN(live, k) && Batch_itstate(&Batch_var_lanes[k]) == 0
+				&& Batch_var_lanes[k].reg.R[15] == Batch_var_lanes[l].reg.R[15];
+		}
+		if (count > bestcount) {
+			best = l;
+			bestcount = count;
+		}
+	}
+	if (bestcount < 2) {
+		return 0;	// nothing to share
+	}
+
+	uint32 group = 0;
+	for (uint32 k = 0; k < BATCH_LANES; k++) {
+		if (BATCH_LANE_IN(live, k) && Batch_itstate(&Batch_var_lanes[k]) == 0
+			&& Batch_var_lanes[k].reg.R[15] == Batch_var_lanes[best].reg.R[15]) {
+			Batch_join(k);
+			group |= 0x1 << k;
+		}
+	}
+	return group;
+}
+
+void Batch_run(uint64_t max_cycles) {
+	// lanes have their own memory, fastmem would reach the shared one
+	uint8* fastmem = Fastmem_var_base;
+	Fastmem_var_base = NULL;
+
+	for (;;) {
+		uint32 group = 0, live = 0;
+		for (uint32 l = 0; l < Batch_var_nlanes; l++) {
+			Batch_lane* lane = &Batch_var_lanes[l];
+			if (lane->halted || lane->cycles >= max_cycles) {
+				if (lane->grouped) {
+					Batch_leave(l);
+				}
+				continue;
+			}
+			live |= 0x1 << l;
+			group |= lane->grouped << l;
+		}
+		if (live == 0) {
+			break;
+		}
+
+		if (group == 0) {
+			group = Batch_regroup(live);
+		}
+		else if (Batch_itstate(&Batch_var_lanes[Batch_leader(group)]) != 0) {
+			// it blocks run scalar, the lanes meet again after it
+			for (uint32 l = 0; l < BATCH_LANES; l++) {
+				if (BATCH_LANE_IN(group, l)) {
+					Batch_leave(l);
+				}
+			}
+			group = 0;
+		}
+
+		uint32 pc = 0;
+		if (group != 0) {
+			group = Batch_group(group);
+			pc = (group != 0) ? Batch_var_soa.R[15][Batch_leader(group)] : 0;
+		}
+
+		for (uint32 l = 0; l < Batch_var_nlanes; l++) {
+			Batch_lane* lane = &Batch_var_lanes[l];
+			if (!BATCH_LANE_IN(live, l) || BATCH_LANE_IN(group, l) || lane->halted) {
+				continue;
+			}
+			if (!lane->grouped) {
+				Batch_scalar(l);
+			}
+			if (group != 0 && !lane->halted && lane->cycles < max_cycles && lane->reg.R[15] == pc && Batch_itstate(lane) == 0) {
+				Batch_join(l);
+			}
+		}
+	}
+
+	Fastmem_var_base = fastmem;
+}
+
+CPU_struct_reg* Batch_reg(uint32 lane) {
+	if (Batch_var_lanes[lane].grouped) {
+		Batch_soa_out(lane);
+	}
+	return &Batch_var_lanes[lane].reg;
+}
+
+void Batch_free() {
+	for (uint32 l = 0; l < BATCH_LANES; l++) {
+		for (uint32 i = 0; i < MEMORY_MAP_MAX_SECTIONS; i++) {
+			if (Batch_var_lanes[l].data[i] != NULL) {
+				free(Batch_var_lanes[l].data[i]);
+				Batch_var_lanes[l].data[i] = NULL;
+			}
+		}
+	}
+	Batch_var_nlanes = 0;
+}
+
+void Batch_init(uint32 nlanes) {
+	Batch_free();
+	m_assert(nlanes <= BATCH_LANES, "batch: too many lanes\\n");
+
+#if BATCH_HAS_AVX2 && defined(__GNUC__)
+	Batch_var_avx2 = __builtin_cpu_supports("avx2") ? 1 : 0;
+#elif BATCH_HAS_AVX2
+	Batch_var_avx2 = 1;
+#endif
+
+	for (uint32 i = 0; i < MEMORY_MAP_MAX_SECTIONS; i++) {
+		Batch_var_shared[i] = (i < Memory_var_arrlen) ? Memory_var_arr[i].data : NULL;
+	}
+
+	Batch_var_nlanes = nlanes;
+	for (uint32 l = 0; l < nlanes; l++) {
+		Batch_lane* lane = &Batch_var_lanes[l];
+		lane->reg = *CPU_var_reg;
+		for (uint32 i = 0; i < Memory_var_arrlen; i++) {
+			Memory_map_elem* thismap = &Memory_var_arr[i];
+			if (MEMORY_IS_DIRECT(thismap)) {
+				// 8 lanes of code + sram don't fit the emu pool, lane copies come from the host heap
+				lane->data[i] = (uint8*)malloc(thismap->size);
+				m_assert(lane->data[i] != NULL, "batch: out of memory for lane copies\n");
+				memcpy(lane->data[i], thismap->data, thismap->size);
+			}
+		}
+		lane->halted = 0;
+		lane->exitcode = 0;
+		lane->cycles = 0;
+		Batch_soa_in(l);
+		lane->grouped = 1;	// everyone starts at the same pc
+	}
+}
+
+/*
+* entry point
+*/
+
+void Batch_setup() {
+	const char* env = getenv(BATCH_ENV);
+	Batch_var_enabled = (env != NULL && env[0] != '\0') ? (uint32)strtoul(env, NULL, 0) : 0;
+	if (Batch_var_enabled > BATCH_LANES) {
+		eprintf("batch: %d lanes at most\n", (int)BATCH_LANES);
+		Batch_var_enabled = BATCH_LANES;
+	}
+}
+
+// <dir>/lane-<l> into the lane's buffer, r0 / r1 like the fuzzer's input
+static void Batch_input(uint32 l, uint32 buffer, const char* dir) {
+	Memory_map_elem* thismap = Memory_getMap(buffer);
+	uint32 room = thismap->base + thismap->size - buffer;
+	uint8* input = (uint8*)malloc(room);
+	m_assert(input != NULL, "batch: out of memory for the input\n");
+
+	char path[1024];
+	snprintf(path, sizeof(path), "%s/lane-%d", dir, (int)l);
+	uint32 size = 0;
+	FILE* fp = fopen(path, "rb");
+	if (fp != NULL) {
+		size = (uint32)fread(input, 1, room, fp);
+		fclose(fp);
+	}
+	else {
+		eprintf("batch: no %s, lane %d runs on an empty input\n", path, (int)l);
+	}
+
+	Batch_write(l, buffer, input, size);
+	free(input);
+	Batch_var_lanes[l].reg.R[0] = buffer;
+	Batch_var_lanes[l].reg.R[1] = size;
+}
+
+void Batch_main() {
+	if (Batch_var_enabled == 0) {
+		return;
+	}
+	if (CPU_var_reg == NULL) {
+		eprintf("batch: no cpu to run\n");
+		return;
+	}
+
+	uint32 buffer = 0;
+	const char* dir = NULL;
+	const char* input = getenv(BATCH_INPUT_ENV);
+	if (input != NULL && input[0] != '\0') {
+		char* end = NULL;
+		buffer = (uint32)strtoul(input, &end, 16);
+		dir = (end != NULL && *end == ',') ? end + 1 : ".";
+		Memory_map_elem* thismap = Memory_getMap(buffer);
+		if (thismap == NULL || !MEMORY_IS_DIRECT(thismap)) {
+			eprintf("batch: input buffer 0x%08x is not in plain memory\n", (int)buffer);
+			return;
+		}
+	}
+	const char* cycles = getenv(BATCH_CYCLES_ENV);
+	uint64_t max_cycles = (cycles != NULL && cycles[0] != '\0') ? strtoull(cycles, NULL, 0) : BATCH_CYCLES;
+
+	Batch_init(Batch_var_enabled);
+	for (uint32 l = 0; l < Batch_var_nlanes; l++) {
+		if (buffer != 0) {
+			Batch_input(l, buffer, dir);
+		}
+		else {
+			Batch_var_lanes[l].reg.R[0] = l;
+		}
+		Batch_soa_in(l);
+	}
+	printf("batch: %d lanes from 0x%08x, input %s\n", (int)Batch_var_nlanes, (int)CPU_var_reg->R[15], (buffer != 0) ? dir : "r0 = lane");
+
+	Batch_run(max_cycles);
+
+	uint32 exitcode = 0;
+	for (uint32 l = 0; l < Batch_var_nlanes; l++) {
+		Batch_lane* lane = &Batch_var_lanes[l];
+		if (!lane->halted) {
+			printf("batch: lane %d: out of cycles, %llu cycles\n", (int)l, (unsigned long long)lane->cycles);
+		}
+		else if (lane->exitcode == BATCH_FAULTED) {
+			printf("batch: lane %d: fault at pc 0x%08x, %llu cycles\n", (int)l, (int)Batch_reg(l)->R[15], (unsigned long long)lane->cycles);
+		}
+		else {
+			printf("batch: lane %d: exit %d, %llu cycles\n", (int)l, (int)lane->exitcode, (unsigned long long)lane->cycles);
+		}
+		if (exitcode == 0 && (!lane->halted || lane->exitcode != 0)) {
+			exitcode = (lane->halted && lane->exitcode != BATCH_FAULTED) ? lane->exitcode : 1;
+		}
+	}
+	printf("batch: %d group blocks, %d scalar blocks, %d splits, %d joins%s\n", (int)Batch_var_groupblocks, (int)Batch_var_scalarblocks,
+		(int)Batch_var_splits, (int)Batch_var_joins, Batch_var_avx2 ? ", avx2" : "");
+
+	Batch_free();
+	Semihost_var_exitcode = exitcode;	// main returns it
+}
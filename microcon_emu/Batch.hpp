@@ -0,0 +1,97 @@
+#pragma once
+#include "Proxy.hpp"
+#include "Memory.hpp"
+#include "CPU.hpp"
+#include "IR.hpp"
+
+/*
+* lockstep batch interpreter: the same firmware on BATCH_LANES instances at once (parameter sweeps)
+*
+* lanes:
+* - Batch_init snapshots the current cpu and memory into every lane. each lane gets a private copy of every
+*   plain memory section (MEMORY_IS_DIRECT), so inputs can be written per lane (Batch_write) before Batch_run.
+* - peripherals, the ppb and the rest of the emulator stay shared.
+*
+* the group:
+* - lanes at the same pc run as one group: the block is lowered once and every IR op is executed for all lanes
+*   over structure-of-arrays registers and temps (Batch_soa). alu ops use avx2 (8 lanes per op) when the host
+*   has it, plain lane loops otherwise.
+* - loads and stores go to each lane's own memory, IR_INTERP runs the handler once per lane on its scalar state.
+* - a conditional exit that only some lanes take, or branches to different targets, split the group:
+*   the lanes that are not at the leader's (lowest lane's) pc leave it.
+*
+* scalar lanes:
+* - a lane out of the group runs one block per round with CPU_interpret on its own state and memory.
+* - it rejoins as soon as it reaches the group's pc again (loops reconverge at their head).
+* - with no group left, the scalar lanes at the most common pc form a new one.
+* - it blocks always run scalar.
+*
+* a lane stops when it exits through semihosting (its own exit code) or when its cycle budget is spent.
+* nothing else (jit, fastmem, mpu sync, irq stats) runs while a batch runs.
+*
+* MICROCON_EMU_BATCH=<lanes> runs the booted image that way, Batch_main instead of the clock loop (Core_mainThread):
+* - MICROCON_EMU_BATCH_INPUT=<hex addr>,<dir>: lane l gets the file <dir>/lane-<l> copied to that guest buffer,
+*   r0 = addr and r1 = length at reset (a missing file is an empty input). unset: r0 = the lane number.
+* - MICROCON_EMU_BATCH_CYCLES: guest cycles each lane may spend (BATCH_CYCLES).
+* every lane's exit code and cycles are printed at the end, the first lane that did not exit with 0 gives
+* the exit code of the emulator.
+*/
+
+#define BATCH_ENV "MICROCON_EMU_BATCH"
+#define BATCH_INPUT_ENV "MICROCON_EMU_BATCH_INPUT"
+#define BATCH_CYCLES_ENV "MICROCON_EMU_BATCH_CYCLES"
+#define BATCH_CYCLES 100000000
+
+#define BATCH_LANES 8	// multiple of 8 (one avx2 register)
+#define BATCH_FAULTED 0xFFFFFFFF	// exitcode of a lane that stopped on a fault
+
+struct Batch_soa {
+	alignas(32) uint32_t R[16][BATCH_LANES];
+	alignas(32) uint32_t N[BATCH_LANES];
+	alignas(32) uint32_t Z[BATCH_LANES];
+	alignas(32) uint32_t C[BATCH_LANES];
+	alignas(32) uint32_t V[BATCH_LANES];
+};
+
+struct Batch_lane {
+	CPU_struct_reg reg;	// scalar state. while grouped, r0 ~ r15 and nzcv live in Batch_var_soa instead
+	uint8* data[MEMORY_MAP_MAX_SECTIONS];	// private section copies (NULL: shared section)
+	uint32 grouped;
+	uint32 halted;
+	uint32 exitcode;
+	uint64_t cycles;
+};
+
+extern struct Batch_soa Batch_var_soa;
+extern struct Batch_lane Batch_var_lanes[BATCH_LANES];
+extern uint32 Batch_var_nlanes;
+extern uint32 Batch_var_enabled;	// lanes MICROCON_EMU_BATCH asked for, 0: off
+extern uint32 Batch_var_avx2;	// vector kernels in use
+
+// telemetry
+extern uint32 Batch_var_groupblocks;	// blocks run for the whole group
+extern uint32 Batch_var_scalarblocks;	// blocks run for a single lane
+extern uint32 Batch_var_splits;
+extern uint32 Batch_var_joins;
+
+// snapshot CPU_var_reg and memory into nlanes lanes (<= BATCH_LANES)
+extern void Batch_init(uint32 nlanes);
+
+// lane memory (private copy if the section has one, shared memory otherwise)
+extern void Batch_write(uint32 lane, uint32 addr, const uint8* src, uint32 size);
+extern void Batch_read(uint32 lane, uint32 addr, uint8* dest, uint32 size);
+
+// lane registers (synced out of the group)
+extern CPU_struct_reg* Batch_reg(uint32 lane);
+
+// run until every lane exited or spent max_cycles
+extern void Batch_run(uint64_t max_cycles);
+
+// drop the lane copies
+extern void Batch_free();
+
+// after Memory_init: MICROCON_EMU_BATCH
+extern void Batch_setup();
+
+// lanes from the booted cpu, their inputs, run them all and report (Core_mainThread)
+extern void Batch_main();
@@ -0,0 +1,13 @@
+#include "Board.hpp"
+
+#ifdef MICROCON_EMU_BOARD_FIXED
+constexpr Board_clocktape Board_var_tape = Board_clocktape_build();
+#endif
+
+void Board_clocks() {
+	for (uint32 i = 0; i < BOARD_CLOCKS; i++) {
+		Clock_struct obj = Board_var_clocks[i];	// Clock_add copies it again
+		Clock_add(i, &obj);
+	}
+	Clock_var_board = 1;
+}
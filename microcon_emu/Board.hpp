@@ -0,0 +1,263 @@
+#pragma once
+#include "Proxy.hpp"
+#include "Memory.hpp"
+#include "Clock.hpp"
+#include "MPU.hpp"
+#include "Nvic.hpp"
+#include "Dwt.hpp"
+#include "Itm.hpp"
+#include "Fuzz.hpp"
+#include "Poll.hpp"
+
+/*
+* board description
+*
+* the one place that says what the board is, all constexpr:
+* - Board_var_regions: memory map. Memory_init adds them in this order, so region i is Memory_var_arr[i].
+* - Board_var_clocks: clock tree, index i is clock object i (master at 0, see Clock_add).
+*   Board_clocks() puts it into the scheduler.
+* - Board_var_peris: register hooks. a store that overlaps [base, base + size) calls write with the address and width
+*   of the whole store, after it has landed in memory. a load from a section above MEMORY_DIRECT_LIMIT that overlaps it
+*   calls read first, for registers worked out on demand (NULL: plain memory). a loop that loads
+*   through one is never skipped as polling (Poll.hpp).
+*
+* the default build runs the scheduler and memory map off the copies made at boot, like before, and can still
+* change them at runtime (Clock_replace, Memory_addMap).
+*
+* -DMICROCON_EMU_BOARD_FIXED (./build.sh board) specializes the build for this board:
+* - Memory_read / Memory_write find the region through an unrolled chain of compares with the bounds as immediates,
+*   no walk of the section list.
+* - the clock tape (Board_var_tape: schedule, link vector, dividers) is built by the compiler. Clock_ready
+*   installs it as is while the tree is the one Board_clocks() put in, and builds one at runtime only after
+*   something replaced an object.
+* - peripheral hooks are unrolled the same way: direct calls behind immediate compares (Board_read / Board_write).
+*/
+
+struct Board_region {
+	uint32 base;
+	uint32 size;	// bytes
+	uint32 attrib;	// MEMORY_ATTRIB_xxx
+};
+
+struct Board_peri {
+	uint32 base;
+	uint32 size;
+	void (*read)(uint32 addr, uint32 width);
+	void (*write)(uint32 addr, uint32 width, uint32 data);
+};
+
+// clocked objects (CPU.cpp)
+extern void CPU_clock();
+
+static inline void Board_mpuWrite(uint32 addr, uint32 width, uint32) {
+	MPU_write(addr, width);
+}
+
+static constexpr Board_region Board_var_regions[] = {
+	{ 0x0, 0x20000, MEMORY_ATTRIB_S_ALL },	// code
+	{ 0x20000000, 0x20000, MEMORY_ATTRIB_S_ALL },	// sram
+	{ 0x40000000, 0x10000, MEMORY_ATTRIB_S_ALL },	// peripherals
+	{ 0xE0000000, 0x20000, MEMORY_ATTRIB_S_ALL },	// ppb
+};
+#define BOARD_REGIONS (sizeof(Board_var_regions) / sizeof(Board_var_regions[0]))
+
+// linked_by, groupid, multiplier, baseclock, objfunc, clock_type
+static constexpr Clock_struct Board_var_clocks[] = {
+	{ 0, 0, 0, 100, NULL, Clock_type_enum::master },	// 0: master, 100hz
+	{ 0, 0, 0, 0, CPU_clock, Clock_type_enum::peri },	// 1: cpu
+};
+#define BOARD_CLOCKS (sizeof(Board_var_clocks) / sizeof(Board_var_clocks[0]))
+static_assert(BOARD_CLOCKS <= CLOCK_MAX_SCHEDULE_SIZE, "too many clock objects for one tape");
+static_assert(Board_var_clocks[0].clock_type == Clock_type_enum::master, "the master clock goes to index 0");
+
+static constexpr Board_peri Board_var_peris[] = {
+	{ MPU_REG_BASE, MPU_REG_SIZE, NULL, Board_mpuWrite },
+	{ NVIC_ISER, NVIC_REGS_SIZE, Nvic_read, Nvic_write },	// enable / pending, set and clear
+	{ NVIC_ICSR, 4, Nvic_read, Nvic_write },
+	{ NVIC_STIR, 4, NULL, Nvic_write },
+	{ DWT_BASE, DWT_SIZE, Dwt_read, Dwt_write },
+	{ DWT_DEMCR, 4, NULL, Dwt_write },
+	{ ITM_BASE, ITM_PORTS * 4, Itm_read, Itm_write },	// stimulus ports
+	{ ITM_TER, 4, NULL, Itm_write },
+	{ ITM_TCR, 4, NULL, Itm_write },
+	{ DWT_DEMCR, 4, NULL, Itm_write },	// TRCENA
+	{ FUZZ_FIFO_BASE, FUZZ_FIFO_SIZE, Fuzz_read, NULL },	// fuzz input
+};
+#define BOARD_PERIS (sizeof(Board_var_peris) / sizeof(Board_var_peris[0]))
+
+// Clock_init, Board_clocks, Clock_ready: the board clock tree into the scheduler
+extern void Board_clocks();
+
+#ifdef MICROCON_EMU_BOARD_FIXED
+
+// region i or the next one, bounds are immediates. ends in NULL past the last region
+template<uint32 i> struct Board_map {
+	static inline Memory_map_elem* get(uint32 addr) {
+		if (addr - Board_var_regions[i].base < Board_var_regions[i].size) {
+			return &Memory_var_arr[i];
+		}
+		return Board_map<i + 1>::get(addr);
+	}
+};
+template<> struct Board_map<BOARD_REGIONS> {
+	static inline Memory_map_elem* get(uint32) {
+		return NULL;
+	}
+};
+
+template<uint32 i> struct Board_hook {
+	static inline void read(uint32 addr, uint32 width) {
+		if (Board_var_peris[i].read != NULL && addr + width > Board_var_peris[i].base && addr < Board_var_peris[i].base + Board_var_peris[i].size) {
+			Poll_var_hooked = 1;
+			Board_var_peris[i].read(addr, width);
+		}
+		Board_hook<i + 1>::read(addr, width);
+	}
+	static inline void write(uint32 addr, uint32 width, uint32 data) {
+		if (Board_var_peris[i].write != NULL && addr + width > Board_var_peris[i].base && addr < Board_var_peris[i].base + Board_var_peris[i].size) {
+			Board_var_peris[i].write(addr, width, data);
+		}
+		Board_hook<i + 1>::write(addr, width, data);
+	}
+};
+template<> struct Board_hook<BOARD_PERIS> {
+	static inline void read(uint32, uint32) {
+	}
+	static inline void write(uint32, uint32, uint32) {
+	}
+};
+
+// the same numbers Clock_ready works out, by the compiler (Clock_ready_getmaxvalperobj)
+static constexpr uint32 Board_clockrate(uint32 index) {
+	uint32 idx = index;
+	uint32 maxval = 100;	// percentage
+	uint32 countermax = 100;
+	if (Board_var_clocks[idx].clock_type == Clock_type_enum::peri) {
+		idx = Board_var_clocks[idx].linked_by;
+	}
+	while (Board_var_clocks[idx].clock_type == Clock_type_enum::midobj) {
+		maxval *= Board_var_clocks[idx].multiplier;
+		countermax *= 100;
+		idx = Board_var_clocks[idx].linked_by;
+	}
+	return Board_var_clocks[0].baseclock * maxval / countermax;
+}
+
+static constexpr uint32 Board_clocklcm() {
+	uint32 lcm = Board_var_clocks[0].baseclock;
+	for (uint32 i = 1; i < BOARD_CLOCKS; i++) {
+		lcm = Clock_lcm(lcm, Board_clockrate(i));
+	}
+	return lcm;
+}
+
+static constexpr uint32 Board_clockgcd() {
+	uint32 gcd = Clock_gcd(Board_clocklcm(), Board_var_clocks[0].baseclock);
+	for (uint32 i = 1; i < BOARD_CLOCKS; i++) {
+		if (Board_var_clocks[i].clock_type == Clock_type_enum::peri) {
+			gcd = Clock_gcd(gcd, Board_clockrate(i));
+		}
+	}
+	return gcd;
+}
+
+#define BOARD_TAPE_SIZE (Board_clocklcm() / Board_clockgcd())
+
+struct Board_clocktape {
+	uint32 maxtickrate;
+	uint32 tickratemul;
+	uint32 maxindex;
+	uint32 vectormode;
+	uint32 tickrate[CLOCK_MAX_SCHEDULE_SIZE];
+	uint32 div[CLOCK_MAX_SCHEDULE_SIZE];
+	uint32 vect[BOARD_TAPE_SIZE];
+	uint32 linkvect[BOARD_TAPE_SIZE];
+};
+
+// Clock_ready, step by step
+static constexpr Board_clocktape Board_clocktape_build() {
+	Board_clocktape tape = {};
+	uint32 gcd = Board_clockgcd();
+
+	tape.maxtickrate = BOARD_TAPE_SIZE;
+	tape.tickratemul = gcd;
+	tape.tickrate[0] = Board_var_clocks[0].baseclock / gcd;
+	for (uint32 i = 1; i < BOARD_CLOCKS; i++) {
+		tape.tickrate[i] = Board_clockrate(i);
+		if (Board_var_clocks[i].clock_type == Clock_type_enum::peri) {
+			tape.tickrate[i] /= gcd;
+		}
+		tape.maxindex = i + 1;
+	}
+
+	// hammer the pins in, every div ticks per peri
+	for (uint32 i = 1; i < tape.maxindex; i++) {
+		if (Board_var_clocks[i].clock_type != Clock_type_enum::peri) {
+			continue;
+		}
+		tape.div[i] = tape.maxtickrate / tape.tickrate[i];
+		for (uint32 j = 0; j < tape.maxtickrate; j += tape.div[i]) {
+			tape.vect[j] |= (0x1 << i);
+		}
+	}
+
+	// two empty slots or more: skip them with the link vector
+	uint32 empty = 0;
+	for (uint32 i = 0; i < tape.maxtickrate; i++) {
+		empty += (tape.vect[i] == 0);
+	}
+	tape.vectormode = (empty >= 2);
+	if (tape.vectormode) {
+		uint32 front_loc = 0;
+		for (uint32 x = tape.maxtickrate; x > 0; x--) {
+			if (tape.vect[x - 1] != 0) {
+				tape.linkvect[x - 1] = front_loc;
+				front_loc = x - 1;
+			}
+		}
+	}
+	return tape;
+}
+
+extern const Board_clocktape Board_var_tape;
+
+#endif
+
+// Memory_read / Memory_write: the hooks of the registers [addr, addr + width) touches
+static inline void Board_read(uint32 addr, uint32 width) {
+#ifdef MICROCON_EMU_BOARD_FIXED
+	Board_hook<0>::read(addr, width);
+#else
+	for (uint32 i = 0; i < BOARD_PERIS; i++) {
+		const Board_peri* peri = &Board_var_peris[i];
+		if (peri->read != NULL && addr + width > peri->base && addr < peri->base + peri->size) {
+			Poll_var_hooked = 1;
+			peri->read(addr, width);
+		}
+	}
+#endif
+}
+
+// some read hook covers [addr, addr + width): loads from there change without a store (Poll_match)
+static inline uint32 Board_readHooked(uint32 addr, uint32 width) {
+	for (uint32 i = 0; i < BOARD_PERIS; i++) {
+		const Board_peri* peri = &Board_var_peris[i];
+		if (peri->read != NULL && addr + width > peri->base && addr < peri->base + peri->size) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static inline void Board_write(uint32 addr, uint32 width, uint32 data) {
+#ifdef MICROCON_EMU_BOARD_FIXED
+	Board_hook<0>::write(addr, width, data);
+#else
+	for (uint32 i = 0; i < BOARD_PERIS; i++) {
+		const Board_peri* peri = &Board_var_peris[i];
+		if (peri->write != NULL && addr + width > peri->base && addr < peri->base + peri->size) {
+			peri->write(addr, width, data);
+		}
+	}
+#endif
+}
@@ -1,9 +1,33 @@
 #include "CPU.hpp"
 #include "Memory.hpp"
+#include "IR.hpp"
+#include "Jit.hpp"
+#include "IrqStat.hpp"
+#include "Nvic.hpp"
+#include "Coverage.hpp"
+#include "Idiom.hpp"
+#include "Poll.hpp"
+#include "Hle.hpp"
+#include "Tier.hpp"
+#include "Clock.hpp"
+#include "Fault.hpp"
+#include "Callprof.hpp"
+#include "Rtos.hpp"
+#include "Fuzz.hpp"
 
 
 struct CPU_struct_reg* CPU_var_reg;
 CPU_op_vect_t** CPU_op_vect;
+uint64_t CPU_var_cycles = 0;
+uint64_t CPU_var_instrs = 0;
+uint64_t CPU_var_lsu = 0;
+uint64_t CPU_var_exccycles = 0;
+uint32 CPU_var_monitor = CPU_MONITOR_OPEN;
+
+static IR_block CPU_var_block;	// lowering scratch
+static vect8 CPU_var_code;	// jit scratch, copied into the cache
+static uint32 CPU_var_poll = 0;	// the block that just ran is a polling loop: guest cycles of one iteration
+static uint32 CPU_var_ahead = 0;	// cycles the last slice ran past its budget
 
 // void CPU_init_insertop(void* func, uint32 opcode){
 // 	CPU_op_vect_t* temp = CPU_op_vect[opcode >> 16];
@@ -20,7 +44,8 @@ void CPU_init(uint32 pc_pos, uint32 sp_pos) {
 	// set start pc
 	CPU_var_reg->R[15] = pc_pos;
 	CPU_var_reg->R[13] = CPU_var_reg->MSP = sp_pos;	// starts with kernel, so MSP
-
+	CPU_var_reg->R[14] = 0xFFFFFFFF;	// reset value
+	CPU_var_reg->xPSR.raw = 0x01000000;	// thumb
 
 }
 
@@ -37,3 +62,284 @@ void CPU_fetch() {
 
 }
 
+
+// exception entry: r0-r3, r12, lr, return address, xpsr onto the current stack as one 8 word block transfer.
+// 8 byte alignment (CCR.STKALIGN) is recorded in bit 9 of the stacked xpsr
+void CPU_pushFrame(CPU_struct_reg* reg, uint32 return_address) {
+	uint32 sp = reg->R[13];
+	uint32 realign = ((reg->CCR >> 9) & 0x1) && (sp & 0x4);
+	uint32 frameptr = (sp - CPU_FRAME_SIZE) & ~(realign << 2);
+	uint32 frame[8] = { reg->R[0], reg->R[1], reg->R[2], reg->R[3], reg->R[12], reg->R[14], return_address,
+		(reg->xPSR.raw & ~(0x1 << 9)) | (realign << 9) };
+
+	Memory_writeWords(frameptr, frame, 8, MEMORY_ATTRIB_S_W);
+	if (Memory_var_access_err != 0) {
+		return;	// stacking error, sp unchanged
+	}
+	reg->R[13] = frameptr;
+}
+
+// exception return: the same frame back, pc from the frame, sp past it (and the alignment word)
+void CPU_popFrame(CPU_struct_reg* reg) {
+	uint32 frame[8];
+
+	Memory_readWords(reg->R[13], frame, 8, MEMORY_ATTRIB_S_R);
+	if (Memory_var_access_err != 0) {
+		return;	// unstacking error, nothing restored
+	}
+	reg->R[0] = frame[0];
+	reg->R[1] = frame[1];
+	reg->R[2] = frame[2];
+	reg->R[3] = frame[3];
+	reg->R[12] = frame[4];
+	reg->R[14] = frame[5];
+	reg->R[15] = frame[6] & ~0x1;
+	reg->R[13] += CPU_FRAME_SIZE + (((frame[7] >> 9) & 0x1) << 2);
+	reg->xPSR.raw = frame[7] & ~(0x1 << 9);
+}
+
+uint32 CPU_exceptionEntry(CPU_struct_reg* reg, uint32 exception, uint32 return_address) {
+	uint32 handler = (reg->xPSR.IPSR.exception != 0);
+	uint32 psp = !handler && reg->CONTROL.SPSEL;
+
+	CPU_pushFrame(reg, return_address);
+	if (psp) {
+		reg->PSP = reg->R[13];
+		reg->R[13] = reg->MSP;
+		reg->CONTROL.SPSEL = 0;
+	}
+	reg->R[14] = handler ? 0xFFFFFFF1 : psp ? 0xFFFFFFFD : 0xFFFFFFF9;
+	reg->xPSR.IPSR.exception = exception;
+	CPU_var_monitor = CPU_MONITOR_OPEN;
+	reg->xPSR.EPSR.ICIT0 = 0;
+	reg->xPSR.EPSR.ICIT1 = 0;
+
+	uint32 vtor = 0;
+	uint8* data = (uint8*)Memory_read(CPU_VTOR, Memory_enum_size::u32, MEMORY_ATTRIB_S_R);
+	if (data != NULL) {
+		vtor = (data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32)data[3] << 24)) & 0xFFFFFF80;
+	}
+	data = (uint8*)Memory_read(vtor + (exception << 2), Memory_enum_size::u32, MEMORY_ATTRIB_S_R);
+	reg->R[15] = (data != NULL) ? (data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32)data[3] << 24)) & ~0x1 : 0;
+	RTOS_ENTRY(reg, !handler);
+	CALLPROF_EXCEPTION(reg, return_address);
+	CPU_var_exccycles += CPU_ENTRY_CYCLES;
+	return CPU_ENTRY_CYCLES;
+}
+
+uint32 CPU_exceptionReturn(CPU_struct_reg* reg) {
+	uint32 excret = reg->R[15];
+
+	// bit 2: back to thread mode on psp, the frame is there. bit 0 is gone already, branches to pc clear it
+	if ((excret & 0xC) == 0xC) {
+		reg->MSP = reg->R[13];
+		reg->R[13] = reg->PSP;
+		reg->CONTROL.SPSEL = 1;
+	}
+	CPU_popFrame(reg);
+	CPU_var_monitor = CPU_MONITOR_OPEN;
+	RTOS_RETURN(reg);
+	CALLPROF_EXC_RETURN();
+	CPU_var_exccycles += CPU_EXIT_CYCLES;
+	return CPU_EXIT_CYCLES;
+}
+
+// run one block starting at pc through the IR interpreter, whatever the host. returns the guest cycles spent
+uint32 CPU_interpret(CPU_struct_reg* reg) {
+	uint32 itstate = (reg->xPSR.EPSR.ICIT0 << 2) | reg->xPSR.EPSR.ICIT1;
+	uint32 cycles;
+
+	CPU_var_poll = 0;
+	if (itstate != 0) {
+		// inside an it block: one conditional instruction at a time, never cached
+		IR_lower(&CPU_var_block, reg->R[15], itstate);
+		IR_optimize(&CPU_var_block);
+		COVERAGE_MARK(CPU_var_block.guest_start, CPU_var_block.guest_end);
+		cycles = IR_execute(&CPU_var_block, reg);
+		COVERAGE_PATH(CPU_var_block.guest_start, IR_RETIRED_INSTRS(IR_var_retired));
+
+		// ITAdvance()
+		if ((itstate & 0x7) == 0) {
+			itstate = 0;
+		}
+		else {
+			itstate = (itstate & 0xE0) | ((itstate << 1) & 0x1F);
+		}
+		reg->xPSR.EPSR.ICIT0 = (itstate >> 2) & 0x3F;
+		reg->xPSR.EPSR.ICIT1 = itstate & 0x3;
+		return cycles;
+	}
+
+	IR_lower(&CPU_var_block, reg->R[15], 0);
+	IR_optimize(&CPU_var_block);
+	COVERAGE_MARK(CPU_var_block.guest_start, CPU_var_block.guest_end);
+
+	// copy / fill / scan loop: all but the last iteration in bulk
+	cycles = Idiom_run(Idiom_match(&CPU_var_block), reg);
+	CPU_var_poll = Poll_match(&CPU_var_block);
+	cycles += IR_execute(&CPU_var_block, reg);
+	COVERAGE_PATH(CPU_var_block.guest_start, IR_RETIRED_INSTRS(IR_var_retired));
+	return cycles;
+}
+
+// run one block starting at pc: jit code from the cache if the host can run it, IR interpreter otherwise.
+// returns the guest cycles spent
+static uint32 CPU_run(CPU_struct_reg* reg) {
+#if JIT_HOST_X86
+	if (reg->xPSR.EPSR.ICIT0 != 0 || reg->xPSR.EPSR.ICIT1 != 0) {
+		return CPU_interpret(reg);
+	}
+
+	TIER_INSTALL();
+	JitCache_block* block = JitCache_lookup(reg->R[15]);
+	if (block == NULL && Tier_var_enabled) {
+		// not compiled (yet): the interpreter runs it, the compile thread gets it once it is hot
+		if (Tier_hot(reg->R[15])) {
+			IR_lower(&CPU_var_block, reg->R[15], 0);
+			IR_optimize(&CPU_var_block);
+			Tier_submit(&CPU_var_block);
+		}
+		return CPU_interpret(reg);
+	}
+	if (block == NULL) {
+		IR_lower(&CPU_var_block, reg->R[15], 0);
+		IR_optimize(&CPU_var_block);
+
+		CPU_var_code.clear();
+		Jit_compile(&CPU_var_block, &CPU_var_code);
+		block = JitCache_insert(CPU_var_block.guest_start, CPU_var_block.guest_end, CPU_var_code.data(), CPU_var_code.size(),
+			Jit_var_relocs, Jit_var_nrelocs);
+		if (block == NULL) {
+			// did not fit, run it once through the interpreter
+			COVERAGE_MARK(CPU_var_block.guest_start, CPU_var_block.guest_end);
+			uint32 cycles = Idiom_run(Idiom_match(&CPU_var_block), reg);
+			CPU_var_poll = Poll_match(&CPU_var_block);
+			cycles += IR_execute(&CPU_var_block, reg);
+			COVERAGE_PATH(CPU_var_block.guest_start, IR_RETIRED_INSTRS(IR_var_retired));
+			return cycles;
+		}
+		block->idiom = Idiom_match(&CPU_var_block);
+		block->poll = Poll_match(&CPU_var_block);
+	}
+	CPU_var_poll = block->poll;
+	// coverage: once per block, on its first dispatch
+	if (Coverage_var_enabled && !Coverage_var_paths && !block->covered) {
+		Coverage_mark(block->guest_start, block->guest_end);
+		block->covered = 1;
+	}
+	uint32 cycles = 0;
+	if (block->idiom != 0) {
+		cycles = Idiom_run(block->idiom, reg);
+	}
+	cycles += ((Jit_func)block->host_code)();
+
+	// paths: once per block and exit, after it ran
+	if (Coverage_var_paths) {
+		uint32 instrs = IR_RETIRED_INSTRS(IR_var_retired);
+		uint32 bit = 0x1 << ((instrs - 1) & 0x1F);
+		if ((block->exits & bit) == 0) {
+			block->exits |= bit;
+			Coverage_markPath(block->guest_start, instrs);
+		}
+	}
+	return cycles;
+#else
+	return CPU_interpret(reg);
+#endif
+}
+
+uint32 CPU_step() {
+	CPU_struct_reg* reg = CPU_var_reg;
+
+	// a pending exception that preempts: the block is its handler's first
+	uint32 entry = NVIC_STEP(reg);
+	CPU_var_cycles += entry;
+
+	// privilege can only change between blocks (msr, exception entry/return)
+	if (MPU_var_ctrl & MPU_CTRL_ENABLE) {
+		MPU_sync(reg);
+	}
+
+	// handler entry / resume after exception return
+	IRQSTAT_STEP(reg);
+
+	uint32 start = reg->R[15];
+	uint32 cycles = 0;
+
+	// libgcc / newlib helper: on the host, straight back to lr
+	if (HLE_TEST(start)) {
+		cycles = Hle_call(reg);
+	}
+	if (cycles == 0) {
+		cycles = CPU_run(reg);
+		CPU_var_instrs += IR_RETIRED_INSTRS(IR_var_retired);
+		CPU_var_lsu += IR_RETIRED_LSU(IR_var_retired);
+		IR_var_elapsed = 0;
+	}
+
+	// spinning on a status register: nothing changes until the next event, skip the rounds up to it
+	if (CPU_var_poll != 0 && reg->R[15] == start) {
+		cycles += Poll_skip(CPU_var_poll, cycles);
+	}
+	CPU_var_cycles += cycles;
+	HLE_AFTER(reg);
+
+	// block left with EXC_RETURN in pc. the unstacking is what the resume latency sees first
+	IRQSTAT_AFTER(reg);
+	if (CPU_IS_EXC_RETURN(reg)) {
+		uint32 exit = CPU_exceptionReturn(reg);
+		CPU_var_cycles += exit;
+		cycles += exit;
+	}
+
+	// shadow call stack: whatever the block called or returned to
+	CALLPROF_STEP(reg, start);
+	RTOS_STEP(reg);
+
+	// fuzzing: the harness entry returned
+	FUZZ_STEP(reg);
+	return entry + cycles;
+}
+
+uint32 CPU_slice(uint32 budget) {
+	volatile uint32 used = 0;	// survives the longjmp
+	jmp_buf env;
+
+	// a guest access faulted somewhere in the block: take it at that instruction (Fault.hpp).
+	// what the block ran before it is not charged
+	if (setjmp(env) != 0) {
+		uint32 cycles = Fault_take(CPU_var_reg);
+		CPU_var_cycles += cycles;
+		used += cycles;
+	}
+	Fault_var_jmp = &env;
+
+	while (used < budget && !Clock_var_halt) {
+		Poll_var_budget = budget - used;
+		used += CPU_step();
+	}
+	Poll_var_budget = 0;
+	Fault_var_jmp = NULL;
+	return used;
+}
+
+void CPU_clock() {
+	uint32 avail = CLOCK_GET_AVAILABLE_CYCLES();
+
+	// no image: nothing to run, the time passes anyway
+	if (CPU_var_reg == NULL || Clock_var_halt) {
+		CLOCK_SET_USE_CYCLES = avail;
+		return;
+	}
+
+	// the last block of a slice runs past it: the next slice starts that much later
+	if (CPU_var_ahead >= avail) {
+		CPU_var_ahead -= avail;
+		CLOCK_SET_USE_CYCLES = avail;
+		return;
+	}
+	uint32 budget = avail - CPU_var_ahead;
+	uint32 used = CPU_slice(budget);
+	CPU_var_ahead = (used > budget) ? used - budget : 0;
+	CLOCK_SET_USE_CYCLES = avail;
+}
@@ -383,11 +383,52 @@ typedef enum CPU_op_enum {
 } CPU_op_enum;
 
 extern struct CPU_struct_reg* CPU_var_reg;
+extern uint64_t CPU_var_cycles;	// guest cycles retired by CPU_step
+extern uint64_t CPU_var_instrs;	// guest instructions retired by CPU_step (hle calls, bulk idiom / poll rounds: none)
+extern uint64_t CPU_var_lsu;	// of CPU_var_cycles: extra cycles of loads / stores past their first
+extern uint64_t CPU_var_exccycles;	// of CPU_var_cycles: exception entry and return
 
 // functions
 
-extern void CPU_init(uint32 pc_pos);
+extern void CPU_init(uint32 pc_pos, uint32 sp_pos);
 
 // execute one cycle
 extern void CPU_fetch();
 
+// execute one block (IR interpreter or jit), returns guest cycles spent
+extern uint32 CPU_step();
+
+// execute blocks until 'budget' guest cycles are used (the last block may run past it), returns the cycles used.
+// budget is the time until the next scheduled event (CLOCK_GET_AVAILABLE_CYCLES() for a cpu clock object),
+// a polling loop skips ahead to it
+extern uint32 CPU_slice(uint32 budget);
+
+// the cpu clock object (Board_var_clocks): CPU_slice(CLOCK_GET_AVAILABLE_CYCLES()), what ran past it is taken off the next one
+extern void CPU_clock();
+
+// execute one block of reg with the IR interpreter (no jit, no cycle count, no hooks)
+extern uint32 CPU_interpret(CPU_struct_reg* reg);
+
+// basic exception stack frame (8 words), moved with one block transfer.
+// the stack pointer is r13 as it is at the time of the call
+#define CPU_FRAME_SIZE 0x20
+extern void CPU_pushFrame(CPU_struct_reg* reg, uint32 return_address);
+extern void CPU_popFrame(CPU_struct_reg* reg);
+
+// exception entry: frame on the current stack, lr = EXC_RETURN, handler mode on msp, pc from the vector table.
+// returns the guest cycles it took
+#define CPU_ENTRY_CYCLES 12
+#define CPU_VTOR 0xE000ED08
+extern uint32 CPU_exceptionEntry(CPU_struct_reg* reg, uint32 exception, uint32 return_address);
+
+// local exclusive monitor: the address of the last LDREX, CPU_MONITOR_OPEN after STREX / CLREX.
+// exception entry and return clear it too
+#define CPU_MONITOR_OPEN 0xFFFFFFFF
+extern uint32 CPU_var_monitor;
+
+// exception return: EXC_RETURN in pc while in handler mode (checked after every block).
+// returns the guest cycles of the unstacking
+#define CPU_IS_EXC_RETURN(reg) ((reg)->xPSR.IPSR.exception != 0 && ((reg)->R[15] & 0xF0000000) == 0xF0000000)
+#define CPU_EXIT_CYCLES 10
+extern uint32 CPU_exceptionReturn(CPU_struct_reg* reg);
+
@@ -1,5 +1,9 @@
 #include "CPU.hpp"
 #include "Memory.hpp"
+#include "Semihost.hpp"
+#include "Fault.hpp"
+#include "Nvic.hpp"
+#include "Fuzz.hpp"	// Fuzz_var_running
 
 /*
  * ARMv7-M Instruction Implementation Bodies
@@ -15,1246 +19,1907 @@
  * for instruction decoding and execution.
  */
 
+/*
+* block transfers (LDM / STM / PUSH / POP)
+* the register list goes to ascending addresses, lowest register first.
+* all words move with one Memory_readWords / Memory_writeWords, so the section and permissions are resolved once.
+* 16bit encodings come in as the halfword, 32bit ones as hw1 << 16 | hw2.
+*/
+static uint32 INSTR_regcount(uint32 list) {
+	uint32 count = 0;
+	for (; list != 0; list &= list - 1) {
+		count += 1;
+	}
+	return count;
+}
+
+// LoadWritePC: EXC_RETURN in handler mode is kept as is for the exception return, otherwise interworking
+static void INSTR_loadWritePC(CPU_struct_reg* reg, uint32 value) {
+	if (reg->xPSR.IPSR.exception != 0 && (value & 0xF0000000) == 0xF0000000) {
+		reg->R[15] = value;
+		return;
+	}
+	reg->R[15] = value & ~0x1;
+}
+
+// returns 0 if the store faulted (no writeback then). under CPU_slice a fault does not come back (Fault.hpp)
+static uint32 INSTR_storeMultiple(CPU_struct_reg* reg, uint32 address, uint32 list) {
+	uint32 words[16];
+	uint32 count = 0;
+	for (uint32 r = 0; r < 16; r++) {
+		if ((list >> r) & 0x1) {
+			words[count++] = reg->R[r];
+		}
+	}
+	Memory_writeWords(address, words, count, MEMORY_ATTRIB_S_W);
+	if (Memory_var_access_err != 0) {
+		FAULT_ACCESS(address, MEMORY_ATTRIB_S_W);
+		return 0;
+	}
+	return 1;
+}
+
+// returns 0 if the load faulted (registers untouched then). under CPU_slice a fault does not come back
+static uint32 INSTR_loadMultiple(CPU_struct_reg* reg, uint32 address, uint32 list, uint32 rn, uint32 wback, uint32 wback_value) {
+	uint32 words[16];
+	uint32 count = INSTR_regcount(list);
+	Memory_readWords(address, words, count, MEMORY_ATTRIB_S_R);
+	if (Memory_var_access_err != 0) {
+		FAULT_ACCESS(address, MEMORY_ATTRIB_S_R);
+		return 0;
+	}
+
+	uint32 i = 0;
+	for (uint32 r = 0; r < 15; r++) {
+		if ((list >> r) & 0x1) {
+			reg->R[r] = words[i++];
+		}
+	}
+	if (wback && !((list >> rn) & 0x1)) {
+		reg->R[rn] = wback_value;
+	}
+	if ((list >> 15) & 0x1) {
+		INSTR_loadWritePC(reg, words[i]);
+	}
+	return 1;
+}
+
+/*
+* the other handlers get what the IR does not lower (IR_lower16 / IR_lower32), in the 32bit encoding unless
+* noted. they run with R[15] at their own instruction: INSTR_getreg gives pc + 4 like the architecture, a branch
+* writes R[15] (IR_do_interp moves on to the next instruction otherwise). a guest access that fails raises its
+* fault, like the block transfers. values are computed in uint32_t, uint32 is wider on some hosts.
+* hints and barriers have empty bodies: accesses complete in order, and WFI / WFE have no low power state to
+* enter (the loop around them spins until the event comes).
+*/
+#define INSTR_SHIFT_RRX 4	// shift type 3 with amount 0, after DecodeImmShift
+
+static uint32_t INSTR_getreg(CPU_struct_reg* reg, uint32 r) {
+	return (uint32_t)((r == 15) ? reg->R[15] + 4 : reg->R[r]);
+}
+
+// decoded, but not run here: the IR lowers it, or nothing emulates it (yet). loud, and an undefined instruction for the guest
+static void INSTR_unimplemented(const char* name, uint32 instr, CPU_struct_reg* reg) {
+	if (!Fuzz_var_running) {	// fuzzing reports each crash site once (Fuzz_triage)
+		printf("cpu: %s (%08x) at pc %08x is not implemented\n", name, (unsigned)instr, (unsigned)reg->R[15]);
+	}
+	Fault_raise(FAULT_USAGE, FAULT_UNDEFINSTR, 0);
+}
+
+// coprocessor space, the fpu included: there is no coprocessor
+static void INSTR_nocp(uint32 instr, CPU_struct_reg* reg) {
+	if (!Fuzz_var_running) {
+		printf("cpu: coprocessor instruction %08x at pc %08x, no coprocessor\n", (unsigned)instr, (unsigned)reg->R[15]);
+	}
+	Fault_raise(FAULT_USAGE, FAULT_NOCP, 0);
+}
+
+static uint32_t INSTR_read(uint32 addr, uint32 sizetype) {
+	uint8* data = (uint8*)Memory_read(addr, (Memory_enum_size)sizetype, MEMORY_ATTRIB_S_R);
+	if (data == NULL) {
+		FAULT_ACCESS(addr, MEMORY_ATTRIB_S_R);
+		return 0;
+	}
+	switch (sizetype) {
+	case Memory_enum_size::u8: return data[0];
+	case Memory_enum_size::u16: return data[0] | (data[1] << 8);
+	default: return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+	}
+}
+
+// returns 0 if the store faulted
+static uint32 INSTR_write(uint32 addr, uint32_t value, uint32 sizetype) {
+	Memory_write(addr, (Memory_enum_size)sizetype, value, MEMORY_ATTRIB_S_W);
+	if (Memory_var_access_err != 0) {
+		FAULT_ACCESS(addr, MEMORY_ATTRIB_S_W);
+		return 0;
+	}
+	return 1;
+}
+
+static void INSTR_setnz(CPU_struct_reg* reg, uint32_t result) {
+	reg->xPSR.APSR.N = (result >> 31) & 0x1;
+	reg->xPSR.APSR.Z = (result == 0);
+}
+
+// AddWithCarry, nzcv with setflags
+static uint32_t INSTR_addc(CPU_struct_reg* reg, uint32_t a, uint32_t b, uint32_t carry, uint32 setflags) {
+	uint32_t result = a + b + carry;
+	if (setflags) {
+		INSTR_setnz(reg, result);
+		reg->xPSR.APSR.C = carry ? (result <= a) : (result < a);
+		reg->xPSR.APSR.V = (~(a ^ b) & (a ^ result)) >> 31;
+	}
+	return result;
+}
+
+// Shift_C: type lsl / lsr / asr / ror / rrx. carry goes in and comes out. register amounts use their bottom byte
+static uint32_t INSTR_shiftc(uint32_t value, uint32 type, uint32 amount, uint32* carry) {
+	if (type == INSTR_SHIFT_RRX) {
+		uint32_t result = (value >> 1) | ((uint32_t)*carry << 31);
+		*carry = value & 0x1;
+		return result;
+	}
+	amount &= 0xFF;
+	if (amount == 0) {
+		return value;
+	}
+	switch (type) {
+	case 0:
+		*carry = (amount > 32) ? 0 : (uint32)((value >> (32 - amount)) & 0x1);
+		return (amount >= 32) ? 0 : value << amount;
+	case 1:
+		*carry = (amount > 32) ? 0 : (uint32)((value >> (amount - 1)) & 0x1);
+		return (amount >= 32) ? 0 : value >> amount;
+	case 2:
+		if (amount >= 32) {
+			*carry = value >> 31;
+			return (uint32_t)((int32_t)value >> 31);
+		}
+		*carry = (value >> (amount - 1)) & 0x1;
+		return (uint32_t)((int32_t)value >> amount);
+	default:
+		amount &= 0x1F;
+		value = (amount == 0) ? value : (value >> amount) | (value << (32 - amount));
+		*carry = value >> 31;
+		return value;
+	}
+}
+
+// DecodeImmShift of a shifted register operand: imm3:imm2, type in hw2
+static uint32_t INSTR_immshift(uint32 instr, uint32_t value, uint32* carry) {
+	uint32 type = (instr >> 4) & 0x3;
+	uint32 imm5 = (((instr >> 12) & 0x7) << 2) | ((instr >> 6) & 0x3);
+	if (type != 0 && imm5 == 0) {
+		return INSTR_shiftc(value, (type == 3) ? INSTR_SHIFT_RRX : type, 32, carry);
+	}
+	return INSTR_shiftc(value, type, imm5, carry);
+}
+
+// ThumbExpandImm_C
+static uint32_t INSTR_expandimm(uint32 instr, uint32* carry) {
+	uint32 imm12 = (((instr >> 26) & 0x1) << 11) | (((instr >> 12) & 0x7) << 8) | (instr & 0xFF);
+	uint32_t imm8 = imm12 & 0xFF;
+	if ((imm12 >> 10) == 0) {
+		switch ((imm12 >> 8) & 0x3) {
+		case 0: return imm8;
+		case 1: return (imm8 << 16) | imm8;
+		case 2: return (imm8 << 24) | (imm8 << 8);
+		default: return (imm8 << 24) | (imm8 << 16) | (imm8 << 8) | imm8;
+		}
+	}
+	return INSTR_shiftc(0x80 | (imm12 & 0x7F), 3, imm12 >> 7, carry);
+}
+
+// a scb register, as the guest left it (FAULT_CCR ...)
+static uint32_t INSTR_scb(uint32 addr) {
+	uint8* data = (uint8*)Memory_read(addr, Memory_enum_size::u32, MEMORY_ATTRIB_S_R);
+	return (data == NULL) ? 0 : data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+static uint32 INSTR_privileged(CPU_struct_reg* reg) {
+	return reg->xPSR.IPSR.exception != 0 || !reg->CONTROL.nPRIV;
+}
+
+// r13 is the stack in use, MSP / PSP keep the other one
+static uint32 INSTR_onmsp(CPU_struct_reg* reg) {
+	return reg->xPSR.IPSR.exception != 0 || !reg->CONTROL.SPSEL;
+}
+
+/*
+* data processing, modified immediate and shifted register: one body, the handler says which op.
+* rn = pc moves and rd = pc compares come here already told apart (IR_lowerdp), rrx is ror #0
+*/
+enum INSTR_dp_enum {
+	INSTR_DP_AND, INSTR_DP_BIC, INSTR_DP_ORR, INSTR_DP_ORN, INSTR_DP_EOR, INSTR_DP_ADD, INSTR_DP_ADC, INSTR_DP_SBC,
+	INSTR_DP_SUB, INSTR_DP_RSB, INSTR_DP_MOV, INSTR_DP_MVN, INSTR_DP_TST, INSTR_DP_TEQ, INSTR_DP_CMN, INSTR_DP_CMP,
+};
+
+static void INSTR_dp(uint32 instr, CPU_struct_reg* reg, uint32 op) {
+	uint32 rd = (instr >> 8) & 0xF;
+	uint32 s = (instr >> 20) & 0x1;
+	uint32 carry = reg->xPSR.APSR.C;
+	uint32_t a = INSTR_getreg(reg, (instr >> 16) & 0xF);
+	uint32_t b = (((instr >> 16) & 0xFE00) == 0xEA00) ? INSTR_immshift(instr, INSTR_getreg(reg, instr & 0xF), &carry)
+		: INSTR_expandimm(instr, &carry);
+	uint32_t result = 0;
+	uint32 logical = 1;
+
+	switch (op) {
+	case INSTR_DP_AND: case INSTR_DP_TST: result = a & b; break;
+	case INSTR_DP_BIC: result = a & ~b; break;
+	case INSTR_DP_ORR: result = a | b; break;
+	case INSTR_DP_ORN: result = a | ~b; break;
+	case INSTR_DP_EOR: case INSTR_DP_TEQ: result = a ^ b; break;
+	case INSTR_DP_MOV: result = b; break;
+	case INSTR_DP_MVN: result = ~b; break;
+	default:
+		logical = 0;
+		switch (op) {
+		case INSTR_DP_ADD: case INSTR_DP_CMN: result = INSTR_addc(reg, a, b, 0, s); break;
+		case INSTR_DP_ADC: result = INSTR_addc(reg, a, b, reg->xPSR.APSR.C, s); break;
+		case INSTR_DP_SBC: result = INSTR_addc(reg, a, ~b, reg->xPSR.APSR.C, s); break;
+		case INSTR_DP_RSB: result = INSTR_addc(reg, ~a, b, 1, s); break;
+		default: result = INSTR_addc(reg, a, ~b, 1, s); break;
+		}
+		break;
+	}
+	if (logical && s) {
+		INSTR_setnz(reg, result);
+		reg->xPSR.APSR.C = carry;
+	}
+
+	if (op >= INSTR_DP_TST) {
+		return;
+	}
+	if (rd == 15) {
+		reg->R[15] = result & ~0x1;	// unpredictable, branch like the 16bit forms
+		return;
+	}
+	reg->R[rd] = result;
+}
+
+// SXTB / SXTH / UXTB / UXTH (T2) and the forms adding rn (rn != pc): rm rotated right by 8 * rotate
+static void INSTR_extend(uint32 instr, CPU_struct_reg* reg, uint32_t mask, uint32 sign) {
+	uint32 rn = (instr >> 16) & 0xF;
+	uint32 rotation = ((instr >> 4) & 0x3) << 3;
+	uint32_t value = (uint32_t)reg->R[instr & 0xF];
+	if (rotation != 0) {
+		value = (value >> rotation) | (value << (32 - rotation));
+	}
+	value &= mask;
+	if (sign && (value & ((mask >> 1) + 1))) {
+		value |= ~mask;
+	}
+	if (rn != 15) {
+		value += (uint32_t)reg->R[rn];
+	}
+	reg->R[(instr >> 8) & 0xF] = value;
+}
+
+// rd / rm of the 16bit (T1) or 32bit byte reversals
+static void INSTR_rev(uint32 instr, CPU_struct_reg* reg, uint32 op) {
+	uint32 rd = (instr >> 16) ? (instr >> 8) & 0xF : instr & 0x7;
+	uint32_t value = (uint32_t)reg->R[(instr >> 16) ? instr & 0xF : (instr >> 3) & 0x7];
+	switch (op) {
+	case REV:
+		value = (value >> 24) | ((value >> 8) & 0xFF00) | ((value << 8) & 0xFF0000) | (value << 24);
+		break;
+	case REV16:
+		value = ((value >> 8) & 0x00FF00FF) | ((value << 8) & 0xFF00FF00);
+		break;
+	default:	// REVSH
+		value = (uint32_t)(int32_t)(int16_t)(((value >> 8) & 0xFF) | ((value & 0xFF) << 8));
+		break;
+	}
+	reg->R[rd] = value;
+}
+
+// 64bit results of the long multiplies: rdlo, rdhi
+static void INSTR_setlong(CPU_struct_reg* reg, uint32 instr, uint64_t value) {
+	reg->R[(instr >> 12) & 0xF] = (uint32_t)value;
+	reg->R[(instr >> 8) & 0xF] = (uint32_t)(value >> 32);
+}
+
+static uint64_t INSTR_getlong(CPU_struct_reg* reg, uint32 instr) {
+	return ((uint64_t)(uint32_t)reg->R[(instr >> 8) & 0xF] << 32) | (uint32_t)reg->R[(instr >> 12) & 0xF];
+}
+
+// UDIV / SDIV by zero: the result is 0, or a usagefault with CCR.DIV_0_TRP
+static void INSTR_divzero(uint32 instr, CPU_struct_reg* reg) {
+	if (INSTR_scb(FAULT_CCR) & FAULT_CCR_DIV_0_TRP) {
+		Fault_raise(FAULT_USAGE, FAULT_DIVBYZERO, 0);
+		return;
+	}
+	reg->R[(instr >> 8) & 0xF] = 0;
+}
+
 // ===== ADC - Add with Carry =====
 void INSTR_ADC_IMMEDIATE(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute ADC (immediate)
+	INSTR_dp(instr, reg, INSTR_DP_ADC);
 }
 
 void INSTR_ADC_REGISTER(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute ADC (register)
+	INSTR_dp(instr, reg, INSTR_DP_ADC);
 }
 
 // ===== ADD - Addition =====
 void INSTR_ADD_IMMEDIATE(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute ADD (immediate)
+	INSTR_dp(instr, reg, INSTR_DP_ADD);
 }
 
 void INSTR_ADD_REGISTER(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute ADD (register)
+	INSTR_dp(instr, reg, INSTR_DP_ADD);
 }
 
 void INSTR_ADD_SP_PLUS_IMMEDIATE(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute ADD (SP plus immediate)
+	INSTR_unimplemented("ADD (SP plus immediate)", instr, reg);
 }
 
 void INSTR_ADD_SP_PLUS_REGISTER(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute ADD (SP plus register)
+	INSTR_unimplemented("ADD (SP plus register)", instr, reg);
 }
 
 // ===== ADR - Form PC-relative Address =====
 void INSTR_ADR(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute ADR
+	INSTR_unimplemented("ADR", instr, reg);
 }
 
 // ===== AND - Logical AND =====
 void INSTR_AND_IMMEDIATE(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute AND (immediate)
+	INSTR_dp(instr, reg, INSTR_DP_AND);
 }
 
 void INSTR_AND_REGISTER(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute AND (register)
+	INSTR_dp(instr, reg, INSTR_DP_AND);
 }
 
 // ===== ASR - Arithmetic Shift Right =====
 void INSTR_ASR_IMMEDIATE(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute ASR (immediate)
+	INSTR_unimplemented("ASR (immediate)", instr, reg);
 }
 
 void INSTR_ASR_REGISTER(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute ASR (register)
+	INSTR_unimplemented("ASR (register)", instr, reg);
 }
 
 // ===== B - Branch =====
 void INSTR_B(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute B (conditional and unconditional)
+	INSTR_unimplemented("B (conditional and unconditional)", instr, reg);
 }
 
 // ===== BFC - Bit Field Clear =====
 void INSTR_BFC(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute BFC
+	uint32 lsb = (((instr >> 12) & 0x7) << 2) | ((instr >> 6) & 0x3);
+	uint32 msb = instr & 0x1F;
+	uint32 rd = (instr >> 8) & 0xF;
+	if (msb >= lsb) {
+		uint32_t mask = (uint32_t)((((uint64_t)0x1 << (msb - lsb + 1)) - 1) << lsb);
+		reg->R[rd] = (uint32_t)reg->R[rd] & ~mask;
+	}
 }
 
 // ===== BFI - Bit Field Insert =====
 void INSTR_BFI(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute BFI
+	uint32 lsb = (((instr >> 12) & 0x7) << 2) | ((instr >> 6) & 0x3);
+	uint32 msb = instr & 0x1F;
+	uint32 rd = (instr >> 8) & 0xF;
+	if (msb >= lsb) {
+		uint32_t mask = (uint32_t)((((uint64_t)0x1 << (msb - lsb + 1)) - 1) << lsb);
+		reg->R[rd] = ((uint32_t)reg->R[rd] & ~mask) | (((uint32_t)reg->R[(instr >> 16) & 0xF] << lsb) & mask);
+	}
 }
 
 // ===== BIC - Bit Clear =====
 void INSTR_BIC_IMMEDIATE(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute BIC (immediate)
+	INSTR_dp(instr, reg, INSTR_DP_BIC);
 }
 
 void INSTR_BIC_REGISTER(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute BIC (register)
+	INSTR_dp(instr, reg, INSTR_DP_BIC);
 }
 
 // ===== BKPT - Breakpoint =====
 void INSTR_BKPT(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute BKPT
+	// BKPT 0xAB is a semihosting call, execution continues after it
+	if ((instr & 0xFF) == SEMIHOST_IMM) {
+		Semihost_call(reg);
+		return;
+	}
+	// no debugger attached: the debug event escalates to hardfault
+	printf("cpu: bkpt #%d at pc %08x\n", (int)(instr & 0xFF), (unsigned)reg->R[15]);
+	Fault_raise(FAULT_HARD, 0, 0);
 }
 
 // ===== BL - Branch with Link =====
 void INSTR_BL(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute BL
+	INSTR_unimplemented("BL", instr, reg);
 }
 
 // ===== BLX - Branch with Link and Exchange =====
 void INSTR_BLX_REGISTER(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute BLX (register)
+	// 16bit, the IR lowers it
+	uint32 target = INSTR_getreg(reg, (instr >> 3) & 0xF);
+	reg->R[14] = (reg->R[15] + 2) | 0x1;
+	reg->R[15] = target & ~0x1;
 }
 
 // ===== BX - Branch and Exchange =====
 void INSTR_BX(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute BX
+	// 16bit, the IR lowers it
+	INSTR_loadWritePC(reg, INSTR_getreg(reg, (instr >> 3) & 0xF));
 }
 
 // ===== CBNZ, CBZ - Compare and Branch on (Non-)Zero =====
 void INSTR_CBNZ_CBZ(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute CBNZ/CBZ
+	// 16bit, the IR lowers it
+	uint32 nonzero = (instr >> 11) & 0x1;
+	if ((reg->R[instr & 0x7] != 0) == nonzero) {
+		reg->R[15] = reg->R[15] + 4 + ((((instr >> 9) & 0x1) << 6) | (((instr >> 3) & 0x1F) << 1));
+	}
 }
 
 // ===== CDP, CDP2 - Coprocessor Data Processing =====
 void INSTR_CDP_CDP2(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute CDP/CDP2
+	INSTR_nocp(instr, reg);
 }
 
 // ===== CLREX - Clear Exclusive =====
-void INSTR_CLREX(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute CLREX
+void INSTR_CLREX(uint32, CPU_struct_reg*) {
+	CPU_var_monitor = CPU_MONITOR_OPEN;
 }
 
 // ===== CLZ - Count Leading Zeros =====
 void INSTR_CLZ(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute CLZ
+	uint32_t value = (uint32_t)reg->R[instr & 0xF];
+	uint32 count = 0;
+	for (; count < 32 && !(value & 0x80000000); count++) {
+		value <<= 1;
+	}
+	reg->R[(instr >> 8) & 0xF] = count;
 }
 
 // ===== CMN - Compare Negative =====
 void INSTR_CMN_IMMEDIATE(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute CMN (immediate)
+	INSTR_dp(instr, reg, INSTR_DP_CMN);
 }
 
 void INSTR_CMN_REGISTER(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute CMN (register)
+	INSTR_dp(instr, reg, INSTR_DP_CMN);
 }
 
 // ===== CMP - Compare =====
 void INSTR_CMP_IMMEDIATE(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute CMP (immediate)
+	INSTR_dp(instr, reg, INSTR_DP_CMP);
 }
 
 void INSTR_CMP_REGISTER(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute CMP (register)
+	INSTR_dp(instr, reg, INSTR_DP_CMP);
 }
 
 // ===== CPS - Change Processor State =====
 void INSTR_CPS(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute CPS (CPSID/CPSIE)
+	// CPSIE / CPSID i, f. unprivileged it does nothing, FAULTMASK can't be set from nmi / hardfault
+	uint32 disable = (instr >> 4) & 0x1;
+	if (!INSTR_privileged(reg)) {
+		return;
+	}
+	if (instr & 0x2) {
+		reg->PRIMASK = disable;
+	}
+	if ((instr & 0x1) && (!disable || (reg->xPSR.IPSR.exception != FAULT_NMI && reg->xPSR.IPSR.exception != FAULT_HARD))) {
+		reg->FAULTMASK = disable;
+	}
 }
 
 // ===== CPY - Copy (deprecated, use MOV) =====
 void INSTR_CPY(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute CPY
+	INSTR_unimplemented("CPY", instr, reg);
 }
 
 // ===== CSDB - Consumption of Speculative Data Barrier =====
-void INSTR_CSDB(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute CSDB
+void INSTR_CSDB(uint32, CPU_struct_reg*) {
 }
 
 // ===== DBG - Debug Hint =====
-void INSTR_DBG(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute DBG
+void INSTR_DBG(uint32, CPU_struct_reg*) {
 }
 
 // ===== DMB - Data Memory Barrier =====
-void INSTR_DMB(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute DMB
+void INSTR_DMB(uint32, CPU_struct_reg*) {
 }
 
 // ===== DSB - Data Synchronization Barrier =====
-void INSTR_DSB(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute DSB
+void INSTR_DSB(uint32, CPU_struct_reg*) {
 }
 
 // ===== EOR - Exclusive OR =====
 void INSTR_EOR_IMMEDIATE(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute EOR (immediate)
+	INSTR_dp(instr, reg, INSTR_DP_EOR);
 }
 
 void INSTR_EOR_REGISTER(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute EOR (register)
+	INSTR_dp(instr, reg, INSTR_DP_EOR);
 }
 
 // ===== ISB - Instruction Synchronization Barrier =====
-void INSTR_ISB(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute ISB
+void INSTR_ISB(uint32, CPU_struct_reg*) {
 }
 
 // ===== IT - If-Then =====
 void INSTR_IT(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute IT
+	// ITSTATE = firstcond:mask, CPU_interpret runs the block one instruction at a time from here
+	reg->xPSR.EPSR.ICIT0 = (instr >> 2) & 0x3F;
+	reg->xPSR.EPSR.ICIT1 = instr & 0x3;
 }
 
 // ===== LDC, LDC2 - Load Coprocessor =====
 void INSTR_LDC_LDC2_IMMEDIATE(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute LDC/LDC2 (immediate)
+	INSTR_nocp(instr, reg);
 }
 
 void INSTR_LDC_LDC2_LITERAL(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute LDC/LDC2 (literal)
+	INSTR_nocp(instr, reg);
 }
 
 // ===== LDM - Load Multiple =====
 void INSTR_LDM_LDMIA_LDMFD(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute LDM/LDMIA/LDMFD
+	uint32 rn, list, wback;
+	if (instr >> 16) {
+		rn = (instr >> 16) & 0xF;
+		list = instr & 0xDFFF;
+		wback = (instr >> 21) & 0x1;
+	}
+	else {
+		// T1: writeback unless rn is in the list
+		rn = (instr >> 8) & 0x7;
+		list = instr & 0xFF;
+		wback = !((list >> rn) & 0x1);
+	}
+	uint32 address = reg->R[rn];
+	INSTR_loadMultiple(reg, address, list, rn, wback, address + 4 * INSTR_regcount(list));
 }
 
 void INSTR_LDMDB_LDMEA(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute LDMDB/LDMEA
+	uint32 rn = (instr >> 16) & 0xF;
+	uint32 list = instr & 0xDFFF;
+	uint32 address = reg->R[rn] - 4 * INSTR_regcount(list);
+	INSTR_loadMultiple(reg, address, list, rn, (instr >> 21) & 0x1, address);
 }
 
 // ===== LDR - Load Register =====
 void INSTR_LDR_IMMEDIATE(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute LDR (immediate)
+	INSTR_unimplemented("LDR (immediate)", instr, reg);
 }
 
 void INSTR_LDR_LITERAL(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute LDR (literal)
+	INSTR_unimplemented("LDR (literal)", instr, reg);
 }
 
 void INSTR_LDR_REGISTER(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute LDR (register)
+	INSTR_unimplemented("LDR (register)", instr, reg);
 }
 
 // ===== LDRB - Load Register Byte =====
 void INSTR_LDRB_IMMEDIATE(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute LDRB (immediate)
+	INSTR_unimplemented("LDRB (immediate)", instr, reg);
 }
 
 void INSTR_LDRB_LITERAL(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute LDRB (literal)
+	INSTR_unimplemented("LDRB (literal)", instr, reg);
 }
 
 void INSTR_LDRB_REGISTER(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute LDRB (register)
+	INSTR_unimplemented("LDRB (register)", instr, reg);
 }
 
 // ===== LDRBT - Load Register Byte Unprivileged =====
 void INSTR_LDRBT(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute LDRBT
+	INSTR_unimplemented("LDRBT", instr, reg);
 }
 
 // ===== LDRD - Load Register Dual =====
 void INSTR_LDRD_IMMEDIATE(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute LDRD (immediate)
+	uint32 rn = (instr >> 16) & 0xF;
+	uint32 offset = (instr & 0xFF) << 2;
+	uint32_t base = (rn == 15) ? (INSTR_getreg(reg, 15) & ~0x3) : (uint32_t)reg->R[rn];
+	uint32_t offaddr = ((instr >> 23) & 0x1) ? base + offset : base - offset;
+	uint32_t addr = ((instr >> 24) & 0x1) ? offaddr : base;
+	uint32_t lo = INSTR_read(addr, Memory_enum_size::u32);
+	uint32_t hi = INSTR_read(addr + 4, Memory_enum_size::u32);
+	if (Memory_var_access_err != 0) {
+		return;
+	}
+	if ((instr >> 21) & 0x1) {
+		reg->R[rn] = offaddr;
+	}
+	reg->R[(instr >> 12) & 0xF] = lo;
+	reg->R[(instr >> 8) & 0xF] = hi;
 }
 
 void INSTR_LDRD_LITERAL(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute LDRD (literal)
+	INSTR_LDRD_IMMEDIATE(instr, reg);
 }
 
 // ===== LDREX - Load Register Exclusive =====
 void INSTR_LDREX(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute LDREX
+	uint32 addr = reg->R[(instr >> 16) & 0xF] + ((instr & 0xFF) << 2);
+	uint32_t value = INSTR_read(addr, Memory_enum_size::u32);
+	if (Memory_var_access_err == 0) {
+		CPU_var_monitor = addr;
+		reg->R[(instr >> 12) & 0xF] = value;
+	}
 }
 
 void INSTR_LDREXB(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute LDREXB
+	uint32 addr = reg->R[(instr >> 16) & 0xF];
+	uint32_t value = INSTR_read(addr, Memory_enum_size::u8);
+	if (Memory_var_access_err == 0) {
+		CPU_var_monitor = addr;
+		reg->R[(instr >> 12) & 0xF] = value;
+	}
 }
 
 void INSTR_LDREXH(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute LDREXH
+	uint32 addr = reg->R[(instr >> 16) & 0xF];
+	uint32_t value = INSTR_read(addr, Memory_enum_size::u16);
+	if (Memory_var_access_err == 0) {
+		CPU_var_monitor = addr;
+		reg->R[(instr >> 12) & 0xF] = value;
+	}
 }
 
 // ===== LDRH - Load Register Halfword =====
 void INSTR_LDRH_IMMEDIATE(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute LDRH (immediate)
+	INSTR_unimplemented("LDRH (immediate)", instr, reg);
 }
 
 void INSTR_LDRH_LITERAL(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute LDRH (literal)
+	INSTR_unimplemented("LDRH (literal)", instr, reg);
 }
 
 void INSTR_LDRH_REGISTER(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute LDRH (register)
+	INSTR_unimplemented("LDRH (register)", instr, reg);
 }
 
 // ===== LDRHT - Load Register Halfword Unprivileged =====
 void INSTR_LDRHT(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute LDRHT
+	INSTR_unimplemented("LDRHT", instr, reg);
 }
 
 // ===== LDRSB - Load Register Signed Byte =====
 void INSTR_LDRSB_IMMEDIATE(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute LDRSB (immediate)
+	INSTR_unimplemented("LDRSB (immediate)", instr, reg);
 }
 
 void INSTR_LDRSB_LITERAL(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute LDRSB (literal)
+	INSTR_unimplemented("LDRSB (literal)", instr, reg);
 }
 
 void INSTR_LDRSB_REGISTER(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute LDRSB (register)
+	INSTR_unimplemented("LDRSB (register)", instr, reg);
 }
 
 // ===== LDRSBT - Load Register Signed Byte Unprivileged =====
 void INSTR_LDRSBT(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute LDRSBT
+	INSTR_unimplemented("LDRSBT", instr, reg);
 }
 
 // ===== LDRSH - Load Register Signed Halfword =====
 void INSTR_LDRSH_IMMEDIATE(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute LDRSH (immediate)
+	INSTR_unimplemented("LDRSH (immediate)", instr, reg);
 }
 
 void INSTR_LDRSH_LITERAL(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute LDRSH (literal)
+	INSTR_unimplemented("LDRSH (literal)", instr, reg);
 }
 
 void INSTR_LDRSH_REGISTER(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute LDRSH (register)
+	INSTR_unimplemented("LDRSH (register)", instr, reg);
 }
 
 // ===== LDRSHT - Load Register Signed Halfword Unprivileged =====
 void INSTR_LDRSHT(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute LDRSHT
+	INSTR_unimplemented("LDRSHT", instr, reg);
 }
 
 // ===== LDRT - Load Register Unprivileged =====
 void INSTR_LDRT(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute LDRT
+	INSTR_unimplemented("LDRT", instr, reg);
 }
 
 // ===== LSL - Logical Shift Left =====
 void INSTR_LSL_IMMEDIATE(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute LSL (immediate)
+	INSTR_unimplemented("LSL (immediate)", instr, reg);
 }
 
 void INSTR_LSL_REGISTER(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute LSL (register)
+	INSTR_unimplemented("LSL (register)", instr, reg);
 }
 
 // ===== LSR - Logical Shift Right =====
 void INSTR_LSR_IMMEDIATE(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute LSR (immediate)
+	INSTR_unimplemented("LSR (immediate)", instr, reg);
 }
 
 void INSTR_LSR_REGISTER(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute LSR (register)
+	INSTR_unimplemented("LSR (register)", instr, reg);
 }
 
 // ===== MCR, MCR2 - Move to Coprocessor from ARM Register =====
 void INSTR_MCR_MCR2(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute MCR/MCR2
+	INSTR_nocp(instr, reg);
 }
 
 // ===== MCRR, MCRR2 - Move to Coprocessor from two ARM Registers =====
 void INSTR_MCRR_MCRR2(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute MCRR/MCRR2
+	INSTR_nocp(instr, reg);
 }
 
 // ===== MLA - Multiply Accumulate =====
 void INSTR_MLA(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute MLA
+	uint32_t a = (uint32_t)reg->R[(instr >> 16) & 0xF];
+	uint32_t b = (uint32_t)reg->R[instr & 0xF];
+	reg->R[(instr >> 8) & 0xF] = a * b + (uint32_t)reg->R[(instr >> 12) & 0xF];
 }
 
 // ===== MLS - Multiply and Subtract =====
 void INSTR_MLS(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute MLS
+	uint32_t a = (uint32_t)reg->R[(instr >> 16) & 0xF];
+	uint32_t b = (uint32_t)reg->R[instr & 0xF];
+	reg->R[(instr >> 8) & 0xF] = (uint32_t)reg->R[(instr >> 12) & 0xF] - a * b;
 }
 
 // ===== MOV - Move =====
 void INSTR_MOV_IMMEDIATE(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute MOV (immediate)
+	// MOVW (T3), the IR only leaves it the rd = sp / pc ones
+	if (((instr >> 16) & 0xFB70) == 0xF240) {
+		uint32 rd = (instr >> 8) & 0xF;
+		uint32_t imm16 = (((instr >> 16) & 0xF) << 12) | (((instr >> 26) & 0x1) << 11) | (((instr >> 12) & 0x7) << 8) | (instr & 0xFF);
+		reg->R[rd] = (rd == 15) ? (imm16 & ~0x1) : imm16;
+		return;
+	}
+	INSTR_dp(instr, reg, INSTR_DP_MOV);
 }
 
 void INSTR_MOV_REGISTER(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute MOV (register)
+	INSTR_dp(instr, reg, INSTR_DP_MOV);
 }
 
 void INSTR_MOV_SHIFTED_REGISTER(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute MOV (shifted register)
+	INSTR_unimplemented("MOV (shifted register)", instr, reg);
 }
 
 // ===== MOVT - Move Top =====
 void INSTR_MOVT(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute MOVT
+	uint32 rd = (instr >> 8) & 0xF;
+	uint32_t imm16 = (((instr >> 16) & 0xF) << 12) | (((instr >> 26) & 0x1) << 11) | (((instr >> 12) & 0x7) << 8) | (instr & 0xFF);
+	reg->R[rd] = ((uint32_t)reg->R[rd] & 0xFFFF) | (imm16 << 16);
 }
 
 // ===== MRC, MRC2 - Move to ARM Register from Coprocessor =====
 void INSTR_MRC_MRC2(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute MRC/MRC2
+	INSTR_nocp(instr, reg);
 }
 
 // ===== MRRC, MRRC2 - Move to two ARM Registers from Coprocessor =====
 void INSTR_MRRC_MRRC2(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute MRRC/MRRC2
+	INSTR_nocp(instr, reg);
 }
 
 // ===== MRS - Move from Special Register =====
 void INSTR_MRS(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute MRS
+	uint32 sysm = instr & 0xFF;
+	uint32_t value = 0;
+	switch (sysm >> 3) {
+	case 0:	// apsr / ipsr / epsr combinations, the execution state reads as 0
+		if (sysm & 0x1) {
+			value |= (uint32_t)reg->xPSR.raw & 0x1FF;
+		}
+		if (!(sysm & 0x4)) {
+			value |= (uint32_t)reg->xPSR.raw & 0xF80F0000;
+		}
+		break;
+	case 1:
+		if (sysm == 8) {
+			value = INSTR_onmsp(reg) ? reg->R[13] : reg->MSP;
+		}
+		else if (sysm == 9) {
+			value = INSTR_onmsp(reg) ? reg->PSP : reg->R[13];
+		}
+		break;
+	case 2:
+		switch (sysm) {
+		case 16: value = reg->PRIMASK; break;
+		case 17: case 18: value = reg->BASEPRI; break;
+		case 19: value = reg->FAULTMASK; break;
+		case 20: value = reg->CONTROL.nPRIV | (reg->CONTROL.SPSEL << 1); break;
+		default: break;
+		}
+		break;
+	default:
+		break;
+	}
+	reg->R[(instr >> 8) & 0xF] = value;
 }
 
 // ===== MSR - Move to Special Register =====
 void INSTR_MSR(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute MSR
+	// the block ends here, MPU_sync picks up a privilege change before the next one
+	uint32 sysm = instr & 0xFF;
+	uint32_t value = (uint32_t)reg->R[(instr >> 16) & 0xF];
+	if ((sysm >> 3) == 0) {
+		if (!(sysm & 0x4) && (instr & 0x800)) {
+			reg->xPSR.raw = (reg->xPSR.raw & ~(uint32)0xF8000000) | (value & 0xF8000000);	// nzcvq
+		}
+		return;
+	}
+	if (!INSTR_privileged(reg)) {
+		return;
+	}
+	switch (sysm) {
+	case 8:
+		if (INSTR_onmsp(reg)) {
+			reg->R[13] = value & ~0x3;
+		}
+		else {
+			reg->MSP = value & ~0x3;
+		}
+		break;
+	case 9:
+		if (INSTR_onmsp(reg)) {
+			reg->PSP = value & ~0x3;
+		}
+		else {
+			reg->R[13] = value & ~0x3;
+		}
+		break;
+	case 16:
+		reg->PRIMASK = value & 0x1;
+		break;
+	case 17:
+		reg->BASEPRI = value & 0xFF;
+		break;
+	case 18:	// BASEPRI_MAX: only raises the priority
+		if ((value & 0xFF) != 0 && ((value & 0xFF) < reg->BASEPRI || reg->BASEPRI == 0)) {
+			reg->BASEPRI = value & 0xFF;
+		}
+		break;
+	case 19:
+		if (reg->xPSR.IPSR.exception != FAULT_NMI && reg->xPSR.IPSR.exception != FAULT_HARD) {
+			reg->FAULTMASK = value & 0x1;
+		}
+		break;
+	case 20:
+		reg->CONTROL.nPRIV = value & 0x1;
+		if (reg->xPSR.IPSR.exception == 0 && reg->CONTROL.SPSEL != ((value >> 1) & 0x1)) {
+			// thread mode switches stacks: r13 follows
+			if (reg->CONTROL.SPSEL) {
+				reg->PSP = reg->R[13];
+				reg->R[13] = reg->MSP;
+			}
+			else {
+				reg->MSP = reg->R[13];
+				reg->R[13] = reg->PSP;
+			}
+			reg->CONTROL.SPSEL = (value >> 1) & 0x1;
+		}
+		break;
+	default:
+		break;
+	}
 }
 
 // ===== MUL - Multiply =====
 void INSTR_MUL(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute MUL
+	uint32_t a = (uint32_t)reg->R[(instr >> 16) & 0xF];
+	uint32_t b = (uint32_t)reg->R[instr & 0xF];
+	reg->R[(instr >> 8) & 0xF] = a * b;
 }
 
 // ===== MVN - Move NOT =====
 void INSTR_MVN_IMMEDIATE(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute MVN (immediate)
+	INSTR_dp(instr, reg, INSTR_DP_MVN);
 }
 
 void INSTR_MVN_REGISTER(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute MVN (register)
+	INSTR_dp(instr, reg, INSTR_DP_MVN);
 }
 
 // ===== NEG - Negate =====
 void INSTR_NEG(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute NEG
+	INSTR_unimplemented("NEG", instr, reg);
 }
 
 // ===== NOP - No Operation =====
-void INSTR_NOP(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute NOP
+void INSTR_NOP(uint32, CPU_struct_reg*) {
 }
 
 // ===== ORN - Logical OR NOT =====
 void INSTR_ORN_IMMEDIATE(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute ORN (immediate)
+	INSTR_dp(instr, reg, INSTR_DP_ORN);
 }
 
 void INSTR_ORN_REGISTER(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute ORN (register)
+	INSTR_dp(instr, reg, INSTR_DP_ORN);
 }
 
 // ===== ORR - Logical OR =====
 void INSTR_ORR_IMMEDIATE(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute ORR (immediate)
+	INSTR_dp(instr, reg, INSTR_DP_ORR);
 }
 
 void INSTR_ORR_REGISTER(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute ORR (register)
+	INSTR_dp(instr, reg, INSTR_DP_ORR);
 }
 
 // ===== PKHBT, PKHTB - Pack Halfword =====
 void INSTR_PKHBT_PKHTB(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute PKHBT/PKHTB
+	INSTR_unimplemented("PKHBT/PKHTB", instr, reg);
 }
 
 // ===== PLD - Preload Data =====
 void INSTR_PLD_IMMEDIATE(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute PLD (immediate)
+	INSTR_unimplemented("PLD (immediate)", instr, reg);
 }
 
 void INSTR_PLD_LITERAL(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute PLD (literal)
+	INSTR_unimplemented("PLD (literal)", instr, reg);
 }
 
 void INSTR_PLD_REGISTER(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute PLD (register)
+	INSTR_unimplemented("PLD (register)", instr, reg);
 }
 
 // ===== PLI - Preload Instruction =====
 void INSTR_PLI_IMMEDIATE_LITERAL(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute PLI (immediate/literal)
+	INSTR_unimplemented("PLI (immediate/literal)", instr, reg);
 }
 
 void INSTR_PLI_REGISTER(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute PLI (register)
+	INSTR_unimplemented("PLI (register)", instr, reg);
 }
 
 // ===== POP - Pop Multiple Registers =====
 void INSTR_POP(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute POP
+	uint32 list;
+	if ((instr >> 16) == 0xE8BD) {
+		list = instr & 0xDFFF;	// T2 (LDMIA sp!)
+	}
+	else if (instr >> 16) {
+		list = 0x1 << ((instr >> 12) & 0xF);	// T3 (LDR rt, [sp], #4)
+	}
+	else {
+		list = (instr & 0xFF) | (((instr >> 8) & 0x1) << 15);
+	}
+	uint32 address = reg->R[13];
+	INSTR_loadMultiple(reg, address, list, 13, 1, address + 4 * INSTR_regcount(list));
 }
 
 // ===== PSSBB - Physical Speculative Store Bypass Barrier =====
-void INSTR_PSSBB(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute PSSBB
+void INSTR_PSSBB(uint32, CPU_struct_reg*) {
 }
 
 // ===== PUSH - Push Multiple Registers =====
 void INSTR_PUSH(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute PUSH
+	uint32 list;
+	if ((instr >> 16) == 0xE92D) {
+		list = instr & 0x5FFF;	// T2 (STMDB sp!)
+	}
+	else if (instr >> 16) {
+		list = 0x1 << ((instr >> 12) & 0xF);	// T3 (STR rt, [sp, #-4]!)
+	}
+	else {
+		list = (instr & 0xFF) | (((instr >> 8) & 0x1) << 14);
+	}
+	uint32 address = reg->R[13] - 4 * INSTR_regcount(list);
+	if (INSTR_storeMultiple(reg, address, list)) {
+		reg->R[13] = address;
+	}
 }
 
 // ===== QADD - Saturating Add =====
 void INSTR_QADD(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute QADD
+	INSTR_unimplemented("QADD", instr, reg);
 }
 
 void INSTR_QADD16(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute QADD16
+	INSTR_unimplemented("QADD16", instr, reg);
 }
 
 void INSTR_QADD8(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute QADD8
+	INSTR_unimplemented("QADD8", instr, reg);
 }
 
 // ===== QASX - Saturating Add and Subtract with Exchange =====
 void INSTR_QASX(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute QASX
+	INSTR_unimplemented("QASX", instr, reg);
 }
 
 // ===== QDADD - Saturating Double and Add =====
 void INSTR_QDADD(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute QDADD
+	INSTR_unimplemented("QDADD", instr, reg);
 }
 
 // ===== QDSUB - Saturating Double and Subtract =====
 void INSTR_QDSUB(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute QDSUB
+	INSTR_unimplemented("QDSUB", instr, reg);
 }
 
 // ===== QSAX - Saturating Subtract and Add with Exchange =====
 void INSTR_QSAX(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute QSAX
+	INSTR_unimplemented("QSAX", instr, reg);
 }
 
 // ===== QSUB - Saturating Subtract =====
 void INSTR_QSUB(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute QSUB
+	INSTR_unimplemented("QSUB", instr, reg);
 }
 
 void INSTR_QSUB16(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute QSUB16
+	INSTR_unimplemented("QSUB16", instr, reg);
 }
 
 void INSTR_QSUB8(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute QSUB8
+	INSTR_unimplemented("QSUB8", instr, reg);
 }
 
 // ===== RBIT - Reverse Bits =====
 void INSTR_RBIT(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute RBIT
+	uint32_t value = (uint32_t)reg->R[instr & 0xF];
+	uint32_t result = 0;
+	for (uint32 i = 0; i < 32; i++) {
+		result = (result << 1) | ((value >> i) & 0x1);
+	}
+	reg->R[(instr >> 8) & 0xF] = result;
 }
 
 // ===== REV - Byte-Reverse Word =====
 void INSTR_REV(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute REV
+	INSTR_rev(instr, reg, REV);
 }
 
 void INSTR_REV16(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute REV16
+	INSTR_rev(instr, reg, REV16);
 }
 
 void INSTR_REVSH(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute REVSH
+	INSTR_rev(instr, reg, REVSH);
 }
 
 // ===== ROR - Rotate Right =====
 void INSTR_ROR_IMMEDIATE(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute ROR (immediate)
+	INSTR_unimplemented("ROR (immediate)", instr, reg);
 }
 
 void INSTR_ROR_REGISTER(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute ROR (register)
+	INSTR_unimplemented("ROR (register)", instr, reg);
 }
 
 // ===== RRX - Rotate Right with Extend =====
 void INSTR_RRX(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute RRX
+	INSTR_unimplemented("RRX", instr, reg);
 }
 
 // ===== RSB - Reverse Subtract =====
 void INSTR_RSB_IMMEDIATE(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute RSB (immediate)
+	INSTR_dp(instr, reg, INSTR_DP_RSB);
 }
 
 void INSTR_RSB_REGISTER(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute RSB (register)
+	INSTR_dp(instr, reg, INSTR_DP_RSB);
 }
 
 // ===== SADD16 - Signed Add 16-bit =====
 void INSTR_SADD16(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute SADD16
+	INSTR_unimplemented("SADD16", instr, reg);
 }
 
 void INSTR_SADD8(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute SADD8
+	INSTR_unimplemented("SADD8", instr, reg);
 }
 
 // ===== SASX - Signed Add and Subtract with Exchange =====
 void INSTR_SASX(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute SASX
+	INSTR_unimplemented("SASX", instr, reg);
 }
 
 // ===== SBC - Subtract with Carry =====
 void INSTR_SBC_IMMEDIATE(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute SBC (immediate)
+	INSTR_dp(instr, reg, INSTR_DP_SBC);
 }
 
 void INSTR_SBC_REGISTER(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute SBC (register)
+	INSTR_dp(instr, reg, INSTR_DP_SBC);
 }
 
 // ===== SBFX - Signed Bit Field Extract =====
 void INSTR_SBFX(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute SBFX
+	uint32 lsb = (((instr >> 12) & 0x7) << 2) | ((instr >> 6) & 0x3);
+	uint32 width = (instr & 0x1F) + 1;
+	if (lsb + width <= 32) {
+		uint32_t value = (uint32_t)reg->R[(instr >> 16) & 0xF] << (32 - lsb - width);
+		reg->R[(instr >> 8) & 0xF] = (uint32_t)((int32_t)value >> (32 - width));
+	}
 }
 
 // ===== SDIV - Signed Divide =====
 void INSTR_SDIV(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute SDIV
+	uint32_t a = (uint32_t)reg->R[(instr >> 16) & 0xF];
+	uint32_t b = (uint32_t)reg->R[instr & 0xF];
+	if (b == 0) {
+		INSTR_divzero(instr, reg);
+		return;
+	}
+	// 0x80000000 / -1 overflows back to 0x80000000
+	reg->R[(instr >> 8) & 0xF] = (a == 0x80000000 && b == 0xFFFFFFFF) ? a : (uint32_t)((int32_t)a / (int32_t)b);
 }
 
 // ===== SEL - Select Bytes =====
 void INSTR_SEL(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute SEL
+	INSTR_unimplemented("SEL", instr, reg);
 }
 
 // ===== SEV - Send Event =====
-void INSTR_SEV(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute SEV
+void INSTR_SEV(uint32, CPU_struct_reg*) {
 }
 
 // ===== SHADD16 - Signed Halving Add 16-bit =====
 void INSTR_SHADD16(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute SHADD16
+	INSTR_unimplemented("SHADD16", instr, reg);
 }
 
 void INSTR_SHADD8(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute SHADD8
+	INSTR_unimplemented("SHADD8", instr, reg);
 }
 
 // ===== SHASX - Signed Halving Add and Subtract with Exchange =====
 void INSTR_SHASX(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute SHASX
+	INSTR_unimplemented("SHASX", instr, reg);
 }
 
 // ===== SHSAX - Signed Halving Subtract and Add with Exchange =====
 void INSTR_SHSAX(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute SHSAX
+	INSTR_unimplemented("SHSAX", instr, reg);
 }
 
 // ===== SHSUB16 - Signed Halving Subtract 16-bit =====
 void INSTR_SHSUB16(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute SHSUB16
+	INSTR_unimplemented("SHSUB16", instr, reg);
 }
 
 void INSTR_SHSUB8(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute SHSUB8
+	INSTR_unimplemented("SHSUB8", instr, reg);
 }
 
 // ===== SMLABB, SMLABT, SMLATB, SMLATT - Signed Multiply Accumulate =====
 void INSTR_SMLABB_SMLABT_SMLATB_SMLATT(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute SMLABB/SMLABT/SMLATB/SMLATT
+	INSTR_unimplemented("SMLABB/SMLABT/SMLATB/SMLATT", instr, reg);
 }
 
 // ===== SMLAD - Signed Multiply Accumulate Dual =====
 void INSTR_SMLAD_SMLADX(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute SMLAD/SMLADX
+	INSTR_unimplemented("SMLAD/SMLADX", instr, reg);
 }
 
 // ===== SMLAL - Signed Multiply Accumulate Long =====
 void INSTR_SMLAL(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute SMLAL
+	uint32_t a = (uint32_t)reg->R[(instr >> 16) & 0xF];
+	uint32_t b = (uint32_t)reg->R[instr & 0xF];
+	INSTR_setlong(reg, instr, (uint64_t)((int64_t)(int32_t)a * (int32_t)b) + INSTR_getlong(reg, instr));
 }
 
 // ===== SMLALBB - Signed Multiply Accumulate Long (halfwords) =====
 void INSTR_SMLALBB_SMLALBT_SMLALTB_SMLALTT(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute SMLALBB/SMLALBT/SMLALTB/SMLALTT
+	INSTR_unimplemented("SMLALBB/SMLALBT/SMLALTB/SMLALTT", instr, reg);
 }
 
 // ===== SMLALD - Signed Multiply Accumulate Long Dual =====
 void INSTR_SMLALD_SMLALDX(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute SMLALD/SMLALDX
+	INSTR_unimplemented("SMLALD/SMLALDX", instr, reg);
 }
 
 // ===== SMLAWB, SMLAWT - Signed Multiply Accumulate Word =====
 void INSTR_SMLAWB_SMLAWT(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute SMLAWB/SMLAWT
+	INSTR_unimplemented("SMLAWB/SMLAWT", instr, reg);
 }
 
 // ===== SMLSD - Signed Multiply Subtract Dual =====
 void INSTR_SMLSD_SMLSDX(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute SMLSD/SMLSDX
+	INSTR_unimplemented("SMLSD/SMLSDX", instr, reg);
 }
 
 // ===== SMLSLD - Signed Multiply Subtract Long Dual =====
 void INSTR_SMLSLD_SMLSLDX(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute SMLSLD/SMLSLDX
+	INSTR_unimplemented("SMLSLD/SMLSLDX", instr, reg);
 }
 
 // ===== SMMLA - Signed Most Significant Word Multiply Accumulate =====
 void INSTR_SMMLA_SMMLAR(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute SMMLA/SMMLAR
+	INSTR_unimplemented("SMMLA/SMMLAR", instr, reg);
 }
 
 // ===== SMMLS - Signed Most Significant Word Multiply Subtract =====
 void INSTR_SMMLS_SMMLSR(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute SMMLS/SMMLSR
+	INSTR_unimplemented("SMMLS/SMMLSR", instr, reg);
 }
 
 // ===== SMMUL - Signed Most Significant Word Multiply =====
 void INSTR_SMMUL_SMMULR(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute SMMUL/SMMULR
+	INSTR_unimplemented("SMMUL/SMMULR", instr, reg);
 }
 
 // ===== SMUAD - Signed Dual Multiply Add =====
 void INSTR_SMUAD_SMUADX(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute SMUAD/SMUADX
+	INSTR_unimplemented("SMUAD/SMUADX", instr, reg);
 }
 
 // ===== SMULBB - Signed Multiply (halfwords) =====
 void INSTR_SMULBB_SMULBT_SMULTB_SMULTT(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute SMULBB/SMULBT/SMULTB/SMULTT
+	INSTR_unimplemented("SMULBB/SMULBT/SMULTB/SMULTT", instr, reg);
 }
 
 // ===== SMULL - Signed Multiply Long =====
 void INSTR_SMULL(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute SMULL
+	uint32_t a = (uint32_t)reg->R[(instr >> 16) & 0xF];
+	uint32_t b = (uint32_t)reg->R[instr & 0xF];
+	INSTR_setlong(reg, instr, (uint64_t)((int64_t)(int32_t)a * (int32_t)b));
 }
 
 // ===== SMULWB, SMULWT - Signed Multiply Word =====
 void INSTR_SMULWB_SMULWT(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute SMULWB/SMULWT
+	INSTR_unimplemented("SMULWB/SMULWT", instr, reg);
 }
 
 // ===== SMUSD - Signed Dual Multiply Subtract =====
 void INSTR_SMUSD_SMUSDX(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute SMUSD/SMUSDX
+	INSTR_unimplemented("SMUSD/SMUSDX", instr, reg);
 }
 
 // ===== SSAT - Signed Saturate =====
 void INSTR_SSAT(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute SSAT
+	uint32 amount = (((instr >> 12) & 0x7) << 2) | ((instr >> 6) & 0x3);
+	uint32 carry = 0;
+	int64_t value = (int32_t)INSTR_shiftc((uint32_t)reg->R[(instr >> 16) & 0xF], ((instr >> 21) & 0x1) ? 2 : 0, amount, &carry);
+	int64_t max = ((int64_t)0x1 << (instr & 0x1F)) - 1;	// saturate_to is imm5 + 1 bits
+	int64_t min = -max - 1;
+	if (value > max || value < min) {
+		value = (value > max) ? max : min;
+		reg->xPSR.APSR.Q = 1;
+	}
+	reg->R[(instr >> 8) & 0xF] = (uint32_t)value;
 }
 
 void INSTR_SSAT16(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute SSAT16
+	INSTR_unimplemented("SSAT16", instr, reg);
 }
 
 // ===== SSAX - Signed Subtract and Add with Exchange =====
 void INSTR_SSAX(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute SSAX
+	INSTR_unimplemented("SSAX", instr, reg);
 }
 
 // ===== SSBB - Speculative Store Bypass Barrier =====
-void INSTR_SSBB(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute SSBB
+void INSTR_SSBB(uint32, CPU_struct_reg*) {
 }
 
 // ===== SSUB16 - Signed Subtract 16-bit =====
 void INSTR_SSUB16(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute SSUB16
+	INSTR_unimplemented("SSUB16", instr, reg);
 }
 
 void INSTR_SSUB8(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute SSUB8
+	INSTR_unimplemented("SSUB8", instr, reg);
 }
 
 // ===== STC, STC2 - Store Coprocessor =====
 void INSTR_STC_STC2(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute STC/STC2
+	INSTR_nocp(instr, reg);
 }
 
 // ===== STM - Store Multiple =====
 void INSTR_STM_STMIA_STMEA(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute STM/STMIA/STMEA
+	uint32 rn, list, wback;
+	if (instr >> 16) {
+		rn = (instr >> 16) & 0xF;
+		list = instr & 0x5FFF;
+		wback = (instr >> 21) & 0x1;
+	}
+	else {
+		rn = (instr >> 8) & 0x7;
+		list = instr & 0xFF;
+		wback = 1;
+	}
+	uint32 address = reg->R[rn];
+	if (INSTR_storeMultiple(reg, address, list) && wback) {
+		reg->R[rn] = address + 4 * INSTR_regcount(list);
+	}
 }
 
 void INSTR_STMDB_STMFD(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute STMDB/STMFD
+	uint32 rn = (instr >> 16) & 0xF;
+	uint32 list = instr & 0x5FFF;
+	uint32 address = reg->R[rn] - 4 * INSTR_regcount(list);
+	if (INSTR_storeMultiple(reg, address, list) && ((instr >> 21) & 0x1)) {
+		reg->R[rn] = address;
+	}
 }
 
 // ===== STR - Store Register =====
 void INSTR_STR_IMMEDIATE(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute STR (immediate)
+	INSTR_unimplemented("STR (immediate)", instr, reg);
 }
 
 void INSTR_STR_REGISTER(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute STR (register)
+	INSTR_unimplemented("STR (register)", instr, reg);
 }
 
 // ===== STRB - Store Register Byte =====
 void INSTR_STRB_IMMEDIATE(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute STRB (immediate)
+	INSTR_unimplemented("STRB (immediate)", instr, reg);
 }
 
 void INSTR_STRB_REGISTER(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute STRB (register)
+	INSTR_unimplemented("STRB (register)", instr, reg);
 }
 
 // ===== STRBT - Store Register Byte Unprivileged =====
 void INSTR_STRBT(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute STRBT
+	INSTR_unimplemented("STRBT", instr, reg);
 }
 
 // ===== STRD - Store Register Dual =====
 void INSTR_STRD_IMMEDIATE(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute STRD (immediate)
+	uint32 rn = (instr >> 16) & 0xF;
+	uint32 offset = (instr & 0xFF) << 2;
+	uint32_t base = (rn == 15) ? (INSTR_getreg(reg, 15) & ~0x3) : (uint32_t)reg->R[rn];
+	uint32_t offaddr = ((instr >> 23) & 0x1) ? base + offset : base - offset;
+	uint32_t addr = ((instr >> 24) & 0x1) ? offaddr : base;
+	if (!INSTR_write(addr, (uint32_t)reg->R[(instr >> 12) & 0xF], Memory_enum_size::u32)
+		|| !INSTR_write(addr + 4, (uint32_t)reg->R[(instr >> 8) & 0xF], Memory_enum_size::u32)) {
+		return;
+	}
+	if ((instr >> 21) & 0x1) {
+		reg->R[rn] = offaddr;
+	}
 }
 
 // ===== STREX - Store Register Exclusive =====
 void INSTR_STREX(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute STREX
+	// the local monitor only: it holds while nothing else ran in between (exception entry / return clear it)
+	uint32 addr = reg->R[(instr >> 16) & 0xF] + ((instr & 0xFF) << 2);
+	uint32 rd = (instr >> 8) & 0xF;
+	if (CPU_var_monitor != addr) {
+		reg->R[rd] = 1;
+		return;
+	}
+	if (INSTR_write(addr, (uint32_t)reg->R[(instr >> 12) & 0xF], Memory_enum_size::u32)) {
+		CPU_var_monitor = CPU_MONITOR_OPEN;
+		reg->R[rd] = 0;
+	}
 }
 
 void INSTR_STREXB(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute STREXB
+	// the local monitor only: it holds while nothing else ran in between (exception entry / return clear it)
+	uint32 addr = reg->R[(instr >> 16) & 0xF];
+	uint32 rd = instr & 0xF;
+	if (CPU_var_monitor != addr) {
+		reg->R[rd] = 1;
+		return;
+	}
+	if (INSTR_write(addr, (uint32_t)reg->R[(instr >> 12) & 0xF], Memory_enum_size::u8)) {
+		CPU_var_monitor = CPU_MONITOR_OPEN;
+		reg->R[rd] = 0;
+	}
 }
 
 void INSTR_STREXH(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute STREXH
+	// the local monitor only: it holds while nothing else ran in between (exception entry / return clear it)
+	uint32 addr = reg->R[(instr >> 16) & 0xF];
+	uint32 rd = instr & 0xF;
+	if (CPU_var_monitor != addr) {
+		reg->R[rd] = 1;
+		return;
+	}
+	if (INSTR_write(addr, (uint32_t)reg->R[(instr >> 12) & 0xF], Memory_enum_size::u16)) {
+		CPU_var_monitor = CPU_MONITOR_OPEN;
+		reg->R[rd] = 0;
+	}
 }
 
 // ===== STRH - Store Register Halfword =====
 void INSTR_STRH_IMMEDIATE(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute STRH (immediate)
+	INSTR_unimplemented("STRH (immediate)", instr, reg);
 }
 
 void INSTR_STRH_REGISTER(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute STRH (register)
+	INSTR_unimplemented("STRH (register)", instr, reg);
 }
 
 // ===== STRHT - Store Register Halfword Unprivileged =====
 void INSTR_STRHT(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute STRHT
+	INSTR_unimplemented("STRHT", instr, reg);
 }
 
 // ===== STRT - Store Register Unprivileged =====
 void INSTR_STRT(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute STRT
+	INSTR_unimplemented("STRT", instr, reg);
 }
 
 // ===== SUB - Subtract =====
 void INSTR_SUB_IMMEDIATE(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute SUB (immediate)
+	INSTR_dp(instr, reg, INSTR_DP_SUB);
 }
 
 void INSTR_SUB_REGISTER(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute SUB (register)
+	INSTR_dp(instr, reg, INSTR_DP_SUB);
 }
 
 void INSTR_SUB_SP_MINUS_IMMEDIATE(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute SUB (SP minus immediate)
+	INSTR_unimplemented("SUB (SP minus immediate)", instr, reg);
 }
 
 void INSTR_SUB_SP_MINUS_REGISTER(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute SUB (SP minus register)
+	INSTR_unimplemented("SUB (SP minus register)", instr, reg);
 }
 
 // ===== SVC - Supervisor Call =====
 void INSTR_SVC(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute SVC
+	// SVC 0xAB: older semihosting convention, handled like BKPT 0xAB
+	if ((instr & 0xFF) == SEMIHOST_IMM) {
+		Semihost_call(reg);
+		return;
+	}
+	// SVCall is synchronous: it can't wait behind the execution priority, it escalates (Fault_take).
+	// otherwise it pends and Nvic_step takes it after this instruction (SVC ends the block)
+	if (Fault_priority(NVIC_SVCALL) >= Fault_execPriority(reg)) {
+		Fault_raise(NVIC_SVCALL, 0, 0);
+		return;
+	}
+	Nvic_pend(NVIC_SVCALL);
 }
 
 // ===== SXTAB - Signed Extend and Add Byte =====
 void INSTR_SXTAB(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute SXTAB
+	INSTR_extend(instr, reg, 0xFF, 1);
 }
 
 void INSTR_SXTAB16(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute SXTAB16
+	INSTR_unimplemented("SXTAB16", instr, reg);
 }
 
 void INSTR_SXTAH(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute SXTAH
+	INSTR_extend(instr, reg, 0xFFFF, 1);
 }
 
 // ===== SXTB - Signed Extend Byte =====
 void INSTR_SXTB(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute SXTB
+	INSTR_extend(instr, reg, 0xFF, 1);
 }
 
 void INSTR_SXTB16(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute SXTB16
+	INSTR_unimplemented("SXTB16", instr, reg);
 }
 
 // ===== SXTH - Signed Extend Halfword =====
 void INSTR_SXTH(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute SXTH
+	INSTR_extend(instr, reg, 0xFFFF, 1);
 }
 
 // ===== TBB, TBH - Table Branch Byte/Halfword =====
 void INSTR_TBB_TBH(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute TBB/TBH
+	// the IR lowers it
+	uint32 half = (instr >> 4) & 0x1;
+	uint32 addr = INSTR_getreg(reg, (instr >> 16) & 0xF) + (INSTR_getreg(reg, instr & 0xF) << half);
+	uint32_t entry = INSTR_read(addr, half ? Memory_enum_size::u16 : Memory_enum_size::u8);
+	if (Memory_var_access_err == 0) {
+		reg->R[15] = reg->R[15] + 4 + (entry << 1);
+	}
 }
 
 // ===== TEQ - Test Equivalence =====
 void INSTR_TEQ_IMMEDIATE(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute TEQ (immediate)
+	INSTR_dp(instr, reg, INSTR_DP_TEQ);
 }
 
 void INSTR_TEQ_REGISTER(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute TEQ (register)
+	INSTR_dp(instr, reg, INSTR_DP_TEQ);
 }
 
 // ===== TST - Test =====
 void INSTR_TST_IMMEDIATE(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute TST (immediate)
+	INSTR_dp(instr, reg, INSTR_DP_TST);
 }
 
 void INSTR_TST_REGISTER(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute TST (register)
+	INSTR_dp(instr, reg, INSTR_DP_TST);
 }
 
 // ===== UADD16 - Unsigned Add 16-bit =====
 void INSTR_UADD16(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute UADD16
+	INSTR_unimplemented("UADD16", instr, reg);
 }
 
 void INSTR_UADD8(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute UADD8
+	INSTR_unimplemented("UADD8", instr, reg);
 }
 
 // ===== UASX - Unsigned Add and Subtract with Exchange =====
 void INSTR_UASX(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute UASX
+	INSTR_unimplemented("UASX", instr, reg);
 }
 
 // ===== UBFX - Unsigned Bit Field Extract =====
 void INSTR_UBFX(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute UBFX
+	uint32 lsb = (((instr >> 12) & 0x7) << 2) | ((instr >> 6) & 0x3);
+	uint32 width = (instr & 0x1F) + 1;
+	if (lsb + width <= 32) {
+		uint32_t value = (uint32_t)reg->R[(instr >> 16) & 0xF] << (32 - lsb - width);
+		reg->R[(instr >> 8) & 0xF] = value >> (32 - width);
+	}
 }
 
 // ===== UDF - Permanently Undefined =====
+// also where the decoder sends encodings it doesn't know
 void INSTR_UDF(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute UDF (generate exception)
+	if (!Fuzz_var_running) {
+		printf("cpu: undefined instruction %08x at pc %08x\n", (unsigned)instr, (unsigned)reg->R[15]);
+	}
+	Fault_raise(FAULT_USAGE, FAULT_UNDEFINSTR, 0);
 }
 
 // ===== UDIV - Unsigned Divide =====
 void INSTR_UDIV(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute UDIV
+	uint32_t a = (uint32_t)reg->R[(instr >> 16) & 0xF];
+	uint32_t b = (uint32_t)reg->R[instr & 0xF];
+	if (b == 0) {
+		INSTR_divzero(instr, reg);
+		return;
+	}
+	reg->R[(instr >> 8) & 0xF] = a / b;
 }
 
 // ===== UHADD16 - Unsigned Halving Add 16-bit =====
 void INSTR_UHADD16(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute UHADD16
+	INSTR_unimplemented("UHADD16", instr, reg);
 }
 
 void INSTR_UHADD8(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute UHADD8
+	INSTR_unimplemented("UHADD8", instr, reg);
 }
 
 // ===== UHASX - Unsigned Halving Add and Subtract with Exchange =====
 void INSTR_UHASX(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute UHASX
+	INSTR_unimplemented("UHASX", instr, reg);
 }
 
 // ===== UHSAX - Unsigned Halving Subtract and Add with Exchange =====
 void INSTR_UHSAX(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute UHSAX
+	INSTR_unimplemented("UHSAX", instr, reg);
 }
 
 // ===== UHSUB16 - Unsigned Halving Subtract 16-bit =====
 void INSTR_UHSUB16(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute UHSUB16
+	INSTR_unimplemented("UHSUB16", instr, reg);
 }
 
 void INSTR_UHSUB8(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute UHSUB8
+	INSTR_unimplemented("UHSUB8", instr, reg);
 }
 
 // ===== UMAAL - Unsigned Multiply Accumulate Accumulate Long =====
 void INSTR_UMAAL(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute UMAAL
+	uint32_t a = (uint32_t)reg->R[(instr >> 16) & 0xF];
+	uint32_t b = (uint32_t)reg->R[instr & 0xF];
+	uint64_t acc = INSTR_getlong(reg, instr);
+	INSTR_setlong(reg, instr, (uint64_t)a * b + (uint32_t)acc + (acc >> 32));
 }
 
 // ===== UMLAL - Unsigned Multiply Accumulate Long =====
 void INSTR_UMLAL(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute UMLAL
+	uint32_t a = (uint32_t)reg->R[(instr >> 16) & 0xF];
+	uint32_t b = (uint32_t)reg->R[instr & 0xF];
+	INSTR_setlong(reg, instr, (uint64_t)a * b + INSTR_getlong(reg, instr));
 }
 
 // ===== UMULL - Unsigned Multiply Long =====
 void INSTR_UMULL(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute UMULL
+	uint32_t a = (uint32_t)reg->R[(instr >> 16) & 0xF];
+	uint32_t b = (uint32_t)reg->R[instr & 0xF];
+	INSTR_setlong(reg, instr, (uint64_t)a * b);
 }
 
 // ===== UQADD16 - Unsigned Saturating Add 16-bit =====
 void INSTR_UQADD16(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute UQADD16
+	INSTR_unimplemented("UQADD16", instr, reg);
 }
 
 void INSTR_UQADD8(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute UQADD8
+	INSTR_unimplemented("UQADD8", instr, reg);
 }
 
 // ===== UQASX - Unsigned Saturating Add and Subtract with Exchange =====
 void INSTR_UQASX(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute UQASX
+	INSTR_unimplemented("UQASX", instr, reg);
 }
 
 // ===== UQSAX - Unsigned Saturating Subtract and Add with Exchange =====
 void INSTR_UQSAX(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute UQSAX
+	INSTR_unimplemented("UQSAX", instr, reg);
 }
 
 // ===== UQSUB16 - Unsigned Saturating Subtract 16-bit =====
 void INSTR_UQSUB16(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute UQSUB16
+	INSTR_unimplemented("UQSUB16", instr, reg);
 }
 
 void INSTR_UQSUB8(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute UQSUB8
+	INSTR_unimplemented("UQSUB8", instr, reg);
 }
 
 // ===== USAD8 - Unsigned Sum of Absolute Differences =====
 void INSTR_USAD8(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute USAD8
+	INSTR_unimplemented("USAD8", instr, reg);
 }
 
 // ===== USADA8 - Unsigned Sum of Absolute Differences and Accumulate =====
 void INSTR_USADA8(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute USADA8
+	INSTR_unimplemented("USADA8", instr, reg);
 }
 
 // ===== USAT - Unsigned Saturate =====
 void INSTR_USAT(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute USAT
+	uint32 amount = (((instr >> 12) & 0x7) << 2) | ((instr >> 6) & 0x3);
+	uint32 carry = 0;
+	int64_t value = (int32_t)INSTR_shiftc((uint32_t)reg->R[(instr >> 16) & 0xF], ((instr >> 21) & 0x1) ? 2 : 0, amount, &carry);
+	int64_t max = ((int64_t)0x1 << (instr & 0x1F)) - 1;
+	if (value > max || value < 0) {
+		value = (value > max) ? max : 0;
+		reg->xPSR.APSR.Q = 1;
+	}
+	reg->R[(instr >> 8) & 0xF] = (uint32_t)value;
 }
 
 void INSTR_USAT16(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute USAT16
+	INSTR_unimplemented("USAT16", instr, reg);
 }
 
 // ===== USAX - Unsigned Subtract and Add with Exchange =====
 void INSTR_USAX(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute USAX
+	INSTR_unimplemented("USAX", instr, reg);
 }
 
 // ===== USUB16 - Unsigned Subtract 16-bit =====
 void INSTR_USUB16(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute USUB16
+	INSTR_unimplemented("USUB16", instr, reg);
 }
 
 void INSTR_USUB8(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute USUB8
+	INSTR_unimplemented("USUB8", instr, reg);
 }
 
 // ===== UXTAB - Unsigned Extend and Add Byte =====
 void INSTR_UXTAB(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute UXTAB
+	INSTR_extend(instr, reg, 0xFF, 0);
 }
 
 void INSTR_UXTAB16(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute UXTAB16
+	INSTR_unimplemented("UXTAB16", instr, reg);
 }
 
 void INSTR_UXTAH(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute UXTAH
+	INSTR_extend(instr, reg, 0xFFFF, 0);
 }
 
 // ===== UXTB - Unsigned Extend Byte =====
 void INSTR_UXTB(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute UXTB
+	INSTR_extend(instr, reg, 0xFF, 0);
 }
 
 void INSTR_UXTB16(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute UXTB16
+	INSTR_unimplemented("UXTB16", instr, reg);
 }
 
 // ===== UXTH - Unsigned Extend Halfword =====
 void INSTR_UXTH(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute UXTH
+	INSTR_extend(instr, reg, 0xFFFF, 0);
 }
 
 // ===== FLOATING POINT INSTRUCTIONS =====
 
 // ===== VABS - Vector Absolute =====
 void INSTR_VABS(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute VABS
+	INSTR_nocp(instr, reg);
 }
 
 // ===== VADD - Vector Add =====
 void INSTR_VADD(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute VADD
+	INSTR_nocp(instr, reg);
 }
 
 // ===== VCMP, VCMPE - Vector Compare =====
 void INSTR_VCMP_VCMPE(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute VCMP/VCMPE
+	INSTR_nocp(instr, reg);
 }
 
 // ===== VCVTA, VCVTN, VCVTP, VCVTM - Vector Convert (rounding modes) =====
 void INSTR_VCVTA_VCVTN_VCVTP_AND_VCVTM(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute VCVTA/VCVTN/VCVTP/VCVTM
+	INSTR_nocp(instr, reg);
 }
 
 // ===== VCVT, VCVTR - Vector Convert (float/int) =====
 void INSTR_VCVT_VCVTR_BETWEEN_FLOATING_POINT_AND_INTEGER(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute VCVT/VCVTR (float<->int)
+	INSTR_nocp(instr, reg);
 }
 
 // ===== VCVT - Vector Convert (float/fixed) =====
 void INSTR_VCVT_BETWEEN_FLOATING_POINT_AND_FIXED_POINT(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute VCVT (float<->fixed)
+	INSTR_nocp(instr, reg);
 }
 
 // ===== VCVT - Vector Convert (double/single) =====
 void INSTR_VCVT_BETWEEN_DOUBLE_PRECISION_AND_SINGLE_PRECISION(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute VCVT (double<->single)
+	INSTR_nocp(instr, reg);
 }
 
 // ===== VCVTB, VCVTT - Vector Convert (half precision) =====
 void INSTR_VCVTB_VCVTT(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute VCVTB/VCVTT
+	INSTR_nocp(instr, reg);
 }
 
 // ===== VDIV - Vector Divide =====
 void INSTR_VDIV(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute VDIV
+	INSTR_nocp(instr, reg);
 }
 
 // ===== VFMA, VFMS - Vector Fused Multiply Accumulate/Subtract =====
 void INSTR_VFMA_VFMS(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute VFMA/VFMS
+	INSTR_nocp(instr, reg);
 }
 
 // ===== VFNMA, VFNMS - Vector Fused Negate Multiply Accumulate/Subtract =====
 void INSTR_VFNMA_VFNMS(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute VFNMA/VFNMS
+	INSTR_nocp(instr, reg);
 }
 
 // ===== VLDM - Vector Load Multiple =====
 void INSTR_VLDM(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute VLDM
+	INSTR_nocp(instr, reg);
 }
 
 // ===== VLDR - Vector Load Register =====
 void INSTR_VLDR(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute VLDR
+	INSTR_nocp(instr, reg);
 }
 
 // ===== VMAXNM, VMINNM - Vector Maximum/Minimum Number =====
 void INSTR_VMAXNM_VMINNM(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute VMAXNM/VMINNM
+	INSTR_nocp(instr, reg);
 }
 
 // ===== VMLA, VMLS - Vector Multiply Accumulate/Subtract =====
 void INSTR_VMLA_VMLS(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute VMLA/VMLS
+	INSTR_nocp(instr, reg);
 }
 
 // ===== VMOV - Vector Move (immediate) =====
 void INSTR_VMOV_IMMEDIATE(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute VMOV (immediate)
+	INSTR_nocp(instr, reg);
 }
 
 // ===== VMOV - Vector Move (register) =====
 void INSTR_VMOV_REGISTER(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute VMOV (register)
+	INSTR_nocp(instr, reg);
 }
 
 // ===== VMOV - ARM core register to scalar =====
 void INSTR_VMOV_ARM_CORE_REGISTER_TO_SCALAR(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute VMOV (ARM->scalar)
+	INSTR_nocp(instr, reg);
 }
 
 // ===== VMOV - Scalar to ARM core register =====
 void INSTR_VMOV_SCALAR_TO_ARM_CORE_REGISTER(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute VMOV (scalar->ARM)
+	INSTR_nocp(instr, reg);
 }
 
 // ===== VMOV - Between ARM core register and single-precision =====
 void INSTR_VMOV_BETWEEN_ARM_CORE_REGISTER_AND_SINGLE_PRECISION_REGISTER(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute VMOV (ARM<->single)
+	INSTR_nocp(instr, reg);
 }
 
 // ===== VMOV - Between two ARM core registers and two single-precision =====
 void INSTR_VMOV_BETWEEN_TWO_ARM_CORE_REGISTERS_AND_TWO_SINGLE_PRECISION_REGISTERS(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute VMOV (2xARM<->2xsingle)
+	INSTR_nocp(instr, reg);
 }
 
 // ===== VMOV - Between two ARM core registers and doubleword =====
 void INSTR_VMOV_BETWEEN_TWO_ARM_CORE_REGISTERS_AND_A_DOUBLEWORD_REGISTER(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute VMOV (2xARM<->double)
+	INSTR_nocp(instr, reg);
 }
 
 // ===== VMRS - Move to ARM core register from floating-point system register =====
 void INSTR_VMRS(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute VMRS
+	INSTR_nocp(instr, reg);
 }
 
 // ===== VMSR - Move to floating-point system register from ARM core register =====
 void INSTR_VMSR(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute VMSR
+	INSTR_nocp(instr, reg);
 }
 
 // ===== VMUL - Vector Multiply =====
 void INSTR_VMUL(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute VMUL
+	INSTR_nocp(instr, reg);
 }
 
 // ===== VNEG - Vector Negate =====
 void INSTR_VNEG(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute VNEG
+	INSTR_nocp(instr, reg);
 }
 
 // ===== VNMLA, VNMLS, VNMUL - Vector Negate Multiply... =====
 void INSTR_VNMLA_VNMLS_VNMUL(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute VNMLA/VNMLS/VNMUL
+	INSTR_nocp(instr, reg);
 }
 
 // ===== VPOP - Vector Pop =====
 void INSTR_VPOP(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute VPOP
+	INSTR_nocp(instr, reg);
 }
 
 // ===== VPUSH - Vector Push =====
 void INSTR_VPUSH(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute VPUSH
+	INSTR_nocp(instr, reg);
 }
 
 // ===== VRINTA, VRINTN, VRINTP, VRINTM - Vector Round (modes) =====
 void INSTR_VRINTA_VRINTN_VRINTP_AND_VRINTM(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute VRINTA/VRINTN/VRINTP/VRINTM
+	INSTR_nocp(instr, reg);
 }
 
 // ===== VRINTX - Vector Round (inexact) =====
 void INSTR_VRINTX(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute VRINTX
+	INSTR_nocp(instr, reg);
 }
 
 // ===== VRINTZ, VRINTR - Vector Round (zero/nearest) =====
 void INSTR_VRINTZ_VRINTR(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute VRINTZ/VRINTR
+	INSTR_nocp(instr, reg);
 }
 
 // ===== VSEL - Vector Select =====
 void INSTR_VSEL(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute VSEL
+	INSTR_nocp(instr, reg);
 }
 
 // ===== VSQRT - Vector Square Root =====
 void INSTR_VSQRT(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute VSQRT
+	INSTR_nocp(instr, reg);
 }
 
 // ===== VSTM - Vector Store Multiple =====
 void INSTR_VSTM(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute VSTM
+	INSTR_nocp(instr, reg);
 }
 
 // ===== VSTR - Vector Store Register =====
 void INSTR_VSTR(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute VSTR
+	INSTR_nocp(instr, reg);
 }
 
 // ===== VSUB - Vector Subtract =====
 void INSTR_VSUB(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute VSUB
+	INSTR_nocp(instr, reg);
 }
 
 // ===== WFE - Wait For Event =====
-void INSTR_WFE(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute WFE
+void INSTR_WFE(uint32, CPU_struct_reg*) {
 }
 
 // ===== WFI - Wait For Interrupt =====
-void INSTR_WFI(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute WFI
+void INSTR_WFI(uint32, CPU_struct_reg*) {
 }
 
 // ===== YIELD - Yield =====
-void INSTR_YIELD(uint32 instr, CPU_struct_reg* reg) {
-	// TODO: Decode and execute YIELD
+void INSTR_YIELD(uint32, CPU_struct_reg*) {
 }
@@ -0,0 +1,269 @@
+#include "Callprof.hpp"
+#include "Coverage.hpp"	// Coverage_elf_symbols, COVERAGE_ELF_ENV
+#include "IR.hpp"	// IR_MAX_GUEST
+#include <stdlib.h>	// getenv
+#include <string.h>
+#include <string>
+#include <map>
+
+struct Callprof_fn {
+	uint32 addr;	// entry
+	uint32 calls;
+	uint32 active;	// frames of it on the stack (recursion)
+	uint64_t incl;
+	uint64_t excl;
+};
+
+struct Callprof_arc {
+	Callprof_fn* caller;
+	Callprof_fn* callee;
+	uint32 calls;
+	uint64_t incl;
+};
+
+struct Callprof_frame {
+	Callprof_fn* fn;
+	Callprof_arc* arc;	// NULL for the root
+	uint32 ret;	// pc that pops it
+	uint32 exception;	// handler frame: only exception return pops it
+	uint64_t entered;
+};
+
+uint32 Callprof_var_enabled = 0;
+
+uint32 Callprof_var_calls = 0;
+uint32 Callprof_var_overflow = 0;
+
+static std::map<uint32, Callprof_fn> Callprof_var_fns;
+static std::map<uint64_t, Callprof_arc> Callprof_var_arcs;	// caller << 32 | callee
+static Callprof_frame Callprof_var_stack[CALLPROF_MAX_DEPTH];
+static uint32 Callprof_var_depth = 0;
+static uint64_t Callprof_var_charged = 0;	// CPU_var_cycles already given to a function
+
+void Callprof_init() {
+	const char* out = getenv(CALLPROF_ENV);
+	Callprof_var_enabled = (out != NULL && out[0] != '\0');
+	Callprof_var_fns.clear();
+	Callprof_var_arcs.clear();
+	Callprof_var_depth = 0;
+	Callprof_var_charged = 0;
+	Callprof_var_calls = 0;
+	Callprof_var_overflow = 0;
+}
+
+static Callprof_fn* Callprof_fn_get(uint32 addr) {
+	Callprof_fn* fn = &Callprof_var_fns[addr];
+	fn->addr = addr;
+	return fn;
+}
+
+// cycles since the last step belong to whatever was on top
+static void Callprof_charge() {
+	if (Callprof_var_depth != 0) {
+		Callprof_var_stack[Callprof_var_depth - 1].fn->excl += CPU_var_cycles - Callprof_var_charged;
+	}
+	Callprof_var_charged = CPU_var_cycles;
+}
+
+static void Callprof_push(uint32 addr, uint32 ret, uint32 exception) {
+	if (Callprof_var_depth == CALLPROF_MAX_DEPTH) {
+		Callprof_var_overflow += 1;
+		return;
+	}
+	Callprof_fn* fn = Callprof_fn_get(addr);
+	Callprof_frame* frame = &Callprof_var_stack[Callprof_var_depth];
+
+	frame->arc = NULL;
+	if (Callprof_var_depth != 0) {
+		Callprof_fn* caller = Callprof_var_stack[Callprof_var_depth - 1].fn;
+		frame->arc = &Callprof_var_arcs[((uint64_t)caller->addr << 32) | addr];
+		frame->arc->caller = caller;
+		frame->arc->callee = fn;
+		frame->arc->calls += 1;
+	}
+	fn->calls += 1;
+	fn->active += 1;
+	frame->fn = fn;
+	frame->ret = ret;
+	frame->exception = exception;
+	frame->entered = CPU_var_cycles;
+	Callprof_var_depth += 1;
+	Callprof_var_calls += 1;
+}
+
+static void Callprof_pop() {
+	Callprof_frame* frame = &Callprof_var_stack[--Callprof_var_depth];
+	uint64_t incl = CPU_var_cycles - frame->entered;
+
+	if (--frame->fn->active == 0) {
+		frame->fn->incl += incl;
+	}
+	if (frame->arc != NULL) {
+		frame->arc->incl += incl;
+	}
+}
+
+static uint32 Callprof_half(uint32 addr) {
+	Memory_map_elem* thismap = Memory_getMap(addr);
+	if (thismap == NULL || !MEMORY_IS_DIRECT(thismap) || addr + 2 > thismap->base + thismap->size) {
+		return 0;	// movs r0, r0: neither bl nor blx
+	}
+	uint8* data = &thismap->data[addr - thismap->base];
+	return data[0] | (data[1] << 8);
+}
+
+// the block [start, ...) ended in a bl / blx that set lr and went to pc
+static uint32 Callprof_isCall(CPU_struct_reg* reg, uint32 start) {
+	uint32 lr = reg->R[14];
+	uint32 ret = lr & ~0x1;
+	uint32 pc = reg->R[15];
+
+	if ((lr & 0x1) == 0 || ret < start + 2 || ret > start + IR_MAX_GUEST * 4) {
+		return 0;
+	}
+
+	// blx rm
+	uint32 hw = Callprof_half(ret - 2);
+	if ((hw & 0xFF87) == 0x4780) {
+		uint32 rm = (hw >> 3) & 0xF;
+		return rm == 14 || (reg->R[rm] & ~0x1) == pc;
+	}
+
+	// bl: S:I1:I2:imm10:imm11:0 from the return address
+	if (ret < start + 4) {
+		return 0;
+	}
+	uint32 hw1 = Callprof_half(ret - 4);
+	uint32 hw2 = Callprof_half(ret - 2);
+	if ((hw1 & 0xF800) != 0xF000 || (hw2 & 0xD000) != 0xD000) {
+		return 0;
+	}
+	uint32 s = (hw1 >> 10) & 0x1;
+	uint32 i1 = !(((hw2 >> 13) & 0x1) ^ s);
+	uint32 i2 = !(((hw2 >> 11) & 0x1) ^ s);
+	uint32_t imm = (s ? 0xFF000000 : 0) | (i1 << 23) | (i2 << 22) | ((hw1 & 0x3FF) << 12) | ((hw2 & 0x7FF) << 1);
+	return ((ret + imm) & 0xFFFFFFFF) == pc;
+}
+
+void Callprof_step(CPU_struct_reg* reg, uint32 start) {
+	uint32 pc = reg->R[15];
+
+	if (Callprof_var_depth == 0) {
+		Callprof_push(start, CALLPROF_NONE, 0);
+	}
+	Callprof_charge();
+
+	// back at the return address of a frame, the top one or a deeper one. not across a handler
+	for (uint32 i = Callprof_var_depth; i-- > 0;) {
+		Callprof_frame* frame = &Callprof_var_stack[i];
+		if (frame->ret == pc && !frame->exception) {
+			while (Callprof_var_depth > i) {
+				Callprof_pop();
+			}
+			return;
+		}
+		if (frame->exception) {
+			break;
+		}
+	}
+
+	if (Callprof_isCall(reg, start)) {
+		Callprof_push(pc, reg->R[14] & ~0x1, 0);
+	}
+}
+
+void Callprof_exception(CPU_struct_reg* reg, uint32 return_address) {
+	Callprof_charge();
+	Callprof_push(reg->R[15], return_address, 1);
+}
+
+void Callprof_excReturn() {
+	Callprof_charge();
+	while (Callprof_var_depth != 0) {
+		uint32 exception = Callprof_var_stack[Callprof_var_depth - 1].exception;
+		Callprof_pop();
+		if (exception) {
+			break;
+		}
+	}
+}
+
+// sorted STT_FUNC symbols, entry -> name
+static void Callprof_symbol(void* arg, const char* name, uint32 value, uint32 info) {
+	std::map<uint32, std::string>* names = (std::map<uint32, std::string>*)arg;
+	if ((info & 0xF) != 2) {	// STT_FUNC
+		return;
+	}
+	names->insert(std::make_pair(value & ~0x1, std::string(name)));	// the first alias wins
+}
+
+static std::string Callprof_name(std::map<uint32, std::string>& names, uint32 addr) {
+	char buf[32];
+	std::map<uint32, std::string>::iterator it = names.upper_bound(addr);
+	if (it == names.begin()) {
+		snprintf(buf, sizeof(buf), "0x%08x", (unsigned)addr);
+		return std::string(buf);
+	}
+	--it;
+	if (it->first == addr) {
+		return it->second;
+	}
+	snprintf(buf, sizeof(buf), "+0x%x", (unsigned)(addr - it->first));
+	return it->second + buf;
+}
+
+void Callprof_export() {
+	if (!Callprof_var_enabled) {
+		return;
+	}
+	Callprof_charge();
+	while (Callprof_var_depth != 0) {
+		Callprof_pop();
+	}
+
+	const char* out = getenv(CALLPROF_ENV);
+	const char* elfpath = getenv(COVERAGE_ELF_ENV);
+	std::map<uint32, std::string> names;
+	if (elfpath != NULL && elfpath[0] != '\0') {
+		uint32 elfsize = 0;
+		uint8* elf = (uint8*)map_file(elfpath, &elfsize);
+		if (elf != NULL) {
+			Coverage_elf_symbols(elf, elfsize, Callprof_symbol, &names);
+			unmap_file(elf, elfsize);
+		}
+		else {
+			eprintf("callprof: can't open %s\n", elfpath);
+		}
+	}
+
+	FILE* fp = fopen(out, "w");
+	if (fp == NULL) {
+		eprintf("callprof: can't write %s\n", out);
+		return;
+	}
+	uint64_t total = 0;
+	for (std::map<uint32, Callprof_fn>::iterator it = Callprof_var_fns.begin(); it != Callprof_var_fns.end(); ++it) {
+		total += it->second.excl;
+	}
+	fprintf(fp, "# callgrind format\nversion: 1\ncreator: microcon_emu\npositions: instr\nevents: Cycles\n");
+	fprintf(fp, "summary: %llu\n", (unsigned long long)total);
+
+	// one block per function: its own cost at its entry, then its calls. arcs are sorted by caller
+	std::map<uint64_t, Callprof_arc>::iterator arc = Callprof_var_arcs.begin();
+	for (std::map<uint32, Callprof_fn>::iterator it = Callprof_var_fns.begin(); it != Callprof_var_fns.end(); ++it) {
+		Callprof_fn* fn = &it->second;
+		fprintf(fp, "\nfn=%s\n0x%08x %llu\n", Callprof_name(names, fn->addr).c_str(), (unsigned)fn->addr, (unsigned long long)fn->excl);
+		for (; arc != Callprof_var_arcs.end() && (arc->first >> 32) == fn->addr; ++arc) {
+			Callprof_arc* a = &arc->second;
+			fprintf(fp, "cfn=%s\ncalls=%d 0x%08x\n0x%08x %llu\n", Callprof_name(names, a->callee->addr).c_str(),
+				(int)a->calls, (unsigned)a->callee->addr, (unsigned)fn->addr, (unsigned long long)a->incl);
+		}
+	}
+	fclose(fp);
+
+	printf("callprof: %d calls, %d functions, %llu cycles -> %s\n", (int)Callprof_var_calls, (int)Callprof_var_fns.size(),
+		(unsigned long long)total, out);
+	if (Callprof_var_overflow != 0) {
+		printf("callprof: %d calls deeper than %d frames not tracked\n", (int)Callprof_var_overflow, CALLPROF_MAX_DEPTH);
+	}
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include "Proxy.hpp"
+#include "CPU.hpp"
+
+/*
+* exact call graph profiler (callgrind output)
+*
+* every call and return is seen, nothing is sampled. a shadow stack of frames runs next to the guest stack:
+* - call: a block that ends in bl / blx rm. Callprof_step looks at the instruction in front of lr after the block:
+*   it has to be inside the block, be a bl whose target (or a blx whose rm) is the new pc. a frame for the
+*   new pc is pushed, returning to lr.
+* - return: the block left pc at the return address of the top frame (bx lr, pop {pc}, ldr pc, mov pc, lr ...).
+*   a pc that matches a deeper frame (longjmp, unwinding) pops everything above it too.
+* - exception: entry (CPU_exceptionEntry) pushes a frame for the handler over whatever was interrupted,
+*   exception return pops down to and including it, wherever the handler sends pc (context switches).
+* a tail call (b to another function) stays in the frame of the caller.
+*
+* costs, in simulated cycles (CPU_var_cycles):
+* - exclusive: whatever CPU_var_cycles moved by between two steps goes to the function on top.
+* - inclusive: from push to pop. a recursive function only counts its outermost activation.
+* - per caller -> callee arc: calls and inclusive cycles.
+* frames still open at exit (main, the idle loop) are closed then.
+*
+* MICROCON_EMU_CALLGRIND=<file> turns it on and names the callgrind file written at exit (kcachegrind,
+* callgrind_annotate). functions are named from the STT_FUNC symbols of MICROCON_EMU_ELF, by the
+* symbol at or below their entry. without an elf they are their addresses.
+* off, the cost is one compare per block.
+*/
+
+#define CALLPROF_ENV "MICROCON_EMU_CALLGRIND"
+#define CALLPROF_MAX_DEPTH 1024
+#define CALLPROF_NONE 0xFFFFFFFF	// return address of the root frame
+
+extern uint32 Callprof_var_enabled;
+
+// telemetry
+extern uint32 Callprof_var_calls;
+extern uint32 Callprof_var_overflow;	// calls not tracked, the shadow stack was full
+
+// after Memory_init
+extern void Callprof_init();
+
+// CPU_step, after the block (and its exception return): charge cycles, then push / pop for the call / return it ended in
+#define CALLPROF_STEP(reg, start) if (Callprof_var_enabled) Callprof_step((reg), (start))
+extern void Callprof_step(CPU_struct_reg* reg, uint32 start);
+
+// CPU_exceptionEntry, pc at the handler
+#define CALLPROF_EXCEPTION(reg, return_address) if (Callprof_var_enabled) Callprof_exception((reg), (return_address))
+extern void Callprof_exception(CPU_struct_reg* reg, uint32 return_address);
+
+// CPU_exceptionReturn
+#define CALLPROF_EXC_RETURN() if (Callprof_var_enabled) Callprof_excReturn()
+extern void Callprof_excReturn();
+
+// close the open frames and write the callgrind file
+extern void Callprof_export();
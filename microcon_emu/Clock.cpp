@@ -1,4 +1,5 @@
 #include "Clock.hpp"
+#include "Board.hpp"
 
 /*
 *
@@ -55,7 +56,10 @@ uint32 Clock_var_tick = 0;
 
 uint32 Clock_var_wake;
 
+uint32 Clock_var_halt = 0;
+
 uint32 Clock_arr_map = 0;
+uint32 Clock_var_board = 0;
 
 /* Clock schedule vector
 *
@@ -85,6 +89,7 @@ void Clock_init()
 	if ((Clock_schedule_vect_alloc & 0x2) != 0x0) {
 		efree(Clock_schedule_linkvect);
 	}
+	Clock_schedule_vect_alloc = 0;
 
 	Clock_var_wake = 1;
 	Clock_var_maxtickrate_prev = Clock_var_maxtickrate;
@@ -126,7 +131,7 @@ void Clock_body_main()
 
 	// -------- everything here before the while loop is only to be executed once. //
 
-	while (1) {
+	while (Clock_var_halt == 0) {
 
 		// recalculate simclock when clock scheduler has regenerated.
 		/*
@@ -386,6 +391,11 @@ void Clock_resume() {
 	Clock_var_wake = 1;
 }
 
+void Clock_halt() {
+	Clock_var_halt = 1;
+	Clock_var_wake = 1;	// a paused loop must not keep waiting
+}
+
 // function to insert clock objects in. master must always be index 0!!
 // obj is copied so you no need to worry about obj getting dereferenced.
 void Clock_add(uint32 index, Clock_struct* clock_obj) 
@@ -408,6 +418,7 @@ void Clock_add(uint32 index, Clock_struct* clock_obj)
 
 	Clock_arr_map |= (0x1 << index);
 	Clock_arr[index] = *clock_obj;	// copy obj
+	Clock_var_board = 0;
 
 }
 
@@ -428,6 +439,7 @@ void Clock_replace(uint32 index, Clock_struct* clock_obj)
 
 	Clock_arr_map |= (0x1 << index);
 	Clock_arr[index] = *clock_obj;	// copy obj
+	Clock_var_board = 0;
 
 }
 
@@ -468,8 +480,34 @@ uint32 Clock_ready_getmaxvalperobj(uint32 masterclock, uint32 startindex) {
 	return masterclock * maxval / countermax;	// percentage
 }
 
+#ifdef MICROCON_EMU_BOARD_FIXED
+// the tape the compiler built for the board tree (Board.hpp). lives in rodata, nothing for Clock_init to free
+static void Clock_ready_board() {
+	Clock_var_maxtickrate = Board_var_tape.maxtickrate;
+	Clock_var_tickratemul = Board_var_tape.tickratemul;
+	Clock_var_maxindex = Board_var_tape.maxindex;
+	for (uint32 i = 0; i < CLOCK_MAX_SCHEDULE_SIZE; i++) {
+		Clock_tickratearr[i] = Board_var_tape.tickrate[i];
+		Clock_div_arr[i] = Board_var_tape.div[i];
+	}
+	Clock_schedule_vect = (uint32*)Board_var_tape.vect;
+	Clock_var_vectormode = Board_var_tape.vectormode;
+	Clock_schedule_linkvect = Clock_var_vectormode ? (uint32*)Board_var_tape.linkvect : NULL;
+	Clock_schedule_vect_alloc = 0;
+
+	Clock_var_poweron = 1;	// ready to run.
+	Clock_var_poweron_count += 1;
+}
+#endif
+
 void Clock_ready()
 {
+#ifdef MICROCON_EMU_BOARD_FIXED
+	if (Clock_var_board) {
+		Clock_ready_board();
+		return;
+	}
+#endif
 	uint32 masterclock = 0;
 	uint32 tmpclock = 0;
 
@@ -146,8 +146,8 @@ static inline uint32 Clock_hintavail_cycle(uint32 master_index, uint32 n, uint32
 	return closest_peri_remaining_ticks;
 }
 
-// static instead of extern, this is only to be used in Clock.
-static inline uint32 Clock_gcd(uint32 a, uint32 b) {
+// static instead of extern, this is only to be used in Clock (and the board tape, Board.hpp).
+static constexpr uint32 Clock_gcd(uint32 a, uint32 b) {
 	while (b != 0) {
 		// (a - (a / b) * b) -> a % b
 		uint32 temp = b;
@@ -156,13 +156,17 @@ static inline uint32 Clock_gcd(uint32 a, uint32 b) {
 	}
 	return a;
 }
-static inline uint32 Clock_lcm(uint32 a, uint32 b) {
+static constexpr uint32 Clock_lcm(uint32 a, uint32 b) {
 	return (a / Clock_gcd(a, b)) * b;
 }
 
 extern void Clock_pause();
 extern void Clock_resume();
 
+// leave Clock_body_main after the current frame (guest exited)
+extern uint32 Clock_var_halt;
+extern void Clock_halt();
+
 extern void Clock_init();
 
 // main body for counting ticks
@@ -178,6 +182,8 @@ extern void Clock_remove(uint32 index);
 
 // calculate LCM and generate clock schedule arr for run
 extern void Clock_ready();
+// 1 while the tree is the one Board_clocks() put in (Clock_add / Clock_replace clear it)
+extern uint32 Clock_var_board;
 
 // telemetry
 extern uint32 Clock_currenttime();
@@ -2,19 +2,17 @@
 
 int Core_var_status;
 int Core_var_Memory_init;
+static int Core_var_selftest = 0;	// no image: the allocator and scheduler test instead
+
+#define CORE_SELFTEST_SECONDS 10	// the scheduler test stops after this long
 
 
-int test_pericpu_count = 0;
 int test_peri0_count = 0;
 int test_peri1_count = 0;
 int test_peri2_count = 0;
 int test_peri3_count = 0;
 int test_peri4_count = 0;
 
-void test_pericpu() {
-    eprintf("pericpu executing... the time is: %d\n", Clock_currenttime());
-    test_pericpu_count += 1;
-}
 void test_peri0() {
     eprintf("mul0 -> peri0 executing... the time is: %d\n", Clock_currenttime());
     test_peri0_count += 1;
@@ -34,7 +32,7 @@ void test_peri3() {
     eprintf("mul1 -> peri3 executing... the time is: %d\n", Clock_currenttime());
     test_peri3_count += 1;
 
-    eprintf("counting result: cpu: %d, peri0(0.7): %d, peri1(0.7): %d, peri2(0.3): %d, peri3(0.5): %d, Clock_var_hintcycles: %d\n", test_pericpu_count, 
+    eprintf("counting result: cpu: %d cycles, peri0(0.7): %d, peri1(0.7): %d, peri2(0.3): %d, peri3(0.5): %d, Clock_var_hintcycles: %d\n", (int)CPU_var_cycles, 
     	test_peri0_count, test_peri1_count, test_peri2_count, test_peri3_count, CLOCK_GET_AVAILABLE_CYCLES());
     // TODO: clock drift test (must not drift, otherwise accuracy is at stake!)
 
@@ -97,101 +95,111 @@ void test_peri_print() {
     test_peri4_count += 1;
     // eprintf("%d seconds passed. slept: %d\n", test_peri4_count, Clock_var_sleepfor);
 
+    if (test_peri4_count == CORE_SELFTEST_SECONDS) {
+        Clock_var_halt = 1;
+    }
 }
 
-enum hell { op321, op123, op456, op654, op234, op432, op111 };
-
-void hello_opt(int* data, int* value) {
-	int i = 0;
-	static int op_table[1000];
-
-	op_table[321] = op321;
-	op_table[123] = op123;
-	op_table[456] = op456;
-	op_table[654] = op654;
-	op_table[234] = op234;
-	op_table[432] = op432;
-	op_table[111] = op111;
-	while (1) {
-		switch (op_table[data[i++]]) {	// the case values must be adjacent to each other for the compiler to optimize it to jump table (jump table confirmed at O0)
-		case op321:
-			*value *= *value;
-			break;
-		case op123:
-			*value += *value;
-			break;
-		case op456:
-			*value /= *value;
-			break;
-		case op654:
-			*value -= *value;
-			break;
-		case op234:
-			*value = *value + 123;
-			break;
-		case op432:
-			*value = *value + 321;
-			break;
-		case op111:
-			return;
-		default:
-			break;
-		}
-	}
-}
-
-void Core_mainThread() {
-	// FOR NOW: we shall do test running here
+// the scheduler test: the test peripherals above on top of the board clock tree. never part of a booted image,
+// test_peri3 writes to sram and replaces clock objects
+static void Core_clockTest() {
+	struct Clock_struct clockmul0;	// for peri0 peri1
+	struct Clock_struct clockmul1;	// for per2
+	struct Clock_struct clockperi0;		// peri0
+	struct Clock_struct clockperi1;		// peri1
+	struct Clock_struct clockperi2;		// peri2
+	struct Clock_struct clockmul2;	// to mul0
+	struct Clock_struct clockperi3;	// peri3
+	struct Clock_struct testmul;
+	struct Clock_struct testperi;
 
-	int* data = (int *)ecalloc(0x10000, sizeof(int));
+	clockmul0.linked_by = 0;
+	clockmul0.clock_type = Clock_type_enum::midobj;
+	clockmul0.multiplier = 70;	// 0.7
+	Clock_add(2, &clockmul0);
 
-	for (int i = 0; i < 0x10000; i++) {
-		switch (i % 6) {
-		case 0:
-			data[i] = 123;
-			break;
-		case 1:
-			data[i] = 321;
-			break;
+	clockperi0.linked_by = 2;
+	clockperi0.clock_type = Clock_type_enum::peri;
+	clockperi0.objfunc = test_peri0;
+	Clock_add(3, &clockperi0);
 
-		case 2:
-			data[i] = 234;
-			break;
-		case 3:
-			data[i] = 432;
-			break;
-		case 4:
-			data[i] = 456;
-			break;
-		case 5:
-			data[i] = 654;
-			break;
+	clockperi1.linked_by = 2;
+	clockperi1.clock_type = Clock_type_enum::peri;
+	clockperi1.objfunc = test_peri1;
+	Clock_add(4, &clockperi1);
 
-		}
-	}
-	data[0x10000 - 1] = 111;
-	int value = 121;
+	clockmul1.linked_by = 0;
+	clockmul1.clock_type = Clock_type_enum::midobj;
+	clockmul1.multiplier = 30;	// 0.3
+	Clock_add(5, &clockmul1);
 
-	hello_opt(data, &value);			// 1st place
+	clockperi2.linked_by = 5;
+	clockperi2.clock_type = Clock_type_enum::peri;
+	clockperi2.objfunc = test_peri2;
+	Clock_add(6, &clockperi2);
 
-	// eprintf("value = %d\n", value);
+	clockmul2.linked_by = 2;
+	clockmul2.clock_type = Clock_type_enum::midobj;
+	clockmul2.multiplier = 70;  // 0.7 * 0.7 = 0.49999...0.5
+	Clock_add(7, &clockmul2);
 
+	clockperi3.linked_by = 7;
+	clockperi3.clock_type = Clock_type_enum::peri;
+	clockperi3.objfunc = test_peri3;
+	Clock_add(8, &clockperi3);
 
+	testmul.linked_by = 0;
+	testmul.clock_type = Clock_type_enum::midobj;
+	testmul.multiplier = 1;	// 0.01 -> every 1 second
+	Clock_add(9, &testmul);
 
+	testperi.linked_by = 9;
+	testperi.clock_type = Clock_type_enum::peri;
+	testperi.objfunc = test_peri_print;
+	Clock_add(10, &testperi);
+}
 
+void Core_mainThread() {
+	// FOR NOW: we shall do test running here
+	// (the dispatch experiment that ran here first is bench_dispatch.cpp, ./build.sh bench)
 
 	//return;
 
-	Clock_body_main();
-
-}
-
-void Core_start(Thread_data* mydata) {
+	// the self test: the scheduler alone, until test_peri_print stops it
+	if (Core_var_selftest) {
+		Clock_body_main();
+		return;
+	}
 
-	// FOR NOW: we shall do test related init in here
+	// fuzzing: the cpu alone, from the snapshot over and over (Fuzz.hpp)
+	if (Fuzz_var_enabled) {
+		Fuzz_main();
+	}
+	// the image on several lanes in lockstep (Batch.hpp)
+	else if (Batch_var_enabled) {
+		Batch_main();
+	}
+	else {
+		Clock_body_main();
+	}
 
-	logalloc_init();
+	Semihost_shutdown();
+	Itm_shutdown();
+	IrqStat_dump();
+	Hle_dump();
+	Idiom_dump();
+	Poll_dump();
+	Coverage_export();
+	Callprof_export();
+	Rtos_dump();
+
+	// keep what was translated for the next boot of the same image
+	Tier_shutdown();
+	JitAot_save(JitAot_dir());
+}
 
+// the allocator test, Core_start runs it when there is no image
+static void Core_logallocTest() {
 // #ifdef RELATIVE_INDEXING
 // 	efree((uint32*)(logalloc_pool + 0x2));
 // #else
@@ -676,79 +684,28 @@ void Core_start(Thread_data* mydata) {
 
 	/* DUMP 6: Final state after all allocator tests complete */
 	logalloc_dump_pool();
-	
-	exit(0);
-
-
-	Clock_init();
-	
-	// do scheduling first
-	struct Clock_struct clockgen;	// for master clock
-	struct Clock_struct clockpericpu;	// cpu
-	struct Clock_struct clockmul0;	// for peri0 peri1
-	struct Clock_struct clockmul1;	// for per2
-	struct Clock_struct clockperi0;		// peri0
-	struct Clock_struct clockperi1;		// peri1
-	struct Clock_struct clockperi2;		// peri2
-	struct Clock_struct clockmul2;	// to mul0
-	struct Clock_struct clockperi3;	// peri3
-	struct Clock_struct testmul;
-	struct Clock_struct testperi;
-
-	clockgen.baseclock = 100;	// 10hz
-	clockgen.clock_type = Clock_type_enum::master;
-	Clock_add(0, &clockgen);
-
-	clockpericpu.linked_by = 0;
-	clockpericpu.clock_type = Clock_type_enum::peri;
-	clockpericpu.objfunc = test_pericpu;
-	Clock_add(1, &clockpericpu);
-
-	clockmul0.linked_by = 0;
-	clockmul0.clock_type = Clock_type_enum::midobj;
-	clockmul0.multiplier = 70;	// 0.7
-	Clock_add(2, &clockmul0);
-	
-	clockperi0.linked_by = 2;
-	clockperi0.clock_type = Clock_type_enum::peri;
-	clockperi0.objfunc = test_peri0;
-	Clock_add(3, &clockperi0);
-
-	clockperi1.linked_by = 2;
-	clockperi1.clock_type = Clock_type_enum::peri;
-	clockperi1.objfunc = test_peri1;
-	Clock_add(4, &clockperi1);
-
-	clockmul1.linked_by = 0;
-	clockmul1.clock_type = Clock_type_enum::midobj;
-	clockmul1.multiplier = 30;	// 0.3
-	Clock_add(5, &clockmul1);
+}
 
-	clockperi2.linked_by = 5;
-	clockperi2.clock_type = Clock_type_enum::peri;
-	clockperi2.objfunc = test_peri2;
-	Clock_add(6, &clockperi2);
+void Core_start(Thread_data* mydata) {
 
-	clockmul2.linked_by = 2;
-	clockmul2.clock_type = Clock_type_enum::midobj;
-	clockmul2.multiplier = 70;  // 0.7 * 0.7 = 0.49999...0.5
-	Clock_add(7, &clockmul2);
+	// FOR NOW: we shall do test related init in here
 
-	clockperi3.linked_by = 7;
-	clockperi3.clock_type = Clock_type_enum::peri;
-	clockperi3.objfunc = test_peri3;
-	Clock_add(8, &clockperi3);
+	logalloc_init();
 
-	testmul.linked_by = 0;
-	testmul.clock_type = Clock_type_enum::midobj;
-	testmul.multiplier = 1;	// 0.01 -> every 1 second
-	Clock_add(9, &testmul);
+	// no image to run: the self test. the allocator, then the scheduler with the test peripherals
+	if (Loader_path() == NULL) {
+		Core_logallocTest();
+		Core_var_selftest = 1;
+	}
 
-	testperi.linked_by = 9;
-	testperi.clock_type = Clock_type_enum::peri;
-	testperi.objfunc = test_peri_print;
-	Clock_add(10, &testperi);
 
+	Clock_init();
+	
+	// do scheduling first: the clock tree of the board (Board.hpp), the test objects only for the self test
+	Board_clocks();
+	if (Core_var_selftest) {
+		Core_clockTest();
+	}
 	Clock_ready();
 	
 	mydata->func = Core_mainThread;
@@ -761,6 +718,36 @@ void Core_start(Thread_data* mydata) {
 	// core module status init
 	Core_var_Memory_init = 0;
 	Memory_init();
+	if (Core_var_selftest) {
+		Core_var_Memory_init = 1;
+		return;
+	}
+	Fastmem_init();
+	MPU_init();
+	Dwt_init();
+	Itm_init();
+	Fuzz_init();
+	Batch_setup();
+	Semihost_init();
+	Nvic_init();
+	IrqStat_init();
+	Coverage_init();
+	Callprof_init();
+	Rtos_init();
+	Idiom_init();
+	Poll_init();
+	Hle_init();
+	JitCache_init();
+
+	// firmware into memory, the cpu out of reset
+	if (!Loader_boot()) {
+		printf("no image to run\n");
+		exit(1);
+	}
+
+	// blocks translated last time: keyed by the hash of the image, so not before it is in memory
+	JitAot_load(JitAot_dir());
+	Tier_init();
 	Core_var_Memory_init = 1;
 }
 
@@ -3,6 +3,27 @@
 #include "Proxy.hpp"
 #include "Memory.hpp"
 #include "Clock.hpp"
+#include "MPU.hpp"
+#include "Semihost.hpp"
+#include "IrqStat.hpp"
+#include "Nvic.hpp"
+#include "Coverage.hpp"
+#include "Idiom.hpp"
+#include "Poll.hpp"
+#include "Hle.hpp"
+#include "Fastmem.hpp"
+#include "JitCache.hpp"
+#include "JitAot.hpp"
+#include "Tier.hpp"
+#include "Fault.hpp"
+#include "Callprof.hpp"
+#include "Rtos.hpp"
+#include "Dwt.hpp"
+#include "Itm.hpp"
+#include "Fuzz.hpp"
+#include "Batch.hpp"
+#include "Board.hpp"
+#include "Loader.hpp"
 
 // type defines
 
@@ -0,0 +1,610 @@
+#include "Coverage.hpp"
+#include "Fuzz.hpp"
+#include <stdlib.h>	// getenv
+#include <string.h>
+#include <string>
+#include <map>
+#include <vector>
+
+uint32 Coverage_var_enabled = 0;
+uint32 Coverage_var_new = 0;
+uint32 Coverage_var_paths = 0;
+
+#define COVERAGE_BITMAP_WORDS(size) ((((size) >> 1) + 31) >> 5)
+
+void Coverage_init() {
+	const char* out = getenv(COVERAGE_ENV);
+	Coverage_var_enabled = (out != NULL && out[0] != '\0') || Fuzz_var_enabled;
+	Coverage_var_new = 0;
+	Coverage_var_paths = Fuzz_var_enabled;
+
+	for (uint32 i = 0; i < Memory_var_arrlen; i++) {
+		Memory_map_elem* thismap = &Memory_var_arr[i];
+		if (thismap->coverage != NULL) {
+			efree(thismap->coverage);
+			thismap->coverage = NULL;
+		}
+		if (Coverage_var_enabled && MEMORY_IS_DIRECT(thismap) && (thismap->attrib & (MEMORY_ATTRIB_U_X | MEMORY_ATTRIB_S_X)) != 0) {
+			thismap->coverage = (uint32*)ecalloc(COVERAGE_BITMAP_WORDS(thismap->size), sizeof(uint32));
+		}
+	}
+}
+
+void Coverage_mark(uint32 start, uint32 end) {
+	Memory_map_elem* thismap = Memory_getMap(start);
+	if (thismap == NULL || thismap->coverage == NULL) {
+		return;
+	}
+	if (end > thismap->base + thismap->size) {
+		end = thismap->base + thismap->size;
+	}
+
+	uint32 first = (start - thismap->base) >> 1;
+	uint32 last = (end - thismap->base + 1) >> 1;	// exclusive
+	uint32* bitmap = thismap->coverage;
+	for (uint32 half = first; half < last; half++) {
+		uint32 bit = 0x1 << (half & 0x1F);
+		if ((bitmap[half >> 5] & bit) == 0) {
+			bitmap[half >> 5] |= bit;
+			Coverage_var_new += 1;
+		}
+	}
+}
+
+void Coverage_markPath(uint32 start, uint32 instrs) {
+	Memory_map_elem* thismap = Memory_getMap(start);
+	if (thismap == NULL || thismap->coverage == NULL) {
+		return;
+	}
+	// thumb: a first halfword of 0b11101 / 0b11110 / 0b11111 starts a 32bit instruction
+	uint32 end = start;
+	for (uint32 i = 0; i < instrs && end + 2 <= thismap->base + thismap->size; i++) {
+		uint8* data = &thismap->data[end - thismap->base];
+		uint32 hw = data[0] | (data[1] << 8);
+		end += ((hw >> 11) >= 0x1D) ? 4 : 2;
+	}
+	Coverage_mark(start, end);
+}
+
+uint32 Coverage_test(uint32 addr) {
+	Memory_map_elem* thismap = Memory_getMap(addr);
+	if (thismap == NULL || thismap->coverage == NULL) {
+		return 0;
+	}
+	uint32 half = (addr - thismap->base) >> 1;
+	return (thismap->coverage[half >> 5] >> (half & 0x1F)) & 0x1;
+}
+
+uint32 Coverage_count(uint32 start, uint32 end) {
+	uint32 count = 0;
+	for (uint32 addr = start & ~0x1; addr < end; addr += 2) {
+		count += Coverage_test(addr);
+	}
+	return count;
+}
+
+
+/*
+* elf / dwarf reader, only what the export (and Hle.cpp) needs: section lookup, .symtab and the .debug_line state machine.
+* 32 bit little endian elf (arm), 32 bit dwarf.
+*/
+
+struct Coverage_reader {
+	const uint8* pos;
+	const uint8* end;
+	uint32 bad;	// ran past end
+};
+
+static uint32 Coverage_u8(Coverage_reader* r) {
+	if (r->pos + 1 > r->end) {
+		r->bad = 1;
+		return 0;
+	}
+	return *r->pos++;
+}
+
+static uint32 Coverage_u16(Coverage_reader* r) {
+	uint32 value = Coverage_u8(r);
+	return value | (Coverage_u8(r) << 8);
+}
+
+static uint32 Coverage_u32(Coverage_reader* r) {
+	uint32 value = Coverage_u16(r);
+	return value | (Coverage_u16(r) << 16);
+}
+
+static void Coverage_skip(Coverage_reader* r, uint32 size) {
+	if (size > (uint32)(r->end - r->pos)) {
+		r->bad = 1;
+		r->pos = r->end;
+		return;
+	}
+	r->pos += size;
+}
+
+static uint32 Coverage_uleb(Coverage_reader* r) {
+	uint32 value = 0;
+	uint32 shift = 0;
+	uint32 byte;
+	do {
+		byte = Coverage_u8(r);
+		if (shift < 32) {
+			value |= (byte & 0x7F) << shift;
+		}
+		shift += 7;
+	} while ((byte & 0x80) && !r->bad);
+	return value & 0xFFFFFFFF;
+}
+
+static long Coverage_sleb(Coverage_reader* r) {
+	long value = 0;
+	uint32 shift = 0;
+	uint32 byte;
+	do {
+		byte = Coverage_u8(r);
+		if (shift < 63) {
+			value |= (long)(byte & 0x7F) << shift;
+		}
+		shift += 7;
+	} while ((byte & 0x80) && !r->bad);
+	if (shift < 64 && (byte & 0x40)) {
+		value |= -((long)1 << shift);
+	}
+	return value;
+}
+
+static const char* Coverage_cstr(Coverage_reader* r) {
+	const char* str = (const char*)r->pos;
+	while (r->pos < r->end && *r->pos != 0) {
+		r->pos++;
+	}
+	if (r->pos >= r->end) {
+		r->bad = 1;
+		return "";
+	}
+	r->pos++;
+	return str;
+}
+
+struct Coverage_section {
+	const uint8* data;
+	uint32 size;
+	uint32 link;
+};
+
+static uint32 Coverage_elf_section(const uint8* elf, uint32 elfsize, const char* name, uint32 type, Coverage_section* out) {
+	Coverage_reader r = { elf, elf + elfsize, 0 };
+	if (elfsize < 0x34 || memcmp(elf, "\x7F" "ELF", 4) != 0 || elf[4] != 1 || elf[5] != 1) {
+		return 0;	// not elf32 little endian
+	}
+	Coverage_skip(&r, 0x20);
+	uint32 shoff = Coverage_u32(&r);
+	Coverage_skip(&r, 0x2E - 0x24);
+	uint32 shentsize = Coverage_u16(&r);
+	uint32 shnum = Coverage_u16(&r);
+	uint32 shstrndx = Coverage_u16(&r);
+	if (shentsize < 40 || shoff > elfsize || (uint64_t)shnum * shentsize > elfsize - shoff || shstrndx >= shnum) {
+		return 0;
+	}
+
+	const uint8* strhdr = elf + shoff + shstrndx * shentsize;
+	uint32 stroff = strhdr[16] | (strhdr[17] << 8) | (strhdr[18] << 16) | ((uint32)strhdr[19] << 24);
+	for (uint32 i = 0; i < shnum; i++) {
+		Coverage_reader h = { elf + shoff + i * shentsize, elf + shoff + (i + 1) * shentsize, 0 };
+		uint32 sh_name = Coverage_u32(&h);
+		uint32 sh_type = Coverage_u32(&h);
+		Coverage_skip(&h, 8);
+		uint32 sh_offset = Coverage_u32(&h);
+		uint32 sh_size = Coverage_u32(&h);
+		uint32 sh_link = Coverage_u32(&h);
+
+		if ((type != 0 && sh_type != type) || (name != NULL && (stroff + sh_name >= elfsize ||
+			strncmp((const char*)elf + stroff + sh_name, name, elfsize - stroff - sh_name) != 0))) {
+			continue;
+		}
+		if (sh_offset > elfsize || sh_size > elfsize - sh_offset) {
+			return 0;
+		}
+		out->data = elf + sh_offset;
+		out->size = sh_size;
+		out->link = sh_link;
+		if (out->link < shnum) {
+			// caller may need the linked section (symtab -> strtab)
+			const uint8* linkhdr = elf + shoff + sh_link * shentsize;
+			uint32 link_offset = linkhdr[16] | (linkhdr[17] << 8) | (linkhdr[18] << 16) | ((uint32)linkhdr[19] << 24);
+			uint32 link_size = linkhdr[20] | (linkhdr[21] << 8) | (linkhdr[22] << 16) | ((uint32)linkhdr[23] << 24);
+			out->link = (link_offset <= elfsize && link_size <= elfsize - link_offset) ? link_offset : 0;
+		}
+		return 1;
+	}
+	return 0;
+}
+
+// calls fn for every named symbol in .symtab: name, value (thumb bit as is), st_info. returns 0 without a .symtab
+uint32 Coverage_elf_symbols(const uint8* elf, uint32 elfsize, void (*fn)(void* arg, const char* name, uint32 value, uint32 info), void* arg) {
+	Coverage_section symtab = { NULL, 0, 0 };
+	if (!Coverage_elf_section(elf, elfsize, ".symtab", 2, &symtab) || symtab.link == 0) {	// SHT_SYMTAB
+		return 0;
+	}
+	const char* strtab = (const char*)elf + symtab.link;
+	uint32 strtab_max = elfsize - symtab.link;
+	for (uint32 off = 16; off + 16 <= symtab.size; off += 16) {	// entry 0 is null
+		Coverage_reader s = { symtab.data + off, symtab.data + off + 16, 0 };
+		uint32 st_name = Coverage_u32(&s);
+		uint32 st_value = Coverage_u32(&s);
+		Coverage_u32(&s);
+		uint32 st_info = Coverage_u8(&s);
+		if (st_name == 0 || st_name >= strtab_max || memchr(strtab + st_name, 0, strtab_max - st_name) == NULL) {
+			continue;
+		}
+		fn(arg, strtab + st_name, st_value, st_info);
+	}
+	return 1;
+}
+
+
+/*
+* lcov data: file -> line -> hit, plus the first line of every address for function records
+*/
+struct Coverage_line {
+	const std::string* file;
+	uint32 line;
+};
+
+struct Coverage_func {
+	uint32 line;
+	std::string name;
+	uint32 hit;
+};
+
+typedef std::map<std::string, std::map<uint32, uint32> > Coverage_lines_t;
+typedef std::map<uint32, Coverage_line> Coverage_rows_t;
+
+struct Coverage_funcs_arg {
+	Coverage_rows_t* rows;
+	std::map<const std::string*, std::vector<Coverage_func> >* funcs;
+};
+
+static void Coverage_funcs_add(void* arg, const char* name, uint32 value, uint32 info) {
+	Coverage_funcs_arg* f = (Coverage_funcs_arg*)arg;
+	if ((info & 0xF) != 2) {	// STT_FUNC
+		return;
+	}
+	Coverage_rows_t::iterator row = f->rows->find(value & ~0x1);	// thumb bit
+	if (row == f->rows->end()) {
+		return;
+	}
+	Coverage_func func = { row->second.line, std::string(name), Coverage_test(value & ~0x1) };
+	(*f->funcs)[row->second.file].push_back(func);
+}
+
+static void Coverage_row(Coverage_lines_t* lines, Coverage_rows_t* rows, const std::string& file, uint32 line, uint32 start, uint32 end) {
+	if (end <= start || line == 0) {
+		return;
+	}
+	Memory_map_elem* thismap = Memory_getMap(start);
+	if (thismap == NULL || thismap->coverage == NULL) {
+		return;	// not in executable memory of this board
+	}
+
+	Coverage_lines_t::iterator it = lines->insert(std::make_pair(file, std::map<uint32, uint32>())).first;
+	uint32& hit = it->second[line];
+	if (!hit && Coverage_count(start, end) != 0) {
+		hit = 1;
+	}
+
+	Coverage_line row = { &it->first, line };
+	rows->insert(std::make_pair(start, row));
+}
+
+// dwarf 5 directory / file entry: pick DW_LNCT_path and DW_LNCT_directory_index, skip the rest
+static void Coverage_entry(Coverage_reader* r, const std::vector<uint32>& format, Coverage_section* line_str,
+	Coverage_section* str, std::string* path, uint32* dir) {
+	*path = "";
+	*dir = 0;
+	for (size_t f = 0; f + 1 < format.size(); f += 2) {
+		uint32 content = format[f];
+		uint32 form = format[f + 1];
+		const char* text = NULL;
+		uint32 value = 0;
+
+		switch (form) {
+		case 0x08:	// DW_FORM_string
+			text = Coverage_cstr(r);
+			break;
+		case 0x1F:	// DW_FORM_line_strp
+		case 0x0E: {	// DW_FORM_strp
+			uint32 offset = Coverage_u32(r);
+			Coverage_section* pool = (form == 0x1F) ? line_str : str;
+			text = (pool->data != NULL && offset < pool->size) ? (const char*)pool->data + offset : "";
+			break;
+		}
+		case 0x0B: value = Coverage_u8(r); break;	// DW_FORM_data1
+		case 0x05: value = Coverage_u16(r); break;	// DW_FORM_data2
+		case 0x06: value = Coverage_u32(r); break;	// DW_FORM_data4
+		case 0x07: Coverage_skip(r, 8); break;	// DW_FORM_data8
+		case 0x1E: Coverage_skip(r, 16); break;	// DW_FORM_data16 (md5)
+		case 0x0F: value = Coverage_uleb(r); break;	// DW_FORM_udata
+		case 0x09: Coverage_skip(r, Coverage_uleb(r)); break;	// DW_FORM_block
+		default:
+			r->bad = 1;
+			return;
+		}
+
+		if (content == 1 && text != NULL) {	// DW_LNCT_path
+			*path = text;
+		}
+		else if (content == 2) {	// DW_LNCT_directory_index
+			*dir = value;
+		}
+	}
+}
+
+static std::string Coverage_join(const std::vector<std::string>& dirs, uint32 dir, const std::string& name) {
+	if (name.empty() || name[0] == '/' || (name.size() > 1 && name[1] == ':') || dir >= dirs.size() || dirs[dir].empty()) {
+		return name;
+	}
+	return dirs[dir] + "/" + name;
+}
+
+static void Coverage_debug_line(Coverage_section* debug_line, Coverage_section* line_str, Coverage_section* str,
+	Coverage_lines_t* lines, Coverage_rows_t* rows) {
+	Coverage_reader unit = { debug_line->data, debug_line->data + debug_line->size, 0 };
+
+	while (!unit.bad && unit.pos + 4 <= unit.end) {
+		uint32 length = Coverage_u32(&unit);
+		if (length == 0xFFFFFFFF || length > (uint32)(unit.end - unit.pos)) {
+			break;	// 64 bit dwarf or garbage
+		}
+		Coverage_reader r = { unit.pos, unit.pos + length, 0 };
+		unit.pos += length;
+
+		uint32 version = Coverage_u16(&r);
+		if (version < 2 || version > 5) {
+			continue;
+		}
+		if (version >= 5) {
+			Coverage_skip(&r, 2);	// address_size, segment_selector_size
+		}
+		uint32 header_length = Coverage_u32(&r);
+		const uint8* program = r.pos + header_length;
+		uint32 min_inst = Coverage_u8(&r);
+		if (version >= 4) {
+			Coverage_u8(&r);	// maximum_operations_per_instruction, always 1 here
+		}
+		uint32 default_is_stmt = Coverage_u8(&r);
+		long line_base = (signed char)Coverage_u8(&r);
+		uint32 line_range = Coverage_u8(&r);
+		uint32 opcode_base = Coverage_u8(&r);
+		uint8 oplen[256] = { 0 };
+		for (uint32 i = 1; i < opcode_base; i++) {
+			oplen[i] = (uint8)Coverage_u8(&r);
+		}
+		if (line_range == 0) {
+			continue;
+		}
+
+		std::vector<std::string> dirs;
+		std::vector<std::string> files;
+		if (version < 5) {
+			// directory 0 is the compilation directory, not listed. file indices start at 1
+			dirs.push_back("");
+			files.push_back("");
+			while (!r.bad) {
+				const char* dir = Coverage_cstr(&r);
+				if (dir[0] == '\0') {
+					break;
+				}
+				dirs.push_back(dir);
+			}
+			while (!r.bad) {
+				const char* name = Coverage_cstr(&r);
+				if (name[0] == '\0') {
+					break;
+				}
+				uint32 dir = Coverage_uleb(&r);
+				Coverage_uleb(&r);	// mtime
+				Coverage_uleb(&r);	// length
+				files.push_back(Coverage_join(dirs, dir, name));
+			}
+		}
+		else {
+			std::vector<uint32> format;
+			uint32 count = Coverage_u8(&r);
+			for (uint32 i = 0; i < count * 2 && !r.bad; i++) {
+				format.push_back(Coverage_uleb(&r));
+			}
+			count = Coverage_uleb(&r);
+			for (uint32 i = 0; i < count && !r.bad; i++) {
+				std::string path;
+				uint32 dir;
+				Coverage_entry(&r, format, line_str, str, &path, &dir);
+				dirs.push_back(path);
+			}
+
+			format.clear();
+			count = Coverage_u8(&r);
+			for (uint32 i = 0; i < count * 2 && !r.bad; i++) {
+				format.push_back(Coverage_uleb(&r));
+			}
+			count = Coverage_uleb(&r);
+			for (uint32 i = 0; i < count && !r.bad; i++) {
+				std::string path;
+				uint32 dir;
+				Coverage_entry(&r, format, line_str, str, &path, &dir);
+				files.push_back(Coverage_join(dirs, dir, path));
+			}
+		}
+		if (r.bad || program > r.end) {
+			continue;
+		}
+		r.pos = program;
+
+		// line number program. every row covers [its address, the next row's address)
+		uint32 address = 0, file = 1, line = 1;
+		uint32 prev_valid = 0, prev_address = 0, prev_file = 0, prev_line = 0;
+		(void)default_is_stmt;
+
+		while (!r.bad && r.pos < r.end) {
+			uint32 opcode = Coverage_u8(&r);
+			uint32 emit = 0, end_sequence = 0;
+
+			if (opcode >= opcode_base) {
+				uint32 adjusted = opcode - opcode_base;
+				address += (adjusted / line_range) * min_inst;
+				line += line_base + (long)(adjusted % line_range);
+				emit = 1;
+			}
+			else if (opcode == 0) {
+				uint32 len = Coverage_uleb(&r);
+				const uint8* next = r.pos + len;
+				if (len == 0 || next > r.end) {
+					break;
+				}
+				switch (Coverage_u8(&r)) {
+				case 1:	// DW_LNE_end_sequence
+					emit = end_sequence = 1;
+					break;
+				case 2:	// DW_LNE_set_address
+					address = Coverage_u32(&r);
+					break;
+				default:	// define_file, set_discriminator, vendor
+					break;
+				}
+				r.pos = next;
+			}
+			else {
+				switch (opcode) {
+				case 1: emit = 1; break;	// DW_LNS_copy
+				case 2: address += Coverage_uleb(&r) * min_inst; break;	// advance_pc
+				case 3: line += Coverage_sleb(&r); break;	// advance_line
+				case 4: file = Coverage_uleb(&r); break;	// set_file
+				case 8: address += ((255 - opcode_base) / line_range) * min_inst; break;	// const_add_pc
+				case 9: address += Coverage_u16(&r); break;	// fixed_advance_pc
+				default:
+					// column, negate_stmt, basic_block, prologue / epilogue, isa and unknown ones: skip the operands
+					for (uint32 i = 0; i < oplen[opcode]; i++) {
+						Coverage_uleb(&r);
+					}
+					break;
+				}
+			}
+			address &= 0xFFFFFFFF;
+			line &= 0xFFFFFFFF;
+
+			if (!emit) {
+				continue;
+			}
+			if (prev_valid && prev_file < files.size()) {
+				Coverage_row(lines, rows, files[prev_file], prev_line, prev_address, address);
+			}
+			prev_valid = !end_sequence;
+			prev_address = address;
+			prev_file = file;
+			prev_line = line;
+			if (end_sequence) {
+				address = 0;
+				file = 1;
+				line = 1;
+			}
+		}
+	}
+}
+
+void Coverage_export() {
+	if (!Coverage_var_enabled) {
+		return;
+	}
+
+	// summary
+	for (uint32 i = 0; i < Memory_var_arrlen; i++) {
+		Memory_map_elem* thismap = &Memory_var_arr[i];
+		if (thismap->coverage == NULL) {
+			continue;
+		}
+		uint32 count = 0;
+		for (uint32 w = 0; w < COVERAGE_BITMAP_WORDS(thismap->size); w++) {
+			for (uint32 bits = thismap->coverage[w]; bits != 0; bits &= bits - 1) {
+				count += 1;
+			}
+		}
+		printf("coverage: 0x%08x ~ 0x%08x: %d halfwords executed (%d bytes)\n",
+			(int)thismap->base, (int)(thismap->base + thismap->size), (int)count, (int)(count * 2));
+	}
+
+	const char* out = getenv(COVERAGE_ENV);
+	if (out == NULL || out[0] == '\0') {
+		return;	// on for fuzzing only
+	}
+	const char* elfpath = getenv(COVERAGE_ELF_ENV);
+	if (elfpath == NULL || elfpath[0] == '\0') {
+		printf("coverage: %s not set, no line info for %s\n", COVERAGE_ELF_ENV, out);
+		return;
+	}
+
+	uint32 elfsize = 0;
+	uint8* elf = (uint8*)map_file(elfpath, &elfsize);
+	if (elf == NULL) {
+		eprintf("coverage: can't open %s\n", elfpath);
+		return;
+	}
+
+	Coverage_section debug_line = { NULL, 0, 0 };
+	Coverage_section line_str = { NULL, 0, 0 };
+	Coverage_section str = { NULL, 0, 0 };
+	Coverage_lines_t lines;
+	Coverage_rows_t rows;
+
+	if (!Coverage_elf_section(elf, elfsize, ".debug_line", 0, &debug_line)) {
+		eprintf("coverage: %s has no .debug_line\n", elfpath);
+		unmap_file(elf, elfsize);
+		return;
+	}
+	Coverage_elf_section(elf, elfsize, ".debug_line_str", 0, &line_str);
+	Coverage_elf_section(elf, elfsize, ".debug_str", 0, &str);
+	Coverage_debug_line(&debug_line, &line_str, &str, &lines, &rows);
+
+	FILE* fp = fopen(out, "w");
+	if (fp == NULL) {
+		eprintf("coverage: can't write %s\n", out);
+		unmap_file(elf, elfsize);
+		return;
+	}
+	fprintf(fp, "TN:\n");
+
+	// functions, grouped by the file of their first line
+	std::map<const std::string*, std::vector<Coverage_func> > funcs;
+	Coverage_funcs_arg funcs_arg = { &rows, &funcs };
+	Coverage_elf_symbols(elf, elfsize, Coverage_funcs_add, &funcs_arg);
+
+	uint32 total_lines = 0, total_hit = 0;
+	for (Coverage_lines_t::iterator file = lines.begin(); file != lines.end(); ++file) {
+		fprintf(fp, "SF:%s\n", file->first.c_str());
+
+		std::vector<Coverage_func>& fns = funcs[&file->first];
+		uint32 fnh = 0;
+		for (size_t i = 0; i < fns.size(); i++) {
+			fprintf(fp, "FN:%d,%s\n", (int)fns[i].line, fns[i].name.c_str());
+		}
+		for (size_t i = 0; i < fns.size(); i++) {
+			fnh += fns[i].hit;
+			fprintf(fp, "FNDA:%d,%s\n", (int)fns[i].hit, fns[i].name.c_str());
+		}
+		if (!fns.empty()) {
+			fprintf(fp, "FNF:%d\nFNH:%d\n", (int)fns.size(), (int)fnh);
+		}
+
+		uint32 hit = 0;
+		for (std::map<uint32, uint32>::iterator l = file->second.begin(); l != file->second.end(); ++l) {
+			fprintf(fp, "DA:%d,%d\n", (int)l->first, (int)l->second);
+			hit += l->second;
+		}
+		fprintf(fp, "LF:%d\nLH:%d\nend_of_record\n", (int)file->second.size(), (int)hit);
+		total_lines += file->second.size();
+		total_hit += hit;
+	}
+	fclose(fp);
+	unmap_file(elf, elfsize);
+
+	printf("coverage: %d of %d lines in %d files -> %s\n", (int)total_hit, (int)total_lines, (int)lines.size(), out);
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include "Proxy.hpp"
+#include "Memory.hpp"
+
+/*
+* guest code coverage
+*
+* every executable code / sram section gets a bitmap with one bit per halfword (Memory_map_elem->coverage).
+* a set bit means an instruction (or the second half of one) at that halfword was executed.
+*
+* marking is per block, never per instruction:
+* - interpreter: the range of the block is marked when it is run.
+* - jit: the first time a translated block is dispatched (block->covered), then never again.
+*   so the steady state cost is one compare per dispatch.
+* - a block that faults halfway still marks the whole block. blocks stop at branches, so this is rare.
+* - paths (fuzzing): a block runs on past conditional branches, so the translated range says nothing about the way
+*   an input took. with Coverage_var_paths a block marks what it ran instead, from its start up to the exit it left by
+*   (IR_var_retired). the jit walks that only for an exit the block was not left by before (block->exits).
+*
+* export (end of run):
+* - MICROCON_EMU_COVERAGE=<file>: turns coverage on and names the lcov tracefile that is written at exit.
+* - MICROCON_EMU_ELF=<file>: elf the image was built from. its .debug_line (dwarf 2 ~ 5) gives the
+*   address range of every source line, a line is hit if any halfword of its ranges is set.
+*   STT_FUNC symbols become FN / FNDA records (hit if the entry halfword is set).
+* - without an elf only a per-section summary is printed.
+* - the bitmap has no counts, hits are always 0 or 1.
+* - fuzzing (Fuzz.hpp) turns it on without a tracefile, only the summary is printed then.
+*/
+
+#define COVERAGE_ENV "MICROCON_EMU_COVERAGE"
+#define COVERAGE_ELF_ENV "MICROCON_EMU_ELF"
+
+extern uint32 Coverage_var_enabled;
+extern uint32 Coverage_var_new;	// halfwords set for the first time, fuzz feedback (Fuzz.hpp) clears it per run
+extern uint32 Coverage_var_paths;	// mark what blocks ran, not what was translated (fuzzing)
+
+// allocate bitmaps for executable sections if MICROCON_EMU_COVERAGE is set. after Memory_init
+extern void Coverage_init();
+
+// mark [start, end) as executed
+#define COVERAGE_MARK(start, end) if (Coverage_var_enabled && !Coverage_var_paths) Coverage_mark(start, end)
+extern void Coverage_mark(uint32 start, uint32 end);
+
+// paths: mark the first instrs guest instructions from start, after the block ran
+#define COVERAGE_PATH(start, instrs) if (Coverage_var_paths) Coverage_markPath(start, instrs)
+extern void Coverage_markPath(uint32 start, uint32 instrs);
+
+// halfword at addr was executed
+extern uint32 Coverage_test(uint32 addr);
+
+// executed halfwords in [start, end)
+extern uint32 Coverage_count(uint32 start, uint32 end);
+
+// write the lcov tracefile (and print the summary)
+extern void Coverage_export();
+
+// every named .symtab entry of a mapped elf32: fn(arg, name, st_value, st_info). 0 if there is no .symtab
+extern uint32 Coverage_elf_symbols(const uint8* elf, uint32 elfsize, void (*fn)(void* arg, const char* name, uint32 value, uint32 info), void* arg);
@@ -0,0 +1,132 @@
+#include "Dwt.hpp"
+#include "Memory.hpp"
+#include "IR.hpp"	// IR_var_elapsed
+
+struct Dwt_counter {
+	uint32 enable;	// DWT_CTRL bit
+	uint32 mask;	// width
+	uint32 enabled;
+	uint64_t held;	// value at origin
+	uint64_t origin;	// source at the last write / enable / disable
+};
+
+static Dwt_counter Dwt_var_counters[DWT_COUNTERS] = {
+	{ DWT_CTRL_CYCCNTENA, 0xFFFFFFFF, 0, 0, 0 },
+	{ DWT_CTRL_CPIEVTENA, 0xFF, 0, 0, 0 },
+	{ DWT_CTRL_EXCEVTENA, 0xFF, 0, 0, 0 },
+	{ DWT_CTRL_SLEEPEVTENA, 0xFF, 0, 0, 0 },
+	{ DWT_CTRL_LSUEVTENA, 0xFF, 0, 0, 0 },
+	{ DWT_CTRL_FOLDEVTENA, 0xFF, 0, 0, 0 },
+};
+
+static uint8* Dwt_reg(uint32 addr) {
+	Memory_map_elem* thismap = Memory_getMap(addr);
+	if (thismap == NULL || addr + 4 > thismap->base + thismap->size) {
+		return NULL;
+	}
+	return &thismap->data[addr - thismap->base];
+}
+
+static uint32 Dwt_load32(uint32 addr) {
+	uint8* data = Dwt_reg(addr);
+	return (data != NULL) ? (data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32)data[3] << 24)) : 0;
+}
+
+static void Dwt_store32(uint32 addr, uint32 value) {
+	uint8* data = Dwt_reg(addr);
+	if (data != NULL) {
+		data[0] = (uint8)(value & 0xFF);
+		data[1] = (uint8)((value >> 8) & 0xFF);
+		data[2] = (uint8)((value >> 16) & 0xFF);
+		data[3] = (uint8)((value >> 24) & 0xFF);
+	}
+}
+
+// where counter i is right now
+static uint64_t Dwt_source(uint32 i) {
+	switch (i) {
+	case 0:
+		return CPU_var_cycles + IR_var_elapsed;
+	case 1:
+		return CPU_var_cycles - CPU_var_instrs - CPU_var_exccycles - CPU_var_lsu;
+	case 2:
+		return CPU_var_exccycles;
+	case 4:
+		return CPU_var_lsu;
+	default:
+		return 0;	// sleep, fold
+	}
+}
+
+static uint32 Dwt_value(uint32 i) {
+	Dwt_counter* counter = &Dwt_var_counters[i];
+	uint64_t value = counter->held;
+	if (counter->enabled) {
+		value += Dwt_source(i) - counter->origin;
+	}
+	return (uint32)(value & counter->mask);
+}
+
+// DWT_CTRL or DEMCR changed: counters that start or stop keep what they have so far
+static void Dwt_sync() {
+	uint32 ctrl = Dwt_load32(DWT_CTRL);
+	uint32 trcena = Dwt_load32(DWT_DEMCR) & DWT_DEMCR_TRCENA;
+
+	for (uint32 i = 0; i < DWT_COUNTERS; i++) {
+		Dwt_counter* counter = &Dwt_var_counters[i];
+		uint32 enabled = (trcena && (ctrl & counter->enable)) ? 1 : 0;
+		if (enabled != counter->enabled) {
+			counter->held = Dwt_value(i);
+			counter->origin = Dwt_source(i);
+			counter->enabled = enabled;
+		}
+	}
+}
+
+void Dwt_init() {
+	for (uint32 i = 0; i < DWT_COUNTERS; i++) {
+		Dwt_var_counters[i].enabled = 0;
+		Dwt_var_counters[i].held = 0;
+		Dwt_var_counters[i].origin = 0;
+	}
+	for (uint32 addr = DWT_BASE; addr < DWT_BASE + DWT_SIZE; addr += 4) {
+		Dwt_store32(addr, 0);
+	}
+}
+
+void Dwt_read(uint32 addr, uint32 width) {
+	for (uint32 reg = addr & ~0x3; reg < addr + width; reg += 4) {
+		if (reg >= DWT_CYCCNT && reg <= DWT_FOLDCNT) {
+			Dwt_store32(reg, Dwt_value((reg - DWT_CYCCNT) >> 2));
+		}
+		else if (reg == DWT_PCSR) {
+			Dwt_store32(reg, (CPU_var_reg != NULL) ? CPU_var_reg->R[15] : 0xFFFFFFFF);
+		}
+	}
+}
+
+void Dwt_write(uint32 addr, uint32 width, uint32) {
+	uint32 sync = 0;
+	for (uint32 reg = addr & ~0x3; reg < addr + width; reg += 4) {
+		if (reg == DWT_CTRL) {
+			Dwt_store32(reg, Dwt_load32(reg) & (DWT_CTRL_CYCCNTENA | DWT_CTRL_EXCEVTENA | DWT_CTRL_CPIEVTENA
+				| DWT_CTRL_SLEEPEVTENA | DWT_CTRL_LSUEVTENA | DWT_CTRL_FOLDEVTENA));
+			sync = 1;
+		}
+		else if (reg == DWT_DEMCR) {
+			sync = 1;
+		}
+		else if (reg >= DWT_CYCCNT && reg <= DWT_FOLDCNT) {
+			// counts on from what was written
+			Dwt_counter* counter = &Dwt_var_counters[(reg - DWT_CYCCNT) >> 2];
+			counter->held = Dwt_load32(reg) & counter->mask;
+			counter->origin = Dwt_source((reg - DWT_CYCCNT) >> 2);
+		}
+		else if (reg == DWT_PCSR) {
+			Dwt_store32(reg, 0);	// read only
+		}
+	}
+	if (sync) {
+		Dwt_sync();
+	}
+}
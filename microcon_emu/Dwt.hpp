@@ -0,0 +1,60 @@
+#pragma once
+#include "Proxy.hpp"
+#include "CPU.hpp"
+
+/*
+* data watchpoint and trace unit: cycle counter and profiling counters
+*
+* registers (ppb):
+* - 0xE0001000 DWT_CTRL: CYCCNTENA(0), EXCEVTENA(16), CPIEVTENA(17), SLEEPEVTENA(19), LSUEVTENA(20), FOLDEVTENA(21).
+*   NUMCOMP reads 0: no comparators
+* - 0xE0001004 DWT_CYCCNT: 32 bit
+* - 0xE0001008 DWT_CPICNT, 0xE000100C DWT_EXCCNT, 0xE0001010 DWT_SLEEPCNT, 0xE0001014 DWT_LSUCNT,
+*   0xE0001018 DWT_FOLDCNT: 8 bit, wrap
+* - 0xE000101C DWT_PCSR: pc of the running block
+* - 0xE000EDFC DEMCR: TRCENA(24) has to be set too for anything to count
+*
+* nothing is counted per cycle. every counter is 'held' (its value when it was last written, enabled or disabled)
+* plus how far its source moved since then while enabled. a guest read works that out and stores it where the
+* load picks it up (Board_read). the sources are what CPU_step keeps anyway:
+* - CYCCNT: CPU_var_cycles, plus IR_var_elapsed: the cycles the reading block spent before the load.
+*   so two reads in one block are as far apart as the timing model says.
+* - EXCCNT: CPU_var_exccycles (exception entry and return).
+* - LSUCNT: CPU_var_lsu, the extra cycles of loads / stores (baked into the block exits like the instruction count).
+* - CPICNT: whatever else went past one cycle per instruction: CPU_var_cycles - instructions - exception - lsu.
+*   cycles of calls done on the host (Hle.hpp) and of skipped polling rounds (Poll.hpp) land here.
+* - SLEEPCNT, FOLDCNT: the timing model has no sleep (wfi / wfe are nops) and folds nothing, they stay put.
+* so CYCCNT = instructions + CPICNT + EXCCNT + SLEEPCNT + LSUCNT - FOLDCNT, as the architecture says.
+*/
+
+#define DWT_BASE 0xE0001000
+#define DWT_CTRL 0xE0001000
+#define DWT_CYCCNT 0xE0001004
+#define DWT_CPICNT 0xE0001008
+#define DWT_EXCCNT 0xE000100C
+#define DWT_SLEEPCNT 0xE0001010
+#define DWT_LSUCNT 0xE0001014
+#define DWT_FOLDCNT 0xE0001018
+#define DWT_PCSR 0xE000101C
+#define DWT_SIZE 0x20
+
+#define DWT_DEMCR 0xE000EDFC
+#define DWT_DEMCR_TRCENA 0x01000000
+
+#define DWT_CTRL_CYCCNTENA 0x00000001
+#define DWT_CTRL_EXCEVTENA 0x00010000
+#define DWT_CTRL_CPIEVTENA 0x00020000
+#define DWT_CTRL_SLEEPEVTENA 0x00080000
+#define DWT_CTRL_LSUEVTENA 0x00100000
+#define DWT_CTRL_FOLDEVTENA 0x00200000
+
+#define DWT_COUNTERS 6	// CYCCNT ... FOLDCNT, in register order
+
+// after Memory_init
+extern void Dwt_init();
+
+// Memory_read, before a load from DWT_BASE .. DWT_BASE + DWT_SIZE: put the current counts in place
+extern void Dwt_read(uint32 addr, uint32 width);
+
+// Memory_write, the store is in place: DWT_CTRL, a counter or DEMCR
+extern void Dwt_write(uint32 addr, uint32 width, uint32 data);
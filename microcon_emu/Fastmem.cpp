@@ -0,0 +1,124 @@
+#include "Fastmem.hpp"
+#include <stdlib.h>	// getenv
+#include <string.h>
+
+uint8* Fastmem_var_base = NULL;
+uint32 Fastmem_var_faults = 0;
+
+#if FASTMEM_HOST
+#include <signal.h>
+#include <ucontext.h>
+
+/*
+* probes: leaf functions without a frame. the handler moves rip from the faulting access
+* to Fastmem_probe_fault, which returns FASTMEM_FAULT to the caller of the probe.
+*/
+__asm__(
+	".text\n"
+	".p2align 4\n"
+	".globl Fastmem_load8\n"
+	".globl Fastmem_load16\n"
+	".globl Fastmem_load32\n"
+	".globl Fastmem_store8\n"
+	".globl Fastmem_store16\n"
+	".globl Fastmem_store32\n"
+	"Fastmem_probe_start:\n"
+	"Fastmem_load8:\n"
+	"	movzbl (%rdi), %eax\n"
+	"	ret\n"
+	"Fastmem_load16:\n"
+	"	movzwl (%rdi), %eax\n"
+	"	ret\n"
+	"Fastmem_load32:\n"
+	"	movl (%rdi), %eax\n"
+	"	ret\n"
+	"Fastmem_store8:\n"
+	"	movb %sil, (%rdi)\n"
+	"	xorl %eax, %eax\n"
+	"	ret\n"
+	"Fastmem_store16:\n"
+	"	movw %si, (%rdi)\n"
+	"	xorl %eax, %eax\n"
+	"	ret\n"
+	"Fastmem_store32:\n"
+	"	movl %esi, (%rdi)\n"
+	"	xorl %eax, %eax\n"
+	"	ret\n"
+	"Fastmem_probe_end:\n"
+	"Fastmem_probe_fault:\n"
+	"	movabsq $0x100000000, %rax\n"
+	"	ret\n"
+	".globl Fastmem_probe_start\n"
+	".globl Fastmem_probe_end\n"
+	".globl Fastmem_probe_fault\n"
+);
+
+extern "C" uint8 Fastmem_probe_start[];
+extern "C" uint8 Fastmem_probe_end[];
+extern "C" uint8 Fastmem_probe_fault[];
+
+static struct sigaction Fastmem_var_oldsegv;
+
+static void Fastmem_handler(int, siginfo_t* info, void* context) {
+	ucontext_t* uc = (ucontext_t*)context;
+	uint8* rip = (uint8*)uc->uc_mcontext.gregs[REG_RIP];
+	uint8* fault = (uint8*)info->si_addr;
+
+	if (rip >= Fastmem_probe_start && rip < Fastmem_probe_end
+		&& fault >= Fastmem_var_base && fault < Fastmem_var_base + FASTMEM_SIZE) {
+		uc->uc_mcontext.gregs[REG_RIP] = (greg_t)Fastmem_probe_fault;
+		Fastmem_var_faults += 1;
+		return;
+	}
+
+	// not ours: put the previous handler back, the access faults again into it
+	sigaction(SIGSEGV, &Fastmem_var_oldsegv, NULL);
+}
+#endif
+
+void Fastmem_init() {
+#if FASTMEM_HOST
+	const char* env = getenv(FASTMEM_ENV);
+	if (env != NULL && strcmp(env, "0") == 0) {
+		return;
+	}
+
+	if (Fastmem_var_base == NULL) {
+		void* base = mmap(NULL, FASTMEM_SIZE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		if (base == MAP_FAILED) {
+			eprintf("fastmem: can't reserve 4GB, staying on the slow path\n");
+			return;
+		}
+		Fastmem_var_base = (uint8*)base;
+
+		struct sigaction action;
+		memset(&action, 0, sizeof(action));
+		action.sa_sigaction = Fastmem_handler;
+		action.sa_flags = SA_SIGINFO | SA_NODEFER;
+		sigemptyset(&action.sa_mask);
+		sigaction(SIGSEGV, &action, &Fastmem_var_oldsegv);
+	}
+
+	uint32 pagesize = (uint32)sysconf(_SC_PAGESIZE);
+	for (uint32 i = 0; i < Memory_var_arrlen; i++) {
+		Memory_map_elem* thismap = &Memory_var_arr[i];
+		uint8* host = Fastmem_var_base + thismap->base;
+		if (!MEMORY_IS_DIRECT(thismap) || thismap->data == host
+			|| (thismap->attrib & (MEMORY_ATTRIB_S_R | MEMORY_ATTRIB_S_W)) != (MEMORY_ATTRIB_S_R | MEMORY_ATTRIB_S_W)) {
+			continue;
+		}
+		if ((thismap->base & (pagesize - 1)) != 0 || (thismap->size & (pagesize - 1)) != 0) {
+			eprintf("fastmem: 0x%08x ~ 0x%08x not page aligned, slow path\n", (int)thismap->base, (int)(thismap->base + thismap->size));
+			continue;
+		}
+
+		// contents move into the reservation, pointers to the section data follow
+		if (mprotect(host, thismap->size, PROT_READ | PROT_WRITE) != 0) {
+			continue;
+		}
+		memcpy(host, thismap->data, thismap->size);
+		efree(thismap->data);
+		thismap->data = host;
+	}
+#endif
+}
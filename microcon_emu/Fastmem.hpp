@@ -0,0 +1,72 @@
+#pragma once
+#include "Proxy.hpp"
+#include "Memory.hpp"
+
+/*
+* fast memory: the whole 4GB guest address space as one host reservation
+*
+* - Fastmem_var_base + guest address is the byte, for every guest address. the reservation is PROT_NONE.
+* - plain memory sections (code, sram: MEMORY_IS_DIRECT) that are supervisor readable and writable are moved
+*   into it at their guest address, read / write. Memory_map_elem->data points there afterwards,
+*   so Memory_read / Memory_write and everything holding section pointers stay coherent.
+*   sections with narrower attributes stay where they are (PROT_NONE here), so their rules are still checked.
+* - peripherals, the ppb and unmapped space stay PROT_NONE.
+*
+* the interpreter loads and stores through small probes (one add, one load or store, no Memory_getMap).
+* an access that lands on a PROT_NONE page raises SIGSEGV. the handler sees the fault came from
+* a probe, makes the probe return FASTMEM_FAULT and the access is redone through Memory_read / Memory_write,
+* which reports the section / attribute error or runs the peripheral hooks.
+* any other SIGSEGV is handed back to the previous handler.
+*
+* limits:
+* - needs a 64bit host (linux x86_64 for now). the jit targets 32bit x86 where 4GB can't be reserved,
+*   it keeps its own inline fast path (Jit_emitLoad / Jit_emitStore).
+* - sections must be page aligned in base and size, others stay on the slow path.
+* - off while the mpu is enabled: permissions are per region, not per section.
+* - stores skip the smc pagemap test. nothing is translated on the hosts that have fastmem.
+* - MICROCON_EMU_FASTMEM=0 turns it off.
+*/
+
+#if defined(__x86_64__) && defined(__linux__)
+#define FASTMEM_HOST 1
+#else
+#define FASTMEM_HOST 0
+#endif
+
+#define FASTMEM_ENV "MICROCON_EMU_FASTMEM"
+#define FASTMEM_SIZE 0x100000000ULL
+#define FASTMEM_FAULT 0x100000000ULL	// probe result: the access faulted
+
+extern uint8* Fastmem_var_base;	// NULL if off
+extern uint32 Fastmem_var_faults;	// telemetry: probes redirected to the slow path
+
+// after Memory_init, before anything else takes section data pointers
+extern void Fastmem_init();
+
+#if FASTMEM_HOST
+// probes (Fastmem.cpp, asm): value zero extended, or FASTMEM_FAULT
+extern "C" uint64_t Fastmem_load8(const uint8* host);
+extern "C" uint64_t Fastmem_load16(const uint8* host);
+extern "C" uint64_t Fastmem_load32(const uint8* host);
+extern "C" uint64_t Fastmem_store8(uint8* host, uint32_t value);
+extern "C" uint64_t Fastmem_store16(uint8* host, uint32_t value);
+extern "C" uint64_t Fastmem_store32(uint8* host, uint32_t value);
+
+static inline uint64_t Fastmem_load(uint32 addr, uint32 sizetype) {
+	const uint8* host = Fastmem_var_base + (addr & 0xFFFFFFFF);
+	switch (sizetype) {
+	case Memory_enum_size::u8: return Fastmem_load8(host);
+	case Memory_enum_size::u16: return Fastmem_load16(host);
+	default: return Fastmem_load32(host);
+	}
+}
+
+static inline uint64_t Fastmem_store(uint32 addr, uint32 data, uint32 sizetype) {
+	uint8* host = Fastmem_var_base + (addr & 0xFFFFFFFF);
+	switch (sizetype) {
+	case Memory_enum_size::u8: return Fastmem_store8(host, (uint32_t)data);
+	case Memory_enum_size::u16: return Fastmem_store16(host, (uint32_t)data);
+	default: return Fastmem_store32(host, (uint32_t)data);
+	}
+}
+#endif
@@ -0,0 +1,122 @@
+#include "Fault.hpp"
+#include "Clock.hpp"
+#include "Fuzz.hpp"
+#include "IrqStat.hpp"
+
+jmp_buf* Fault_var_jmp = NULL;
+
+uint32 Fault_var_taken = 0;
+uint32 Fault_var_escalated = 0;
+
+// raised, not taken yet
+static uint32 Fault_var_exception = 0;
+static uint32 Fault_var_status = 0;
+static uint32 Fault_var_addr = 0;
+
+static uint32 Fault_read(uint32 addr, Memory_enum_size sizetype) {
+	uint8* data = (uint8*)Memory_read(addr, sizetype, MEMORY_ATTRIB_S_R);
+	if (data == NULL) {
+		return 0;
+	}
+	return (sizetype == Memory_enum_size::u8) ? data[0] : data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32)data[3] << 24);
+}
+
+static void Fault_write(uint32 addr, uint32 value) {
+	Memory_write(addr, Memory_enum_size::u32, value, MEMORY_ATTRIB_S_W);
+}
+
+// lower is more urgent. reset, nmi and hardfault are fixed, the rest comes from SHPR / NVIC_IPR
+int32_t Fault_priority(uint32 exception) {
+	if (exception <= FAULT_HARD) {
+		return (int32_t)exception - 4;
+	}
+	if (exception < 16) {
+		return (int32_t)Fault_read(FAULT_SHPR + exception - 4, Memory_enum_size::u8);
+	}
+	return (int32_t)Fault_read(FAULT_NVIC_IPR + exception - 16, Memory_enum_size::u8);
+}
+
+// execution priority: the running handler, boosted by the mask registers
+int32_t Fault_execPriority(CPU_struct_reg* reg) {
+	int32_t prio = (reg->xPSR.IPSR.exception != 0) ? Fault_priority(reg->xPSR.IPSR.exception) : 256;
+	if (reg->BASEPRI != 0 && (int32_t)(reg->BASEPRI & 0xFF) < prio) {
+		prio = reg->BASEPRI & 0xFF;
+	}
+	if (reg->PRIMASK && prio > 0) {
+		prio = 0;
+	}
+	if (reg->FAULTMASK) {
+		prio = -1;
+	}
+	return prio;
+}
+
+void Fault_raise(uint32 exception, uint32 status, uint32 addr) {
+	jmp_buf* jmp = Fault_var_jmp;
+
+	// nothing to take it: say so and stop, the caller sees the halt
+	if (jmp == NULL) {
+		printf("fault: exception %d (cfsr %08x, addr %08x) outside CPU_slice, halting\n", (int)exception, (unsigned)status, (unsigned)addr);
+		Clock_var_halt = 1;
+		return;
+	}
+
+	Fault_var_exception = exception;
+	Fault_var_status = status;
+	Fault_var_addr = addr;
+	Fault_var_jmp = NULL;	// CPU_slice arms it again
+	longjmp(*jmp, 1);
+}
+
+void Fault_access(uint32 addr, uint32 attrib) {
+	uint32 fetch = (attrib & (MEMORY_ATTRIB_S_X | MEMORY_ATTRIB_U_X)) != 0;
+
+	// mpu region: memmanage. no section / not allowed by the section: busfault
+	if (Memory_var_access_err == Memory_access_status_enum::mpu_err) {
+		Fault_raise(FAULT_MEMMANAGE, fetch ? FAULT_IACCVIOL : (FAULT_DACCVIOL | FAULT_MMARVALID), addr);
+		return;
+	}
+	Fault_raise(FAULT_BUS, fetch ? FAULT_IBUSERR : (FAULT_PRECISERR | FAULT_BFARVALID), addr);
+}
+
+uint32 Fault_take(CPU_struct_reg* reg) {
+	uint32 exception = Fault_var_exception;
+	uint32 status = Fault_var_status;
+	int32_t current = Fault_execPriority(reg);
+
+	Fault_var_taken += 1;
+	FUZZ_FAULT(reg, exception);
+
+	if (status != 0) {
+		Fault_write(FAULT_CFSR, Fault_read(FAULT_CFSR, Memory_enum_size::u32) | status);
+	}
+	if (status & FAULT_MMARVALID) {
+		Fault_write(FAULT_MMFAR, Fault_var_addr);
+	}
+	if (status & FAULT_BFARVALID) {
+		Fault_write(FAULT_BFAR, Fault_var_addr);
+	}
+
+	if (exception != FAULT_HARD) {
+		// only the configurable faults have an enable bit, anything else raised here (SVCall) always escalates
+		uint32 enabled = exception <= FAULT_USAGE &&
+			(Fault_read(FAULT_SHCSR, Memory_enum_size::u32) & (FAULT_SHCSR_MEMFAULTENA << (exception - FAULT_MEMMANAGE))) != 0;
+		if (!enabled || Fault_priority(exception) >= current) {
+			exception = FAULT_HARD;
+			Fault_write(FAULT_HFSR, Fault_read(FAULT_HFSR, Memory_enum_size::u32) | FAULT_HFSR_FORCED);
+			Fault_var_escalated += 1;
+		}
+	}
+	if (exception == FAULT_HARD && Fault_priority(FAULT_HARD) >= current) {
+		printf("fault: lockup at pc %08x (exception %d, cfsr %08x)\n", (unsigned)reg->R[15], (int)reg->xPSR.IPSR.exception,
+			(unsigned)Fault_read(FAULT_CFSR, Memory_enum_size::u32));
+		Clock_var_halt = 1;
+		return 0;
+	}
+
+	// asserted now as far as the clock goes: the faulting block is not charged (CPU_slice)
+	IrqStat_assert(exception);
+
+	// the faulting instruction is the return address: the handler can fix things up and retry it
+	return CPU_exceptionEntry(reg, exception, reg->R[15]);
+}
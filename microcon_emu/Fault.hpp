@@ -0,0 +1,88 @@
+#pragma once
+#include "Proxy.hpp"
+#include "CPU.hpp"
+#include "Memory.hpp"
+
+/*
+* memory faults (busfault, memmanage, usagefault), delivered by a non-local exit
+*
+* a guest access that fails does not come back. the access path (Jit_slowRead / Jit_slowWrite, the block
+* transfer handlers, the first fetch of a block) calls Fault_access, which records the fault and longjmps out of
+* the block to CPU_slice. there it is taken as an exception, at the boundary of the faulting instruction:
+* - pc: the slow memory paths (IR_execute, jit slow calls) store the guest pc of the access in R[15] before
+*   calling out, handlers run with R[15] at their instruction anyway.
+* - registers and flags the instructions before it wrote are in place: loads / stores count as exits
+*   for the dead register / flag passes, and the jit writes host flags back before any memory access.
+* so blocks, the jit and the handlers have no error checks after an access. only the failing one pays.
+*
+* taking it (Fault_take):
+* - status in the scb (plain ppb memory): CFSR (MMFSR / BFSR / UFSR), MMFAR / BFAR. sticky, the guest writes ones to clear.
+* - priority: a fault disabled in SHCSR, or not above the execution priority (active exception from SHPR / NVIC_IPR,
+*   BASEPRI, PRIMASK, FAULTMASK), escalates to hardfault with HFSR.FORCED. one that hardfault can't preempt either
+*   (in the nmi / hardfault handler, FAULTMASK set) locks up: the clock halts.
+* - entry (CPU_exceptionEntry): frame on the current stack, handler mode on msp, pc from the vector table at VTOR.
+*
+* outside CPU_slice (loaders, analysis, batch lanes) nothing is armed, Memory_var_access_err is set as before
+* and the caller checks it. what can't be checked there (a block that can't be fetched, an undefined instruction)
+* raises anyway: unarmed, Fault_raise reports it and halts the clock.
+*
+* usagefault: UDF and encodings the decoder doesn't know (UNDEFINSTR), coprocessor space (NOCP), UDIV / SDIV
+* by zero with CCR.DIV_0_TRP (DIVBYZERO). raised by the handler, so pc is the instruction's own.
+*/
+
+#define FAULT_NMI 2
+#define FAULT_HARD 3
+#define FAULT_MEMMANAGE 4
+#define FAULT_BUS 5
+#define FAULT_USAGE 6
+
+// scb
+#define FAULT_VTOR 0xE000ED08
+#define FAULT_CCR 0xE000ED14
+#define FAULT_SHPR 0xE000ED18	// one byte per exception 4 ~ 15
+#define FAULT_SHCSR 0xE000ED24
+#define FAULT_CFSR 0xE000ED28
+#define FAULT_HFSR 0xE000ED2C
+#define FAULT_MMFAR 0xE000ED34
+#define FAULT_BFAR 0xE000ED38
+#define FAULT_NVIC_IPR 0xE000E400	// one byte per external interrupt
+
+#define FAULT_SHCSR_MEMFAULTENA 0x10000	// BUSFAULTENA, USGFAULTENA follow
+
+// CFSR
+#define FAULT_IACCVIOL 0x1
+#define FAULT_DACCVIOL 0x2
+#define FAULT_MMARVALID 0x80
+#define FAULT_IBUSERR 0x100
+#define FAULT_PRECISERR 0x200
+#define FAULT_BFARVALID 0x8000
+#define FAULT_UNDEFINSTR 0x10000
+#define FAULT_NOCP 0x80000
+#define FAULT_UNALIGNED 0x1000000
+#define FAULT_DIVBYZERO 0x2000000
+
+#define FAULT_HFSR_FORCED 0x40000000
+
+#define FAULT_CCR_DIV_0_TRP 0x10
+
+extern jmp_buf* Fault_var_jmp;	// armed by CPU_slice, NULL otherwise
+
+// telemetry
+extern uint32 Fault_var_taken;
+extern uint32 Fault_var_escalated;
+
+// a guest access to addr failed (Memory_var_access_err says why). does not return while armed
+#define FAULT_ACCESS(addr, attrib) if (Fault_var_jmp != NULL) Fault_access((addr), (attrib))
+extern void Fault_access(uint32 addr, uint32 attrib);
+
+// any fault: status is the CFSR bits, addr goes to MMFAR / BFAR if status has the valid bit.
+// does not return while armed, otherwise halts the clock and returns
+extern void Fault_raise(uint32 exception, uint32 status, uint32 addr);
+
+// CPU_slice, after the longjmp: status, escalation and exception entry. returns the guest cycles it took
+extern uint32 Fault_take(CPU_struct_reg* reg);
+
+// priority of an exception, lower is more urgent (reset, nmi, hardfault fixed at -3 ~ -1)
+extern int32_t Fault_priority(uint32 exception);
+// execution priority: the running handler, boosted by BASEPRI / PRIMASK / FAULTMASK. 256 in thread mode
+extern int32_t Fault_execPriority(CPU_struct_reg* reg);
@@ -0,0 +1,600 @@
+#include "Fuzz.hpp"
+#include "Clock.hpp"
+#include "Semihost.hpp"
+#include "Coverage.hpp"
+#include "JitCache.hpp"
+#include "Fastmem.hpp"
+#include "Nvic.hpp"
+#include <stdlib.h>	// getenv, malloc
+#include <string.h>
+#include <vector>
+
+typedef std::vector<uint8> Fuzz_input;
+
+uint32 Fuzz_var_enabled = 0;
+uint32 Fuzz_var_running = 0;
+uint32 Fuzz_var_return = 1;
+
+uint64_t Fuzz_var_runs = 0;
+uint32 Fuzz_var_crashes = 0;
+uint32 Fuzz_var_hangs = 0;
+uint64_t Fuzz_var_dirtypages = 0;
+
+#define FUZZ_PAGE (0x1 << MEMORY_CODEPAGE_SHIFT)
+#define FUZZ_DIRTY_ENTRY(section, page) (((section) << 24) | (page))
+
+static const char* Fuzz_var_dir = NULL;
+static uint32 Fuzz_var_entry = 0;
+static uint32 Fuzz_var_hasentry = 0;
+static uint32 Fuzz_var_buffer = 0;	// guest input buffer, 0: fifo
+static uint32 Fuzz_var_maxinput = FUZZ_MAX_INPUT;
+static uint64_t Fuzz_var_cycles = FUZZ_CYCLES;
+static uint64_t Fuzz_var_maxruns = 0;
+
+// snapshot
+static CPU_struct_reg Fuzz_var_reg;
+static Nvic_state Fuzz_var_nvic;	// pend / enable state is not in memory
+static uint8* Fuzz_var_snap[MEMORY_MAP_MAX_SECTIONS];	// section data at the snapshot (host heap)
+static uint32 Fuzz_var_hostpages[MEMORY_MAP_MAX_SECTIONS];	// fuzz pages per host page, 0 if not in fastmem
+static uint32* Fuzz_var_dirty = NULL;	// FUZZ_DIRTY_ENTRY of every page written since the last reset
+static uint32 Fuzz_var_ndirty = 0;
+
+// this run
+static uint32 Fuzz_var_result = FUZZ_RESULT_NONE;
+static uint32 Fuzz_var_faultpc = 0;
+static uint32 Fuzz_var_exception = 0;
+static const uint8* Fuzz_var_fifo = NULL;
+static uint32 Fuzz_var_fifolen = 0;
+static uint32 Fuzz_var_fifopos = 0;
+
+// corpus
+static std::vector<Fuzz_input> Fuzz_var_queue;
+static std::vector<uint32> Fuzz_var_crashsites;	// exception << 24 ^ pc, saved once each
+static uint32 Fuzz_var_rng = 1;
+static uint32 Fuzz_var_saved_queue = 0;
+static uint32 Fuzz_var_saved_crash = 0;
+static uint32 Fuzz_var_saved_hang = 0;
+
+static uint32 Fuzz_env(const char* name, uint32 def) {
+	const char* env = getenv(name);
+	return (env != NULL && env[0] != '\0') ? (uint32)strtoul(env, NULL, 0) : def;
+}
+
+void Fuzz_init() {
+	const char* dir = getenv(FUZZ_ENV);
+	Fuzz_var_enabled = (dir != NULL && dir[0] != '\0');
+	Fuzz_var_running = 0;
+	Fuzz_var_return = 1;
+	Fuzz_var_runs = 0;
+	Fuzz_var_crashes = 0;
+	Fuzz_var_hangs = 0;
+	Fuzz_var_dirtypages = 0;
+	Fuzz_var_ndirty = 0;
+
+	for (uint32 i = 0; i < Memory_var_arrlen; i++) {
+		Memory_map_elem* thismap = &Memory_var_arr[i];
+		if (thismap->fuzz_clean != NULL) {
+			efree(thismap->fuzz_clean);
+			thismap->fuzz_clean = NULL;
+		}
+		if (Fuzz_var_snap[i] != NULL) {
+			free(Fuzz_var_snap[i]);
+			Fuzz_var_snap[i] = NULL;
+		}
+	}
+	if (Fuzz_var_dirty != NULL) {
+		free(Fuzz_var_dirty);
+		Fuzz_var_dirty = NULL;
+	}
+	if (!Fuzz_var_enabled) {
+		return;
+	}
+
+	Fuzz_var_dir = dir;
+	const char* entry = getenv(FUZZ_ENTRY_ENV);
+	Fuzz_var_hasentry = (entry != NULL && entry[0] != '\0');
+	Fuzz_var_entry = Fuzz_var_hasentry ? (uint32)strtoul(entry, NULL, 16) & ~0x1 : 0;
+
+	const char* input = getenv(FUZZ_INPUT_ENV);
+	Fuzz_var_buffer = 0;
+	Fuzz_var_maxinput = FUZZ_MAX_INPUT;
+	if (input != NULL && input[0] != '\0') {
+		char* end = NULL;
+		Fuzz_var_buffer = (uint32)strtoul(input, &end, 16);
+		if (end != NULL && *end == ',') {
+			Fuzz_var_maxinput = (uint32)strtoul(end + 1, NULL, 0);
+		}
+	}
+	Fuzz_var_cycles = Fuzz_env(FUZZ_CYCLES_ENV, FUZZ_CYCLES);
+	Fuzz_var_maxruns = Fuzz_env(FUZZ_RUNS_ENV, 0);
+
+	// the pointers are baked into translated stores, they must not move from here on
+	uint32 pages = 0;
+	for (uint32 i = 0; i < Memory_var_arrlen; i++) {
+		Memory_map_elem* thismap = &Memory_var_arr[i];
+		thismap->fuzz_clean = (uint32*)ecalloc((thismap->size >> (MEMORY_CODEPAGE_SHIFT + 5)) + 2, sizeof(uint32));
+		pages += (thismap->size + FUZZ_PAGE - 1) >> MEMORY_CODEPAGE_SHIFT;
+
+		Fuzz_var_hostpages[i] = 0;
+#if FASTMEM_HOST
+		if (Fastmem_var_base != NULL && thismap->data == Fastmem_var_base + thismap->base) {
+			Fuzz_var_hostpages[i] = (uint32)sysconf(_SC_PAGESIZE) >> MEMORY_CODEPAGE_SHIFT;
+		}
+#endif
+	}
+	Fuzz_var_dirty = (uint32*)malloc(pages * sizeof(uint32));
+}
+
+/*
+* dirty pages
+*/
+
+void Fuzz_dirty(Memory_map_elem* thismap, uint32 offset, uint32 size) {
+	if (size == 0) {
+		return;
+	}
+	uint32 section = (uint32)(thismap - Memory_var_arr);
+	uint32 first = offset >> MEMORY_CODEPAGE_SHIFT;
+	uint32 last = (offset + size - 1) >> MEMORY_CODEPAGE_SHIFT;
+	uint32 hostpages = Fuzz_var_hostpages[section];
+	if (hostpages > 1) {
+		// fastmem protects whole host pages, they are let go whole
+		first &= ~(hostpages - 1);
+		last |= hostpages - 1;
+	}
+
+	uint32 marked = 0;
+	for (uint32 page = first; page <= last && (page << MEMORY_CODEPAGE_SHIFT) < thismap->size; page++) {
+		if (MEMORY_CODEPAGE_TEST(thismap->fuzz_clean, page << MEMORY_CODEPAGE_SHIFT)) {
+			MEMORY_CODEPAGE_CLEAR(thismap->fuzz_clean, page << MEMORY_CODEPAGE_SHIFT);
+			Fuzz_var_dirty[Fuzz_var_ndirty++] = FUZZ_DIRTY_ENTRY(section, page);
+			marked = 1;
+		}
+	}
+#if FASTMEM_HOST
+	if (marked && hostpages != 0) {
+		mprotect(thismap->data + (first << MEMORY_CODEPAGE_SHIFT), (last - first + 1) << MEMORY_CODEPAGE_SHIFT, PROT_READ | PROT_WRITE);
+	}
+#endif
+}
+
+// every page clean from here on
+static void Fuzz_protect() {
+	for (uint32 i = 0; i < Memory_var_arrlen; i++) {
+		Memory_map_elem* thismap = &Memory_var_arr[i];
+		for (uint32 offset = 0; offset < thismap->size; offset += FUZZ_PAGE) {
+			MEMORY_CODEPAGE_SET(thismap->fuzz_clean, offset);
+		}
+#if FASTMEM_HOST
+		if (Fuzz_var_hostpages[i] != 0) {
+			mprotect(thismap->data, thismap->size, PROT_READ);
+		}
+#endif
+	}
+	Fuzz_var_ndirty = 0;
+}
+
+static void Fuzz_snapshot() {
+	Fuzz_var_reg = *CPU_var_reg;
+	Fuzz_var_nvic = Nvic_var_state;
+	for (uint32 i = 0; i < Memory_var_arrlen; i++) {
+		Memory_map_elem* thismap = &Memory_var_arr[i];
+		Fuzz_var_snap[i] = (uint8*)malloc(thismap->size);
+		memcpy(Fuzz_var_snap[i], thismap->data, thismap->size);
+	}
+	Fuzz_protect();
+}
+
+// back to the snapshot: the pages the run wrote and the registers
+static void Fuzz_reset() {
+	for (uint32 d = 0; d < Fuzz_var_ndirty; d++) {
+		uint32 section = Fuzz_var_dirty[d] >> 24;
+		uint32 offset = (Fuzz_var_dirty[d] & 0xFFFFFF) << MEMORY_CODEPAGE_SHIFT;
+		Memory_map_elem* thismap = &Memory_var_arr[section];
+		uint32 len = (thismap->size - offset < FUZZ_PAGE) ? thismap->size - offset : FUZZ_PAGE;
+
+		if (memcmp(thismap->data + offset, Fuzz_var_snap[section] + offset, len) != 0) {
+			// code the run changed: blocks translated from what it wrote go
+			if (thismap->jit_pagemap != NULL && MEMORY_CODEPAGE_TEST(thismap->jit_pagemap, offset)) {
+				JitCache_invalidate(thismap->base + offset, len);
+			}
+			memcpy(thismap->data + offset, Fuzz_var_snap[section] + offset, len);
+		}
+		MEMORY_CODEPAGE_SET(thismap->fuzz_clean, offset);
+#if FASTMEM_HOST
+		// the fuzz pages of a host page went on the list together, in order: protect after the last one
+		uint32 hostpages = Fuzz_var_hostpages[section];
+		if (hostpages != 0 && ((offset >> MEMORY_CODEPAGE_SHIFT) & (hostpages - 1)) == hostpages - 1) {
+			uint32 hostoffset = offset & ~((hostpages << MEMORY_CODEPAGE_SHIFT) - 1);
+			mprotect(thismap->data + hostoffset, hostpages << MEMORY_CODEPAGE_SHIFT, PROT_READ);
+		}
+#endif
+	}
+	Fuzz_var_dirtypages += Fuzz_var_ndirty;
+	Fuzz_var_ndirty = 0;
+
+	*CPU_var_reg = Fuzz_var_reg;
+	Nvic_var_state = Fuzz_var_nvic;
+	Clock_var_halt = 0;
+	Semihost_var_exited = 0;
+	Semihost_var_exitcode = 0;
+}
+
+/*
+* one run
+*/
+
+void Fuzz_exit() {
+	if (Fuzz_var_result == FUZZ_RESULT_NONE) {
+		Fuzz_var_result = FUZZ_RESULT_EXIT;
+	}
+	Clock_halt();
+}
+
+void Fuzz_fault(CPU_struct_reg* reg, uint32 exception) {
+	if (Fuzz_var_result == FUZZ_RESULT_NONE) {
+		Fuzz_var_result = FUZZ_RESULT_CRASH;
+		Fuzz_var_faultpc = reg->R[15];
+		Fuzz_var_exception = exception;
+	}
+	Clock_halt();
+}
+
+static void Fuzz_store32(uint32 addr, uint32 value) {
+	Memory_map_elem* thismap = Memory_getMap(addr);
+	if (thismap == NULL || addr + 4 > thismap->base + thismap->size) {
+		return;
+	}
+	uint8* data = &thismap->data[addr - thismap->base];
+	data[0] = (uint8)(value & 0xFF);
+	data[1] = (uint8)((value >> 8) & 0xFF);
+	data[2] = (uint8)((value >> 16) & 0xFF);
+	data[3] = (uint8)((value >> 24) & 0xFF);
+}
+
+void Fuzz_read(uint32 addr, uint32 width) {
+	for (uint32 reg = addr & ~0x3; reg < addr + width; reg += 4) {
+		if (reg == FUZZ_FIFO_DATA) {
+			if (Fuzz_var_fifopos < Fuzz_var_fifolen) {
+				Fuzz_store32(reg, Fuzz_var_fifo[Fuzz_var_fifopos++]);
+				continue;
+			}
+			// used up: the rest of the run can't depend on the input
+			Fuzz_store32(reg, 0);
+			if (Fuzz_var_running) {
+				Fuzz_exit();
+			}
+		}
+		else if (reg == FUZZ_FIFO_COUNT) {
+			Fuzz_store32(reg, Fuzz_var_fifolen - Fuzz_var_fifopos);
+		}
+	}
+}
+
+// input into the guest buffer, r0 / r1 like LLVMFuzzerTestOneInput
+static void Fuzz_inject(const uint8* input, uint32 size) {
+	if (Fuzz_var_buffer == 0) {
+		Fuzz_var_fifo = input;
+		Fuzz_var_fifolen = size;
+		Fuzz_var_fifopos = 0;
+		return;
+	}
+
+	Memory_map_elem* thismap = Memory_getMap(Fuzz_var_buffer);
+	uint32 offset = Fuzz_var_buffer - thismap->base;
+	if (size > thismap->size - offset) {
+		size = thismap->size - offset;
+	}
+	FUZZ_DIRTY(thismap, offset, size);
+	if (thismap->jit_pagemap != NULL && size != 0) {
+		for (uint32 page = offset; page < offset + size; page = (page | (FUZZ_PAGE - 1)) + 1) {
+			if (MEMORY_CODEPAGE_TEST(thismap->jit_pagemap, page)) {
+				JitCache_invalidate(Fuzz_var_buffer, size);
+				break;
+			}
+		}
+	}
+	memcpy(thismap->data + offset, input, size);
+	CPU_var_reg->R[0] = Fuzz_var_buffer;
+	CPU_var_reg->R[1] = size;
+}
+
+// run input from the snapshot until exit, crash or hang. the machine is back at the snapshot afterwards
+static uint32 Fuzz_run(const uint8* input, uint32 size) {
+	Fuzz_inject(input, size);
+	Fuzz_var_result = FUZZ_RESULT_NONE;
+	Fuzz_var_running = 1;
+
+	uint64_t start = CPU_var_cycles;
+	while (!Clock_var_halt) {
+		if (CPU_var_cycles - start >= Fuzz_var_cycles) {
+			Fuzz_var_result = FUZZ_RESULT_HANG;
+			break;
+		}
+		CPU_slice(FUZZ_SLICE);
+	}
+	Fuzz_var_running = 0;
+
+	uint32 result = Fuzz_var_result;
+	if (Semihost_var_exited && result == FUZZ_RESULT_NONE) {
+		result = (Semihost_var_exitcode == 0) ? FUZZ_RESULT_EXIT : FUZZ_RESULT_CRASH;
+		Fuzz_var_faultpc = CPU_var_reg->R[15];
+		Fuzz_var_exception = 0;
+	}
+	if (result == FUZZ_RESULT_NONE) {
+		result = FUZZ_RESULT_EXIT;	// halted from outside
+	}
+
+	Fuzz_reset();
+	Fuzz_var_fifo = NULL;
+	Fuzz_var_fifolen = 0;
+	Fuzz_var_runs += 1;
+	return result;
+}
+
+/*
+* corpus
+*/
+
+static void Fuzz_save(const char* kind, uint32 n, const Fuzz_input* input) {
+	char path[1024];
+	snprintf(path, sizeof(path), "%s/%s-%06d", Fuzz_var_dir, kind, (int)n);
+	FILE* fp = fopen(path, "wb");
+	if (fp == NULL) {
+		eprintf("fuzz: can't write %s\n", path);
+		return;
+	}
+	if (!input->empty()) {
+		fwrite(input->data(), 1, input->size(), fp);
+	}
+	fclose(fp);
+}
+
+// queue-000000 ... from an earlier session, up to the first one missing
+static void Fuzz_load() {
+	char path[1024];
+	for (;;) {
+		snprintf(path, sizeof(path), "%s/queue-%06d", Fuzz_var_dir, (int)Fuzz_var_saved_queue);
+		FILE* fp = fopen(path, "rb");
+		if (fp == NULL) {
+			break;
+		}
+		Fuzz_input input;
+		uint8 buf[4096];
+		size_t got;
+		while ((got = fread(buf, 1, sizeof(buf), fp)) > 0 && input.size() < Fuzz_var_maxinput) {
+			input.insert(input.end(), buf, buf + got);
+		}
+		fclose(fp);
+		if (input.size() > Fuzz_var_maxinput) {
+			input.resize(Fuzz_var_maxinput);
+		}
+		Fuzz_var_queue.push_back(input);
+		Fuzz_var_saved_queue += 1;
+	}
+}
+
+// what the run found: queue entry, crash, hang
+static void Fuzz_triage(const Fuzz_input* input, uint32 result, uint32 newcode, uint32 fromqueue) {
+	switch (result) {
+	case FUZZ_RESULT_CRASH: {
+		Fuzz_var_crashes += 1;
+		uint32 site = (Fuzz_var_exception << 24) ^ Fuzz_var_faultpc;
+		for (uint32 i = 0; i < Fuzz_var_crashsites.size(); i++) {
+			if (Fuzz_var_crashsites[i] == site) {
+				return;
+			}
+		}
+		Fuzz_var_crashsites.push_back(site);
+		printf("fuzz: crash, exception %d at 0x%08x (crash-%06d)\n", (int)Fuzz_var_exception, (int)Fuzz_var_faultpc, (int)Fuzz_var_saved_crash);
+		Fuzz_save("crash", Fuzz_var_saved_crash++, input);
+		break;
+	}
+	case FUZZ_RESULT_HANG:
+		Fuzz_var_hangs += 1;
+		if (newcode || Fuzz_var_saved_hang == 0) {
+			Fuzz_save("hang", Fuzz_var_saved_hang++, input);
+		}
+		break;
+	default:
+		if (newcode && !fromqueue) {
+			Fuzz_var_queue.push_back(*input);
+			Fuzz_save("queue", Fuzz_var_saved_queue++, input);
+		}
+		break;
+	}
+}
+
+/*
+* mutations
+*/
+
+static uint32 Fuzz_rand(uint32 limit) {
+	// xorshift32
+	Fuzz_var_rng ^= Fuzz_var_rng << 13;
+	Fuzz_var_rng ^= Fuzz_var_rng >> 17;
+	Fuzz_var_rng ^= Fuzz_var_rng << 5;
+	return (limit != 0) ? (uint32)((uint32_t)Fuzz_var_rng % limit) : 0;
+}
+
+static const int32_t Fuzz_var_interesting[] = {
+	-128, -1, 0, 1, 16, 32, 64, 100, 127,	// 8 bit
+	-32768, -129, 128, 255, 256, 512, 1000, 1024, 4096, 32767,	// 16 bit
+	(int32_t)0x80000000, -100663046, -32769, 32768, 65535, 65536, 100663045, 0x7FFFFFFF	// 32 bit
+};
+#define FUZZ_INTERESTING (sizeof(Fuzz_var_interesting) / sizeof(Fuzz_var_interesting[0]))
+
+static void Fuzz_put(Fuzz_input* input, uint32 pos, uint32 value, uint32 width) {
+	for (uint32 i = 0; i < width && pos + i < input->size(); i++) {
+		(*input)[pos + i] = (uint8)(value >> (i * 8));
+	}
+}
+
+// a few stacked random edits of a queue entry
+static void Fuzz_mutate(Fuzz_input* input) {
+	*input = Fuzz_var_queue[Fuzz_rand((uint32)Fuzz_var_queue.size())];
+	uint32 edits = 1 << (1 + Fuzz_rand(4));
+
+	for (uint32 e = 0; e < edits; e++) {
+		uint32 size = (uint32)input->size();
+		uint32 pos = Fuzz_rand(size);
+		switch (Fuzz_rand(size == 0 ? 1 : 9)) {
+		case 0: {
+			// insert: random bytes or a copy of a piece
+			if (size >= Fuzz_var_maxinput) {
+				break;
+			}
+			uint32 len = 1 + Fuzz_rand((Fuzz_var_maxinput - size < 32) ? Fuzz_var_maxinput - size : 32);
+			uint32 at = Fuzz_rand(size + 1);
+			Fuzz_input piece(len);
+			uint32 from = Fuzz_rand(size);
+			for (uint32 i = 0; i < len; i++) {
+				piece[i] = (size != 0 && Fuzz_rand(2)) ? (*input)[(from + i) % size] : (uint8)Fuzz_rand(256);
+			}
+			input->insert(input->begin() + at, piece.begin(), piece.end());
+			break;
+		}
+		case 1:
+			(*input)[pos] ^= (uint8)(0x1 << Fuzz_rand(8));
+			break;
+		case 2:
+			(*input)[pos] = (uint8)Fuzz_rand(256);
+			break;
+		case 3: {
+			uint32 width = 1 << Fuzz_rand(3);
+			Fuzz_put(input, pos, (uint32)Fuzz_var_interesting[Fuzz_rand(FUZZ_INTERESTING)], width);
+			break;
+		}
+		case 4: {
+			// small add / sub on a byte, halfword or word
+			uint32 width = 1 << Fuzz_rand(3);
+			uint32 value = 0;
+			for (uint32 i = 0; i < width && pos + i < size; i++) {
+				value |= (uint32)(*input)[pos + i] << (i * 8);
+			}
+			uint32 delta = 1 + Fuzz_rand(35);
+			Fuzz_put(input, pos, Fuzz_rand(2) ? value + delta : value - delta, width);
+			break;
+		}
+		case 5: {
+			uint32 len = 1 + Fuzz_rand((size - pos < 32) ? size - pos : 32);
+			input->erase(input->begin() + pos, input->begin() + pos + len);
+			break;
+		}
+		case 6: {
+			// copy a piece over another place
+			uint32 from = Fuzz_rand(size);
+			uint32 len = 1 + Fuzz_rand(32);
+			for (uint32 i = 0; i < len && pos + i < size && from + i < size; i++) {
+				(*input)[pos + i] = (*input)[from + i];
+			}
+			break;
+		}
+		case 7: {
+			// splice: this entry up to pos, another one from there
+			const Fuzz_input* other = &Fuzz_var_queue[Fuzz_rand((uint32)Fuzz_var_queue.size())];
+			if (pos < other->size()) {
+				input->resize(pos);
+				input->insert(input->end(), other->begin() + pos, other->end());
+			}
+			break;
+		}
+		default:
+			(*input)[pos] = (uint8)(0xFF - (*input)[pos]);
+			break;
+		}
+	}
+	if (input->size() > Fuzz_var_maxinput) {
+		input->resize(Fuzz_var_maxinput);
+	}
+}
+
+/*
+* main loop
+*/
+
+// boot until a block starts at the entry
+static uint32 Fuzz_boot() {
+	if (!Fuzz_var_hasentry) {
+		return 1;
+	}
+	uint64_t start = CPU_var_cycles;
+	while (CPU_var_reg->R[15] != Fuzz_var_entry) {
+		if (Clock_var_halt || CPU_var_cycles - start >= FUZZ_BOOT_CYCLES) {
+			printf("fuzz: entry 0x%08x not reached\n", (int)Fuzz_var_entry);
+			return 0;
+		}
+		CPU_slice(1);	// one block
+	}
+	return 1;
+}
+
+static void Fuzz_report(uint32 msec) {
+	printf("fuzz: %llu runs, %d/s, queue %d, %d crashes (%d saved), %d hangs, %d.%d dirty pages per run\n",
+		(unsigned long long)Fuzz_var_runs, (int)((msec != 0) ? Fuzz_var_runs * 1000 / msec : 0), (int)Fuzz_var_queue.size(),
+		(int)Fuzz_var_crashes, (int)Fuzz_var_saved_crash, (int)Fuzz_var_hangs,
+		(int)((Fuzz_var_runs != 0) ? Fuzz_var_dirtypages / Fuzz_var_runs : 0),
+		(int)((Fuzz_var_runs != 0) ? Fuzz_var_dirtypages * 10 / Fuzz_var_runs % 10 : 0));
+}
+
+void Fuzz_main() {
+	if (!Fuzz_var_enabled) {
+		return;
+	}
+	if (CPU_var_reg == NULL) {
+		eprintf("fuzz: no cpu to run\n");
+		return;
+	}
+	if (Fuzz_var_buffer != 0) {
+		Memory_map_elem* thismap = Memory_getMap(Fuzz_var_buffer);
+		if (thismap == NULL || !MEMORY_IS_DIRECT(thismap)) {
+			eprintf("fuzz: input buffer 0x%08x is not in plain memory\n", (int)Fuzz_var_buffer);
+			return;
+		}
+	}
+	if (!Fuzz_boot()) {
+		return;
+	}
+
+	Fuzz_var_return = Fuzz_var_hasentry ? (CPU_var_reg->R[14] & ~0x1) : 1;
+	Fuzz_snapshot();
+	Fuzz_var_rng = Clock_gettime_msec() | 1;
+	Fuzz_var_queue.clear();
+	Fuzz_var_crashsites.clear();
+	Fuzz_var_saved_queue = 0;
+	Fuzz_var_saved_crash = 0;
+	Fuzz_var_saved_hang = 0;
+	Fuzz_load();
+	if (Fuzz_var_queue.empty()) {
+		Fuzz_var_queue.push_back(Fuzz_input());
+		Fuzz_save("queue", Fuzz_var_saved_queue++, &Fuzz_var_queue[0]);
+	}
+	printf("fuzz: snapshot at 0x%08x, %d queue entries, input %s 0x%08x\n", (int)Fuzz_var_reg.R[15], (int)Fuzz_var_queue.size(),
+		(Fuzz_var_buffer != 0) ? "buffer" : "fifo", (int)((Fuzz_var_buffer != 0) ? Fuzz_var_buffer : FUZZ_FIFO_DATA));
+
+	uint32 begin = Clock_gettime_msec();
+	uint32 last = begin;
+	Fuzz_input input;
+
+	// the queue as it is first, so its coverage is in before anything counts as new
+	for (uint32 i = 0; i < Fuzz_var_queue.size(); i++) {
+		input = Fuzz_var_queue[i];
+		Coverage_var_new = 0;
+		uint32 result = Fuzz_run(input.data(), (uint32)input.size());
+		Fuzz_triage(&input, result, Coverage_var_new, 1);
+	}
+
+	while (Fuzz_var_maxruns == 0 || Fuzz_var_runs < Fuzz_var_maxruns) {
+		Fuzz_mutate(&input);
+		Coverage_var_new = 0;
+		uint32 result = Fuzz_run(input.data(), (uint32)input.size());
+		Fuzz_triage(&input, result, Coverage_var_new, 0);
+
+		uint32 now = Clock_gettime_msec();
+		if (now - last >= FUZZ_REPORT_MSEC) {
+			Fuzz_report(now - begin);
+			last = now;
+		}
+	}
+	Fuzz_report(Clock_gettime_msec() - begin);
+}
@@ -0,0 +1,105 @@
+#pragma once
+#include "Proxy.hpp"
+#include "Memory.hpp"
+#include "CPU.hpp"
+
+/*
+* in-process fuzzing: one snapshot at the harness entry, then input after input on the same machine
+*
+* MICROCON_EMU_FUZZ=<dir> turns it on, Core_mainThread runs Fuzz_main instead of the clock loop. the image boots
+* the usual way first (Loader.hpp), Fuzz_main starts from reset:
+* - MICROCON_EMU_FUZZ_ENTRY=<hex pc>: the guest runs until a block starts there (a function entry or any branch
+*   target), that is the snapshot. unset: the snapshot is taken wherever the cpu is when Fuzz_main starts.
+* - MICROCON_EMU_FUZZ_INPUT=<hex addr>[,<max size>]: every input is copied to that guest buffer, r0 = addr and
+*   r1 = length at the entry, like LLVMFuzzerTestOneInput(data, size).
+*   unset: the input comes out of a fifo (Board_var_peris): a read of FUZZ_FIFO_DATA pops one byte,
+*   FUZZ_FIFO_COUNT reads how many are left. reading the empty fifo ends the run, nothing after it depends on the input.
+* - MICROCON_EMU_FUZZ_CYCLES: guest cycles one run may spend (FUZZ_CYCLES).
+* - MICROCON_EMU_FUZZ_RUNS: stop after that many runs (0, default: until killed).
+*
+* a run ends on:
+* - exit: semihosting exit with code 0, or the entry returns (pc reaches the lr it was entered with).
+* - crash: any fault taken (Fault_take), or a semihosting exit with another code (abort, a failed assert).
+*   the input goes to <dir>/crash-<n>, once per exception and pc.
+* - hang: the cycle budget is spent. the input goes to <dir>/hang-<n> if it is the first or found new code.
+* only the cpu runs, the clock tree does not: time is the guest cycle count.
+*
+* feedback is the coverage bitmap (Coverage.hpp, on while fuzzing, marking paths): an input that ran a halfword no earlier
+* run did joins the queue and is written to <dir>/queue-<n>. queue files already there are run first, so a session
+* picks up where the last one stopped. every other input is a queue entry put through a few random mutations
+* (bit flips, interesting values, arithmetic, block erase / insert / copy, splice with another entry).
+*
+* reset, no fork and no re-exec:
+* - every section gets a bitmap of 1KB pages (the smc page, MEMORY_CODEPAGE_SHIFT) that are clean since the
+*   snapshot (Memory_map_elem->fuzz_clean). the snapshot copies section data aside and sets every bit.
+* - the first write to a clean page clears its bit and puts the page on the dirty list (Fuzz_dirty). whatever
+*   writes section data tests the bit next to its smc test: Memory_write / Memory_writeWords, jit inline stores
+*   (a second bt on the page index the smc test left in eax, a hit takes the slow path), semihosting, hle and idiom
+*   copies. a dirty page costs nothing more for the rest of the run.
+* - fastmem sections are read only on the host while clean, so the probe faults into the slow path once.
+*   marking takes the whole host page then. that is a host fault and two mprotect calls per dirty page and run,
+*   a small harness may run faster with MICROCON_EMU_FASTMEM=0.
+* - after a run only the dirty pages are copied back and CPU_struct_reg is restored, so a reset costs what the run
+*   wrote, not the size of the memory. translated code stays, except blocks on a restored page that changed.
+* - what models keep on the host is not rolled back (mpu regions, dwt counters, pending irqs, hle / rtos / callprof
+*   state). a harness that reconfigures them per input has to do its own reset.
+* - translations carry the page test while fuzzing, so the jit cache file (JitAot.hpp) is not used.
+*/
+
+#define FUZZ_ENV "MICROCON_EMU_FUZZ"
+#define FUZZ_ENTRY_ENV "MICROCON_EMU_FUZZ_ENTRY"
+#define FUZZ_INPUT_ENV "MICROCON_EMU_FUZZ_INPUT"
+#define FUZZ_CYCLES_ENV "MICROCON_EMU_FUZZ_CYCLES"
+#define FUZZ_RUNS_ENV "MICROCON_EMU_FUZZ_RUNS"
+
+#define FUZZ_MAX_INPUT 4096	// bytes
+#define FUZZ_CYCLES 10000000
+#define FUZZ_BOOT_CYCLES 0x100000000ULL	// to reach the entry
+#define FUZZ_SLICE 100000	// cycles per CPU_slice, the budget is checked in between
+#define FUZZ_REPORT_MSEC 1000
+
+// input fifo (peripheral region of the board)
+#ifndef FUZZ_FIFO_BASE
+#define FUZZ_FIFO_BASE 0x4000F000
+#endif
+#define FUZZ_FIFO_DATA (FUZZ_FIFO_BASE)
+#define FUZZ_FIFO_COUNT (FUZZ_FIFO_BASE + 4)
+#define FUZZ_FIFO_SIZE 8
+
+enum Fuzz_result_enum {
+	FUZZ_RESULT_NONE = 0,
+	FUZZ_RESULT_EXIT,
+	FUZZ_RESULT_CRASH,
+	FUZZ_RESULT_HANG
+};
+
+extern uint32 Fuzz_var_enabled;
+extern uint32 Fuzz_var_running;	// a run is on, the hooks below count
+extern uint32 Fuzz_var_return;	// lr at the entry, pc there is an exit (1: none)
+
+// telemetry
+extern uint64_t Fuzz_var_runs;
+extern uint32 Fuzz_var_crashes;
+extern uint32 Fuzz_var_hangs;
+extern uint64_t Fuzz_var_dirtypages;	// restored, all runs
+
+// after Memory_init and Fastmem_init, before Coverage_init and anything that translates
+extern void Fuzz_init();
+
+// boot to the entry, snapshot, then run inputs until MICROCON_EMU_FUZZ_RUNS (Core_mainThread)
+extern void Fuzz_main();
+
+// a write of size bytes at offset into thismap is about to land: a clean page becomes dirty
+#define FUZZ_DIRTY(thismap, offset, size) if ((thismap)->fuzz_clean != NULL) Fuzz_dirty((thismap), (offset), (size))
+extern void Fuzz_dirty(Memory_map_elem* thismap, uint32 offset, uint32 size);
+
+// CPU_step: the entry returned
+#define FUZZ_STEP(reg) if (Fuzz_var_running && (reg)->R[15] == Fuzz_var_return) Fuzz_exit()
+extern void Fuzz_exit();
+
+// Fault_take: a fault ends the run as a crash (it is still taken)
+#define FUZZ_FAULT(reg, exception) if (Fuzz_var_running) Fuzz_fault((reg), (exception))
+extern void Fuzz_fault(CPU_struct_reg* reg, uint32 exception);
+
+// Memory_read of the fifo: pop a byte / bytes left, in place
+extern void Fuzz_read(uint32 addr, uint32 width);
@@ -0,0 +1,903 @@
+#include "Hle.hpp"
+#include "Coverage.hpp"
+#include "JitCache.hpp"
+#include "MPU.hpp"
+#include "Fuzz.hpp"
+#include <stdlib.h>	// getenv
+#include <string.h>
+#include <float.h>	// FLT_EVAL_METHOD
+
+// float / double arithmetic rounds like the guest only if the host doesn't carry extra precision
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+#define HLE_HOST_IEEE 1
+#else
+#define HLE_HOST_IEEE 0
+#endif
+
+struct Hle_func {
+	const char* name;
+	uint32 (*run)(CPU_struct_reg* reg, uint32* work);	// 1: done, results in reg. 0: the guest runs it
+	uint32 work;	// Hle_work_enum
+	uint32 fp;	// needs HLE_HOST_IEEE
+};
+
+uint32 Hle_var_enabled = 1;
+uint32 Hle_var_count = 0;
+uint32 Hle_var_lo = 0, Hle_var_hi = 0;
+struct Hle_entry* Hle_var_pending = NULL;
+
+uint32 Hle_var_calls = 0;
+uint32 Hle_var_declined = 0;
+
+static Hle_entry Hle_var_entries[HLE_MAX_ENTRIES];	// sorted by addr
+static uint32 Hle_var_float = 0;	// newlib's printf does %f / %e / %g
+
+// the sample in flight
+static uint32 Hle_var_ret = 0;
+static uint32 Hle_var_sp = 0;
+static uint64_t Hle_var_start = 0;
+static uint32 Hle_var_work = 0;
+
+/*
+* guest memory: plain sections only, no mpu
+*/
+
+// host pointer to guest [addr, addr + size) if it is plain memory with attrib inside one section
+static uint8* Hle_direct(uint32 addr, uint32 size, uint32 attrib) {
+	Memory_map_elem* thismap = Memory_getMap(addr);
+	if (thismap == NULL || !MEMORY_IS_DIRECT(thismap) || (thismap->attrib & attrib) == 0
+		|| (uint64_t)addr + size > (uint64_t)thismap->base + thismap->size) {
+		return NULL;
+	}
+	return &thismap->data[addr - thismap->base];
+}
+
+// nul terminated (or max bytes long) string at addr. NULL if it runs off its section first
+static const char* Hle_string(uint32 addr, uint32 max, uint32* len) {
+	Memory_map_elem* thismap = Memory_getMap(addr);
+	if (thismap == NULL || !MEMORY_IS_DIRECT(thismap) || (thismap->attrib & MEMORY_ATTRIB_S_R) == 0
+		|| addr >= thismap->base + thismap->size) {
+		return NULL;
+	}
+	const char* str = (const char*)&thismap->data[addr - thismap->base];
+	uint32 avail = thismap->base + thismap->size - addr;
+	const char* nul = (const char*)memchr(str, 0, (avail < max) ? avail : max);
+	if (nul == NULL && avail < max) {
+		return NULL;
+	}
+	*len = (nul != NULL) ? (uint32)(nul - str) : max;
+	return str;
+}
+
+static void Hle_written(uint32 addr, uint32 size) {
+	Memory_map_elem* thismap = Memory_getMap(addr);
+	if (thismap->jit_pagemap != NULL && size != 0) {
+		JitCache_invalidate(addr, size);
+	}
+	FUZZ_DIRTY(thismap, addr - thismap->base, size);
+}
+
+/*
+* soft-float: r0 (r0:r1) and r1 (r2:r3) in, r0 (r0:r1) out
+*/
+
+static float Hle_f(uint32 r) {
+	uint32_t bits = (uint32_t)r;
+	float f;
+	memcpy(&f, &bits, 4);
+	return f;
+}
+
+static uint32 Hle_fbits(float f) {
+	uint32_t bits;
+	memcpy(&bits, &f, 4);
+	return bits;
+}
+
+static double Hle_d(uint32 lo, uint32 hi) {
+	uint64_t bits = ((uint64_t)(uint32_t)hi << 32) | (uint32_t)lo;
+	double d;
+	memcpy(&d, &bits, 8);
+	return d;
+}
+
+static uint64_t Hle_l(uint32 lo, uint32 hi) {
+	return ((uint64_t)(uint32_t)hi << 32) | (uint32_t)lo;
+}
+
+static void Hle_lret(CPU_struct_reg* reg, uint64_t v) {
+	reg->R[0] = (uint32_t)v;
+	reg->R[1] = (uint32_t)(v >> 32);
+}
+
+static void Hle_dret(CPU_struct_reg* reg, double d) {
+	uint64_t bits;
+	memcpy(&bits, &d, 8);
+	Hle_lret(reg, bits);
+}
+
+#define HLE_FOP(name, expr) \
+static uint32 name(CPU_struct_reg* reg, uint32*) { \
+	float x = Hle_f(reg->R[0]), y = Hle_f(reg->R[1]); \
+	float r = (expr); \
+	if (x != x || y != y || r != r) { \
+		return 0; \
+	} \
+	reg->R[0] = Hle_fbits(r); \
+	return 1; \
+}
+
+#define HLE_DOP(name, expr) \
+static uint32 name(CPU_struct_reg* reg, uint32*) { \
+	double x = Hle_d(reg->R[0], reg->R[1]), y = Hle_d(reg->R[2], reg->R[3]); \
+	double r = (expr); \
+	if (x != x || y != y || r != r) { \
+		return 0; \
+	} \
+	Hle_dret(reg, r); \
+	return 1; \
+}
+
+// compares return 0 / 1 and are defined for nans too
+#define HLE_FCMP(name, expr) \
+static uint32 name(CPU_struct_reg* reg, uint32*) { \
+	float x = Hle_f(reg->R[0]), y = Hle_f(reg->R[1]); \
+	reg->R[0] = (expr) ? 1 : 0; \
+	return 1; \
+}
+
+#define HLE_DCMP(name, expr) \
+static uint32 name(CPU_struct_reg* reg, uint32*) { \
+	double x = Hle_d(reg->R[0], reg->R[1]), y = Hle_d(reg->R[2], reg->R[3]); \
+	reg->R[0] = (expr) ? 1 : 0; \
+	return 1; \
+}
+
+HLE_FOP(Hle_fadd, x + y)
+HLE_FOP(Hle_fsub, x - y)
+HLE_FOP(Hle_frsub, y - x)
+HLE_FOP(Hle_fmul, x * y)
+HLE_FOP(Hle_fdiv, x / y)
+HLE_DOP(Hle_dadd, x + y)
+HLE_DOP(Hle_dsub, x - y)
+HLE_DOP(Hle_drsub, y - x)
+HLE_DOP(Hle_dmul, x * y)
+HLE_DOP(Hle_ddiv, x / y)
+
+HLE_FCMP(Hle_fcmpeq, x == y)
+HLE_FCMP(Hle_fcmplt, x < y)
+HLE_FCMP(Hle_fcmple, x <= y)
+HLE_FCMP(Hle_fcmpge, x >= y)
+HLE_FCMP(Hle_fcmpgt, x > y)
+HLE_FCMP(Hle_fcmpun, x != x || y != y)
+HLE_DCMP(Hle_dcmpeq, x == y)
+HLE_DCMP(Hle_dcmplt, x < y)
+HLE_DCMP(Hle_dcmple, x <= y)
+HLE_DCMP(Hle_dcmpge, x >= y)
+HLE_DCMP(Hle_dcmpgt, x > y)
+HLE_DCMP(Hle_dcmpun, x != x || y != y)
+
+// integer -> float, always exact or rounded to nearest
+static uint32 Hle_i2f(CPU_struct_reg* reg, uint32*) { reg->R[0] = Hle_fbits((float)(int32_t)reg->R[0]); return 1; }
+static uint32 Hle_ui2f(CPU_struct_reg* reg, uint32*) { reg->R[0] = Hle_fbits((float)(uint32_t)reg->R[0]); return 1; }
+static uint32 Hle_l2f(CPU_struct_reg* reg, uint32*) { reg->R[0] = Hle_fbits((float)(int64_t)Hle_l(reg->R[0], reg->R[1])); return 1; }
+static uint32 Hle_ul2f(CPU_struct_reg* reg, uint32*) { reg->R[0] = Hle_fbits((float)Hle_l(reg->R[0], reg->R[1])); return 1; }
+static uint32 Hle_i2d(CPU_struct_reg* reg, uint32*) { Hle_dret(reg, (double)(int32_t)reg->R[0]); return 1; }
+static uint32 Hle_ui2d(CPU_struct_reg* reg, uint32*) { Hle_dret(reg, (double)(uint32_t)reg->R[0]); return 1; }
+static uint32 Hle_l2d(CPU_struct_reg* reg, uint32*) { Hle_dret(reg, (double)(int64_t)Hle_l(reg->R[0], reg->R[1])); return 1; }
+static uint32 Hle_ul2d(CPU_struct_reg* reg, uint32*) { Hle_dret(reg, (double)Hle_l(reg->R[0], reg->R[1])); return 1; }
+
+static uint32 Hle_f2d(CPU_struct_reg* reg, uint32*) {
+	float x = Hle_f(reg->R[0]);
+	if (x != x) {
+		return 0;
+	}
+	Hle_dret(reg, (double)x);
+	return 1;
+}
+
+static uint32 Hle_d2f(CPU_struct_reg* reg, uint32*) {
+	double x = Hle_d(reg->R[0], reg->R[1]);
+	if (x != x) {
+		return 0;
+	}
+	reg->R[0] = Hle_fbits((float)x);
+	return 1;
+}
+
+// float -> integer, round toward zero. out of range (and nan) saturates in libgcc, leave it to the guest
+static uint32 Hle_f2iz(CPU_struct_reg* reg, uint32*) {
+	float x = Hle_f(reg->R[0]);
+	if (!(x > -2147483649.0f && x < 2147483648.0f)) {
+		return 0;
+	}
+	reg->R[0] = (uint32_t)(int32_t)x;
+	return 1;
+}
+
+static uint32 Hle_f2uiz(CPU_struct_reg* reg, uint32*) {
+	float x = Hle_f(reg->R[0]);
+	if (!(x > -1.0f && x < 4294967296.0f)) {
+		return 0;
+	}
+	reg->R[0] = (uint32_t)x;
+	return 1;
+}
+
+static uint32 Hle_d2iz(CPU_struct_reg* reg, uint32*) {
+	double x = Hle_d(reg->R[0], reg->R[1]);
+	if (!(x > -2147483649.0 && x < 2147483648.0)) {
+		return 0;
+	}
+	reg->R[0] = (uint32_t)(int32_t)x;
+	return 1;
+}
+
+static uint32 Hle_d2uiz(CPU_struct_reg* reg, uint32*) {
+	double x = Hle_d(reg->R[0], reg->R[1]);
+	if (!(x > -1.0 && x < 4294967296.0)) {
+		return 0;
+	}
+	reg->R[0] = (uint32_t)x;
+	return 1;
+}
+
+static uint32 Hle_f2lz(CPU_struct_reg* reg, uint32*) {
+	float x = Hle_f(reg->R[0]);
+	if (!(x >= -9223372036854775808.0f && x < 9223372036854775808.0f)) {
+		return 0;
+	}
+	Hle_lret(reg, (uint64_t)(int64_t)x);
+	return 1;
+}
+
+static uint32 Hle_f2ulz(CPU_struct_reg* reg, uint32*) {
+	float x = Hle_f(reg->R[0]);
+	if (!(x > -1.0f && x < 18446744073709551616.0f)) {
+		return 0;
+	}
+	Hle_lret(reg, (uint64_t)x);
+	return 1;
+}
+
+static uint32 Hle_d2lz(CPU_struct_reg* reg, uint32*) {
+	double x = Hle_d(reg->R[0], reg->R[1]);
+	if (!(x >= -9223372036854775808.0 && x < 9223372036854775808.0)) {
+		return 0;
+	}
+	Hle_lret(reg, (uint64_t)(int64_t)x);
+	return 1;
+}
+
+static uint32 Hle_d2ulz(CPU_struct_reg* reg, uint32*) {
+	double x = Hle_d(reg->R[0], reg->R[1]);
+	if (!(x > -1.0 && x < 18446744073709551616.0)) {
+		return 0;
+	}
+	Hle_lret(reg, (uint64_t)x);
+	return 1;
+}
+
+/*
+* integer division. by zero goes through __aeabi_idiv0 in the guest
+*/
+
+static uint32 Hle_uidiv(CPU_struct_reg* reg, uint32*) {
+	uint32_t n = (uint32_t)reg->R[0], d = (uint32_t)reg->R[1];
+	if (d == 0) {
+		return 0;
+	}
+	reg->R[0] = n / d;
+	return 1;
+}
+
+static uint32 Hle_uidivmod(CPU_struct_reg* reg, uint32*) {
+	uint32_t n = (uint32_t)reg->R[0], d = (uint32_t)reg->R[1];
+	if (d == 0) {
+		return 0;
+	}
+	reg->R[0] = n / d;
+	reg->R[1] = n % d;
+	return 1;
+}
+
+// in 64 bit: INT_MIN / -1 wraps to INT_MIN like sdiv instead of trapping the host
+static uint32 Hle_idiv(CPU_struct_reg* reg, uint32*) {
+	int64_t n = (int32_t)reg->R[0], d = (int32_t)reg->R[1];
+	if (d == 0) {
+		return 0;
+	}
+	reg->R[0] = (uint32_t)(n / d);
+	return 1;
+}
+
+static uint32 Hle_idivmod(CPU_struct_reg* reg, uint32*) {
+	int64_t n = (int32_t)reg->R[0], d = (int32_t)reg->R[1];
+	if (d == 0) {
+		return 0;
+	}
+	reg->R[0] = (uint32_t)(n / d);
+	reg->R[1] = (uint32_t)(n % d);
+	return 1;
+}
+
+// r0:r1 / r2:r3 -> quotient r0:r1, remainder r2:r3
+static uint32 Hle_uldivmod(CPU_struct_reg* reg, uint32*) {
+	uint64_t n = Hle_l(reg->R[0], reg->R[1]), d = Hle_l(reg->R[2], reg->R[3]);
+	if (d == 0) {
+		return 0;
+	}
+	Hle_lret(reg, n / d);
+	reg->R[2] = (uint32_t)(n % d);
+	reg->R[3] = (uint32_t)((n % d) >> 32);
+	return 1;
+}
+
+static uint32 Hle_ldivmod(CPU_struct_reg* reg, uint32*) {
+	int64_t n = (int64_t)Hle_l(reg->R[0], reg->R[1]), d = (int64_t)Hle_l(reg->R[2], reg->R[3]);
+	if (d == 0 || (d == -1 && n == INT64_MIN)) {
+		return 0;
+	}
+	Hle_lret(reg, (uint64_t)(n / d));
+	reg->R[2] = (uint32_t)(uint64_t)(n % d);
+	reg->R[3] = (uint32_t)((uint64_t)(n % d) >> 32);
+	return 1;
+}
+
+// __udivdi3 / __umoddi3 and friends: one result in r0:r1
+static uint32 Hle_udivdi3(CPU_struct_reg* reg, uint32*) {
+	uint64_t n = Hle_l(reg->R[0], reg->R[1]), d = Hle_l(reg->R[2], reg->R[3]);
+	if (d == 0) {
+		return 0;
+	}
+	Hle_lret(reg, n / d);
+	return 1;
+}
+
+static uint32 Hle_umoddi3(CPU_struct_reg* reg, uint32*) {
+	uint64_t n = Hle_l(reg->R[0], reg->R[1]), d = Hle_l(reg->R[2], reg->R[3]);
+	if (d == 0) {
+		return 0;
+	}
+	Hle_lret(reg, n % d);
+	return 1;
+}
+
+static uint32 Hle_divdi3(CPU_struct_reg* reg, uint32*) {
+	int64_t n = (int64_t)Hle_l(reg->R[0], reg->R[1]), d = (int64_t)Hle_l(reg->R[2], reg->R[3]);
+	if (d == 0 || (d == -1 && n == INT64_MIN)) {
+		return 0;
+	}
+	Hle_lret(reg, (uint64_t)(n / d));
+	return 1;
+}
+
+static uint32 Hle_moddi3(CPU_struct_reg* reg, uint32*) {
+	int64_t n = (int64_t)Hle_l(reg->R[0], reg->R[1]), d = (int64_t)Hle_l(reg->R[2], reg->R[3]);
+	if (d == 0 || (d == -1 && n == INT64_MIN)) {
+		return 0;
+	}
+	Hle_lret(reg, (uint64_t)(n % d));
+	return 1;
+}
+
+/*
+* string.h
+*/
+
+static uint32 Hle_memcpy(CPU_struct_reg* reg, uint32* work) {
+	uint32_t dest = (uint32_t)reg->R[0], src = (uint32_t)reg->R[1], n = (uint32_t)reg->R[2];
+	if (MPU_var_ctrl & MPU_CTRL_ENABLE) {
+		return 0;
+	}
+	uint8* d = Hle_direct(dest, n, MEMORY_ATTRIB_S_W);
+	uint8* s = Hle_direct(src, n, MEMORY_ATTRIB_S_R);
+	if (d == NULL || s == NULL || (n != 0 && dest < src + n && src < dest + n)) {
+		return 0;	// overlap: what comes out depends on the guest's copy order
+	}
+	Hle_written(dest, n);
+	memcpy(d, s, n);
+	*work = n;
+	return 1;	// r0 is dest already
+}
+
+static uint32 Hle_memset(CPU_struct_reg* reg, uint32* work) {
+	uint32_t dest = (uint32_t)reg->R[0], n = (uint32_t)reg->R[2];
+	if (MPU_var_ctrl & MPU_CTRL_ENABLE) {
+		return 0;
+	}
+	uint8* d = Hle_direct(dest, n, MEMORY_ATTRIB_S_W);
+	if (d == NULL) {
+		return 0;
+	}
+	Hle_written(dest, n);
+	memset(d, (uint8)reg->R[1], n);
+	*work = n;
+	return 1;
+}
+
+static uint32 Hle_strlen(CPU_struct_reg* reg, uint32* work) {
+	uint32 len;
+	if ((MPU_var_ctrl & MPU_CTRL_ENABLE) || Hle_string(reg->R[0], 0xFFFFFFFF, &len) == NULL) {
+		return 0;
+	}
+	reg->R[0] = len;
+	*work = len;
+	return 1;
+}
+
+/*
+* vsnprintf(buf, size, fmt, ap). va_list is a plain pointer into the argument area (aapcs)
+*/
+
+static uint32 Hle_arg(uint32* ap, uint32 wide, uint64_t* value) {
+	if (wide) {
+		*ap = (*ap + 7) & ~0x7;
+	}
+	uint8* data = Hle_direct(*ap, wide ? 8 : 4, MEMORY_ATTRIB_S_R);
+	if (data == NULL) {
+		return 0;
+	}
+	uint32_t lo, hi = 0;
+	memcpy(&lo, data, 4);
+	if (wide) {
+		memcpy(&hi, data + 4, 4);
+	}
+	*value = ((uint64_t)hi << 32) | lo;
+	*ap = (uint32_t)(*ap + (wide ? 8 : 4));
+	return 1;
+}
+
+static uint32 Hle_vsnprintf(CPU_struct_reg* reg, uint32* work) {
+	static char out[HLE_PRINTF_MAX];
+	uint32_t buf = (uint32_t)reg->R[0], size = (uint32_t)reg->R[1];
+	uint32 ap = (uint32_t)reg->R[3];
+	uint32 fmtlen, len = 0;
+
+	if ((MPU_var_ctrl & MPU_CTRL_ENABLE) || size > 0x7FFFFFFF) {
+		return 0;
+	}
+	const char* fmt = Hle_string(reg->R[2], HLE_PRINTF_MAX, &fmtlen);
+	if (fmt == NULL || fmtlen == HLE_PRINTF_MAX) {
+		return 0;
+	}
+
+	// everything is read and printed on the host first, the guest buffer is only written once nothing can fail
+	for (uint32 i = 0; i < fmtlen; ) {
+		if (fmt[i] != '%') {
+			if (len + 1 >= HLE_PRINTF_MAX) {
+				return 0;
+			}
+			out[len++] = fmt[i++];
+			continue;
+		}
+		i++;
+
+		char spec[32];
+		uint32 speclen = 0;
+		uint64_t value;
+		spec[speclen++] = '%';
+
+		// flags
+		while (i < fmtlen && strchr("-+ #0", fmt[i]) != NULL) {
+			if (speclen >= 8) {
+				return 0;
+			}
+			spec[speclen++] = fmt[i++];
+		}
+		uint32 zeropad = (memchr(spec, '0', speclen) != NULL);
+
+		// width, precision (-1: none)
+		int32_t width = -1, prec = -1;
+		if (i < fmtlen && fmt[i] == '*') {
+			if (!Hle_arg(&ap, 0, &value)) {
+				return 0;
+			}
+			width = (int32_t)value;
+			if (width < 0) {
+				spec[speclen++] = '-';
+				width = (width == INT32_MIN) ? INT32_MAX : -width;
+			}
+			i++;
+		}
+		else {
+			for (width = 0; i < fmtlen && fmt[i] >= '0' && fmt[i] <= '9'; i++) {
+				width = width * 10 + (fmt[i] - '0');
+				if (width >= HLE_PRINTF_MAX) {
+					return 0;
+				}
+			}
+			if (i < fmtlen && fmt[i] == '$') {
+				return 0;	// positional
+			}
+		}
+		if (i < fmtlen && fmt[i] == '.') {
+			i++;
+			if (i < fmtlen && fmt[i] == '*') {
+				if (!Hle_arg(&ap, 0, &value)) {
+					return 0;
+				}
+				prec = ((int32_t)value < 0) ? -1 : (int32_t)value;
+				i++;
+			}
+			else {
+				for (prec = 0; i < fmtlen && fmt[i] >= '0' && fmt[i] <= '9'; i++) {
+					prec = prec * 10 + (fmt[i] - '0');
+					if (prec >= HLE_PRINTF_MAX) {
+						return 0;
+					}
+				}
+			}
+		}
+		if (width >= HLE_PRINTF_MAX || prec >= HLE_PRINTF_MAX) {
+			return 0;
+		}
+
+		// length: 0 char, 1 short, 2 int / long / size_t / ptrdiff_t, 3 long long / intmax_t
+		uint32 length = 2;
+		if (i + 1 < fmtlen && fmt[i] == 'h' && fmt[i + 1] == 'h') {
+			length = 0;
+			i += 2;
+		}
+		else if (i + 1 < fmtlen && fmt[i] == 'l' && fmt[i + 1] == 'l') {
+			length = 3;
+			i += 2;
+		}
+		else if (i < fmtlen && fmt[i] == 'h') {
+			length = 1;
+			i++;
+		}
+		else if (i < fmtlen && fmt[i] == 'j') {
+			length = 3;
+			i++;
+		}
+		else if (i < fmtlen && (fmt[i] == 'l' || fmt[i] == 'z' || fmt[i] == 't')) {
+			length = (fmt[i] == 'l') ? 4 : 2;	// 4: long, or wide for c / s
+			i++;
+		}
+		if (i >= fmtlen) {
+			return 0;
+		}
+		char conv = fmt[i++];
+
+		if (width > 0) {
+			speclen += snprintf(spec + speclen, sizeof(spec) - speclen, "%d", (int)width);
+		}
+		if (prec >= 0 && conv != 's') {
+			speclen += snprintf(spec + speclen, sizeof(spec) - speclen, ".%d", (int)prec);
+		}
+
+		int n;
+		uint32 room = HLE_PRINTF_MAX - len;
+		switch (conv) {
+		case '%':
+			n = snprintf(out + len, room, "%%");
+			break;
+
+		case 'd':
+		case 'i':
+		case 'u':
+		case 'o':
+		case 'x':
+		case 'X': {
+			if (!Hle_arg(&ap, length == 3, &value)) {
+				return 0;
+			}
+			uint32 is_signed = (conv == 'd' || conv == 'i');
+			if (length == 0) {
+				value = is_signed ? (uint64_t)(int64_t)(int8_t)value : (uint8_t)value;
+			}
+			else if (length == 1) {
+				value = is_signed ? (uint64_t)(int64_t)(int16_t)value : (uint16_t)value;
+			}
+			else if (length != 3) {
+				value = is_signed ? (uint64_t)(int64_t)(int32_t)value : (uint32_t)value;
+			}
+			snprintf(spec + speclen, sizeof(spec) - speclen, "ll%c", conv);
+			n = is_signed ? snprintf(out + len, room, spec, (long long)value) : snprintf(out + len, room, spec, (unsigned long long)value);
+			break;
+		}
+
+		case 'c':
+			if (length == 4 || zeropad || prec >= 0 || !Hle_arg(&ap, 0, &value)) {
+				return 0;	// newlib pads %0c with zeros, the host may not
+			}
+			snprintf(spec + speclen, sizeof(spec) - speclen, "c");
+			n = snprintf(out + len, room, spec, (int)(uint8_t)value);
+			break;
+
+		case 's': {
+			uint32 slen;
+			const char* str;
+			if (length == 4 || zeropad || !Hle_arg(&ap, 0, &value) || value == 0) {
+				return 0;	// NULL prints differently everywhere
+			}
+			str = Hle_string((uint32_t)value, (prec >= 0) ? (uint32)prec : HLE_PRINTF_MAX, &slen);
+			if (str == NULL || (prec < 0 && slen == HLE_PRINTF_MAX)) {
+				return 0;
+			}
+			snprintf(spec + speclen, sizeof(spec) - speclen, ".%ds", (int)slen);
+			n = snprintf(out + len, room, spec, str);
+			break;
+		}
+
+		case 'p':
+			// newlib: 0x and lowercase hex, 0x0 for NULL
+			if (speclen != 1 || prec >= 0 || !Hle_arg(&ap, 0, &value)) {
+				return 0;
+			}
+			n = snprintf(out + len, room, "0x%x", (unsigned int)value);
+			break;
+
+		case 'f':
+		case 'F':
+		case 'e':
+		case 'E':
+		case 'g':
+		case 'G': {
+			if (!Hle_var_float || !HLE_HOST_IEEE || !Hle_arg(&ap, 1, &value)) {
+				return 0;
+			}
+			double d;
+			memcpy(&d, &value, 8);
+			if (d != d) {
+				return 0;	// -nan / nan differs
+			}
+			snprintf(spec + speclen, sizeof(spec) - speclen, "%c", conv);
+			n = snprintf(out + len, room, spec, d);
+			break;
+		}
+
+		default:	// %n, %a, %ls, %L...
+			return 0;
+		}
+		if (n < 0 || (uint32)n >= room) {
+			return 0;
+		}
+		len += n;
+	}
+
+	if (size != 0) {
+		uint32 count = (len < size - 1) ? len : size - 1;
+		uint8* dest = Hle_direct(buf, count + 1, MEMORY_ATTRIB_S_W);
+		if (dest == NULL) {
+			return 0;
+		}
+		Hle_written(buf, count + 1);
+		memcpy(dest, out, count);
+		dest[count] = 0;
+	}
+	reg->R[0] = len;
+	*work = len;
+	return 1;
+}
+
+/*
+* helper table: aeabi names and the plain libgcc ones, they usually share the entry
+*/
+
+static const Hle_func Hle_var_funcs[] = {
+	{ "__aeabi_fadd", Hle_fadd, HLE_WORK_NONE, 1 },
+	{ "__addsf3", Hle_fadd, HLE_WORK_NONE, 1 },
+	{ "__aeabi_fsub", Hle_fsub, HLE_WORK_NONE, 1 },
+	{ "__subsf3", Hle_fsub, HLE_WORK_NONE, 1 },
+	{ "__aeabi_frsub", Hle_frsub, HLE_WORK_NONE, 1 },
+	{ "__aeabi_fmul", Hle_fmul, HLE_WORK_NONE, 1 },
+	{ "__mulsf3", Hle_fmul, HLE_WORK_NONE, 1 },
+	{ "__aeabi_fdiv", Hle_fdiv, HLE_WORK_NONE, 1 },
+	{ "__divsf3", Hle_fdiv, HLE_WORK_NONE, 1 },
+	{ "__aeabi_dadd", Hle_dadd, HLE_WORK_NONE, 1 },
+	{ "__adddf3", Hle_dadd, HLE_WORK_NONE, 1 },
+	{ "__aeabi_dsub", Hle_dsub, HLE_WORK_NONE, 1 },
+	{ "__subdf3", Hle_dsub, HLE_WORK_NONE, 1 },
+	{ "__aeabi_drsub", Hle_drsub, HLE_WORK_NONE, 1 },
+	{ "__aeabi_dmul", Hle_dmul, HLE_WORK_NONE, 1 },
+	{ "__muldf3", Hle_dmul, HLE_WORK_NONE, 1 },
+	{ "__aeabi_ddiv", Hle_ddiv, HLE_WORK_NONE, 1 },
+	{ "__divdf3", Hle_ddiv, HLE_WORK_NONE, 1 },
+
+	{ "__aeabi_fcmpeq", Hle_fcmpeq, HLE_WORK_NONE, 1 },
+	{ "__aeabi_fcmplt", Hle_fcmplt, HLE_WORK_NONE, 1 },
+	{ "__aeabi_fcmple", Hle_fcmple, HLE_WORK_NONE, 1 },
+	{ "__aeabi_fcmpge", Hle_fcmpge, HLE_WORK_NONE, 1 },
+	{ "__aeabi_fcmpgt", Hle_fcmpgt, HLE_WORK_NONE, 1 },
+	{ "__aeabi_fcmpun", Hle_fcmpun, HLE_WORK_NONE, 1 },
+	{ "__aeabi_dcmpeq", Hle_dcmpeq, HLE_WORK_NONE, 1 },
+	{ "__aeabi_dcmplt", Hle_dcmplt, HLE_WORK_NONE, 1 },
+	{ "__aeabi_dcmple", Hle_dcmple, HLE_WORK_NONE, 1 },
+	{ "__aeabi_dcmpge", Hle_dcmpge, HLE_WORK_NONE, 1 },
+	{ "__aeabi_dcmpgt", Hle_dcmpgt, HLE_WORK_NONE, 1 },
+	{ "__aeabi_dcmpun", Hle_dcmpun, HLE_WORK_NONE, 1 },
+
+	{ "__aeabi_i2f", Hle_i2f, HLE_WORK_NONE, 1 },
+	{ "__aeabi_ui2f", Hle_ui2f, HLE_WORK_NONE, 1 },
+	{ "__aeabi_l2f", Hle_l2f, HLE_WORK_NONE, 1 },
+	{ "__aeabi_ul2f", Hle_ul2f, HLE_WORK_NONE, 1 },
+	{ "__aeabi_i2d", Hle_i2d, HLE_WORK_NONE, 1 },
+	{ "__aeabi_ui2d", Hle_ui2d, HLE_WORK_NONE, 1 },
+	{ "__aeabi_l2d", Hle_l2d, HLE_WORK_NONE, 1 },
+	{ "__aeabi_ul2d", Hle_ul2d, HLE_WORK_NONE, 1 },
+	{ "__aeabi_f2d", Hle_f2d, HLE_WORK_NONE, 1 },
+	{ "__aeabi_d2f", Hle_d2f, HLE_WORK_NONE, 1 },
+	{ "__aeabi_f2iz", Hle_f2iz, HLE_WORK_NONE, 1 },
+	{ "__aeabi_f2uiz", Hle_f2uiz, HLE_WORK_NONE, 1 },
+	{ "__aeabi_d2iz", Hle_d2iz, HLE_WORK_NONE, 1 },
+	{ "__aeabi_d2uiz", Hle_d2uiz, HLE_WORK_NONE, 1 },
+	{ "__aeabi_f2lz", Hle_f2lz, HLE_WORK_NONE, 1 },
+	{ "__aeabi_f2ulz", Hle_f2ulz, HLE_WORK_NONE, 1 },
+	{ "__aeabi_d2lz", Hle_d2lz, HLE_WORK_NONE, 1 },
+	{ "__aeabi_d2ulz", Hle_d2ulz, HLE_WORK_NONE, 1 },
+
+	{ "__aeabi_uidiv", Hle_uidiv, HLE_WORK_NONE, 0 },
+	{ "__udivsi3", Hle_uidiv, HLE_WORK_NONE, 0 },
+	{ "__aeabi_uidivmod", Hle_uidivmod, HLE_WORK_NONE, 0 },
+	{ "__aeabi_idiv", Hle_idiv, HLE_WORK_NONE, 0 },
+	{ "__divsi3", Hle_idiv, HLE_WORK_NONE, 0 },
+	{ "__aeabi_idivmod", Hle_idivmod, HLE_WORK_NONE, 0 },
+	{ "__aeabi_uldivmod", Hle_uldivmod, HLE_WORK_NONE, 0 },
+	{ "__aeabi_ldivmod", Hle_ldivmod, HLE_WORK_NONE, 0 },
+	{ "__udivdi3", Hle_udivdi3, HLE_WORK_NONE, 0 },
+	{ "__umoddi3", Hle_umoddi3, HLE_WORK_NONE, 0 },
+	{ "__divdi3", Hle_divdi3, HLE_WORK_NONE, 0 },
+	{ "__moddi3", Hle_moddi3, HLE_WORK_NONE, 0 },
+
+	{ "memcpy", Hle_memcpy, HLE_WORK_SIZE, 0 },
+	{ "__aeabi_memcpy", Hle_memcpy, HLE_WORK_SIZE, 0 },
+	{ "__aeabi_memcpy4", Hle_memcpy, HLE_WORK_SIZE, 0 },
+	{ "__aeabi_memcpy8", Hle_memcpy, HLE_WORK_SIZE, 0 },
+	{ "memset", Hle_memset, HLE_WORK_SIZE, 0 },
+	{ "strlen", Hle_strlen, HLE_WORK_RESULT, 0 },
+	{ "vsnprintf", Hle_vsnprintf, HLE_WORK_RESULT, 0 },
+};
+
+static void Hle_symbol(void*, const char* name, uint32 value, uint32 info) {
+	if (strcmp(name, "_dtoa_r") == 0 || strcmp(name, "_printf_float") == 0) {
+		Hle_var_float = 1;
+	}
+	if ((info & 0xF) != 2 || (value & 0x1) == 0) {	// STT_FUNC, thumb
+		return;
+	}
+	for (uint32 i = 0; i < sizeof(Hle_var_funcs) / sizeof(Hle_var_funcs[0]); i++) {
+		const Hle_func* func = &Hle_var_funcs[i];
+		if (strcmp(name, func->name) != 0 || (func->fp && !HLE_HOST_IEEE)) {
+			continue;
+		}
+		uint32 addr = value & ~0x1;
+		uint32 pos = 0;
+		while (pos < Hle_var_count && Hle_var_entries[pos].addr < addr) {
+			pos++;
+		}
+		if ((pos < Hle_var_count && Hle_var_entries[pos].addr == addr) || Hle_var_count >= HLE_MAX_ENTRIES) {
+			return;	// alias of an entry we have
+		}
+		memmove(&Hle_var_entries[pos + 1], &Hle_var_entries[pos], (Hle_var_count - pos) * sizeof(Hle_entry));
+		memset(&Hle_var_entries[pos], 0, sizeof(Hle_entry));
+		Hle_var_entries[pos].addr = addr;
+		Hle_var_entries[pos].func = func;
+		Hle_var_count += 1;
+		return;
+	}
+}
+
+void Hle_init() {
+	Hle_var_count = 0;
+	Hle_var_pending = NULL;
+	Hle_var_float = 0;
+	Hle_var_calls = 0;
+	Hle_var_declined = 0;
+
+	const char* env = getenv(HLE_ENV);
+	Hle_var_enabled = !(env != NULL && strcmp(env, "0") == 0);
+	const char* elfpath = getenv(COVERAGE_ELF_ENV);
+	if (!Hle_var_enabled || elfpath == NULL || elfpath[0] == '\0') {
+		return;
+	}
+
+	uint32 elfsize = 0;
+	uint8* elf = (uint8*)map_file(elfpath, &elfsize);
+	if (elf == NULL) {
+		eprintf("hle: can't open %s\n", elfpath);
+		return;
+	}
+	Coverage_elf_symbols(elf, elfsize, Hle_symbol, NULL);
+	unmap_file(elf, elfsize);
+
+	if (Hle_var_count != 0) {
+		Hle_var_lo = Hle_var_entries[0].addr;
+		Hle_var_hi = Hle_var_entries[Hle_var_count - 1].addr;
+	}
+	printf("hle: %d helpers in %s\n", (int)Hle_var_count, elfpath);
+}
+
+static Hle_entry* Hle_find(uint32 addr) {
+	uint32 lo = 0, hi = Hle_var_count;
+	while (lo < hi) {
+		uint32 mid = (lo + hi) / 2;
+		if (Hle_var_entries[mid].addr < addr) {
+			lo = mid + 1;
+		}
+		else {
+			hi = mid;
+		}
+	}
+	return (lo < Hle_var_count && Hle_var_entries[lo].addr == addr) ? &Hle_var_entries[lo] : NULL;
+}
+
+uint32 Hle_call(CPU_struct_reg* reg) {
+	Hle_entry* entry = Hle_find(reg->R[15]);
+	uint32 lr = reg->R[14];
+
+	if (entry == NULL || (lr & 0x1) == 0 || (lr & 0xF0000000) == 0xF0000000) {
+		return 0;	// not a plain call (EXC_RETURN in lr: tail call from a handler)
+	}
+
+	// still calibrating: the guest runs it and Hle_return takes the sample
+	if (entry->samples < HLE_CALIBRATE) {
+		if (Hle_var_pending == NULL) {
+			Hle_var_pending = entry;
+			Hle_var_ret = lr & ~0x1;
+			Hle_var_sp = reg->R[13];
+			Hle_var_start = CPU_var_cycles;
+			Hle_var_work = (entry->func->work == HLE_WORK_SIZE) ? (uint32_t)reg->R[2] : 0;
+		}
+		return 0;
+	}
+
+	uint32 work = 0;
+	if (!entry->func->run(reg, &work)) {
+		Hle_var_declined += 1;
+		return 0;
+	}
+	reg->R[15] = lr & ~0x1;
+	entry->calls += 1;
+	Hle_var_calls += 1;
+
+	double cost = entry->a + entry->b * work;
+	return (cost < 1.0) ? 1 : (uint32)(cost + 0.5);
+}
+
+void Hle_return(CPU_struct_reg* reg) {
+	if (reg->R[15] != Hle_var_ret || reg->R[13] != Hle_var_sp) {
+		return;
+	}
+	Hle_entry* entry = Hle_var_pending;
+	Hle_var_pending = NULL;
+
+	double w = Hle_var_work;
+	if (entry->func->work == HLE_WORK_RESULT) {
+		w = ((int32_t)reg->R[0] < 0) ? 0 : (double)(uint32_t)reg->R[0];
+	}
+	double c = (double)(CPU_var_cycles - Hle_var_start);
+	entry->sw += w;
+	entry->sc += c;
+	entry->sww += w * w;
+	entry->swc += w * c;
+	entry->samples += 1;
+	if (entry->samples < HLE_CALIBRATE) {
+		return;
+	}
+
+	// least squares: cycles = a + b * work (just the mean if work never changed)
+	double n = entry->samples;
+	double var = n * entry->sww - entry->sw * entry->sw;
+	entry->b = (var > 0) ? (n * entry->swc - entry->sw * entry->sc) / var : 0;
+	if (entry->b < 0) {
+		entry->b = 0;
+	}
+	entry->a = (entry->sc - entry->b * entry->sw) / n;
+}
+
+void Hle_dump() {
+	if (Hle_var_calls == 0) {
+		return;
+	}
+	printf("hle: %d calls on the host, %d left to the guest\n", (int)Hle_var_calls, (int)Hle_var_declined);
+	for (uint32 i = 0; i < Hle_var_count; i++) {
+		Hle_entry* entry = &Hle_var_entries[i];
+		if (entry->calls == 0) {
+			continue;
+		}
+		printf("hle: %-18s 0x%08x %10d calls, %.1f + %.3f * work cycles\n", entry->func->name, (int)entry->addr,
+			(int)entry->calls, entry->a, entry->b);
+	}
+}
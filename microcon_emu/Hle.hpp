@@ -0,0 +1,83 @@
+#pragma once
+#include "Proxy.hpp"
+#include "Memory.hpp"
+#include "CPU.hpp"
+
+/*
+* high level emulation of libgcc / newlib helpers
+*
+* soft-float and 64 bit division helpers are hundreds of guest instructions per call, printf far more.
+* when the elf (MICROCON_EMU_ELF, same as coverage) names one of them, a call to its entry runs a host
+* implementation instead and returns straight to lr:
+* - soft-float (__aeabi_fadd ~ __aeabi_ddiv, compares, conversions): host float / double. both are ieee 754
+*   with round to nearest even, so results are the same bits. nans (in or out) and conversions out of range
+*   are left to the guest, libgcc has its own rules there.
+* - integer division (__aeabi_uidiv ~ __aeabi_ldivmod). division by zero is left to the guest (__aeabi_idiv0).
+* - memcpy / memset / strlen (and __aeabi_memcpy / __aeabi_memset) on plain memory.
+* - vsnprintf: the format is walked here, every conversion is printed by the host with guest argument sizes
+*   (int / long 32 bit, long long / double 64 bit and 8 byte aligned on the va_list). %f / %e / %g only if the
+*   image links newlib's float printf (_dtoa_r or _printf_float in the symbol table). %n, %a, positional
+*   arguments, wide chars, NULL strings and nans are left to the guest.
+* only r0 ~ r3 that carry results are written. the other caller-saved registers and the flags keep their
+* values, the abi says the caller doesn't look at them.
+*
+* cycles (calibrated per helper):
+* - the first HLE_CALIBRATE calls of each helper run in the guest, from entry to the return to lr with the same sp.
+*   each one is a sample of (work, cycles), work being 0, the byte count (memcpy / memset) or the result
+*   (strlen / vsnprintf).
+* - after that every call costs a + b * work, fitted to the samples by least squares.
+*   an interrupt taken during a sample counts into it.
+* so a run with hle gives the same results, and cycle counts close to (not equal to) a run without it.
+*
+* limits:
+* - calls that come in through a branch to the entry (bl, blx, b as a tail call). a block that falls through
+*   into an entry runs it in the guest.
+* - float helpers need a host that evaluates float / double in their own precision (FLT_EVAL_METHOD 0, sse).
+*   x87 builds keep them in the guest.
+* - helpers touching memory need the mpu off and every buffer inside one plain section.
+* - MICROCON_EMU_HLE=0 turns it off.
+*/
+
+#define HLE_ENV "MICROCON_EMU_HLE"
+#define HLE_MAX_ENTRIES 64
+#define HLE_CALIBRATE 16	// guest samples per helper
+#define HLE_PRINTF_MAX 0x1000	// longest vsnprintf output done on the host
+
+// what the cost of a call scales with
+enum Hle_work_enum {
+	HLE_WORK_NONE = 0,
+	HLE_WORK_SIZE,	// r2 at entry
+	HLE_WORK_RESULT	// r0 at return
+};
+
+struct Hle_entry {
+	uint32 addr;	// entry, thumb bit cleared
+	const struct Hle_func* func;
+	uint32 samples;
+	double sw, sc, sww, swc;	// sums over the samples: work, cycles, work^2, work * cycles
+	double a, b;	// cost = a + b * work
+	uint32 calls;	// done on the host
+};
+
+extern uint32 Hle_var_enabled;
+extern uint32 Hle_var_count;
+extern uint32 Hle_var_lo, Hle_var_hi;	// entry range, for a cheap test
+extern struct Hle_entry* Hle_var_pending;	// calibration sample in flight
+
+// telemetry
+extern uint32 Hle_var_calls;
+extern uint32 Hle_var_declined;
+
+// read the helpers out of MICROCON_EMU_ELF. after Memory_init
+extern void Hle_init();
+
+// pc is at a helper entry: run it and return to lr. returns the guest cycles charged, 0 if the guest has to run it
+#define HLE_TEST(pc) (Hle_var_count != 0 && (pc) >= Hle_var_lo && (pc) <= Hle_var_hi)
+extern uint32 Hle_call(CPU_struct_reg* reg);
+
+// after every block: close a calibration sample when it returned
+#define HLE_AFTER(reg) if (Hle_var_pending != NULL) Hle_return(reg)
+extern void Hle_return(CPU_struct_reg* reg);
+
+// per helper calls and cost
+extern void Hle_dump();
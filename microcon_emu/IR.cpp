@@ -0,0 +1,1795 @@
+#include "IR.hpp"
+#include "CPU_Instructions.hpp"
+#include "Jit.hpp"
+#include "Fastmem.hpp"
+#include "Fault.hpp"
+
+uint32 IR_var_temps[IR_MAX_INST];
+uint32 IR_var_retired = 0;
+uint32 IR_var_elapsed = 0;
+
+// uint32 is a long, which is 64bit on lp64 hosts. wrap alu results back to 32bit
+#define IR_W(x) ((uint32)(uint32_t)(x))
+
+/*
+* helpers (shared with the jit)
+*/
+
+static uint32 IR_shift(uint32 shiftop, uint32 value, uint32 amount) {
+	amount &= 0xFF;
+	switch (shiftop) {
+	case IR_LSL:
+		return (amount >= 32) ? 0 : IR_W(value << amount);
+	case IR_LSR:
+		return (amount >= 32) ? 0 : IR_W(value >> amount);
+	case IR_ASR:
+		if (amount >= 32) {
+			amount = 31;
+		}
+		return IR_W((int32_t)value >> amount);
+	case IR_ROR:
+		amount &= 0x1F;
+		return (amount == 0) ? value : IR_W((value >> amount) | (value << (32 - amount)));
+	default:
+		break;
+	}
+	return value;
+}
+
+// carry out of a shift, amount must not be 0
+static uint32 IR_shiftcarry(uint32 shiftop, uint32 value, uint32 amount) {
+	amount &= 0xFF;
+	switch (shiftop) {
+	case IR_LSL:
+		return (amount > 32) ? 0 : (value >> (32 - amount)) & 0x1;
+	case IR_LSR:
+		return (amount > 32) ? 0 : (value >> (amount - 1)) & 0x1;
+	case IR_ASR:
+		return (amount >= 32) ? (value >> 31) & 0x1 : (value >> (amount - 1)) & 0x1;
+	case IR_ROR:
+		return (IR_shift(IR_ROR, value, amount) >> 31) & 0x1;
+	default:
+		break;
+	}
+	return 0;
+}
+
+uint32 IR_alu(uint32 op, uint32 a, uint32 b, uint32 c) {
+	switch (op) {
+	case IR_ADD: return IR_W(a + b);
+	case IR_SUB: return IR_W(a - b);
+	case IR_AND: return a & b;
+	case IR_OR: return a | b;
+	case IR_XOR: return a ^ b;
+	case IR_BIC: return IR_W(a & ~b);
+	case IR_MUL: return IR_W(a * b);
+	case IR_LSL:
+	case IR_LSR:
+	case IR_ASR:
+	case IR_ROR:
+		return IR_shift(op, a, b);
+	case IR_ADC: return IR_W(a + b + c);
+	case IR_SBC: return IR_W(a + IR_W(~b) + c);
+	case IR_NOT: return IR_W(~a);
+	default:
+		break;
+	}
+	return 0;
+}
+
+static void IR_do_setflags(CPU_struct_reg* reg, uint32 op, uint32 mask, uint32 a, uint32 b, uint32 c, uint32 shiftop) {
+	uint32 result = a;
+	uint32 carry = 0;
+	uint32 overflow = 0;
+
+	switch (op) {
+	case IR_FLAGS_ADD:
+		// AddWithCarry(a, b, c)
+		result = IR_W(a + b + c);
+		carry = c ? (result <= a) : (result < a);
+		overflow = (IR_W(~(a ^ b) & (a ^ result)) >> 31) & 0x1;
+		break;
+	case IR_FLAGS_SUB:
+		// AddWithCarry(a, ~b, c)
+		b = IR_W(~b);
+		result = IR_W(a + b + c);
+		carry = c ? (result <= a) : (result < a);
+		overflow = (IR_W(~(a ^ b) & (a ^ result)) >> 31) & 0x1;
+		break;
+	case IR_FLAGS_NZ:
+		break;
+	case IR_FLAGS_SHIFTC:
+		if ((b & 0xFF) == 0) {
+			return;	// shift by 0 keeps c
+		}
+		reg->xPSR.APSR.C = IR_shiftcarry(shiftop, a, b);
+		return;
+	default:
+		return;
+	}
+
+	if (mask & IR_FLAG_N) reg->xPSR.APSR.N = (result >> 31) & 0x1;
+	if (mask & IR_FLAG_Z) reg->xPSR.APSR.Z = (result == 0);
+	if (mask & IR_FLAG_C) reg->xPSR.APSR.C = carry;
+	if (mask & IR_FLAG_V) reg->xPSR.APSR.V = overflow;
+}
+
+void IR_setflags(uint32 desc, uint32 a, uint32 b, uint32 c) {
+	IR_do_setflags(CPU_var_reg, desc & 0xFF, (desc >> 8) & 0xFF, a, b, c, (desc >> 16) & 0xFF);
+}
+
+// ConditionPassed()
+static uint32 IR_do_cond(CPU_struct_reg* reg, uint32 cond) {
+	uint32 n = reg->xPSR.APSR.N;
+	uint32 z = reg->xPSR.APSR.Z;
+	uint32 c = reg->xPSR.APSR.C;
+	uint32 v = reg->xPSR.APSR.V;
+	uint32 result;
+
+	switch (cond >> 1) {
+	case 0: result = z; break;					// eq
+	case 1: result = c; break;					// cs
+	case 2: result = n; break;					// mi
+	case 3: result = v; break;					// vs
+	case 4: result = c && !z; break;			// hi
+	case 5: result = (n == v); break;			// ge
+	case 6: result = (n == v) && !z; break;		// gt
+	default: return 1;							// al
+	}
+
+	if ((cond & 0x1) && cond != 0xF) {
+		result = !result;
+	}
+	return result;
+}
+
+uint32 IR_cond(uint32 cond) {
+	return IR_do_cond(CPU_var_reg, cond);
+}
+
+static void IR_do_interp(CPU_struct_reg* reg, uint32 op, uint32 instr, uint32 pc, uint32 length) {
+	reg->R[15] = pc;
+	CPU_ExecuteInstruction((CPU_op_enum)op, instr, reg);
+
+	// handler did not branch -> next instruction
+	if (reg->R[15] == pc) {
+		reg->R[15] = pc + length;
+	}
+}
+
+void IR_interp(uint32 op, uint32 instr, uint32 pc, uint32 length) {
+	IR_do_interp(CPU_var_reg, op, instr, pc, length);
+}
+
+/*
+* lowering
+*/
+
+static uint32 IR_var_pc = 0;		// guest instruction being lowered
+static uint32 IR_var_cycles = 0;	// guest cycles so far in this block
+static uint32 IR_var_lsu = 0;	// of which extra load / store cycles
+
+static IR_inst* IR_new(IR_block* block, uint32 op) {
+	m_assert(block->count < IR_MAX_INST, "ir: block overflow\n");
+	IR_inst* inst = &block->inst[block->count++];
+	memset(inst, 0, sizeof(IR_inst));
+	inst->op = (uint8)op;
+	inst->t = inst->a = inst->b = inst->c = IR_NOTEMP;
+	inst->pc = IR_var_pc;
+	inst->instrs = block->guest_count + 1;	// up to and including the one being lowered
+	inst->cycles = IR_var_cycles;	// exits set their own
+	inst->lsu = IR_var_lsu;
+	return inst;
+}
+
+// a load / store takes 'cycles' more than its first
+static void IR_lsucycles(uint32 cycles) {
+	IR_var_cycles += cycles;
+	IR_var_lsu += cycles;
+}
+
+static uint32 IR_newtemp(IR_block* block, IR_inst* inst) {
+	inst->t = block->ntemps++;
+	return inst->t;
+}
+
+static uint32 IR_const(IR_block* block, uint32 value) {
+	IR_inst* inst = IR_new(block, IR_CONST);
+	inst->imm = value;
+	return IR_newtemp(block, inst);
+}
+
+static uint32 IR_getreg(IR_block* block, uint32 r) {
+	if (r == 15) {
+		// reading pc gives the instruction address + 4
+		return IR_const(block, IR_var_pc + 4);
+	}
+	IR_inst* inst = IR_new(block, IR_GETREG);
+	inst->reg = (uint8)r;
+	return IR_newtemp(block, inst);
+}
+
+static void IR_setreg(IR_block* block, uint32 r, uint32 t) {
+	IR_inst* inst = IR_new(block, IR_SETREG);
+	inst->reg = (uint8)r;
+	inst->a = t;
+}
+
+static uint32 IR_op(IR_block* block, uint32 op, uint32 a, uint32 b, uint32 c = IR_NOTEMP) {
+	IR_inst* inst = IR_new(block, op);
+	inst->a = a;
+	inst->b = b;
+	inst->c = c;
+	return IR_newtemp(block, inst);
+}
+
+static void IR_flags(IR_block* block, uint32 op, uint32 mask, uint32 a, uint32 b = IR_NOTEMP, uint32 c = IR_NOTEMP) {
+	IR_inst* inst = IR_new(block, op);
+	inst->flags = (uint8)mask;
+	inst->a = a;
+	inst->b = b;
+	inst->c = c;
+}
+
+// carry out of a shift. an immediate amount is never 0 here, so it always writes c
+static void IR_shiftc(IR_block* block, uint32 shiftop, uint32 a, uint32 amount, uint32 isimm) {
+	IR_inst* inst = IR_new(block, IR_FLAGS_SHIFTC);
+	inst->flags = IR_FLAG_C;
+	inst->size = (uint8)shiftop;
+	inst->a = a;
+	if (isimm) {
+		inst->bimm = 1;
+		inst->imm = amount;
+	}
+	else {
+		inst->b = amount;
+	}
+}
+
+static uint32 IR_load(IR_block* block, uint32 sizetype, uint32 sign, uint32 addr) {
+	IR_inst* inst = IR_new(block, IR_LOAD);
+	inst->size = (uint8)sizetype;
+	inst->sign = (uint8)sign;
+	inst->a = addr;
+	return IR_newtemp(block, inst);
+}
+
+static void IR_store(IR_block* block, uint32 sizetype, uint32 addr, uint32 value) {
+	IR_inst* inst = IR_new(block, IR_STORE);
+	inst->size = (uint8)sizetype;
+	inst->a = addr;
+	inst->b = value;
+}
+
+static void IR_exit(IR_block* block, uint32 pc, uint32 cycles) {
+	IR_inst* inst = IR_new(block, IR_EXIT);
+	inst->imm = pc;
+	inst->cycles = cycles;
+}
+
+static void IR_branch(IR_block* block, uint32 t, uint32 cycles) {
+	IR_inst* inst = IR_new(block, IR_BRANCH);
+	inst->a = t;
+	inst->cycles = cycles;
+}
+
+static void IR_bcond(IR_block* block, uint32 cond, uint32 pc, uint32 cycles) {
+	IR_inst* inst = IR_new(block, IR_BCOND);
+	inst->size = (uint8)cond;
+	inst->imm = pc;
+	inst->cycles = cycles;
+}
+
+// LDMIA / STMIA: one word per register from the lowest address up, then the writeback. 1 + N cycles
+static void IR_multiple(IR_block* block, uint32 load, uint32 rn, uint32 list, uint32 wback) {
+	uint32 base = IR_getreg(block, rn);
+	uint32 offset = 0;
+
+	for (uint32 r = 0; r < 16; r++) {
+		if (!((list >> r) & 0x1)) {
+			continue;
+		}
+		uint32 addr = IR_op(block, IR_ADD, base, IR_const(block, offset));
+		if (load) {
+			IR_setreg(block, r, IR_load(block, Memory_enum_size::u32, 0, addr));
+		}
+		else {
+			IR_store(block, Memory_enum_size::u32, addr, IR_getreg(block, r));
+		}
+		offset += 4;
+	}
+	IR_lsucycles(offset >> 2);
+	if (wback) {
+		IR_setreg(block, rn, IR_op(block, IR_ADD, base, IR_const(block, offset)));
+	}
+}
+
+static uint32 IR_interpret(IR_block* block, uint32 op, uint32 instr, uint32 length) {
+	IR_inst* inst = IR_new(block, IR_INTERP);
+	inst->a = op;
+	inst->b = length;
+	inst->imm = instr;
+	inst->cycles = IR_var_cycles;
+	return 1;
+}
+
+// BranchWritePC / ALUWritePC
+static uint32 IR_writepc(IR_block* block, uint32 t) {
+	IR_branch(block, IR_op(block, IR_BIC, t, IR_const(block, 0x1)), IR_var_cycles + 2);
+	return 1;
+}
+
+static uint32 IR_fetch16(uint32 addr) {
+	uint8* data = (uint8*)Memory_read(addr, Memory_enum_size::u16, MEMORY_ATTRIB_S_X);
+	if (data == NULL) {
+		return IR_NOTEMP;
+	}
+	return data[0] | (data[1] << 8);
+}
+
+// 16bit thumb. returns 1 if the block ends here
+static uint32 IR_lower16(IR_block* block, uint32 hw, uint32 setflags) {
+	uint32 pc = IR_var_pc;
+	uint32 t, a, b, c;
+
+	IR_var_cycles += 1;
+
+	// shift (immediate), add, subtract, move, compare
+	if ((hw >> 14) == 0x0) {
+		uint32 opc = (hw >> 11) & 0x7;
+		uint32 rd = hw & 0x7;
+		uint32 rn = (hw >> 3) & 0x7;
+
+		if (opc < 3) {
+			// LSL / LSR / ASR (immediate)
+			uint32 imm5 = (hw >> 6) & 0x1F;
+			a = IR_getreg(block, rn);
+			if (opc == 0 && imm5 == 0) {
+				// MOV (register) T2
+				IR_setreg(block, rd, a);
+				if (setflags) {
+					IR_flags(block, IR_FLAGS_NZ, IR_FLAG_NZ, a);
+				}
+				return 0;
+			}
+			uint32 shiftop = (opc == 0) ? IR_LSL : (opc == 1) ? IR_LSR : IR_ASR;
+			uint32 amount = (imm5 == 0) ? 32 : imm5;
+			t = IR_op(block, shiftop, a, IR_const(block, amount));
+			IR_setreg(block, rd, t);
+			if (setflags) {
+				IR_flags(block, IR_FLAGS_NZ, IR_FLAG_NZ, t);
+				IR_shiftc(block, shiftop, a, amount, 1);
+			}
+			return 0;
+		}
+		if (opc == 3) {
+			// ADD / SUB (register, 3bit immediate)
+			uint32 sub = (hw >> 9) & 0x1;
+			a = IR_getreg(block, rn);
+			b = (hw & 0x400) ? IR_const(block, (hw >> 6) & 0x7) : IR_getreg(block, (hw >> 6) & 0x7);
+			t = IR_op(block, sub ? IR_SUB : IR_ADD, a, b);
+			IR_setreg(block, rd, t);
+			if (setflags) {
+				IR_flags(block, sub ? IR_FLAGS_SUB : IR_FLAGS_ADD, IR_FLAG_NZCV, a, b);
+			}
+			return 0;
+		}
+
+		// MOV / CMP / ADD / SUB (8bit immediate)
+		uint32 rdn = (hw >> 8) & 0x7;
+		b = IR_const(block, hw & 0xFF);
+		switch (opc) {
+		case 4:
+			IR_setreg(block, rdn, b);
+			if (setflags) {
+				IR_flags(block, IR_FLAGS_NZ, IR_FLAG_NZ, b);
+			}
+			break;
+		case 5:
+			IR_flags(block, IR_FLAGS_SUB, IR_FLAG_NZCV, IR_getreg(block, rdn), b);
+			break;
+		case 6:
+		case 7:
+			a = IR_getreg(block, rdn);
+			t = IR_op(block, (opc == 6) ? IR_ADD : IR_SUB, a, b);
+			IR_setreg(block, rdn, t);
+			if (setflags) {
+				IR_flags(block, (opc == 6) ? IR_FLAGS_ADD : IR_FLAGS_SUB, IR_FLAG_NZCV, a, b);
+			}
+			break;
+		}
+		return 0;
+	}
+
+	// data processing
+	if ((hw >> 10) == 0x10) {
+		uint32 opc = (hw >> 6) & 0xF;
+		uint32 rdn = hw & 0x7;
+		uint32 rm = (hw >> 3) & 0x7;
+		a = IR_getreg(block, rdn);
+		b = IR_getreg(block, rm);
+
+		switch (opc) {
+		case 0x0:	// AND
+		case 0x1:	// EOR
+		case 0xC:	// ORR
+		case 0xE:	// BIC
+		case 0xD:	// MUL
+			t = IR_op(block, (opc == 0x0) ? IR_AND : (opc == 0x1) ? IR_XOR : (opc == 0xC) ? IR_OR : (opc == 0xE) ? IR_BIC : IR_MUL, a, b);
+			IR_setreg(block, rdn, t);
+			if (setflags) {
+				IR_flags(block, IR_FLAGS_NZ, IR_FLAG_NZ, t);
+			}
+			break;
+		case 0xF:	// MVN
+			t = IR_op(block, IR_NOT, b, IR_NOTEMP);
+			IR_setreg(block, rdn, t);
+			if (setflags) {
+				IR_flags(block, IR_FLAGS_NZ, IR_FLAG_NZ, t);
+			}
+			break;
+		case 0x2:	// LSL
+		case 0x3:	// LSR
+		case 0x4:	// ASR
+		case 0x7: {	// ROR
+			uint32 shiftop = (opc == 0x2) ? IR_LSL : (opc == 0x3) ? IR_LSR : (opc == 0x4) ? IR_ASR : IR_ROR;
+			t = IR_op(block, shiftop, a, b);
+			IR_setreg(block, rdn, t);
+			if (setflags) {
+				IR_flags(block, IR_FLAGS_NZ, IR_FLAG_NZ, t);
+				IR_shiftc(block, shiftop, a, b, 0);
+			}
+			break;
+		}
+		case 0x5:	// ADC
+		case 0x6:	// SBC
+			c = IR_op(block, IR_GETC, IR_NOTEMP, IR_NOTEMP);
+			t = IR_op(block, (opc == 0x5) ? IR_ADC : IR_SBC, a, b, c);
+			IR_setreg(block, rdn, t);
+			if (setflags) {
+				IR_flags(block, (opc == 0x5) ? IR_FLAGS_ADD : IR_FLAGS_SUB, IR_FLAG_NZCV, a, b, c);
+			}
+			break;
+		case 0x8:	// TST
+			IR_flags(block, IR_FLAGS_NZ, IR_FLAG_NZ, IR_op(block, IR_AND, a, b));
+			break;
+		case 0x9:	// RSB #0
+			a = IR_const(block, 0);
+			t = IR_op(block, IR_SUB, a, b);
+			IR_setreg(block, rdn, t);
+			if (setflags) {
+				IR_flags(block, IR_FLAGS_SUB, IR_FLAG_NZCV, a, b);
+			}
+			break;
+		case 0xA:	// CMP
+			IR_flags(block, IR_FLAGS_SUB, IR_FLAG_NZCV, a, b);
+			break;
+		case 0xB:	// CMN
+			IR_flags(block, IR_FLAGS_ADD, IR_FLAG_NZCV, a, b);
+			break;
+		}
+		return 0;
+	}
+
+	// special data instructions and branch and exchange
+	if ((hw >> 10) == 0x11) {
+		uint32 opc = (hw >> 8) & 0x3;
+		uint32 rdn = ((hw >> 4) & 0x8) | (hw & 0x7);
+		uint32 rm = (hw >> 3) & 0xF;
+
+		switch (opc) {
+		case 0:	// ADD (register)
+			t = IR_op(block, IR_ADD, IR_getreg(block, rdn), IR_getreg(block, rm));
+			if (rdn == 15) {
+				return IR_writepc(block, t);
+			}
+			IR_setreg(block, rdn, t);
+			return 0;
+		case 1:	// CMP (register)
+			IR_flags(block, IR_FLAGS_SUB, IR_FLAG_NZCV, IR_getreg(block, rdn), IR_getreg(block, rm));
+			return 0;
+		case 2:	// MOV (register)
+			t = IR_getreg(block, rm);
+			if (rdn == 15) {
+				return IR_writepc(block, t);
+			}
+			IR_setreg(block, rdn, t);
+			return 0;
+		default:	// BX / BLX. EXC_RETURN keeps its top nibble through the bic, CPU_step takes it after the block
+			t = IR_getreg(block, rm);
+			if (hw & 0x80) {
+				IR_setreg(block, 14, IR_const(block, (pc + 2) | 0x1));
+			}
+			return IR_writepc(block, t);
+		}
+	}
+
+	// LDR (literal)
+	if ((hw >> 11) == 0x9) {
+		IR_lsucycles(1);
+		t = IR_load(block, Memory_enum_size::u32, 0, IR_const(block, ((pc + 4) & ~0x3) + ((hw & 0xFF) << 2)));
+		IR_setreg(block, (hw >> 8) & 0x7, t);
+		return 0;
+	}
+
+	// load/store single (register offset)
+	if ((hw >> 12) == 0x5) {
+		static const uint8 sizes[8] = { Memory_enum_size::u32, Memory_enum_size::u16, Memory_enum_size::u8, Memory_enum_size::u8,
+			Memory_enum_size::u32, Memory_enum_size::u16, Memory_enum_size::u8, Memory_enum_size::u16 };
+		uint32 opb = (hw >> 9) & 0x7;
+		uint32 rt = hw & 0x7;
+		a = IR_op(block, IR_ADD, IR_getreg(block, (hw >> 3) & 0x7), IR_getreg(block, (hw >> 6) & 0x7));
+		if (opb < 3) {
+			IR_store(block, sizes[opb], a, IR_getreg(block, rt));
+		}
+		else {
+			IR_lsucycles(1);
+			IR_setreg(block, rt, IR_load(block, sizes[opb], (opb == 3 || opb == 7), a));
+		}
+		return 0;
+	}
+
+	// load/store single (immediate offset): word/byte, halfword, sp relative
+	if ((hw >> 13) == 0x3 || (hw >> 12) == 0x8 || (hw >> 12) == 0x9) {
+		uint32 load = (hw >> 11) & 0x1;
+		uint32 sizetype;
+		uint32 rt, offset;
+
+		if ((hw >> 12) == 0x9) {
+			sizetype = Memory_enum_size::u32;
+			rt = (hw >> 8) & 0x7;
+			offset = (hw & 0xFF) << 2;
+			a = IR_getreg(block, 13);
+		}
+		else {
+			sizetype = ((hw >> 12) == 0x8) ? Memory_enum_size::u16 : ((hw >> 12) & 0x1) ? Memory_enum_size::u8 : Memory_enum_size::u32;
+			rt = hw & 0x7;
+			offset = ((hw >> 6) & 0x1F) << sizetype;
+			a = IR_getreg(block, (hw >> 3) & 0x7);
+		}
+		a = IR_op(block, IR_ADD, a, IR_const(block, offset));
+
+		if (load) {
+			IR_lsucycles(1);
+			IR_setreg(block, rt, IR_load(block, sizetype, 0, a));
+		}
+		else {
+			IR_store(block, sizetype, a, IR_getreg(block, rt));
+		}
+		return 0;
+	}
+
+	// ADR
+	if ((hw >> 11) == 0x14) {
+		IR_setreg(block, (hw >> 8) & 0x7, IR_const(block, ((pc + 4) & ~0x3) + ((hw & 0xFF) << 2)));
+		return 0;
+	}
+
+	// ADD (sp plus immediate)
+	if ((hw >> 11) == 0x15) {
+		IR_setreg(block, (hw >> 8) & 0x7, IR_op(block, IR_ADD, IR_getreg(block, 13), IR_const(block, (hw & 0xFF) << 2)));
+		return 0;
+	}
+
+	// miscellaneous
+	if ((hw >> 12) == 0xB) {
+		if ((hw >> 8) == 0xB0) {
+			// ADD / SUB (sp plus/minus immediate)
+			t = IR_op(block, (hw & 0x80) ? IR_SUB : IR_ADD, IR_getreg(block, 13), IR_const(block, (hw & 0x7F) << 2));
+			IR_setreg(block, 13, t);
+			return 0;
+		}
+		if ((hw >> 8) == 0xB2) {
+			// SXTH / SXTB / UXTH / UXTB
+			uint32 opc = (hw >> 6) & 0x3;
+			a = IR_getreg(block, (hw >> 3) & 0x7);
+			if (opc & 0x2) {
+				t = IR_op(block, IR_AND, a, IR_const(block, (opc & 0x1) ? 0xFF : 0xFFFF));
+			}
+			else {
+				uint32 amount = (opc & 0x1) ? 24 : 16;
+				t = IR_op(block, IR_ASR, IR_op(block, IR_LSL, a, IR_const(block, amount)), IR_const(block, amount));
+			}
+			IR_setreg(block, hw & 0x7, t);
+			return 0;
+		}
+		if ((hw & 0xF500) == 0xB100) {
+			// CBZ / CBNZ without touching the flags: nz = (r | -r) >> 31 picks one of the two targets.
+			// the exit costs the same taken or not
+			uint32 taken = pc + 4 + ((((hw >> 9) & 0x1) << 6) | (((hw >> 3) & 0x1F) << 1));
+			uint32 next = pc + 2;
+			a = IR_getreg(block, hw & 0x7);
+			uint32 nz = IR_op(block, IR_LSR, IR_op(block, IR_OR, a, IR_op(block, IR_SUB, IR_const(block, 0), a)), IR_const(block, 31));
+			if (hw & 0x800) {
+				t = IR_op(block, IR_ADD, IR_const(block, next), IR_op(block, IR_MUL, nz, IR_const(block, IR_W(taken - next))));
+			}
+			else {
+				t = IR_op(block, IR_ADD, IR_const(block, taken), IR_op(block, IR_MUL, nz, IR_const(block, IR_W(next - taken))));
+			}
+			IR_branch(block, t, IR_var_cycles + 1);
+			return 1;
+		}
+		if ((hw >> 9) == 0x5A) {
+			return IR_interpret(block, PUSH, hw, 2);
+		}
+		if ((hw >> 9) == 0x5E) {
+			return IR_interpret(block, POP, hw, 2);
+		}
+		if ((hw >> 8) == 0xBA) {
+			uint32 opc = (hw >> 6) & 0x3;
+			return IR_interpret(block, (opc == 0) ? REV : (opc == 1) ? REV16 : (opc == 3) ? REVSH : UDF, hw, 2);
+		}
+		if ((hw >> 8) == 0xBE) {
+			return IR_interpret(block, BKPT, hw, 2);
+		}
+		if ((hw >> 8) == 0xBF) {
+			if (hw & 0xF) {
+				return IR_interpret(block, IT, hw, 2);
+			}
+			switch ((hw >> 4) & 0xF) {
+			case 0: return 0;	// NOP
+			case 1: return IR_interpret(block, YIELD, hw, 2);
+			case 2: return IR_interpret(block, WFE, hw, 2);
+			case 3: return IR_interpret(block, WFI, hw, 2);
+			case 4: return IR_interpret(block, SEV, hw, 2);
+			default: return 0;	// unallocated hints execute as NOP
+			}
+		}
+		if ((hw & 0xFFE8) == 0xB660) {
+			return IR_interpret(block, CPS, hw, 2);
+		}
+		return IR_interpret(block, UDF, hw, 2);
+	}
+
+	// STM / LDM: writeback unless ldm loads the base
+	if ((hw >> 12) == 0xC) {
+		uint32 list = hw & 0xFF;
+		uint32 rn = (hw >> 8) & 0x7;
+		if (list == 0) {
+			return IR_interpret(block, (hw & 0x800) ? LDM_LDMIA_LDMFD : STM_STMIA_STMEA, hw, 2);
+		}
+		IR_multiple(block, (hw >> 11) & 0x1, rn, list, !(hw & 0x800) || !((list >> rn) & 0x1));
+		return 0;
+	}
+
+	// conditional branch, UDF, SVC
+	if ((hw >> 12) == 0xD) {
+		uint32 cond = (hw >> 8) & 0xF;
+		if (cond == 0xE) {
+			return IR_interpret(block, UDF, hw, 2);
+		}
+		if (cond == 0xF) {
+			return IR_interpret(block, SVC, hw, 2);
+		}
+		uint32 imm32 = IR_W((uint32)((int32_t)((hw & 0xFF) << 24) >> 23));
+		IR_bcond(block, cond, IR_W(pc + 4 + imm32), IR_var_cycles + 2);
+		return 0;	// not taken falls through, keep going
+	}
+
+	// B (unconditional)
+	if ((hw >> 11) == 0x1C) {
+		uint32 imm32 = IR_W((uint32)((int32_t)((hw & 0x7FF) << 21) >> 20));
+		IR_exit(block, IR_W(pc + 4 + imm32), IR_var_cycles + 2);
+		return 1;
+	}
+
+	return IR_interpret(block, UDF, hw, 2);
+}
+
+/*
+* thumb2 data processing (modified immediate / shifted register)
+* written once, specialized at compile time: a body per op and setflags (IR_dp<op, s>), an operand 2 per form
+* (IR_operand2<form>). the decoder picks both out of tables, so a variant has no tests on encoding bits left,
+* and the s=0 variants never emit flag work.
+* rd / rn = sp is only taken for add / sub (sp arithmetic), pc only as the rd of a compare. the rest, and rrx,
+* go to the handlers.
+*/
+
+// op field (hw1 bits 5 ~ 8), then the ones told apart by rn = pc / rd = pc with s
+enum IR_dp_enum {
+	IR_DP_AND = 0x0,
+	IR_DP_BIC = 0x1,
+	IR_DP_ORR = 0x2,
+	IR_DP_ORN = 0x3,
+	IR_DP_EOR = 0x4,
+	IR_DP_ADD = 0x8,
+	IR_DP_ADC = 0xA,
+	IR_DP_SBC = 0xB,
+	IR_DP_SUB = 0xD,
+	IR_DP_RSB = 0xE,
+	IR_DP_MOV = 0x10,	// orr, rn = pc
+	IR_DP_MVN,			// orn, rn = pc
+	IR_DP_TST,			// and, rd = pc, s
+	IR_DP_TEQ,			// eor, rd = pc, s
+	IR_DP_CMN,			// add, rd = pc, s
+	IR_DP_CMP,			// sub, rd = pc, s
+	IR_DP_NUMBER_OF_OPS
+};
+
+enum IR_operand2_enum {
+	IR_OPERAND2_IMM = 0,	// ThumbExpandImm
+	IR_OPERAND2_LSL,		// the rest: rm shifted by imm5, in shift type order
+	IR_OPERAND2_LSR,
+	IR_OPERAND2_ASR,
+	IR_OPERAND2_ROR,
+	IR_NUMBER_OF_OPERAND2
+};
+
+// operand 2 and how to get the shifter carry out of it (shiftop IR_NOP: c unchanged)
+struct IR_operand2_t {
+	uint32 t;
+	uint32 shiftop;
+	uint32 src;
+	uint32 amount;
+};
+
+template<uint32 FORM>
+static void IR_operand2(IR_block* block, uint32 instr, IR_operand2_t* op2) {
+	op2->shiftop = IR_NOP;
+	if (FORM == IR_OPERAND2_IMM) {
+		// ThumbExpandImm_C
+		uint32 imm12 = (((instr >> 26) & 0x1) << 11) | (((instr >> 12) & 0x7) << 8) | (instr & 0xFF);
+		uint32 imm8 = imm12 & 0xFF;
+		if ((imm12 >> 10) == 0) {
+			switch ((imm12 >> 8) & 0x3) {
+			case 0: op2->t = IR_const(block, imm8); break;
+			case 1: op2->t = IR_const(block, (imm8 << 16) | imm8); break;
+			case 2: op2->t = IR_const(block, (imm8 << 24) | (imm8 << 8)); break;
+			default: op2->t = IR_const(block, (imm8 << 24) | (imm8 << 16) | (imm8 << 8) | imm8); break;
+			}
+			return;
+		}
+		uint32 unrotated = 0x80 | (imm12 & 0x7F);
+		uint32 rotation = imm12 >> 7;	// 8 ~ 31
+		op2->t = IR_const(block, IR_W((unrotated >> rotation) | (unrotated << (32 - rotation))));
+		op2->shiftop = IR_ROR;
+		op2->src = IR_const(block, unrotated);
+		op2->amount = rotation;
+		return;
+	}
+
+	// DecodeImmShift. ror #0 is rrx, the decoder does not get here with it
+	static const uint32 shiftops[IR_NUMBER_OF_OPERAND2] = { IR_NOP, IR_LSL, IR_LSR, IR_ASR, IR_ROR };
+	uint32 imm5 = (((instr >> 12) & 0x7) << 2) | ((instr >> 6) & 0x3);
+	uint32 amount = (imm5 == 0 && FORM != IR_OPERAND2_LSL) ? 32 : imm5;
+	uint32 rm = IR_getreg(block, instr & 0xF);
+	if (amount == 0) {
+		op2->t = rm;
+		return;
+	}
+	op2->t = IR_op(block, shiftops[FORM], rm, IR_const(block, amount));
+	op2->shiftop = shiftops[FORM];
+	op2->src = rm;
+	op2->amount = amount;
+}
+
+typedef void (*IR_operand2_func)(IR_block* block, uint32 instr, IR_operand2_t* op2);
+static const IR_operand2_func IR_var_operand2[IR_NUMBER_OF_OPERAND2] = {
+	IR_operand2<IR_OPERAND2_IMM>, IR_operand2<IR_OPERAND2_LSL>, IR_operand2<IR_OPERAND2_LSR>,
+	IR_operand2<IR_OPERAND2_ASR>, IR_operand2<IR_OPERAND2_ROR>,
+};
+
+// handler for what is not lowered: { immediate, register }
+static const uint8 IR_var_dp_handler[IR_DP_NUMBER_OF_OPS][2] = {
+	{ AND_IMMEDIATE, AND_REGISTER }, { BIC_IMMEDIATE, BIC_REGISTER }, { ORR_IMMEDIATE, ORR_REGISTER }, { ORN_IMMEDIATE, ORN_REGISTER },
+	{ EOR_IMMEDIATE, EOR_REGISTER }, { UDF, UDF }, { UDF, PKHBT_PKHTB }, { UDF, UDF },
+	{ ADD_IMMEDIATE, ADD_REGISTER }, { UDF, UDF }, { ADC_IMMEDIATE, ADC_REGISTER }, { SBC_IMMEDIATE, SBC_REGISTER },
+	{ UDF, UDF }, { SUB_IMMEDIATE, SUB_REGISTER }, { RSB_IMMEDIATE, RSB_REGISTER }, { UDF, UDF },
+	{ MOV_IMMEDIATE, MOV_REGISTER }, { MVN_IMMEDIATE, MVN_REGISTER }, { TST_IMMEDIATE, TST_REGISTER }, { TEQ_IMMEDIATE, TEQ_REGISTER },
+	{ CMN_IMMEDIATE, CMN_REGISTER }, { CMP_IMMEDIATE, CMP_REGISTER },
+};
+
+template<uint32 OP, uint32 S>
+static uint32 IR_dp(IR_block* block, uint32 instr, uint32 form) {
+	const uint32 compare = (OP >= IR_DP_TST);
+	const uint32 unary = (OP == IR_DP_MOV || OP == IR_DP_MVN);
+	const uint32 logical = (OP <= IR_DP_EOR || OP == IR_DP_MOV || OP == IR_DP_MVN || OP == IR_DP_TST || OP == IR_DP_TEQ);
+	const uint32 sparith = (OP == IR_DP_ADD || OP == IR_DP_SUB);
+	uint32 rd = (instr >> 8) & 0xF;
+	uint32 rn = (instr >> 16) & 0xF;
+	uint32 a = IR_NOTEMP;
+	uint32 c = IR_NOTEMP;
+	uint32 t = IR_NOTEMP;
+	IR_operand2_t op2;
+
+	if ((!compare && (rd == 15 || (rd == 13 && !sparith))) || (!unary && (rn == 15 || (rn == 13 && !sparith)))
+		|| (form != IR_OPERAND2_IMM && (instr & 0xF) >= 13)) {
+		return IR_interpret(block, IR_var_dp_handler[OP][form != IR_OPERAND2_IMM], instr, 4);
+	}
+
+	if (!unary) {
+		a = IR_getreg(block, rn);
+	}
+	IR_var_operand2[form](block, instr, &op2);
+
+	switch (OP) {
+	case IR_DP_AND: case IR_DP_TST: t = IR_op(block, IR_AND, a, op2.t); break;
+	case IR_DP_BIC: t = IR_op(block, IR_BIC, a, op2.t); break;
+	case IR_DP_ORR: t = IR_op(block, IR_OR, a, op2.t); break;
+	case IR_DP_ORN: t = IR_op(block, IR_OR, a, IR_op(block, IR_NOT, op2.t, IR_NOTEMP)); break;
+	case IR_DP_EOR: case IR_DP_TEQ: t = IR_op(block, IR_XOR, a, op2.t); break;
+	case IR_DP_MOV: t = op2.t; break;
+	case IR_DP_MVN: t = IR_op(block, IR_NOT, op2.t, IR_NOTEMP); break;
+	case IR_DP_ADD: case IR_DP_CMN: t = IR_op(block, IR_ADD, a, op2.t); break;
+	case IR_DP_SUB: case IR_DP_CMP: t = IR_op(block, IR_SUB, a, op2.t); break;
+	case IR_DP_RSB: t = IR_op(block, IR_SUB, op2.t, a); break;
+	case IR_DP_ADC:
+	case IR_DP_SBC:
+		c = IR_op(block, IR_GETC, IR_NOTEMP, IR_NOTEMP);
+		t = IR_op(block, (OP == IR_DP_ADC) ? IR_ADC : IR_SBC, a, op2.t, c);
+		break;
+	}
+	if (!compare) {
+		IR_setreg(block, rd, t);
+	}
+
+	if (S) {
+		if (logical) {
+			IR_flags(block, IR_FLAGS_NZ, IR_FLAG_NZ, t);
+			if (op2.shiftop != IR_NOP) {
+				IR_shiftc(block, op2.shiftop, op2.src, op2.amount, 1);
+			}
+		}
+		else if (OP == IR_DP_RSB) {
+			IR_flags(block, IR_FLAGS_SUB, IR_FLAG_NZCV, op2.t, a);
+		}
+		else {
+			uint32 add = (OP == IR_DP_ADD || OP == IR_DP_CMN || OP == IR_DP_ADC);
+			IR_flags(block, add ? IR_FLAGS_ADD : IR_FLAGS_SUB, IR_FLAG_NZCV, a, op2.t, c);
+		}
+	}
+	return 0;
+}
+
+// op field values that are not data processing (or pkhbt / pkhtb)
+static uint32 IR_dp_none(IR_block* block, uint32 instr, uint32 form) {
+	return IR_interpret(block, IR_var_dp_handler[(instr >> 21) & 0xF][form != IR_OPERAND2_IMM], instr, 4);
+}
+
+typedef uint32 (*IR_dp_func)(IR_block* block, uint32 instr, uint32 form);
+#define IR_DP_VARIANTS(op) { IR_dp<op, 0>, IR_dp<op, 1> }
+#define IR_DP_NONE { IR_dp_none, IR_dp_none }
+static const IR_dp_func IR_var_dp[IR_DP_NUMBER_OF_OPS][2] = {
+	IR_DP_VARIANTS(IR_DP_AND), IR_DP_VARIANTS(IR_DP_BIC), IR_DP_VARIANTS(IR_DP_ORR), IR_DP_VARIANTS(IR_DP_ORN),
+	IR_DP_VARIANTS(IR_DP_EOR), IR_DP_NONE, IR_DP_NONE, IR_DP_NONE,
+	IR_DP_VARIANTS(IR_DP_ADD), IR_DP_NONE, IR_DP_VARIANTS(IR_DP_ADC), IR_DP_VARIANTS(IR_DP_SBC),
+	IR_DP_NONE, IR_DP_VARIANTS(IR_DP_SUB), IR_DP_VARIANTS(IR_DP_RSB), IR_DP_NONE,
+	IR_DP_VARIANTS(IR_DP_MOV), IR_DP_VARIANTS(IR_DP_MVN), IR_DP_VARIANTS(IR_DP_TST), IR_DP_VARIANTS(IR_DP_TEQ),
+	IR_DP_VARIANTS(IR_DP_CMN), IR_DP_VARIANTS(IR_DP_CMP),
+};
+
+// pick the variant: op field, then rn = pc / rd = pc with s
+static uint32 IR_lowerdp(IR_block* block, uint32 instr, uint32 form) {
+	uint32 op = (instr >> 21) & 0xF;
+	uint32 s = (instr >> 20) & 0x1;
+	uint32 rn = (instr >> 16) & 0xF;
+	uint32 rd = (instr >> 8) & 0xF;
+
+	if (rn == 15 && (op == IR_DP_ORR || op == IR_DP_ORN)) {
+		op = (op == IR_DP_ORR) ? IR_DP_MOV : IR_DP_MVN;
+	}
+	else if (rd == 15 && s) {
+		switch (op) {
+		case IR_DP_AND: op = IR_DP_TST; break;
+		case IR_DP_EOR: op = IR_DP_TEQ; break;
+		case IR_DP_ADD: op = IR_DP_CMN; break;
+		case IR_DP_SUB: op = IR_DP_CMP; break;
+		default: break;
+		}
+	}
+	return IR_var_dp[op][s](block, instr, form);
+}
+
+// the rest of 32bit thumb, by encoding class: the handler to run it. UDF for what the architecture leaves
+// undefined (and the unpredictable forms nobody emits), so it faults instead of running as something else
+static uint32 IR_decode32(uint32 instr) {
+	uint32 hw1 = instr >> 16;
+	uint32 hw2 = instr & 0xFFFF;
+
+	// load / store dual, exclusive, table branch
+	if ((hw1 & 0xFE40) == 0xE840) {
+		if (hw1 & 0x120) {
+			return (hw1 & 0x10) ? (((hw1 & 0xF) == 15) ? LDRD_LITERAL : LDRD_IMMEDIATE) : STRD_IMMEDIATE;
+		}
+		switch (hw1 & 0xFF0) {
+		case 0x840: return STREX;
+		case 0x850: return LDREX;
+		case 0x8C0: return ((hw2 & 0xE0) != 0x40) ? UDF : (hw2 & 0x10) ? STREXH : STREXB;
+		case 0x8D0: return ((hw2 & 0xE0) == 0x00) ? TBB_TBH : ((hw2 & 0xE0) == 0x40) ? ((hw2 & 0x10) ? LDREXH : LDREXB) : UDF;
+		default: return UDF;
+		}
+	}
+
+	// coprocessor space: no coprocessor here, the handlers say NOCP
+	if ((hw1 & 0xEC00) == 0xEC00) {
+		uint32 op1 = (hw1 >> 4) & 0x3F;
+		if ((op1 & 0x3A) == 0) {
+			return (op1 == 0x4) ? MCRR_MCRR2 : (op1 == 0x5) ? MRRC_MRRC2 : UDF;
+		}
+		if ((op1 & 0x20) == 0) {
+			return (op1 & 0x1) ? (((hw1 & 0xF) == 15) ? LDC_LDC2_LITERAL : LDC_LDC2_IMMEDIATE) : STC_STC2;
+		}
+		if ((op1 & 0x30) == 0x20) {
+			return (hw2 & 0x10) == 0 ? CDP_CDP2 : (op1 & 0x1) ? MRC_MRC2 : MCR_MCR2;
+		}
+		return UDF;
+	}
+
+	// plain binary immediate (ADDW / SUBW / MOVW are lowered)
+	if ((hw1 & 0xFA00) == 0xF200 && (hw2 & 0x8000) == 0) {
+		uint32 shift = ((hw2 >> 10) & 0x1C) | ((hw2 >> 6) & 0x3);
+		switch ((hw1 >> 4) & 0x1F) {
+		case 0x0C: return MOVT;
+		case 0x10: return SSAT;
+		case 0x12: return (shift == 0) ? SSAT16 : SSAT;
+		case 0x14: return SBFX;
+		case 0x16: return ((hw1 & 0xF) == 15) ? BFC : BFI;
+		case 0x18: return USAT;
+		case 0x1A: return (shift == 0) ? USAT16 : USAT;
+		case 0x1C: return UBFX;
+		default: return UDF;
+		}
+	}
+
+	// branches and miscellaneous control (B / BL are lowered)
+	if ((hw1 & 0xF800) == 0xF000 && (hw2 & 0x8000)) {
+		if ((hw2 & 0x5000) == 0 && ((hw1 >> 7) & 0x7) == 0x7) {
+			switch ((hw1 >> 4) & 0x7F) {
+			case 0x38:
+			case 0x39:
+				return MSR;
+			case 0x3A:
+				if ((hw2 & 0x700) != 0) {
+					return UDF;
+				}
+				switch (hw2 & 0xFF) {
+				case 0x1: return YIELD;
+				case 0x2: return WFE;
+				case 0x3: return WFI;
+				case 0x4: return SEV;
+				case 0x14: return CSDB;
+				default: return ((hw2 & 0xF0) == 0xF0) ? DBG : NOP;	// unallocated hints execute as NOP
+				}
+			case 0x3B:
+				switch ((hw2 >> 4) & 0xF) {
+				case 0x2: return CLREX;
+				case 0x4: return ((hw2 & 0xF) == 0x0) ? SSBB : ((hw2 & 0xF) == 0x4) ? PSSBB : DSB;
+				case 0x5: return DMB;
+				case 0x6: return ISB;
+				default: return UDF;
+				}
+			case 0x3E:
+			case 0x3F:
+				return MRS;
+			default:
+				return UDF;
+			}
+		}
+		return UDF;	// udf.w (0xf7f0a000) among them
+	}
+
+	// data processing (register): shifts by register are lowered
+	if ((hw1 & 0xFF00) == 0xFA00) {
+		uint32 op1 = (hw1 >> 4) & 0xF;
+		uint32 op2 = (hw2 >> 4) & 0xF;
+		uint32 rn = hw1 & 0xF;
+		if ((hw2 & 0xF000) != 0xF000) {
+			return UDF;
+		}
+		if (op1 < 0x6 && (op2 & 0x8)) {
+			static const uint8 extend[6][2] = { { SXTAH, SXTH }, { UXTAH, UXTH }, { SXTAB16, SXTB16 }, { UXTAB16, UXTB16 },
+				{ SXTAB, SXTB }, { UXTAB, UXTB } };
+			return extend[op1][rn == 15];
+		}
+		if ((op1 & 0x8) && op2 < 0x8) {
+			// parallel add / subtract: op1 low bits the operation, op2 signed / saturating / halving, unsigned with bit 2
+			static const uint8 parallel[8][8] = {
+				{ SADD8, QADD8, SHADD8, UDF, UADD8, UQADD8, UHADD8, UDF },
+				{ SADD16, QADD16, SHADD16, UDF, UADD16, UQADD16, UHADD16, UDF },
+				{ SASX, QASX, SHASX, UDF, UASX, UQASX, UHASX, UDF },
+				{ UDF, UDF, UDF, UDF, UDF, UDF, UDF, UDF },
+				{ SSUB8, QSUB8, SHSUB8, UDF, USUB8, UQSUB8, UHSUB8, UDF },
+				{ SSUB16, QSUB16, SHSUB16, UDF, USUB16, UQSUB16, UHSUB16, UDF },
+				{ SSAX, QSAX, SHSAX, UDF, USAX, UQSAX, UHSAX, UDF },
+				{ UDF, UDF, UDF, UDF, UDF, UDF, UDF, UDF },
+			};
+			return parallel[op1 & 0x7][op2];
+		}
+		if ((op1 & 0xC) == 0x8 && (op2 & 0xC) == 0x8) {
+			static const uint8 misc[4][4] = { { QADD, QDADD, QSUB, QDSUB }, { REV, REV16, RBIT, REVSH }, { SEL, UDF, UDF, UDF },
+				{ CLZ, UDF, UDF, UDF } };
+			return misc[op1 & 0x3][op2 & 0x3];
+		}
+		return UDF;
+	}
+
+	// multiply, multiply accumulate, absolute difference
+	if ((hw1 & 0xFF80) == 0xFB00) {
+		uint32 op1 = (hw1 >> 4) & 0x7;
+		uint32 op2 = (hw2 >> 4) & 0x3;
+		uint32 acc = ((hw2 >> 12) != 15);
+		if ((hw2 & 0xC0) != 0) {
+			return UDF;
+		}
+		switch (op1) {
+		case 0x0: return (op2 == 0) ? (acc ? MLA : MUL) : (op2 == 1) ? MLS : UDF;
+		case 0x1: return acc ? SMLABB_SMLABT_SMLATB_SMLATT : SMULBB_SMULBT_SMULTB_SMULTT;
+		case 0x2: return (op2 > 1) ? UDF : acc ? SMLAD_SMLADX : SMUAD_SMUADX;
+		case 0x3: return (op2 > 1) ? UDF : acc ? SMLAWB_SMLAWT : SMULWB_SMULWT;
+		case 0x4: return (op2 > 1) ? UDF : acc ? SMLSD_SMLSDX : SMUSD_SMUSDX;
+		case 0x5: return (op2 > 1) ? UDF : acc ? SMMLA_SMMLAR : SMMUL_SMMULR;
+		case 0x6: return (op2 > 1) ? UDF : SMMLS_SMMLSR;
+		default: return (op2 != 0) ? UDF : acc ? USADA8 : USAD8;
+		}
+	}
+
+	// long multiply, long multiply accumulate, divide
+	if ((hw1 & 0xFF80) == 0xFB80) {
+		uint32 op2 = (hw2 >> 4) & 0xF;
+		switch ((hw1 >> 4) & 0x7) {
+		case 0x0: return (op2 == 0x0) ? SMULL : UDF;
+		case 0x1: return (op2 == 0xF) ? SDIV : UDF;
+		case 0x2: return (op2 == 0x0) ? UMULL : UDF;
+		case 0x3: return (op2 == 0xF) ? UDIV : UDF;
+		case 0x4: return (op2 == 0x0) ? SMLAL : ((op2 & 0xC) == 0x8) ? SMLALBB_SMLALBT_SMLALTB_SMLALTT : ((op2 & 0xE) == 0xC) ? SMLALD_SMLALDX : UDF;
+		case 0x5: return ((op2 & 0xE) == 0xC) ? SMLSLD_SMLSLDX : UDF;
+		case 0x6: return (op2 == 0x0) ? UMLAL : (op2 == 0x6) ? UMAAL : UDF;
+		default: return UDF;
+		}
+	}
+
+	return UDF;
+}
+
+// the branch offset of BL and B.W (T4): S:I1:I2:imm10:imm11:'0', I = NOT(J xor S)
+static uint32 IR_branchimm24(uint32 hw1, uint32 hw2) {
+	uint32 s = (hw1 >> 10) & 0x1;
+	uint32 i1 = !(((hw2 >> 13) & 0x1) ^ s);
+	uint32 i2 = !(((hw2 >> 11) & 0x1) ^ s);
+	uint32 imm32 = (i1 << 23) | (i2 << 22) | ((hw1 & 0x3FF) << 12) | ((hw2 & 0x7FF) << 1);
+	if (s) {
+		imm32 |= 0xFF000000;
+	}
+	return imm32;
+}
+
+// LDR / STR{B,H} / LDRS{B,H}.W: imm12, imm8 with P U W, register << imm2, literal. the unprivileged T forms
+// (P U W = 1 1 0) go with the imm8 ones, privilege is in the memory map already (MPU_sync).
+// rt = pc: a word load branches, byte / halfword loads are PLD / PLI hints
+static uint32 IR_lowerldst(IR_block* block, uint32 instr) {
+	uint32 pc = IR_var_pc;
+	uint32 hw1 = instr >> 16;
+	uint32 hw2 = instr & 0xFFFF;
+	uint32 sizetype = (hw1 >> 5) & 0x3;
+	uint32 load = (hw1 >> 4) & 0x1;
+	uint32 sign = (hw1 >> 8) & 0x1;
+	uint32 rn = hw1 & 0xF;
+	uint32 rt = hw2 >> 12;
+	uint32 addr, t;
+	uint32 wback = IR_NOTEMP;
+
+	if (sizetype == 3 || (sign && sizetype == Memory_enum_size::u32) || (!load && (sign || rn == 15 || rt == 15))) {
+		return IR_interpret(block, UDF, instr, 4);
+	}
+	if (load && rt == 15 && sizetype != Memory_enum_size::u32) {
+		return 0;	// hint
+	}
+
+	if (rn == 15) {
+		uint32 base = (pc + 4) & ~0x3;
+		addr = IR_const(block, IR_W((hw1 & 0x80) ? base + (hw2 & 0xFFF) : base - (hw2 & 0xFFF)));
+	}
+	else if (hw1 & 0x80) {
+		addr = IR_op(block, IR_ADD, IR_getreg(block, rn), IR_const(block, hw2 & 0xFFF));
+	}
+	else if (hw2 & 0x800) {
+		if ((hw2 & 0x500) == 0) {
+			return IR_interpret(block, UDF, instr, 4);	// neither indexed nor writeback
+		}
+		uint32 base = IR_getreg(block, rn);
+		uint32 offset = IR_op(block, (hw2 & 0x200) ? IR_ADD : IR_SUB, base, IR_const(block, hw2 & 0xFF));
+		addr = (hw2 & 0x400) ? offset : base;
+		if (hw2 & 0x100) {
+			wback = offset;
+		}
+	}
+	else if ((hw2 & 0xFC0) == 0 && (hw2 & 0xF) != 13 && (hw2 & 0xF) != 15) {
+		t = IR_op(block, IR_LSL, IR_getreg(block, hw2 & 0xF), IR_const(block, (hw2 >> 4) & 0x3));
+		addr = IR_op(block, IR_ADD, IR_getreg(block, rn), t);
+	}
+	else {
+		return IR_interpret(block, UDF, instr, 4);
+	}
+
+	if (!load) {
+		IR_store(block, sizetype, addr, IR_getreg(block, rt));
+		if (wback != IR_NOTEMP) {
+			IR_setreg(block, rn, wback);
+		}
+		return 0;
+	}
+	IR_lsucycles(1);
+	t = IR_load(block, sizetype, sign, addr);
+	if (wback != IR_NOTEMP) {
+		IR_setreg(block, rn, wback);
+	}
+	if (rt == 15) {
+		return IR_writepc(block, t);
+	}
+	IR_setreg(block, rt, t);
+	return 0;
+}
+
+// 32bit thumb. branches, loads / stores and the common alu ops are lowered, the rest goes to its handler
+static uint32 IR_lower32(IR_block* block, uint32 instr) {
+	uint32 pc = IR_var_pc;
+	uint32 hw1 = instr >> 16;
+	uint32 hw2 = instr & 0xFFFF;
+
+	IR_var_cycles += 1;
+
+	// MOVW / MOVT
+	if ((hw1 & 0xFB70) == 0xF240 && (hw2 & 0x8000) == 0) {
+		uint32 rd = (hw2 >> 8) & 0xF;
+		uint32 imm16 = ((hw1 & 0xF) << 12) | (((hw1 >> 10) & 0x1) << 11) | (((hw2 >> 12) & 0x7) << 8) | (hw2 & 0xFF);
+		uint32 movt = (hw1 >> 7) & 0x1;
+
+		if (rd == 13 || rd == 15) {
+			return IR_interpret(block, movt ? MOVT : MOV_IMMEDIATE, instr, 4);
+		}
+		if (movt) {
+			uint32 t = IR_op(block, IR_AND, IR_getreg(block, rd), IR_const(block, 0xFFFF));
+			IR_setreg(block, rd, IR_op(block, IR_OR, t, IR_const(block, imm16 << 16)));
+		}
+		else {
+			IR_setreg(block, rd, IR_const(block, imm16));
+		}
+		return 0;
+	}
+
+	// data processing (modified immediate)
+	if ((hw1 & 0xFA00) == 0xF000 && (hw2 & 0x8000) == 0) {
+		return IR_lowerdp(block, instr, IR_OPERAND2_IMM);
+	}
+
+	// data processing (shifted register)
+	if ((hw1 & 0xFE00) == 0xEA00) {
+		uint32 type = (hw2 >> 4) & 0x3;
+		if (type == 3 && (hw2 & 0x70C0) == 0) {
+			// rrx
+			return IR_interpret(block, IR_var_dp_handler[(hw1 >> 5) & 0xF][1], instr, 4);
+		}
+		return IR_lowerdp(block, instr, IR_OPERAND2_LSL + type);
+	}
+
+	// ADDW / SUBW, ADR.W (rn = pc)
+	if (((hw1 & 0xFBF0) == 0xF200 || (hw1 & 0xFBF0) == 0xF2A0) && (hw2 & 0x8000) == 0) {
+		uint32 rn = hw1 & 0xF;
+		uint32 rd = (hw2 >> 8) & 0xF;
+		uint32 imm12 = (((hw1 >> 10) & 0x1) << 11) | (((hw2 >> 12) & 0x7) << 8) | (hw2 & 0xFF);
+		uint32 sub = (hw1 >> 7) & 0x1;
+		if (rd == 15) {
+			return IR_interpret(block, UDF, instr, 4);
+		}
+		if (rn == 15) {
+			uint32 base = (pc + 4) & ~0x3;
+			IR_setreg(block, rd, IR_const(block, IR_W(sub ? base - imm12 : base + imm12)));
+			return 0;
+		}
+		IR_setreg(block, rd, IR_op(block, sub ? IR_SUB : IR_ADD, IR_getreg(block, rn), IR_const(block, imm12)));
+		return 0;
+	}
+
+	// BL, B.W
+	if ((hw1 & 0xF800) == 0xF000 && (hw2 & 0xD000) == 0xD000) {
+		IR_setreg(block, 14, IR_const(block, (pc + 4) | 0x1));
+		IR_exit(block, IR_W(pc + 4 + IR_branchimm24(hw1, hw2)), IR_var_cycles + 2);
+		return 1;
+	}
+	if ((hw1 & 0xF800) == 0xF000 && (hw2 & 0xD000) == 0x9000) {
+		IR_exit(block, IR_W(pc + 4 + IR_branchimm24(hw1, hw2)), IR_var_cycles + 2);
+		return 1;
+	}
+
+	// Bcc.W: S:J2:J1:imm6:imm11:'0'. cond 111x is miscellaneous control
+	if ((hw1 & 0xF800) == 0xF000 && (hw2 & 0xD000) == 0x8000 && ((hw1 >> 7) & 0x7) != 0x7) {
+		uint32 imm32 = (((hw1 >> 10) & 0x1) << 20) | (((hw2 >> 11) & 0x1) << 19) | (((hw2 >> 13) & 0x1) << 18)
+			| ((hw1 & 0x3F) << 12) | ((hw2 & 0x7FF) << 1);
+		imm32 = IR_W((uint32)((int32_t)(imm32 << 11) >> 11));
+		IR_bcond(block, (hw1 >> 6) & 0xF, IR_W(pc + 4 + imm32), IR_var_cycles + 2);
+		return 0;
+	}
+
+	// NOP.W
+	if (instr == 0xF3AF8000) {
+		return 0;
+	}
+
+	// LDM / STM / LDMDB / STMDB. PUSH.W / POP.W are the sp! forms, single register PUSH / POP are str / ldr on sp
+	if (hw1 == 0xE92D || (instr & 0xFFFF0FFF) == 0xF84D0D04) {
+		return IR_interpret(block, PUSH, instr, 4);
+	}
+	if (hw1 == 0xE8BD || (instr & 0xFFFF0FFF) == 0xF85D0B04) {
+		return IR_interpret(block, POP, instr, 4);
+	}
+	switch (hw1 & 0xFFD0) {
+	case 0xE880:
+	case 0xE890: {
+		// increment after without pc / sp in the list is plain loads / stores, the rest is the handler's
+		uint32 list = instr & 0xFFFF;
+		uint32 rn = hw1 & 0xF;
+		uint32 wback = (hw1 >> 5) & 0x1;
+		if (rn == 15 || (list & 0xA000) != 0 || (list & (list - 1)) == 0 || (wback && ((list >> rn) & 0x1))) {
+			return IR_interpret(block, (hw1 & 0x10) ? LDM_LDMIA_LDMFD : STM_STMIA_STMEA, instr, 4);
+		}
+		IR_multiple(block, (hw1 >> 4) & 0x1, rn, list, wback);
+		return 0;
+	}
+	case 0xE900: return IR_interpret(block, STMDB_STMFD, instr, 4);
+	case 0xE910: return IR_interpret(block, LDMDB_LDMEA, instr, 4);
+	default: break;
+	}
+
+	// load / store single
+	if ((hw1 & 0xFE00) == 0xF800) {
+		return IR_lowerldst(block, instr);
+	}
+
+	// TBB / TBH: pc + 4 + twice the table entry
+	if ((hw1 & 0xFFF0) == 0xE8D0 && (hw2 & 0xFFE0) == 0xF000) {
+		uint32 half = (hw2 >> 4) & 0x1;
+		uint32 index = IR_getreg(block, hw2 & 0xF);
+		if (half) {
+			index = IR_op(block, IR_LSL, index, IR_const(block, 1));
+		}
+		IR_lsucycles(1);
+		uint32 t = IR_load(block, half ? Memory_enum_size::u16 : Memory_enum_size::u8, 0, IR_op(block, IR_ADD, IR_getreg(block, hw1 & 0xF), index));
+		IR_branch(block, IR_op(block, IR_ADD, IR_const(block, pc + 4), IR_op(block, IR_LSL, t, IR_const(block, 1))), IR_var_cycles + 2);
+		return 1;
+	}
+
+	// LSL / LSR / ASR / ROR (register)
+	if ((hw1 & 0xFF80) == 0xFA00 && (hw2 & 0xF0F0) == 0xF000) {
+		static const uint32 shiftops[4] = { IR_LSL, IR_LSR, IR_ASR, IR_ROR };
+		uint32 shiftop = shiftops[(hw1 >> 5) & 0x3];
+		uint32 rd = (hw2 >> 8) & 0xF;
+		uint32 rn = hw1 & 0xF;
+		uint32 rm = hw2 & 0xF;
+		if (rd == 13 || rd == 15 || rn == 13 || rn == 15 || rm == 13 || rm == 15) {
+			return IR_interpret(block, UDF, instr, 4);
+		}
+		uint32 a = IR_getreg(block, rn);
+		uint32 b = IR_getreg(block, rm);
+		uint32 t = IR_op(block, shiftop, a, b);
+		IR_setreg(block, rd, t);
+		if (hw1 & 0x10) {
+			IR_flags(block, IR_FLAGS_NZ, IR_FLAG_NZ, t);
+			IR_shiftc(block, shiftop, a, b, 0);
+		}
+		return 0;
+	}
+
+	return IR_interpret(block, IR_decode32(instr), instr, 4);
+}
+
+void IR_lower(IR_block* block, uint32 pc, uint32 itstate) {
+	block->guest_start = pc;
+	block->guest_count = 0;
+	block->ntemps = 0;
+	block->count = 0;
+	IR_var_cycles = 0;
+	IR_var_lsu = 0;
+
+	uint32 done = 0;
+	while (!done) {
+		IR_var_pc = pc;
+
+		uint32 hw1 = IR_fetch16(pc);
+		if (hw1 == IR_NOTEMP) {
+			// cannot fetch. a later instruction ends the block before it, the first one faults right here (Fault.hpp).
+			// unarmed, that halts the clock and the block is an empty exit to the same pc
+			if (pc == block->guest_start) {
+				Fault_access(pc, MEMORY_ATTRIB_S_X);
+			}
+			break;
+		}
+
+		uint32 length = ((hw1 >> 11) >= 0x1D) ? 4 : 2;
+		uint32 instr = hw1;
+		if (length == 4) {
+			uint32 hw2 = IR_fetch16(pc + 2);
+			instr = (hw1 << 16) | (hw2 & 0xFFFF);
+		}
+
+		// inside an it block: skip when the condition fails, and 16bit alu ops do not touch apsr
+		if (itstate != 0 && (itstate >> 4) != 0xE) {
+			IR_bcond(block, (itstate >> 4) ^ 0x1, pc + length, IR_var_cycles + 1);
+		}
+
+		done = (length == 2) ? IR_lower16(block, hw1, (itstate == 0)) : IR_lower32(block, instr);
+		pc += length;
+		block->guest_count += 1;
+
+		if (itstate != 0 || block->guest_count == IR_MAX_GUEST || block->count > IR_MAX_INST - 64) {	// room for the largest ldm / stm
+			break;
+		}
+	}
+
+	if (!done) {
+		IR_exit(block, pc, IR_var_cycles);
+		block->inst[block->count - 1].instrs = block->guest_count;
+	}
+	block->guest_end = pc;
+}
+
+/*
+* passes
+*/
+
+static uint32 IR_isalu(uint32 op) {
+	return op >= IR_ADD && op <= IR_ROR;
+}
+
+static uint32 IR_isexit(uint32 op) {
+	return op == IR_EXIT || op == IR_BRANCH || op == IR_BCOND || op == IR_INTERP;
+}
+
+// a faulting access leaves the block at its instruction (Fault.hpp): registers and flags are live there too
+static uint32 IR_mayfault(uint32 op) {
+	return op == IR_LOAD || op == IR_STORE;
+}
+
+// operand temps read by an instruction. returns how many
+static uint32 IR_uses(IR_inst* inst, uint32* uses) {
+	uint32 n = 0;
+	switch (inst->op) {
+	case IR_INTERP:
+	case IR_EXIT:
+	case IR_BCOND:
+	case IR_CONST:
+	case IR_GETREG:
+	case IR_GETC:
+	case IR_SETREGI:
+	case IR_ADDREGI:
+	case IR_NOP:
+		return 0;
+	default:
+		break;
+	}
+	if (inst->a != IR_NOTEMP) uses[n++] = inst->a;
+	if (inst->b != IR_NOTEMP && !inst->bimm) uses[n++] = inst->b;
+	if (inst->c != IR_NOTEMP) uses[n++] = inst->c;
+	return n;
+}
+
+// rewrite every read of 'from' with 'to'
+static void IR_rename(IR_inst* inst, uint32* alias) {
+	uint32 uses[3];
+	if (IR_uses(inst, uses) == 0) {
+		return;
+	}
+	if (inst->a != IR_NOTEMP) inst->a = alias[inst->a];
+	if (inst->b != IR_NOTEMP && !inst->bimm) inst->b = alias[inst->b];
+	if (inst->c != IR_NOTEMP) inst->c = alias[inst->c];
+}
+
+/*
+* constant folding and register forwarding
+* - a GETREG after a SETREG/GETREG of the same register reuses that temp
+* - alu ops on constants become constants, a constant second operand becomes an immediate
+* - so MOVW rd, lo / MOVT rd, hi -> SETREG rd, CONST(hi:lo) (the MOVW write is then dead)
+*/
+void IR_fold_constants(IR_block* block) {
+	static uint32 alias[IR_MAX_INST];
+	static uint8 isconst[IR_MAX_INST];
+	static uint32 value[IR_MAX_INST];
+	uint32 regtemp[16];
+
+	for (uint32 i = 0; i < block->ntemps; i++) {
+		alias[i] = i;
+		isconst[i] = 0;
+	}
+	for (uint32 r = 0; r < 16; r++) {
+		regtemp[r] = IR_NOTEMP;
+	}
+
+	for (uint32 i = 0; i < block->count; i++) {
+		IR_inst* inst = &block->inst[i];
+		IR_rename(inst, alias);
+
+		// constant second operand -> immediate
+		if ((IR_isalu(inst->op) || inst->op == IR_FLAGS_ADD || inst->op == IR_FLAGS_SUB) && !inst->bimm && isconst[inst->b]) {
+			inst->bimm = 1;
+			inst->imm = value[inst->b];
+			inst->b = IR_NOTEMP;
+		}
+		// shift carry with a known amount: amount 0 never writes c, anything else always does
+		if (inst->op == IR_FLAGS_SHIFTC && !inst->bimm && isconst[inst->b]) {
+			if ((value[inst->b] & 0xFF) == 0) {
+				inst->op = IR_NOP;
+				continue;
+			}
+			inst->bimm = 1;
+			inst->imm = value[inst->b];
+			inst->b = IR_NOTEMP;
+		}
+
+		switch (inst->op) {
+		case IR_CONST:
+			isconst[inst->t] = 1;
+			value[inst->t] = inst->imm;
+			break;
+		case IR_GETREG:
+			if (regtemp[inst->reg] != IR_NOTEMP) {
+				alias[inst->t] = regtemp[inst->reg];
+				inst->op = IR_NOP;
+			}
+			else {
+				regtemp[inst->reg] = inst->t;
+			}
+			break;
+		case IR_SETREG:
+			regtemp[inst->reg] = inst->a;
+			break;
+		case IR_NOT:
+			if (isconst[inst->a]) {
+				inst->op = IR_CONST;
+				inst->imm = IR_alu(IR_NOT, value[inst->a], 0, 0);
+				inst->a = IR_NOTEMP;
+				isconst[inst->t] = 1;
+				value[inst->t] = inst->imm;
+			}
+			break;
+		case IR_INTERP:
+			for (uint32 r = 0; r < 16; r++) {
+				regtemp[r] = IR_NOTEMP;
+			}
+			break;
+		default:
+			if (IR_isalu(inst->op) && inst->bimm) {
+				if (isconst[inst->a]) {
+					// both known
+					inst->imm = IR_alu(inst->op, value[inst->a], inst->imm, 0);
+					inst->op = IR_CONST;
+					inst->a = IR_NOTEMP;
+					inst->bimm = 0;
+					isconst[inst->t] = 1;
+					value[inst->t] = inst->imm;
+				}
+				else if ((inst->imm == 0 && inst->op != IR_AND && inst->op != IR_MUL) || (inst->imm == 0xFFFFFFFF && inst->op == IR_AND)) {
+					// x + 0, x | 0, x << 0, x & ~0 ...
+					alias[inst->t] = inst->a;
+					inst->op = IR_NOP;
+				}
+			}
+			break;
+		}
+	}
+}
+
+/*
+* dead apsr updates
+* walk backwards with the set of flags somebody still reads. exits (and loads / stores, which may fault) read everything,
+* a flag op only keeps the bits that are live and kills what it always writes.
+*/
+void IR_eliminate_dead_flags(IR_block* block) {
+	uint32 live = IR_FLAG_NZCV;
+
+	for (uint32 i = block->count; i-- > 0;) {
+		IR_inst* inst = &block->inst[i];
+		switch (inst->op) {
+		case IR_EXIT:
+		case IR_BRANCH:
+		case IR_BCOND:
+		case IR_INTERP:
+		case IR_LOAD:
+		case IR_STORE:
+			live = IR_FLAG_NZCV;
+			break;
+		case IR_GETC:
+			live |= IR_FLAG_C;
+			break;
+		case IR_FLAGS_ADD:
+		case IR_FLAGS_SUB:
+		case IR_FLAGS_NZ:
+		case IR_FLAGS_SHIFTC:
+			inst->flags &= live;
+			if (inst->flags == 0) {
+				inst->op = IR_NOP;
+				break;
+			}
+			// shift by a register amount may leave c alone
+			if (inst->op != IR_FLAGS_SHIFTC || inst->bimm) {
+				live &= ~inst->flags;
+			}
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+/*
+* dead code
+* register writes overwritten before any read or exit, and pure ops nobody reads
+*/
+void IR_eliminate_dead_code(IR_block* block) {
+	static uint8 used[IR_MAX_INST];
+	uint32 regslive = 0xFFFF;
+	uint32 uses[3];
+
+	for (uint32 i = 0; i < block->ntemps; i++) {
+		used[i] = 0;
+	}
+
+	for (uint32 i = block->count; i-- > 0;) {
+		IR_inst* inst = &block->inst[i];
+
+		if (IR_isexit(inst->op) || IR_mayfault(inst->op)) {
+			regslive = 0xFFFF;
+		}
+
+		switch (inst->op) {
+		case IR_SETREG:
+		case IR_SETREGI:
+			if (!(regslive & (0x1 << inst->reg))) {
+				inst->op = IR_NOP;
+				continue;
+			}
+			regslive &= ~(0x1 << inst->reg);
+			break;
+		case IR_ADDREGI:
+			regslive |= (0x1 << inst->reg);
+			break;
+		case IR_GETREG:
+			if (!used[inst->t]) {
+				inst->op = IR_NOP;
+				continue;
+			}
+			regslive |= (0x1 << inst->reg);
+			break;
+		case IR_CONST:
+		case IR_NOT:
+		case IR_GETC:
+		case IR_ADC:
+		case IR_SBC:
+			if (!used[inst->t]) {
+				inst->op = IR_NOP;
+				continue;
+			}
+			break;
+		default:
+			if (IR_isalu(inst->op) && !used[inst->t]) {
+				inst->op = IR_NOP;
+				continue;
+			}
+			break;
+		}
+
+		uint32 n = IR_uses(inst, uses);
+		for (uint32 j = 0; j < n; j++) {
+			used[uses[j]] = 1;
+		}
+	}
+}
+
+/*
+* superinstructions
+* - CONST t; SETREG r, t -> SETREGI r
+* - GETREG t, r; ADD/SUB t2, t, imm; SETREG r, t2 -> ADDREGI r (the usual loop counter update)
+* only when the temps have no other reader
+*/
+void IR_fuse(IR_block* block) {
+	static uint8 nuses[IR_MAX_INST];
+	uint32 uses[3];
+
+	for (uint32 i = 0; i < block->ntemps; i++) {
+		nuses[i] = 0;
+	}
+	for (uint32 i = 0; i < block->count; i++) {
+		uint32 n = IR_uses(&block->inst[i], uses);
+		for (uint32 j = 0; j < n; j++) {
+			nuses[uses[j]] += 1;
+		}
+	}
+
+	IR_inst* prev[2] = { NULL, NULL };	// last two non-nop instructions
+	for (uint32 i = 0; i < block->count; i++) {
+		IR_inst* inst = &block->inst[i];
+		if (inst->op == IR_NOP) {
+			continue;
+		}
+
+		if (inst->op == IR_SETREG && prev[1] != NULL && prev[1]->op == IR_CONST && prev[1]->t == inst->a && nuses[inst->a] == 1) {
+			inst->op = IR_SETREGI;
+			inst->imm = prev[1]->imm;
+			inst->a = IR_NOTEMP;
+			prev[1]->op = IR_NOP;
+		}
+		else if (inst->op == IR_SETREG && prev[0] != NULL && prev[1] != NULL
+			&& prev[0]->op == IR_GETREG && prev[0]->reg == inst->reg && nuses[prev[0]->t] == 1
+			&& (prev[1]->op == IR_ADD || prev[1]->op == IR_SUB) && prev[1]->bimm
+			&& prev[1]->a == prev[0]->t && prev[1]->t == inst->a && nuses[inst->a] == 1) {
+			inst->op = IR_ADDREGI;
+			inst->imm = (prev[1]->op == IR_ADD) ? prev[1]->imm : IR_W(0 - prev[1]->imm);
+			inst->a = IR_NOTEMP;
+			prev[0]->op = IR_NOP;
+			prev[1]->op = IR_NOP;
+		}
+
+		prev[0] = prev[1];
+		prev[1] = inst;
+	}
+}
+
+void IR_compact(IR_block* block) {
+	uint32 n = 0;
+	for (uint32 i = 0; i < block->count; i++) {
+		if (block->inst[i].op != IR_NOP) {
+			block->inst[n++] = block->inst[i];
+		}
+	}
+	block->count = n;
+}
+
+void IR_optimize(IR_block* block) {
+	IR_fold_constants(block);
+	IR_eliminate_dead_flags(block);
+	IR_eliminate_dead_code(block);
+	IR_fuse(block);
+	IR_compact(block);
+}
+
+/*
+* interpreter
+*/
+
+uint32 IR_execute(IR_block* block, CPU_struct_reg* reg) {
+	uint32* T = IR_var_temps;
+
+	for (uint32 i = 0; i < block->count; i++) {
+		IR_inst* inst = &block->inst[i];
+		uint32 b = inst->bimm ? inst->imm : (inst->b != IR_NOTEMP) ? T[inst->b] : 0;
+
+		switch (inst->op) {
+		case IR_NOP:
+			break;
+		case IR_CONST:
+			T[inst->t] = inst->imm;
+			break;
+		case IR_GETREG:
+			T[inst->t] = reg->R[inst->reg];
+			break;
+		case IR_SETREG:
+			reg->R[inst->reg] = T[inst->a];
+			break;
+		case IR_SETREGI:
+			reg->R[inst->reg] = inst->imm;
+			break;
+		case IR_ADDREGI:
+			reg->R[inst->reg] = IR_W(reg->R[inst->reg] + inst->imm);
+			break;
+
+		case IR_ADD: T[inst->t] = IR_W(T[inst->a] + b); break;
+		case IR_SUB: T[inst->t] = IR_W(T[inst->a] - b); break;
+		case IR_AND: T[inst->t] = T[inst->a] & b; break;
+		case IR_OR: T[inst->t] = T[inst->a] | b; break;
+		case IR_XOR: T[inst->t] = T[inst->a] ^ b; break;
+		case IR_BIC: T[inst->t] = IR_W(T[inst->a] & ~b); break;
+		case IR_MUL: T[inst->t] = IR_W(T[inst->a] * b); break;
+		case IR_LSL:
+		case IR_LSR:
+		case IR_ASR:
+		case IR_ROR:
+			T[inst->t] = IR_shift(inst->op, T[inst->a], b);
+			break;
+		case IR_ADC: T[inst->t] = IR_W(T[inst->a] + b + T[inst->c]); break;
+		case IR_SBC: T[inst->t] = IR_W(T[inst->a] + IR_W(~b) + T[inst->c]); break;
+		case IR_NOT: T[inst->t] = IR_W(~T[inst->a]); break;
+		case IR_GETC: T[inst->t] = reg->xPSR.APSR.C; break;
+
+		case IR_FLAGS_ADD:
+			IR_do_setflags(reg, IR_FLAGS_ADD, inst->flags, T[inst->a], b, (inst->c == IR_NOTEMP) ? 0 : T[inst->c], 0);
+			break;
+		case IR_FLAGS_SUB:
+			IR_do_setflags(reg, IR_FLAGS_SUB, inst->flags, T[inst->a], b, (inst->c == IR_NOTEMP) ? 1 : T[inst->c], 0);
+			break;
+		case IR_FLAGS_NZ:
+			IR_do_setflags(reg, IR_FLAGS_NZ, inst->flags, T[inst->a], 0, 0, 0);
+			break;
+		case IR_FLAGS_SHIFTC:
+			IR_do_setflags(reg, IR_FLAGS_SHIFTC, inst->flags, T[inst->a], b, 0, inst->size);
+			break;
+
+		case IR_LOAD: {
+			uint32 value;
+#if FASTMEM_HOST
+			uint64_t fast = (Fastmem_var_base != NULL && !MPU_var_active) ? Fastmem_load(T[inst->a], inst->size) : FASTMEM_FAULT;
+			if (fast & FASTMEM_FAULT) {
+				reg->R[15] = inst->pc;	// for a fault out of the slow path
+				IR_var_elapsed = inst->cycles;
+				value = Jit_slowRead(T[inst->a], inst->size, MEMORY_ATTRIB_S_R);
+			}
+			else {
+				value = (uint32)fast;
+			}
+#else
+			reg->R[15] = inst->pc;
+			IR_var_elapsed = inst->cycles;
+			value = Jit_slowRead(T[inst->a], inst->size, MEMORY_ATTRIB_S_R);
+#endif
+			if (inst->sign) {
+				uint32 shift = 32 - (8 << inst->size);
+				value = IR_W((int32_t)(value << shift) >> shift);
+			}
+			T[inst->t] = value;
+			break;
+		}
+		case IR_STORE:
+#if FASTMEM_HOST
+			if (Fastmem_var_base != NULL && !MPU_var_active && Fastmem_store(T[inst->a], T[inst->b], inst->size) == 0) {
+				break;
+			}
+#endif
+			reg->R[15] = inst->pc;
+			IR_var_elapsed = inst->cycles;
+			Jit_slowWrite(T[inst->a], T[inst->b], inst->size, MEMORY_ATTRIB_S_W);
+			break;
+
+		case IR_EXIT:
+			reg->R[15] = inst->imm;
+			IR_var_retired = IR_RETIRED(inst->instrs, inst->lsu);
+			return inst->cycles;
+		case IR_BRANCH:
+			reg->R[15] = T[inst->a];
+			IR_var_retired = IR_RETIRED(inst->instrs, inst->lsu);
+			return inst->cycles;
+		case IR_BCOND:
+			if (IR_do_cond(reg, inst->size)) {
+				reg->R[15] = inst->imm;
+				IR_var_retired = IR_RETIRED(inst->instrs, inst->lsu);
+				return inst->cycles;
+			}
+			break;
+		case IR_INTERP:
+			IR_var_elapsed = inst->cycles;
+			IR_do_interp(reg, inst->a, inst->imm, inst->pc, inst->b);
+			IR_var_retired = IR_RETIRED(inst->instrs, inst->lsu);
+			return inst->cycles;
+		}
+	}
+
+	// lowering always closes a block with an exit
+	return 0;
+}
+
+/*
+* debug
+*/
+
+static const char* IR_opnames[IR_NUMBER_OF_OPS] = {
+	"nop", "const", "getreg", "setreg",
+	"add", "sub", "and", "or", "xor", "bic", "mul", "lsl", "lsr", "asr", "ror", "adc", "sbc", "not", "getc",
+	"flags_add", "flags_sub", "flags_nz", "flags_shiftc",
+	"load", "store",
+	"exit", "branch", "bcond", "interp",
+	"setregi", "addregi",
+};
+
+void IR_print(IR_block* block) {
+	printf("ir block 0x%08lx-0x%08lx (%lu guest, %lu ir)\n", block->guest_start, block->guest_end, block->guest_count, block->count);
+	for (uint32 i = 0; i < block->count; i++) {
+		IR_inst* inst = &block->inst[i];
+		printf("  %08lx  %-12s", inst->pc, IR_opnames[inst->op]);
+		if (inst->t != IR_NOTEMP) printf(" t%lu =", inst->t);
+		if (inst->op == IR_GETREG || inst->op == IR_SETREG || inst->op == IR_SETREGI || inst->op == IR_ADDREGI) printf(" r%d", inst->reg);
+		if (inst->a != IR_NOTEMP && inst->op != IR_INTERP) printf(" t%lu", inst->a);
+		if (inst->bimm || inst->op == IR_CONST || inst->op == IR_SETREGI || inst->op == IR_ADDREGI || IR_isexit(inst->op)) printf(" #0x%lx", inst->imm);
+		else if (inst->b != IR_NOTEMP) printf(" t%lu", inst->b);
+		if (inst->c != IR_NOTEMP) printf(" t%lu", inst->c);
+		if (inst->flags) printf(" [%s%s%s%s]", (inst->flags & IR_FLAG_N) ? "n" : "", (inst->flags & IR_FLAG_Z) ? "z" : "",
+			(inst->flags & IR_FLAG_C) ? "c" : "", (inst->flags & IR_FLAG_V) ? "v" : "");
+		if (IR_isexit(inst->op)) printf(" (%lu cycles)", inst->cycles);
+		printf("\n");
+	}
+}
@@ -0,0 +1,154 @@
+#pragma once
+#include "Proxy.hpp"
+#include "CPU.hpp"
+#include "Memory.hpp"
+
+/*
+* intermediate representation shared by the interpreter, the jit and analysis passes
+*
+* the thumb decoder lowers a straight-line run of guest instructions (one block) into a flat list of IR_inst.
+* every execution tier and every optimization works on that list, so a handler is written once:
+* - IR_execute: interprets the list (with a couple of fused superinstructions)
+* - Jit_compile (Jit.cpp): turns the list into host code with X86Emitter
+* - passes: constant folding (MOVW/MOVT pairs end up as one constant), dead apsr update removal,
+*   dead register write removal
+*
+* values:
+* - temps are numbered in order of definition and written exactly once (t).
+* - guest registers are only touched through IR_GETREG / IR_SETREG, flags only through the flag ops.
+* - the flag ops recompute the result from their operands, they never depend on an alu inst.
+*   that way an unused apsr update can just be dropped.
+*
+* exits:
+* - IR_EXIT / IR_BRANCH end the block, IR_BCOND leaves only if the condition holds.
+* - every exit carries the guest cycles spent and the guest instructions retired up to and including that instruction,
+*   and how many of those cycles were extra load / store cycles (the dwt counters, Dwt.hpp).
+* - at an exit all guest registers and flags are live.
+* - so they are at a load / store: a fault leaves the block there (Fault.hpp).
+*
+* anything the decoder does not know is kept as IR_INTERP: the INSTR_ handler runs on the real registers
+* and the block ends there.
+* instructions inside an it block are lowered one per block (IR_lower with itstate), never cached.
+*/
+
+#define IR_MAX_INST 256
+#define IR_MAX_GUEST 32		// guest instructions per block
+#define IR_NOTEMP 0xFFFFFFFF
+
+#define IR_FLAG_V 0x1
+#define IR_FLAG_C 0x2
+#define IR_FLAG_Z 0x4
+#define IR_FLAG_N 0x8
+#define IR_FLAG_NZ (IR_FLAG_N | IR_FLAG_Z)
+#define IR_FLAG_NZCV 0xF
+
+enum IR_op_enum {
+	IR_NOP,
+
+	IR_CONST,		// t = imm
+	IR_GETREG,		// t = R[reg]
+	IR_SETREG,		// R[reg] = a
+
+	// alu: t = a op b (b = imm if bimm)
+	IR_ADD,
+	IR_SUB,
+	IR_AND,
+	IR_OR,
+	IR_XOR,
+	IR_BIC,
+	IR_MUL,
+	IR_LSL,			// shifts follow the arm rules: amount is the low byte, 32 and up is allowed
+	IR_LSR,
+	IR_ASR,
+	IR_ROR,
+	IR_ADC,			// t = a + b + c
+	IR_SBC,			// t = a + ~b + c
+	IR_NOT,			// t = ~a
+	IR_GETC,		// t = apsr.c
+
+	// flags (flags = mask of apsr bits to update)
+	IR_FLAGS_ADD,	// nzcv of a + b + c (c = IR_NOTEMP -> 0)
+	IR_FLAGS_SUB,	// nzcv of a + ~b + c (c = IR_NOTEMP -> 1)
+	IR_FLAGS_NZ,	// nz of a
+	IR_FLAGS_SHIFTC,	// c = carry out of shifting a by b with shift op 'size'. amount 0 leaves c alone
+
+	// memory (size = Memory_enum_size)
+	IR_LOAD,		// t = mem[a], sign extended if sign
+	IR_STORE,		// mem[a] = b
+
+	// control
+	IR_EXIT,		// pc = imm, leave
+	IR_BRANCH,		// pc = a, leave
+	IR_BCOND,		// if cond(size) pc = imm and leave
+	IR_INTERP,		// pc = this instruction, run handler a (CPU_op_enum) on encoding imm, length b. leave
+
+	// superinstructions (made by IR_fuse, interpreter and jit both know them)
+	IR_SETREGI,		// R[reg] = imm
+	IR_ADDREGI,		// R[reg] += imm
+
+	IR_NUMBER_OF_OPS
+};
+
+struct IR_inst {
+	uint8 op;		// IR_op_enum
+	uint8 size;		// load/store: Memory_enum_size, IR_FLAGS_SHIFTC: shift op, IR_BCOND: condition
+	uint8 flags;	// flag ops: apsr bits updated
+	uint8 reg;		// register ops: guest register
+	uint8 bimm;		// operand b is imm
+	uint8 sign;		// IR_LOAD: sign extend
+	uint32 t;		// result temp
+	uint32 a, b, c;	// operand temps
+	uint32 imm;
+	uint32 pc;		// guest instruction this came from
+	uint32 cycles;	// exits: guest cycles when leaving here. anything else: guest cycles spent before it
+	uint32 instrs;	// exits: guest instructions retired when leaving here
+	uint32 lsu;		// exits: extra load / store cycles in 'cycles'
+};
+
+struct IR_block {
+	uint32 guest_start;
+	uint32 guest_end;	// exclusive
+	uint32 guest_count;	// guest instructions lowered
+	uint32 ntemps;
+	uint32 count;
+	struct IR_inst inst[IR_MAX_INST];
+};
+
+// scratch temps, shared by the interpreter and jit code (the jit bakes their address)
+extern uint32 IR_var_temps[IR_MAX_INST];
+
+// guest instructions retired by the last block and their extra load / store cycles, stored at its exit as one word
+// (the jit bakes its address as well)
+#define IR_RETIRED(instrs, lsu) ((instrs) | ((lsu) << 16))
+#define IR_RETIRED_INSTRS(retired) ((retired) & 0xFFFF)
+#define IR_RETIRED_LSU(retired) ((retired) >> 16)
+extern uint32 IR_var_retired;
+
+// guest cycles the running block spent before the memory access (or handler) in progress: set on the slow path only,
+// for registers that count cycles (Dwt.hpp). 0 between blocks
+extern uint32 IR_var_elapsed;
+
+// decode from pc into block. itstate != 0 -> lower exactly one instruction under that it condition
+extern void IR_lower(IR_block* block, uint32 pc, uint32 itstate);
+
+// passes
+extern void IR_fold_constants(IR_block* block);
+extern void IR_eliminate_dead_flags(IR_block* block);
+extern void IR_eliminate_dead_code(IR_block* block);
+extern void IR_fuse(IR_block* block);
+extern void IR_compact(IR_block* block);
+extern void IR_optimize(IR_block* block);	// all of the above, in order
+
+// run a block on reg, returns guest cycles spent
+extern uint32 IR_execute(IR_block* block, CPU_struct_reg* reg);
+
+// helpers shared with the jit (cdecl, called from generated code)
+// (flag ops are packed into one word: IR_FLAGDESC(op, mask, shiftop))
+#define IR_FLAGDESC(op, mask, shiftop) ((op) | ((mask) << 8) | ((shiftop) << 16))
+extern uint32 IR_alu(uint32 op, uint32 a, uint32 b, uint32 c);
+extern void IR_setflags(uint32 desc, uint32 a, uint32 b, uint32 c);
+extern uint32 IR_cond(uint32 cond);
+extern void IR_interp(uint32 op, uint32 instr, uint32 pc, uint32 length);
+
+// debug dump
+extern void IR_print(IR_block* block);
@@ -0,0 +1,636 @@
+#include "Idiom.hpp"
+#include "JitCache.hpp"
+#include "MPU.hpp"
+#include "Fuzz.hpp"
+#include <stddef.h>	// ptrdiff_t
+#include <stdlib.h>	// getenv
+#include <string.h>
+
+#define IDIOM_NOREG 0xFF
+
+enum Idiom_sym_kind {
+	IDIOM_SYM_UNKNOWN,
+	IDIOM_SYM_CONST,	// k
+	IDIOM_SYM_REG,		// R[r1] (+ R[r2]) + k, registers as they were at the start of the iteration
+	IDIOM_SYM_LOAD,		// value of loads[load] in this iteration
+};
+
+enum Idiom_form {
+	IDIOM_SCAN,	// no stores
+	IDIOM_COPY,	// stores of loaded values
+	IDIOM_FILL,	// stores of invariants
+};
+
+struct Idiom_sym {
+	uint8 kind;
+	uint8 r1, r2;
+	uint8 load;
+	uint32_t k;
+};
+
+struct Idiom_access {
+	Idiom_sym addr;	// IDIOM_SYM_REG
+	Idiom_sym value;	// stores
+	uint8 size;	// Memory_enum_size
+	uint8 sign;
+};
+
+struct Idiom_desc {
+	uint32 valid;
+	uint32 pc;			// loop start (block start)
+	uint32 guest_end;
+	uint32 cycles;		// one iteration that loops back
+	uint32 invert;		// loop goes on while the condition fails (test at the top)
+	int32_t step[16];	// per iteration step of the induction registers
+	Idiom_sym final[16];	// registers at the end of an iteration
+	uint32 nloads, nstores;
+	Idiom_access loads[IDIOM_MAX_ACCESS];
+	Idiom_access stores[IDIOM_MAX_ACCESS];
+
+	// exit test: cond on the flags of flagop(cmpa, cmpb)
+	uint8 flagop, flagmask, cond;
+	Idiom_sym cmpa, cmpb;
+
+	uint8 form;
+	uint32_t tilelow;	// lowest store offset
+	uint32 tilesize;	// bytes stored per iteration
+	uint32 copyload;	// IDIOM_COPY: the load stores[0] stores
+};
+
+uint32 Idiom_var_enabled = 1;
+uint32 Idiom_var_runs = 0;
+uint64_t Idiom_var_iterations = 0;
+uint64_t Idiom_var_bytes = 0;
+
+static Idiom_desc Idiom_var_descs[IDIOM_MAX_DESCS];
+
+#define IDIOM_SLOT(pc) (((pc) >> 1) & (IDIOM_MAX_DESCS - 1))
+
+// apsr bits each condition reads (by cond >> 1)
+static const uint8 Idiom_condflags[8] = {
+	IR_FLAG_Z, IR_FLAG_C, IR_FLAG_N, IR_FLAG_V, IR_FLAG_C | IR_FLAG_Z, IR_FLAG_N | IR_FLAG_V, IR_FLAG_NZ | IR_FLAG_V, 0
+};
+
+void Idiom_init() {
+	const char* env = getenv(IDIOM_ENV);
+	Idiom_var_enabled = !(env != NULL && strcmp(env, "0") == 0);
+	memset(Idiom_var_descs, 0, sizeof(Idiom_var_descs));
+}
+
+/*
+* symbolic values
+*/
+
+static Idiom_sym Idiom_sym_make(uint32 kind, uint32 r1, uint32 r2, uint32_t k) {
+	Idiom_sym sym;
+	sym.kind = (uint8)kind;
+	sym.r1 = (uint8)r1;
+	sym.r2 = (uint8)r2;
+	sym.load = 0;
+	sym.k = k;
+	return sym;
+}
+
+static Idiom_sym Idiom_add(Idiom_sym a, Idiom_sym b) {
+	if (a.kind == IDIOM_SYM_CONST && b.kind == IDIOM_SYM_REG) {
+		Idiom_sym t = a;
+		a = b;
+		b = t;
+	}
+	if (a.kind == IDIOM_SYM_CONST && b.kind == IDIOM_SYM_CONST) {
+		return Idiom_sym_make(IDIOM_SYM_CONST, IDIOM_NOREG, IDIOM_NOREG, a.k + b.k);
+	}
+	if (a.kind == IDIOM_SYM_REG && b.kind == IDIOM_SYM_CONST) {
+		a.k += b.k;
+		return a;
+	}
+	if (a.kind == IDIOM_SYM_REG && b.kind == IDIOM_SYM_REG && a.r2 == IDIOM_NOREG && b.r2 == IDIOM_NOREG) {
+		return Idiom_sym_make(IDIOM_SYM_REG, a.r1, b.r1, a.k + b.k);	// base + index
+	}
+	return Idiom_sym_make(IDIOM_SYM_UNKNOWN, IDIOM_NOREG, IDIOM_NOREG, 0);
+}
+
+static int32_t Idiom_step(Idiom_desc* desc, Idiom_sym* sym) {
+	if (sym->kind != IDIOM_SYM_REG) {
+		return 0;
+	}
+	return desc->step[sym->r1] + ((sym->r2 != IDIOM_NOREG) ? desc->step[sym->r2] : 0);
+}
+
+// only constants, loads and induction registers can be evaluated for any iteration
+static uint32 Idiom_known(Idiom_sym* sym, const uint32* induction) {
+	switch (sym->kind) {
+	case IDIOM_SYM_CONST:
+	case IDIOM_SYM_LOAD:
+		return 1;
+	case IDIOM_SYM_REG:
+		return induction[sym->r1] && (sym->r2 == IDIOM_NOREG || induction[sym->r2]);
+	default:
+		return 0;
+	}
+}
+
+static uint32_t Idiom_read(const uint8* p, uint32 sizetype, uint32 sign) {
+	switch (sizetype) {
+	case Memory_enum_size::u8: return sign ? (uint32_t)(int32_t)(int8_t)p[0] : p[0];
+	case Memory_enum_size::u16: {
+		uint32_t value = p[0] | (p[1] << 8);
+		return sign ? (uint32_t)(int32_t)(int16_t)value : value;
+	}
+	default: return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+	}
+}
+
+// sym in iteration i. loadhost: host address of every load in iteration 0
+static uint32_t Idiom_value(Idiom_desc* desc, Idiom_sym* sym, const uint32_t* R0, uint32_t i, uint8** loadhost) {
+	switch (sym->kind) {
+	case IDIOM_SYM_CONST:
+		return sym->k;
+	case IDIOM_SYM_REG: {
+		uint32_t value = R0[sym->r1] + (uint32_t)desc->step[sym->r1] * i + sym->k;
+		if (sym->r2 != IDIOM_NOREG) {
+			value += R0[sym->r2] + (uint32_t)desc->step[sym->r2] * i;
+		}
+		return value;
+	}
+	case IDIOM_SYM_LOAD: {
+		Idiom_access* load = &desc->loads[sym->load];
+		return Idiom_read(loadhost[sym->load] + (ptrdiff_t)Idiom_step(desc, &load->addr) * (ptrdiff_t)i, load->size, load->sign);
+	}
+	default:
+		return 0;
+	}
+}
+
+/*
+* matching
+*/
+
+// walk the block once over symbolic values. returns 0 if it is not a loop we can summarize
+static uint32 Idiom_analyze(IR_block* block, Idiom_desc* desc) {
+	static Idiom_sym T[IR_MAX_INST];
+	Idiom_sym cur[16];
+	Idiom_sym unknown = Idiom_sym_make(IDIOM_SYM_UNKNOWN, IDIOM_NOREG, IDIOM_NOREG, 0);
+	IR_inst* bcond = NULL;
+	IR_inst* exit = NULL;
+	uint8 before = 0, after = 0;	// flags written before / after the bcond
+
+	memset(desc, 0, sizeof(Idiom_desc));
+	for (uint32 r = 0; r < 16; r++) {
+		cur[r] = Idiom_sym_make(IDIOM_SYM_REG, r, IDIOM_NOREG, 0);
+	}
+
+	for (uint32 i = 0; i < block->count; i++) {
+		IR_inst* inst = &block->inst[i];
+		Idiom_sym a = (inst->a != IR_NOTEMP && inst->op != IR_INTERP) ? T[inst->a] : unknown;
+		Idiom_sym b = inst->bimm ? Idiom_sym_make(IDIOM_SYM_CONST, IDIOM_NOREG, IDIOM_NOREG, (uint32_t)inst->imm)
+			: (inst->b != IR_NOTEMP) ? T[inst->b] : unknown;
+
+		if (exit != NULL) {
+			return 0;	// nothing after the closing exit
+		}
+
+		switch (inst->op) {
+		case IR_NOP:
+			break;
+		case IR_CONST:
+			T[inst->t] = Idiom_sym_make(IDIOM_SYM_CONST, IDIOM_NOREG, IDIOM_NOREG, (uint32_t)inst->imm);
+			break;
+		case IR_GETREG:
+			T[inst->t] = cur[inst->reg];
+			break;
+		case IR_SETREG:
+			cur[inst->reg] = a;
+			break;
+		case IR_SETREGI:
+			cur[inst->reg] = Idiom_sym_make(IDIOM_SYM_CONST, IDIOM_NOREG, IDIOM_NOREG, (uint32_t)inst->imm);
+			break;
+		case IR_ADDREGI:
+			cur[inst->reg] = Idiom_add(cur[inst->reg], Idiom_sym_make(IDIOM_SYM_CONST, IDIOM_NOREG, IDIOM_NOREG, (uint32_t)inst->imm));
+			break;
+
+		case IR_ADD:
+			T[inst->t] = Idiom_add(a, b);
+			break;
+		case IR_SUB:
+			if (b.kind == IDIOM_SYM_CONST) {
+				b.k = 0 - b.k;
+				T[inst->t] = Idiom_add(a, b);
+			}
+			else {
+				T[inst->t] = unknown;
+			}
+			break;
+		case IR_AND:
+		case IR_OR:
+		case IR_XOR:
+		case IR_BIC:
+		case IR_MUL:
+		case IR_LSL:
+		case IR_LSR:
+		case IR_ASR:
+		case IR_ROR:
+		case IR_NOT:
+			if (a.kind == IDIOM_SYM_CONST && (inst->op == IR_NOT || b.kind == IDIOM_SYM_CONST)) {
+				T[inst->t] = Idiom_sym_make(IDIOM_SYM_CONST, IDIOM_NOREG, IDIOM_NOREG, (uint32_t)IR_alu(inst->op, a.k, b.k, 0));
+			}
+			else {
+				T[inst->t] = unknown;
+			}
+			break;
+		case IR_ADC:
+		case IR_SBC:
+		case IR_GETC:
+			return 0;	// reads the carry of the previous iteration
+
+		case IR_FLAGS_ADD:
+		case IR_FLAGS_SUB:
+		case IR_FLAGS_NZ:
+		case IR_FLAGS_SHIFTC:
+			// the last flag op before the bcond is the exit test, the others only need to be rewritten
+			// by the last iteration (see below)
+			if (bcond != NULL) {
+				after |= inst->flags;
+				break;
+			}
+			before |= inst->flags;
+			desc->flagop = inst->op;
+			desc->flagmask = inst->flags;
+			desc->cmpa = a;
+			desc->cmpb = (inst->op == IR_FLAGS_NZ) ? Idiom_sym_make(IDIOM_SYM_CONST, IDIOM_NOREG, IDIOM_NOREG, 0) : b;
+			break;
+
+		case IR_LOAD:
+			if (a.kind != IDIOM_SYM_REG || desc->nloads == IDIOM_MAX_ACCESS) {
+				return 0;
+			}
+			desc->loads[desc->nloads].addr = a;
+			desc->loads[desc->nloads].size = inst->size;
+			desc->loads[desc->nloads].sign = inst->sign;
+			T[inst->t] = Idiom_sym_make(IDIOM_SYM_LOAD, IDIOM_NOREG, IDIOM_NOREG, 0);
+			T[inst->t].load = (uint8)desc->nloads++;
+			break;
+		case IR_STORE:
+			if (a.kind != IDIOM_SYM_REG || b.kind == IDIOM_SYM_UNKNOWN || desc->nstores == IDIOM_MAX_ACCESS) {
+				return 0;
+			}
+			desc->stores[desc->nstores].addr = a;
+			desc->stores[desc->nstores].value = b;
+			desc->stores[desc->nstores].size = inst->size;
+			desc->nstores++;
+			break;
+
+		case IR_BCOND:
+			if (bcond != NULL || before == 0) {
+				return 0;
+			}
+			bcond = inst;
+			break;
+		case IR_EXIT:
+			exit = inst;
+			break;
+		default:	// IR_BRANCH, IR_INTERP
+			return 0;
+		}
+
+		if (bcond == inst && bcond->imm == block->guest_start) {
+			break;	// the iteration ends at the branch back, the block goes on past the loop
+		}
+	}
+
+	// bcond back to the start, or a test at the top and the way back at the bottom
+	if (bcond == NULL || (exit == NULL && bcond->imm != block->guest_start)) {
+		return 0;
+	}
+	if (bcond->imm == block->guest_start) {
+		desc->cycles = bcond->cycles;
+		desc->invert = 0;
+	}
+	else if (exit->imm == block->guest_start) {
+		desc->cycles = exit->cycles;
+		desc->invert = 1;
+	}
+	else {
+		return 0;
+	}
+	desc->cond = bcond->size;
+	if (desc->cycles == 0 || desc->flagop == IR_FLAGS_SHIFTC || (Idiom_condflags[desc->cond >> 1] & ~desc->flagmask) != 0) {
+		return 0;
+	}
+	// flags are never computed in bulk: the last iteration has to write all of them again before it leaves
+	if ((after & ~before) != 0) {
+		return 0;
+	}
+
+	// induction registers step by a constant, everything else has to be expressed in them
+	uint32 induction[16];
+	for (uint32 r = 0; r < 16; r++) {
+		desc->final[r] = cur[r];
+		induction[r] = (cur[r].kind == IDIOM_SYM_REG && cur[r].r1 == r && cur[r].r2 == IDIOM_NOREG);
+		desc->step[r] = induction[r] ? (int32_t)cur[r].k : 0;
+	}
+	for (uint32 r = 0; r < 16; r++) {
+		if (!Idiom_known(&desc->final[r], induction)) {
+			return 0;
+		}
+	}
+	if (!Idiom_known(&desc->cmpa, induction) || !Idiom_known(&desc->cmpb, induction)) {
+		return 0;
+	}
+	for (uint32 j = 0; j < desc->nloads; j++) {
+		if (!Idiom_known(&desc->loads[j].addr, induction) || Idiom_step(desc, &desc->loads[j].addr) == 0) {
+			return 0;	// a load that doesn't move is polling, not a loop over memory
+		}
+	}
+
+	if (desc->nstores == 0) {
+		desc->form = IDIOM_SCAN;
+		return 1;
+	}
+
+	// stores: one base, offsets that tile the step exactly
+	Idiom_access* first = &desc->stores[0];
+	int32_t step = Idiom_step(desc, &first->addr);
+	uint32 tilesize = (step < 0) ? (uint32)-step : (uint32)step;
+	uint32_t tilelow = first->addr.k;
+	uint64_t covered = 0;
+
+	if (!Idiom_known(&first->addr, induction) || tilesize == 0 || tilesize > IDIOM_MAX_ACCESS * 4) {
+		return 0;
+	}
+	for (uint32 j = 0; j < desc->nstores; j++) {
+		Idiom_access* store = &desc->stores[j];
+		if (store->addr.r1 != first->addr.r1 || store->addr.r2 != first->addr.r2) {
+			return 0;
+		}
+		if ((int32_t)(store->addr.k - tilelow) < 0) {
+			tilelow = store->addr.k;
+		}
+	}
+	for (uint32 j = 0; j < desc->nstores; j++) {
+		Idiom_access* store = &desc->stores[j];
+		uint32 offset = store->addr.k - tilelow;
+		uint64_t bytes = ((0x1ULL << (1 << store->size)) - 1) << offset;
+		if (offset + (1 << store->size) > tilesize || (covered & bytes) != 0) {
+			return 0;
+		}
+		covered |= bytes;
+	}
+	if (covered != ((tilesize == 64) ? ~0ULL : (0x1ULL << tilesize) - 1)) {
+		return 0;
+	}
+	desc->tilelow = tilelow;
+	desc->tilesize = tilesize;
+
+	if (first->value.kind == IDIOM_SYM_LOAD) {
+		// copy: every store stores a load of the same size, all at one distance from their store
+		Idiom_access* src = &desc->loads[first->value.load];
+		uint32_t delta = src->addr.k - first->addr.k;
+		for (uint32 j = 0; j < desc->nstores; j++) {
+			Idiom_access* store = &desc->stores[j];
+			if (store->value.kind != IDIOM_SYM_LOAD) {
+				return 0;
+			}
+			Idiom_access* load = &desc->loads[store->value.load];
+			if (load->size != store->size || load->addr.r1 != src->addr.r1 || load->addr.r2 != src->addr.r2
+				|| load->addr.k - store->addr.k != delta) {
+				return 0;
+			}
+		}
+		if (Idiom_step(desc, &src->addr) != step) {
+			return 0;
+		}
+		desc->form = IDIOM_COPY;
+		desc->copyload = first->value.load;
+		return 1;
+	}
+
+	// fill: invariants only
+	for (uint32 j = 0; j < desc->nstores; j++) {
+		Idiom_sym* value = &desc->stores[j].value;
+		if (value->kind == IDIOM_SYM_LOAD || !Idiom_known(value, induction) || Idiom_step(desc, value) != 0) {
+			return 0;
+		}
+	}
+	desc->form = IDIOM_FILL;
+	return 1;
+}
+
+uint32 Idiom_match(IR_block* block) {
+	static Idiom_desc desc;
+	if (!Idiom_var_enabled || block->count == 0) {
+		return 0;
+	}
+
+	// cheap test first: some exit has to come back here
+	uint32 loops = 0;
+	for (uint32 i = 0; i < block->count; i++) {
+		IR_inst* inst = &block->inst[i];
+		if ((inst->op == IR_BCOND || inst->op == IR_EXIT) && inst->imm == block->guest_start) {
+			loops = 1;
+			break;
+		}
+	}
+
+	uint32 slot = IDIOM_SLOT(block->guest_start);
+	if (!loops || !Idiom_analyze(block, &desc)) {
+		if (Idiom_var_descs[slot].pc == block->guest_start) {
+			Idiom_var_descs[slot].valid = 0;	// the code here changed
+		}
+		return 0;
+	}
+
+	desc.valid = 1;
+	desc.pc = block->guest_start;
+	desc.guest_end = block->guest_end;
+	Idiom_var_descs[slot] = desc;
+	return slot + 1;
+}
+
+/*
+* running
+*/
+
+// ConditionPassed() on the flags of the exit test in iteration i, and whether that means another iteration
+static uint32 Idiom_continues(Idiom_desc* desc, const uint32_t* R0, uint32_t i, uint8** loadhost) {
+	uint32_t a = Idiom_value(desc, &desc->cmpa, R0, i, loadhost);
+	uint32_t b = Idiom_value(desc, &desc->cmpb, R0, i, loadhost);
+	uint32_t result = a;
+	uint32 c = 0, v = 0;
+
+	switch (desc->flagop) {
+	case IR_FLAGS_SUB:
+		result = a - b;
+		c = (a >= b);
+		v = (((a ^ b) & (a ^ result)) >> 31) & 0x1;
+		break;
+	case IR_FLAGS_ADD:
+		result = a + b;
+		c = (result < a);
+		v = ((~(a ^ b) & (a ^ result)) >> 31) & 0x1;
+		break;
+	default:
+		break;
+	}
+
+	uint32 n = (result >> 31) & 0x1, z = (result == 0);
+	uint32 pass;
+	switch (desc->cond >> 1) {
+	case 0: pass = z; break;
+	case 1: pass = c; break;
+	case 2: pass = n; break;
+	case 3: pass = v; break;
+	case 4: pass = c && !z; break;
+	case 5: pass = (n == v); break;
+	case 6: pass = (n == v) && !z; break;
+	default: pass = 1; break;
+	}
+	if ((desc->cond & 0x1) && desc->cond != 0xF) {
+		pass = !pass;
+	}
+	return pass ^ desc->invert;
+}
+
+uint32 Idiom_run(uint32 handle, CPU_struct_reg* reg) {
+	if (handle == 0 || MPU_var_active || Memory_var_endianness != 0) {
+		return 0;
+	}
+	Idiom_desc* desc = &Idiom_var_descs[handle - 1];
+	if (!desc->valid || desc->pc != reg->R[15]) {
+		return 0;	// slot was taken by another loop since
+	}
+
+	uint32_t R0[16];
+	uint8* loadhost[IDIOM_MAX_ACCESS];
+	Memory_map_elem* storemap = NULL;
+	uint32 limit = IDIOM_MAX_CYCLES / desc->cycles;
+
+	for (uint32 r = 0; r < 16; r++) {
+		R0[r] = (uint32_t)reg->R[r];
+	}
+
+	// every access stays in one plain section for all iterations it is done in bulk
+	for (uint32 j = 0; j < desc->nloads + desc->nstores; j++) {
+		uint32 store = (j >= desc->nloads);
+		Idiom_access* access = store ? &desc->stores[j - desc->nloads] : &desc->loads[j];
+		uint32_t addr = Idiom_value(desc, &access->addr, R0, 0, NULL);
+		int32_t step = Idiom_step(desc, &access->addr);
+		uint32_t size = 1 << access->size;
+		Memory_map_elem* thismap = Memory_getMap(addr);
+
+		if ((addr & (size - 1)) != 0 || (step & (int32_t)(size - 1)) != 0 || thismap == NULL || !MEMORY_IS_DIRECT(thismap)
+			|| (thismap->attrib & (store ? MEMORY_ATTRIB_S_W : MEMORY_ATTRIB_S_R)) == 0) {
+			return 0;
+		}
+		uint32_t offset = addr - (uint32_t)thismap->base;
+		if ((uint64_t)offset + size > thismap->size) {
+			return 0;
+		}
+		uint32 n = (step > 0) ? ((uint32_t)thismap->size - size - offset) / (uint32_t)step + 1
+			: (step < 0) ? offset / (uint32_t)-step + 1 : limit;
+		limit = (n < limit) ? n : limit;
+
+		if (store) {
+			storemap = thismap;
+		}
+		else {
+			loadhost[j] = thismap->data + offset;
+		}
+	}
+
+	// how many iterations go round again
+	uint32 count = 0;
+	while (count < limit && Idiom_continues(desc, R0, count, loadhost)) {
+		count++;
+	}
+	if (count < IDIOM_MIN_ITERATIONS) {
+		return 0;
+	}
+
+	uint32_t dstaddr = 0, dstlow = 0, dstlen = 0;
+	if (desc->nstores != 0) {
+		int32_t step = Idiom_step(desc, &desc->stores[0].addr);
+		dstaddr = Idiom_value(desc, &desc->stores[0].addr, R0, 0, NULL);
+		dstlow = dstaddr - desc->stores[0].addr.k + desc->tilelow + ((step < 0) ? (uint32_t)step * (count - 1) : 0);
+		dstlen = count * desc->tilesize;
+
+		// over the loop itself, or over what it reads: leave it to the block
+		if (dstlow < desc->guest_end && desc->pc < dstlow + dstlen) {
+			return 0;
+		}
+		for (uint32 j = 0; j < desc->nloads; j++) {
+			int32_t lstep = Idiom_step(desc, &desc->loads[j].addr);
+			uint32_t laddr = Idiom_value(desc, &desc->loads[j].addr, R0, 0, NULL);
+			uint32_t llow = laddr + ((lstep < 0) ? (uint32_t)lstep * (count - 1) : 0);
+			uint32_t lhigh = llow + ((lstep < 0) ? (uint32_t)-lstep : (uint32_t)lstep) * (count - 1) + (1 << desc->loads[j].size);
+			if (llow < dstlow + dstlen && dstlow < lhigh) {
+				return 0;
+			}
+		}
+	}
+
+	// registers after 'count' iterations, while the sources are still as they were
+	uint32_t after[16];
+	for (uint32 r = 0; r < 15; r++) {
+		after[r] = Idiom_value(desc, &desc->final[r], R0, count - 1, loadhost);
+	}
+
+	if (desc->nstores != 0) {
+		uint8* dst = storemap->data + (dstlow - (uint32_t)storemap->base);
+
+		// smc: code translated from the destination goes
+		if (storemap->jit_pagemap != NULL) {
+			uint32_t firstpage = dstlow - (uint32_t)storemap->base;
+			for (uint32_t page = firstpage; page < firstpage + dstlen; page = (page | ((1 << MEMORY_CODEPAGE_SHIFT) - 1)) + 1) {
+				if (MEMORY_CODEPAGE_TEST(storemap->jit_pagemap, page)) {
+					JitCache_invalidate(dstlow, dstlen);
+					break;
+				}
+			}
+		}
+		FUZZ_DIRTY(storemap, dstlow - (uint32_t)storemap->base, dstlen);
+
+		if (desc->form == IDIOM_COPY) {
+			memcpy(dst, loadhost[desc->copyload] + (int32_t)(dstlow - dstaddr), dstlen);
+		}
+		else {
+			uint8 tile[IDIOM_MAX_ACCESS * 4];
+			for (uint32 j = 0; j < desc->nstores; j++) {
+				Idiom_access* store = &desc->stores[j];
+				uint32_t value = Idiom_value(desc, &store->value, R0, 0, NULL);
+				for (uint32 byte = 0; byte < (uint32)(1 << store->size); byte++) {
+					tile[store->addr.k - desc->tilelow + byte] = (uint8)(value >> (byte * 8));
+				}
+			}
+			uint32 uniform = 1;
+			for (uint32 byte = 1; byte < desc->tilesize; byte++) {
+				uniform &= (tile[byte] == tile[0]);
+			}
+			if (uniform) {
+				memset(dst, tile[0], dstlen);
+			}
+			else {
+				for (uint32 i = 0; i < count; i++) {
+					memcpy(dst + i * desc->tilesize, tile, desc->tilesize);
+				}
+			}
+		}
+		Idiom_var_bytes += dstlen;
+	}
+
+	for (uint32 r = 0; r < 15; r++) {
+		reg->R[r] = after[r];
+	}
+
+	Idiom_var_runs += 1;
+	Idiom_var_iterations += count;
+	return count * desc->cycles;
+}
+
+void Idiom_dump() {
+	if (Idiom_var_runs == 0) {
+		return;
+	}
+	printf("idiom: %d loops run in bulk, %llu iterations, %llu bytes stored\n", (int)Idiom_var_runs,
+		(unsigned long long)Idiom_var_iterations, (unsigned long long)Idiom_var_bytes);
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include "Proxy.hpp"
+#include "Memory.hpp"
+#include "CPU.hpp"
+#include "IR.hpp"
+
+/*
+* idiom recognition: copy / fill / scan loops run as one host memcpy / memset / scan
+*
+* a candidate is a block that loops to itself (bcond back to its start, or a test at the top and
+* a branch back at the bottom). Idiom_match evaluates it once symbolically over the start values of the registers:
+* - every register ends the iteration as a constant, a load of this iteration, or R[x] (+ R[y]) + k,
+*   where x, y only ever step by a constant (induction variables, invariants have step 0)
+* - loads and stores address R[x] (+ R[y]) + k
+* - the last flag op before the bcond (cmp / subs / ...) decides the loop, on such values
+* - stores tile their stride exactly (str / strb / strh / stm, one or more per iteration), and store either
+*   values of this iteration's loads at a fixed distance (copy) or invariants (fill). no stores: scan
+*   (strlen, delay loops)
+* that covers the compiler's byte / word loops, the startup .data copy and .bss clear, newlib's small
+* memcpy / memset / strlen, and ldmia / stmia block copies (lowered to plain loads and stores).
+*
+* Idiom_run then works out how many full iterations the loop makes from the exit test alone, resolves
+* every access to host memory of one plain section, and does them in bulk:
+* - guest cycles: iterations * the cycles of the exit that loops back, exactly what running them costs.
+* - registers are set to what they hold after those iterations. the last iteration (the one that leaves)
+*   always runs normally, so the flags and the exit come out of the block itself.
+* - anything it can't prove (mmio, section edges, unaligned, overlapping source and destination,
+*   mpu enabled, stores over the loop itself) is left to the normal path.
+* - at most IDIOM_MAX_CYCLES per run, so the rest of the emulator still sees time pass in slices.
+*
+* MICROCON_EMU_IDIOM=0 turns it off (cycle counts must come out the same either way).
+*/
+
+#define IDIOM_ENV "MICROCON_EMU_IDIOM"
+#define IDIOM_MAX_ACCESS 8	// loads, and stores, per iteration
+#define IDIOM_MAX_DESCS 64	// descriptor slots, by pc
+#define IDIOM_MIN_ITERATIONS 4	// fewer isn't worth the setup
+#define IDIOM_MAX_CYCLES 0x1000	// guest cycles per run
+
+extern uint32 Idiom_var_enabled;
+
+// telemetry
+extern uint32 Idiom_var_runs;
+extern uint64_t Idiom_var_iterations;	// iterations done in bulk
+extern uint64_t Idiom_var_bytes;	// bytes stored in bulk
+
+extern void Idiom_init();
+
+// look for a copy / fill / scan loop in a lowered, optimized block. returns a handle, 0 if it isn't one
+extern uint32 Idiom_match(IR_block* block);
+
+// run all but the last iteration of a matched loop on reg (pc at the loop). returns the guest cycles spent,
+// 0 if nothing was done. the block still has to run after it
+extern uint32 Idiom_run(uint32 handle, CPU_struct_reg* reg);
+
+// telemetry at exit
+extern void Idiom_dump();
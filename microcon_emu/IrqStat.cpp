@@ -0,0 +1,191 @@
+#include "IrqStat.hpp"
+
+struct IrqStat_exception* IrqStat_var_exc[IRQSTAT_MAX_EXCEPTIONS];
+
+uint32 IrqStat_var_current = 0;
+uint32 IrqStat_var_exiting = IRQSTAT_NONE;
+
+// active exceptions, innermost last
+#define IRQSTAT_MAX_NEST 64
+static uint32 IrqStat_var_stack[IRQSTAT_MAX_NEST];
+static uint32 IrqStat_var_depth = 0;
+
+static const char* IrqStat_var_kindname[IRQSTAT_KINDS] = { "entry", "resume" };
+
+static IrqStat_exception* IrqStat_exc(uint32 exception) {
+	exception &= IRQSTAT_MAX_EXCEPTIONS - 1;
+	if (IrqStat_var_exc[exception] == NULL) {
+		IrqStat_var_exc[exception] = (IrqStat_exception*)ecalloc(1, sizeof(IrqStat_exception));
+		for (uint32 k = 0; k < IRQSTAT_KINDS; k++) {
+			IrqStat_var_exc[exception]->hist[k].min = 0xFFFFFFFF;
+		}
+	}
+	return IrqStat_var_exc[exception];
+}
+
+static uint32 IrqStat_bucket(uint32 value) {
+	if (value < IRQSTAT_SUB_COUNT) {
+		return value;
+	}
+	uint32 msb = IRQSTAT_SUB_BITS;
+	while (msb < 31 && (value >> (msb + 1)) != 0) {
+		msb += 1;
+	}
+	uint32 e = msb - IRQSTAT_SUB_BITS + 1;
+	return IRQSTAT_SUB_COUNT + (e - 1) * IRQSTAT_HALF_COUNT + ((value >> e) - IRQSTAT_HALF_COUNT);
+}
+
+// highest value that lands in bucket idx
+static uint32 IrqStat_bucket_top(uint32 idx) {
+	if (idx < IRQSTAT_SUB_COUNT) {
+		return idx;
+	}
+	uint32 e = (idx - IRQSTAT_SUB_COUNT) / IRQSTAT_HALF_COUNT + 1;
+	uint64_t sub = (idx - IRQSTAT_SUB_COUNT) % IRQSTAT_HALF_COUNT + IRQSTAT_HALF_COUNT;
+	return (uint32)(((sub + 1) << e) - 1);
+}
+
+static void IrqStat_record(IrqStat_hist* hist, uint64_t cycles) {
+	uint32 value = (cycles > 0xFFFFFFFF) ? 0xFFFFFFFF : (uint32)cycles;
+	hist->count[IrqStat_bucket(value)] += 1;
+	hist->samples += 1;
+	hist->total += value;
+	if (value < hist->min) {
+		hist->min = value;
+	}
+	if (value > hist->max) {
+		hist->max = value;
+	}
+}
+
+void IrqStat_init() {
+	for (uint32 i = 0; i < IRQSTAT_MAX_EXCEPTIONS; i++) {
+		if (IrqStat_var_exc[i] != NULL) {
+			efree(IrqStat_var_exc[i]);
+			IrqStat_var_exc[i] = NULL;
+		}
+	}
+	IrqStat_var_current = 0;
+	IrqStat_var_exiting = IRQSTAT_NONE;
+	IrqStat_var_depth = 0;
+}
+
+void IrqStat_assert(uint32 exception) {
+	IrqStat_exception* exc = IrqStat_exc(exception);
+	if (!exc->pending) {
+		exc->pending = 1;
+		exc->asserted_at = CPU_var_cycles;
+	}
+}
+
+void IrqStat_exit(uint32 exception) {
+	IrqStat_exc(exception)->exit_at = CPU_var_cycles;
+	IrqStat_var_exiting = exception;
+}
+
+void IrqStat_step(CPU_struct_reg* reg) {
+	uint32 now = reg->xPSR.IPSR.exception;
+
+	// whatever runs now is the resumption after the handler that returned
+	if (IrqStat_var_exiting != IRQSTAT_NONE) {
+		IrqStat_exception* exc = IrqStat_exc(IrqStat_var_exiting);
+		IrqStat_record(&exc->hist[IRQSTAT_RESUME], CPU_var_cycles - exc->exit_at);
+		if (IrqStat_var_depth > 0 && IrqStat_var_stack[IrqStat_var_depth - 1] == IrqStat_var_exiting) {
+			IrqStat_var_depth -= 1;
+		}
+		IrqStat_var_exiting = IRQSTAT_NONE;
+	}
+
+	if (now == IrqStat_var_current) {
+		return;
+	}
+	IrqStat_var_current = now;
+
+	// back in something that was preempted -> everything above it returned
+	if (now == 0) {
+		IrqStat_var_depth = 0;
+		return;
+	}
+	for (uint32 i = IrqStat_var_depth; i-- > 0;) {
+		if (IrqStat_var_stack[i] == now) {
+			IrqStat_var_depth = i + 1;
+			return;
+		}
+	}
+
+	// first instruction of a new handler
+	IrqStat_exception* exc = IrqStat_exc(now);
+	if (exc->pending) {
+		IrqStat_record(&exc->hist[IRQSTAT_ENTRY], CPU_var_cycles - exc->asserted_at);
+		exc->pending = 0;
+	}
+	else {
+		exc->unasserted += 1;
+	}
+	if (IrqStat_var_depth < IRQSTAT_MAX_NEST) {
+		IrqStat_var_stack[IrqStat_var_depth++] = now;
+	}
+}
+
+IrqStat_hist* IrqStat_get(uint32 exception, uint32 kind) {
+	if (exception >= IRQSTAT_MAX_EXCEPTIONS || kind >= IRQSTAT_KINDS || IrqStat_var_exc[exception] == NULL) {
+		return NULL;
+	}
+	return &IrqStat_var_exc[exception]->hist[kind];
+}
+
+uint32 IrqStat_percentile(IrqStat_hist* hist, double percentile) {
+	if (hist == NULL || hist->samples == 0) {
+		return 0;
+	}
+	uint64_t target = (uint64_t)((percentile / 100.0) * hist->samples + 0.5);
+	if (target < 1) {
+		target = 1;
+	}
+
+	uint64_t seen = 0;
+	for (uint32 i = 0; i < IRQSTAT_BUCKETS; i++) {
+		seen += hist->count[i];
+		if (seen >= target) {
+			uint32 top = IrqStat_bucket_top(i);
+			return (top > hist->max) ? hist->max : top;
+		}
+	}
+	return hist->max;
+}
+
+void IrqStat_dump() {
+	uint32 header = 0;
+
+	for (uint32 i = 0; i < IRQSTAT_MAX_EXCEPTIONS; i++) {
+		IrqStat_exception* exc = IrqStat_var_exc[i];
+		if (exc == NULL) {
+			continue;
+		}
+		if (!header) {
+			printf("interrupt latency (cpu cycles)\n");
+			printf("%-8s %-7s %8s %8s %8s %8s %8s %8s %8s %10s\n", "exc", "kind", "samples", "min", "p50", "p90", "p99", "p99.9", "max", "mean");
+			header = 1;
+		}
+
+		for (uint32 k = 0; k < IRQSTAT_KINDS; k++) {
+			IrqStat_hist* hist = &exc->hist[k];
+			if (hist->samples == 0) {
+				continue;
+			}
+			char name[16];
+			if (i >= 16) {
+				snprintf(name, sizeof(name), "irq%d", (int)(i - 16));
+			}
+			else {
+				snprintf(name, sizeof(name), "exc%d", (int)i);
+			}
+			printf("%-8s %-7s %8d %8d %8d %8d %8d %8d %8d %10.1f\n", name, IrqStat_var_kindname[k], (int)hist->samples, (int)hist->min,
+				(int)IrqStat_percentile(hist, 50.0), (int)IrqStat_percentile(hist, 90.0), (int)IrqStat_percentile(hist, 99.0),
+				(int)IrqStat_percentile(hist, 99.9), (int)hist->max, (double)hist->total / hist->samples);
+		}
+		if (exc->unasserted != 0) {
+			printf("%-8s %d entries without a recorded assertion\n", "", (int)exc->unasserted);
+		}
+	}
+}
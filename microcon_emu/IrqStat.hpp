@@ -0,0 +1,76 @@
+#pragma once
+#include "Proxy.hpp"
+#include "CPU.hpp"
+
+/*
+* interrupt latency and jitter instrumentation
+*
+* per exception number (16 + irq for external interrupts), in simulated cpu cycles (CPU_var_cycles):
+* - entry: assertion -> first instruction of the handler
+* - resume: handler exit (exception return) -> first instruction executed after it
+*   (the interrupted code, or the next handler when tail chaining). the unstacking (CPU_EXIT_CYCLES) at least
+*
+* events:
+* - assertion: IrqStat_assert(), from Nvic_pend: software pends (NVIC_ISPR, STIR, ICSR set-pending bits)
+*   and peripherals raising their line, and from Fault_take for faults (the one taken, after escalation).
+*   an already pending exception keeps its first assertion time, like the nvic keeps one pending bit.
+* - entry / resume: IrqStat_step() runs before every block and compares IPSR with the exception it saw last.
+*   nothing to do (one compare) unless it changed or a handler just returned.
+* - exit: a block that leaves with an EXC_RETURN value in pc (0xFxxxxxxx) while in handler mode.
+*
+* histograms (hdr style, log linear):
+* - values below 2^IRQSTAT_SUB_BITS get their own bucket, above that every power of two is split into
+*   2^(IRQSTAT_SUB_BITS - 1) buckets. relative error stays below 1 / 2^(IRQSTAT_SUB_BITS - 1) (~6%)
+*   across the whole range, with min / max / mean kept exactly.
+* - allocated on the first event of an exception, so only exceptions that fire cost memory.
+* - IrqStat_dump() prints them all at exit.
+*/
+
+#define IRQSTAT_MAX_EXCEPTIONS 512	// IPSR is 9 bits
+#define IRQSTAT_SUB_BITS 5
+#define IRQSTAT_SUB_COUNT (0x1 << IRQSTAT_SUB_BITS)
+#define IRQSTAT_HALF_COUNT (IRQSTAT_SUB_COUNT >> 1)
+#define IRQSTAT_BUCKETS (IRQSTAT_SUB_COUNT + (32 - IRQSTAT_SUB_BITS + 1) * IRQSTAT_HALF_COUNT)
+#define IRQSTAT_NONE 0xFFFFFFFF
+
+enum IrqStat_kind_enum { IRQSTAT_ENTRY, IRQSTAT_RESUME, IRQSTAT_KINDS };
+
+struct IrqStat_hist {
+	uint32 count[IRQSTAT_BUCKETS];
+	uint32 samples;
+	uint32 min;
+	uint32 max;
+	uint64_t total;
+};
+
+struct IrqStat_exception {
+	struct IrqStat_hist hist[IRQSTAT_KINDS];
+	uint64_t asserted_at;
+	uint32 pending;		// asserted_at is valid
+	uint32 unasserted;	// entries without a recorded assertion
+	uint64_t exit_at;
+};
+
+extern struct IrqStat_exception* IrqStat_var_exc[IRQSTAT_MAX_EXCEPTIONS];
+
+extern uint32 IrqStat_var_current;	// IPSR seen before the last block
+extern uint32 IrqStat_var_exiting;	// exception whose handler just returned, IRQSTAT_NONE if none
+
+extern void IrqStat_init();
+
+// an exception became pending
+extern void IrqStat_assert(uint32 exception);
+
+// before every block / after every block
+#define IRQSTAT_STEP(reg) if ((reg)->xPSR.IPSR.exception != IrqStat_var_current || IrqStat_var_exiting != IRQSTAT_NONE) IrqStat_step(reg)
+#define IRQSTAT_AFTER(reg) if ((reg)->xPSR.IPSR.exception != 0 && ((reg)->R[15] & 0xF0000000) == 0xF0000000) IrqStat_exit((reg)->xPSR.IPSR.exception)
+extern void IrqStat_step(CPU_struct_reg* reg);
+extern void IrqStat_exit(uint32 exception);
+
+// api: histogram of one exception (NULL if it never fired)
+extern IrqStat_hist* IrqStat_get(uint32 exception, uint32 kind);
+// value at percentile (0 ~ 100). highest value equivalent to the bucket, like hdr
+extern uint32 IrqStat_percentile(IrqStat_hist* hist, double percentile);
+
+// print every exception that fired
+extern void IrqStat_dump();
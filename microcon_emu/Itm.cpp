@@ -0,0 +1,239 @@
+#include "Itm.hpp"
+#include "Memory.hpp"
+#include "Dwt.hpp"	// DWT_DEMCR
+#include <stdlib.h>	// getenv
+#include <string.h>
+#include <atomic>
+#if !defined(_MSC_VER)
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>	// close
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0	// macos: SO_NOSIGPIPE on the socket instead
+#endif
+#endif
+
+struct Itm_record {
+	uint32_t data;
+	uint8 port;
+	uint8 size;	// bytes
+};
+
+uint32 Itm_var_enabled = 0;
+
+uint32 Itm_var_packets = 0;
+uint32 Itm_var_lost = 0;
+
+static uint32 Itm_var_ter = 0;
+static uint32 Itm_var_tcr = 0;
+static uint32 Itm_var_trcena = 0;
+
+static Itm_record* Itm_var_ring = NULL;	// host heap
+static std::atomic<uint32_t> Itm_var_head(0);	// next record to fill (cpu thread)
+static std::atomic<uint32_t> Itm_var_tail(0);	// next record to drain (drain thread)
+
+static std::atomic<uint32_t> Itm_var_stop(0);
+static Thread_data Itm_var_thread_data;
+static thread_handle_t Itm_var_thread;
+
+// where packets go: one file per port, or one socket
+static const char* Itm_var_dir = NULL;
+static FILE* Itm_var_files[ITM_PORTS];
+static int Itm_var_socket = -1;
+
+static uint32 Itm_load32(uint32 addr) {
+	Memory_map_elem* thismap = Memory_getMap(addr);
+	if (thismap == NULL || addr + 4 > thismap->base + thismap->size) {
+		return 0;
+	}
+	uint8* data = &thismap->data[addr - thismap->base];
+	return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32)data[3] << 24);
+}
+
+static void Itm_output(Itm_record* record) {
+	uint8 bytes[5];
+	for (uint32 i = 0; i < record->size; i++) {
+		bytes[i + 1] = (uint8)((record->data >> (i * 8)) & 0xFF);
+	}
+
+	if (Itm_var_dir != NULL) {
+		FILE** fp = &Itm_var_files[record->port];
+		if (*fp == NULL) {
+			char path[1024];
+			snprintf(path, sizeof(path), "%s/itm%d.txt", Itm_var_dir, (int)record->port);
+			*fp = fopen(path, "ab");
+			if (*fp == NULL) {
+				eprintf("itm: can't write %s\n", path);
+				return;
+			}
+		}
+		fwrite(&bytes[1], 1, record->size, *fp);
+		return;
+	}
+
+#if !defined(_MSC_VER)
+	if (Itm_var_socket >= 0) {
+		// swit header: port, then the payload size as 1, 2, 3
+		bytes[0] = (uint8)((record->port << 3) | ((record->size == 4) ? 3 : record->size));
+		// a reader that went away is an error here, not a SIGPIPE for the whole emulator
+		if (send(Itm_var_socket, bytes, record->size + 1, MSG_NOSIGNAL) < 0) {
+			eprintf("itm: socket closed, no more trace\n");
+			close(Itm_var_socket);
+			Itm_var_socket = -1;
+		}
+	}
+#endif
+}
+
+static void Itm_flush() {
+	for (uint32 i = 0; i < ITM_PORTS; i++) {
+		if (Itm_var_files[i] != NULL) {
+			fflush(Itm_var_files[i]);
+		}
+	}
+}
+
+// everything up to head, returns how many
+static uint32 Itm_drain() {
+	uint32 tail = Itm_var_tail.load(std::memory_order_relaxed);
+	uint32 head = Itm_var_head.load(std::memory_order_acquire);
+	uint32 count = head - tail;
+
+	for (; tail != head; tail++) {
+		Itm_output(&Itm_var_ring[tail & (ITM_RING_SIZE - 1)]);
+	}
+	Itm_var_tail.store(tail, std::memory_order_release);
+	return count;
+}
+
+// drain thread: writes whatever is there, flushes and sleeps when there is nothing
+static void Itm_worker() {
+	while (!Itm_var_stop.load(std::memory_order_acquire)) {
+		if (Itm_drain() == 0) {
+			Itm_flush();
+			Clock_sleep(1);
+		}
+	}
+}
+
+void Itm_init() {
+	const char* env = getenv(ITM_ENV);
+	Itm_var_enabled = 0;
+	Itm_var_packets = 0;
+	Itm_var_lost = 0;
+	Itm_var_ter = 0;
+	Itm_var_tcr = 0;
+	Itm_var_trcena = 0;
+	Itm_var_dir = NULL;
+	Itm_var_socket = -1;
+	memset(Itm_var_files, 0, sizeof(Itm_var_files));
+	Itm_var_head.store(0);
+	Itm_var_tail.store(0);
+	if (env == NULL || env[0] == '\0') {
+		return;
+	}
+
+	if (strncmp(env, ITM_SOCKET_PREFIX, strlen(ITM_SOCKET_PREFIX)) == 0) {
+#if !defined(_MSC_VER)
+		const char* path = env + strlen(ITM_SOCKET_PREFIX);
+		struct sockaddr_un addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sun_family = AF_UNIX;
+		strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+		Itm_var_socket = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (Itm_var_socket < 0 || connect(Itm_var_socket, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+			eprintf("itm: can't connect to %s\n", path);
+			if (Itm_var_socket >= 0) {
+				close(Itm_var_socket);
+				Itm_var_socket = -1;
+			}
+			return;
+		}
+#ifdef SO_NOSIGPIPE
+		int on = 1;
+		setsockopt(Itm_var_socket, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+#else
+		eprintf("itm: no local sockets on this host, give a directory\n");
+		return;
+#endif
+	}
+	else {
+		Itm_var_dir = env;
+	}
+
+	Itm_var_ring = new Itm_record[ITM_RING_SIZE];
+	Itm_var_enabled = 1;
+	Itm_var_stop.store(0);
+	Itm_var_thread_data.func = Itm_worker;
+	Itm_var_thread_data.param1 = 0;
+	Itm_var_thread_data.param2 = 0;
+	Itm_var_thread = make_thread(&Itm_var_thread_data);
+}
+
+static uint32 Itm_full() {
+	return Itm_var_head.load(std::memory_order_relaxed) - Itm_var_tail.load(std::memory_order_acquire) == ITM_RING_SIZE;
+}
+
+void Itm_read(uint32 addr, uint32) {
+	Memory_map_elem* thismap = Memory_getMap(addr & ~0x3);
+	if (thismap == NULL || (addr & ~0x3) + 4 > thismap->base + thismap->size) {
+		return;
+	}
+	// FIFOREADY, the rest of the word reads 0
+	uint8* data = &thismap->data[(addr & ~0x3) - thismap->base];
+	data[0] = (Itm_var_enabled && Itm_full()) ? 0 : 1;
+	data[1] = data[2] = data[3] = 0;
+}
+
+void Itm_write(uint32 addr, uint32 width, uint32 data) {
+	if (addr >= ITM_BASE && addr < ITM_BASE + ITM_PORTS * 4) {
+		uint32 port = (addr - ITM_BASE) >> 2;
+		if (!Itm_var_enabled || !Itm_var_trcena || !(Itm_var_tcr & ITM_TCR_ITMENA) || !((Itm_var_ter >> port) & 0x1)) {
+			return;
+		}
+		if (Itm_full()) {
+			Itm_var_lost += 1;
+			return;
+		}
+		uint32 head = Itm_var_head.load(std::memory_order_relaxed);
+		Itm_record* record = &Itm_var_ring[head & (ITM_RING_SIZE - 1)];
+		record->data = (uint32_t)((width == 4) ? data : data & ((0x1 << (width * 8)) - 1));
+		record->port = (uint8)port;
+		record->size = (uint8)width;
+		Itm_var_head.store(head + 1, std::memory_order_release);
+		Itm_var_packets += 1;
+		return;
+	}
+
+	// the enables are kept here, a packet should not cost three lookups
+	Itm_var_ter = Itm_load32(ITM_TER);
+	Itm_var_tcr = Itm_load32(ITM_TCR);
+	Itm_var_trcena = Itm_load32(DWT_DEMCR) & DWT_DEMCR_TRCENA;
+}
+
+void Itm_shutdown() {
+	if (!Itm_var_enabled) {
+		return;
+	}
+	Itm_var_stop.store(1, std::memory_order_release);
+	wait_thread(Itm_var_thread);
+	Itm_drain();
+
+	for (uint32 i = 0; i < ITM_PORTS; i++) {
+		if (Itm_var_files[i] != NULL) {
+			fclose(Itm_var_files[i]);
+			Itm_var_files[i] = NULL;
+		}
+	}
+#if !defined(_MSC_VER)
+	if (Itm_var_socket >= 0) {
+		close(Itm_var_socket);
+		Itm_var_socket = -1;
+	}
+#endif
+	delete[] Itm_var_ring;
+	Itm_var_ring = NULL;
+	Itm_var_enabled = 0;
+	printf("itm: %d packets, %d lost to a full buffer\n", (int)Itm_var_packets, (int)Itm_var_lost);
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include "Proxy.hpp"
+
+/*
+* instrumentation trace macrocell: stimulus ports, buffered host output
+*
+* registers (ppb):
+* - 0xE0000000 + 4n ITM_STIM[n], n < ITM_PORTS: a write of 1, 2 or 4 bytes is one trace packet on port n.
+*   reads give FIFOREADY (bit 0): 0 while the ring below is full, the packet written then is lost, like on the chip.
+* - 0xE0000E00 ITM_TER: port enables
+* - 0xE0000E80 ITM_TCR: ITMENA(0)
+* - DEMCR.TRCENA (Dwt.hpp) has to be set as well. a packet on a disabled port is dropped without a trace.
+*
+* the cpu thread never does io for a packet: the write hook (Board_var_peris) puts port, size and payload into a
+* single producer / single consumer ring of ITM_RING_SIZE records and moves on. a host thread drains it:
+* - MICROCON_EMU_ITM=<dir>: the payload bytes of port n, little endian, appended to <dir>/itm<n>.txt
+*   (files opened on the first packet of their port).
+* - MICROCON_EMU_ITM=unix:<path>: one stream of swit packets to the local socket at path (posix hosts), the way
+*   swo carries them: header (port << 3 | 1, 2, 3 for 1, 2, 4 bytes) then the payload. itmdump, orbuculum read it.
+* head is only written by the cpu thread and tail only by the drain thread, each with release, read with acquire,
+* so a record is complete before the other side sees it. the drain thread sleeps a millisecond when the ring is empty.
+* Itm_shutdown drains what is left and closes everything.
+*/
+
+#define ITM_ENV "MICROCON_EMU_ITM"
+#define ITM_SOCKET_PREFIX "unix:"
+#define ITM_PORTS 32
+#define ITM_RING_SIZE 65536	// records, power of 2
+
+#define ITM_BASE 0xE0000000
+#define ITM_TER 0xE0000E00
+#define ITM_TCR 0xE0000E80
+#define ITM_TCR_ITMENA 0x1
+
+extern uint32 Itm_var_enabled;
+
+// telemetry
+extern uint32 Itm_var_packets;	// put into the ring
+extern uint32 Itm_var_lost;	// ring full
+
+// after Memory_init. starts the drain thread if MICROCON_EMU_ITM says where to
+extern void Itm_init();
+
+// Memory_read of a stimulus port: FIFOREADY in place
+extern void Itm_read(uint32 addr, uint32 width);
+
+// Memory_write: a stimulus port, ITM_TER, ITM_TCR or DEMCR
+extern void Itm_write(uint32 addr, uint32 width, uint32 data);
+
+// drain, stop the thread, close files / socket
+extern void Itm_shutdown();
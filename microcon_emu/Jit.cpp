@@ -0,0 +1,667 @@
+#include "Jit.hpp"
+#include "Fault.hpp"
+
+static X86Emitter Jit_var_emitter;
+
+JitCache_reloc Jit_var_relocs[JIT_MAX_RELOCS];
+uint32 Jit_var_nrelocs = 0;
+
+static uint32 Jit_addr(void* ptr) {
+	return (uint32_t)(uintptr_t)ptr;
+}
+
+uint32_t Jit_symbol(uint32 symbol) {
+	if (symbol >= JIT_RELOC_FUZZMAP) {
+		return Jit_addr(Memory_var_arr[symbol - JIT_RELOC_FUZZMAP].fuzz_clean);
+	}
+	if (symbol >= JIT_RELOC_PAGEMAP) {
+		return Jit_addr(JitCache_pagemap(&Memory_var_arr[symbol - JIT_RELOC_PAGEMAP]));
+	}
+	if (symbol >= JIT_RELOC_SECTIONDATA) {
+		return Jit_addr(Memory_var_arr[symbol - JIT_RELOC_SECTIONDATA].data);
+	}
+
+	switch (symbol) {
+	case JIT_RELOC_TEMPS: return Jit_addr(IR_var_temps);
+	case JIT_RELOC_RETIRED: return Jit_addr(&IR_var_retired);
+	case JIT_RELOC_ELAPSED: return Jit_addr(&IR_var_elapsed);
+	case JIT_RELOC_CPUREG: return Jit_addr(CPU_var_reg);
+	case JIT_RELOC_SLOWREAD: return Jit_addr((void*)&Jit_slowRead);
+	case JIT_RELOC_SLOWWRITE: return Jit_addr((void*)&Jit_slowWrite);
+	case JIT_RELOC_ALU: return Jit_addr((void*)&IR_alu);
+	case JIT_RELOC_SETFLAGS: return Jit_addr((void*)&IR_setflags);
+	case JIT_RELOC_COND: return Jit_addr((void*)&IR_cond);
+	case JIT_RELOC_INTERP: return Jit_addr((void*)&IR_interp);
+	default:
+		break;
+	}
+	return 0;
+}
+
+// the instruction just emitted ends with an address inside symbol
+static void Jit_reloc(vect8* code, uint32 symbol) {
+	m_assert(Jit_var_nrelocs < JIT_MAX_RELOCS, "jit: too many relocations in one block\n");
+	Jit_var_relocs[Jit_var_nrelocs].offset = (uint32_t)(code->size() - 4);
+	Jit_var_relocs[Jit_var_nrelocs].symbol = (uint32_t)symbol;
+	Jit_var_nrelocs += 1;
+}
+
+uint32 Jit_slowRead(uint32 addr, uint32 sizetype, uint32 attrib) {
+	uint8* data = (uint8*)Memory_read(addr, (Memory_enum_size)sizetype, attrib);
+	if (data == NULL) {
+		// under CPU_slice this does not come back (Fault.hpp). otherwise Memory_var_access_err is left for the caller
+		FAULT_ACCESS(addr, attrib);
+		return 0;
+	}
+
+	switch (sizetype) {
+	case Memory_enum_size::u8:
+		return data[0];
+	case Memory_enum_size::u16:
+		return data[0] | (data[1] << 8);
+	case Memory_enum_size::u32:
+		return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32)data[3] << 24);
+	default:
+		break;
+	}
+	return 0;
+}
+
+void Jit_slowWrite(uint32 addr, uint32 data, uint32 sizetype, uint32 attrib) {
+	Memory_write(addr, (Memory_enum_size)sizetype, data, attrib);
+	if (Memory_var_access_err != 0) {
+		FAULT_ACCESS(addr, attrib);
+	}
+}
+
+// point the jcc/jmp emitted at pos (oplen bytes long, rel8 or rel32) to target
+static void Jit_patch(vect8* block, uint32 pos, uint32 target, uint32 oplen) {
+	int32_t rel = (int32_t)target - (int32_t)(pos + oplen);
+	if (oplen == 2) {
+		m_assert(rel >= -128 && rel <= 127, "jit: short jump out of range\n");
+		(*block)[pos + 1] = (uint8)rel;
+	}
+	else {
+		(*block)[pos + 1] = (uint8)(rel & 0xFF);
+		(*block)[pos + 2] = (uint8)((rel >> 8) & 0xFF);
+		(*block)[pos + 3] = (uint8)((rel >> 16) & 0xFF);
+		(*block)[pos + 4] = (uint8)((rel >> 24) & 0xFF);
+	}
+}
+
+// can this section be accessed inline with this attrib?
+static uint32 Jit_isInline(Memory_map_elem* thismap, uint32 attrib, uint32 width) {
+	return MEMORY_IS_DIRECT(thismap) && (thismap->attrib & (attrib & MEMORY_ATTRIB_CRITICAL)) != 0
+		&& thismap->size >= width && Memory_var_endianness == 0 && !(MPU_var_ctrl & MPU_CTRL_ENABLE);
+}
+
+// ecx = eax - base, then jump to the next section if ecx does not fit. returns position of the jcc
+static uint32 Jit_emitRangeCheck(vect8* block, Memory_map_elem* thismap, uint32 width) {
+	const X86Emitter& em = Jit_var_emitter;
+
+	em.Mov(block, X86Emitter::movDwordRegToRegMode, X86Emitter::Areg, X86Emitter::Creg);
+	em.Sub_imm(block, X86Emitter::dwordSubImmToRegMode, X86Emitter::Creg, em.insertDisp((uint32_t)thismap->base));
+	em.Cmp_imm(block, X86Emitter::dwordCmpImmToRegMode, X86Emitter::Creg, em.insertDisp((uint32_t)(thismap->size - width)));
+
+	uint32 pos = block->size();
+	em.Jcc(block, X86Emitter::byteRelJaMode, em.insertDisp((uint8_t)0));
+	return pos;
+}
+
+// R[15] = the guest instruction doing the access, for a fault out of the slow path (Fault.hpp). clobbers ecx
+static void Jit_emitFaultPC(vect8* block, uint32 pc) {
+	const X86Emitter& em = Jit_var_emitter;
+	em.Mov_imm(block, X86Emitter::movDwordImmToRegMode, X86Emitter::Creg, em.insertDisp((uint32_t)pc));
+	em.Mov(block, X86Emitter::movToMemaddrDwordMode, X86Emitter::Creg, em.insertDisp(Jit_addr(&CPU_var_reg->R[15])));
+	Jit_reloc(block, JIT_RELOC_CPUREG);
+}
+
+// IR_var_elapsed = elapsed, before a slow access or a handler (clobbers ecx)
+static void Jit_emitElapsed(vect8* block, uint32 elapsed) {
+	const X86Emitter& em = Jit_var_emitter;
+	em.Mov_imm(block, X86Emitter::movDwordImmToRegMode, X86Emitter::Creg, em.insertDisp((uint32_t)elapsed));
+	em.Mov(block, X86Emitter::movToMemaddrDwordMode, X86Emitter::Creg, em.insertDisp(Jit_addr(&IR_var_elapsed)));
+	Jit_reloc(block, JIT_RELOC_ELAPSED);
+}
+
+void Jit_emitLoad(vect8* block, Memory_enum_size sizetype, uint32 attrib, uint32 pc, uint32 elapsed) {
+	const X86Emitter& em = Jit_var_emitter;
+	uint32 width = 0x1 << sizetype;
+	uint32 donejmp[MEMORY_MAP_MAX_SECTIONS];
+	uint32 donecount = 0;
+
+	for (uint32 i = 0; i < Memory_var_arrlen; i++) {
+		Memory_map_elem* thismap = &Memory_var_arr[i];
+		if (!Jit_isInline(thismap, attrib, width)) {
+			continue;
+		}
+
+		uint32 skip = Jit_emitRangeCheck(block, thismap, width);
+
+		X86Emitter::Disp data = em.insertDisp((uint32_t)(uintptr_t)thismap->data);
+		switch (sizetype) {
+		case Memory_enum_size::u8:
+			em.Movzx_disp(block, X86Emitter::movzxByteMemDispToDwordMode, X86Emitter::Areg, X86Emitter::Creg, data);
+			break;
+		case Memory_enum_size::u16:
+			em.Movzx_disp(block, X86Emitter::movzxWordMemDispToDwordMode, X86Emitter::Areg, X86Emitter::Creg, data);
+			break;
+		case Memory_enum_size::u32:
+			em.Mov_disp(block, X86Emitter::movDwordMemDispToRegMode, X86Emitter::Areg, X86Emitter::Creg, data);
+			break;
+		default:
+			break;
+		}
+		Jit_reloc(block, JIT_RELOC_SECTIONDATA + i);
+
+		donejmp[donecount++] = block->size();
+		em.Jmp(block, X86Emitter::dwordRelJmpMode, em.insertDisp((uint32_t)0));
+
+		Jit_patch(block, skip, block->size(), X86Emitter::byteRelJaSize);
+	}
+
+	// slow path: eax = Jit_slowRead(eax, sizetype, attrib)
+	Jit_emitFaultPC(block, pc);
+	Jit_emitElapsed(block, elapsed);
+	em.Mov_imm(block, X86Emitter::movDwordImmToRegMode, X86Emitter::Creg, em.insertDisp((uint32_t)attrib));
+	em.Push(block, X86Emitter::pushDwordMode, X86Emitter::Creg);
+	em.Push_imm(block, X86Emitter::pushByteImmMode, em.insertDisp((uint8_t)sizetype));
+	em.Push(block, X86Emitter::pushDwordMode, X86Emitter::Areg);
+	em.Mov_imm(block, X86Emitter::movDwordImmToRegMode, X86Emitter::Creg, em.insertDisp((uint32_t)(uintptr_t)&Jit_slowRead));
+	Jit_reloc(block, JIT_RELOC_SLOWREAD);
+	em.Call(block, X86Emitter::dwordCallMode, X86Emitter::Creg);
+	em.Add_imm(block, X86Emitter::dwordAddImmToRegMode, em.insertDisp((uint32_t)12), X86Emitter::illegal);
+
+	for (uint32 i = 0; i < donecount; i++) {
+		Jit_patch(block, donejmp[i], block->size(), X86Emitter::dwordRelJmpSize);
+	}
+}
+
+void Jit_emitStore(vect8* block, Memory_enum_size sizetype, uint32 attrib, uint32 pc, uint32 elapsed) {
+	const X86Emitter& em = Jit_var_emitter;
+	uint32 width = 0x1 << sizetype;
+	uint32 donejmp[MEMORY_MAP_MAX_SECTIONS];
+	uint32 slowjmp[MEMORY_MAP_MAX_SECTIONS];
+	uint32 count = 0;
+
+	for (uint32 i = 0; i < Memory_var_arrlen; i++) {
+		Memory_map_elem* thismap = &Memory_var_arr[i];
+		if (!Jit_isInline(thismap, attrib, width)) {
+			continue;
+		}
+
+		uint32 skip = Jit_emitRangeCheck(block, thismap, width);
+
+		// translated code on the page of the first or the last byte -> slow path (smc).
+		// fuzzing: a page still clean since the snapshot, too (Fuzz.hpp)
+		X86Emitter::Disp pagemap = em.insertDisp((uint32_t)(uintptr_t)JitCache_pagemap(thismap));
+		uint32 smcjmp[4];
+		uint32 smccount = 0;
+		for (uint32 end = 0; end < width; end += width - 1) {
+			em.Mov(block, X86Emitter::movDwordRegToRegMode, X86Emitter::Creg, X86Emitter::Areg);
+			if (end != 0) {
+				em.Add_imm(block, X86Emitter::dwordAddImmToRegMode, em.insertDisp((uint32_t)end), X86Emitter::Areg);
+			}
+			em.Shift(block, X86Emitter::dwordShiftRightMode, em.insertDisp((uint8_t)MEMORY_CODEPAGE_SHIFT), X86Emitter::Areg);
+			em.Bt(block, X86Emitter::btMemaddrMode, X86Emitter::Areg, pagemap);
+			Jit_reloc(block, JIT_RELOC_PAGEMAP + i);
+			smcjmp[smccount++] = block->size();
+			em.Jcc2(block, X86Emitter::byteRelJbMode, em.insertDisp((uint8_t)0));
+			if (thismap->fuzz_clean != NULL) {
+				em.Bt(block, X86Emitter::btMemaddrMode, X86Emitter::Areg, em.insertDisp((uint32_t)(uintptr_t)thismap->fuzz_clean));
+				Jit_reloc(block, JIT_RELOC_FUZZMAP + i);
+				smcjmp[smccount++] = block->size();
+				em.Jcc2(block, X86Emitter::byteRelJbMode, em.insertDisp((uint8_t)0));
+			}
+			if (width == 1) {
+				break;
+			}
+		}
+
+		X86Emitter::Disp data = em.insertDisp((uint32_t)(uintptr_t)thismap->data);
+		switch (sizetype) {
+		case Memory_enum_size::u8:
+			em.Mov_disp(block, X86Emitter::movByteRegToMemDispMode, X86Emitter::Dreg, X86Emitter::Creg, data);
+			break;
+		case Memory_enum_size::u16:
+			em.Mov_disp(block, X86Emitter::movWordRegToMemDispMode, X86Emitter::Dreg, X86Emitter::Creg, data);
+			break;
+		case Memory_enum_size::u32:
+			em.Mov_disp(block, X86Emitter::movDwordRegToMemDispMode, X86Emitter::Dreg, X86Emitter::Creg, data);
+			break;
+		default:
+			break;
+		}
+		Jit_reloc(block, JIT_RELOC_SECTIONDATA + i);
+
+		donejmp[count] = block->size();
+		em.Jmp(block, X86Emitter::dwordRelJmpMode, em.insertDisp((uint32_t)0));
+
+		// the pagemap test ate eax. rebuild the guest address before going to the slow path
+		for (uint32 j = 0; j < smccount; j++) {
+			Jit_patch(block, smcjmp[j], block->size(), X86Emitter::byteRelJbSize);
+		}
+		em.Mov(block, X86Emitter::movDwordRegToRegMode, X86Emitter::Creg, X86Emitter::Areg);
+		em.Add_imm(block, X86Emitter::dwordAddImmToRegMode, em.insertDisp((uint32_t)thismap->base), X86Emitter::Areg);
+		slowjmp[count] = block->size();
+		em.Jmp(block, X86Emitter::dwordRelJmpMode, em.insertDisp((uint32_t)0));
+		count += 1;
+
+		Jit_patch(block, skip, block->size(), X86Emitter::byteRelJaSize);
+	}
+
+	// slow path: Jit_slowWrite(eax, edx, sizetype, attrib)
+	for (uint32 i = 0; i < count; i++) {
+		Jit_patch(block, slowjmp[i], block->size(), X86Emitter::dwordRelJmpSize);
+	}
+	Jit_emitFaultPC(block, pc);
+	Jit_emitElapsed(block, elapsed);
+	em.Mov_imm(block, X86Emitter::movDwordImmToRegMode, X86Emitter::Creg, em.insertDisp((uint32_t)attrib));
+	em.Push(block, X86Emitter::pushDwordMode, X86Emitter::Creg);
+	em.Push_imm(block, X86Emitter::pushByteImmMode, em.insertDisp((uint8_t)sizetype));
+	em.Push(block, X86Emitter::pushDwordMode, X86Emitter::Dreg);
+	em.Push(block, X86Emitter::pushDwordMode, X86Emitter::Areg);
+	em.Mov_imm(block, X86Emitter::movDwordImmToRegMode, X86Emitter::Creg, em.insertDisp((uint32_t)(uintptr_t)&Jit_slowWrite));
+	Jit_reloc(block, JIT_RELOC_SLOWWRITE);
+	em.Call(block, X86Emitter::dwordCallMode, X86Emitter::Creg);
+	em.Add_imm(block, X86Emitter::dwordAddImmToRegMode, em.insertDisp((uint32_t)16), X86Emitter::illegal);
+
+	for (uint32 i = 0; i < count; i++) {
+		Jit_patch(block, donejmp[i], block->size(), X86Emitter::dwordRelJmpSize);
+	}
+}
+
+/*
+* IR backend
+*/
+
+static void Jit_loadTemp(vect8* code, uint32 t, X86Emitter::X86Regs xreg) {
+	const X86Emitter& em = Jit_var_emitter;
+	em.Mov(code, X86Emitter::movFromMemaddrDwordMode, xreg, em.insertDisp(Jit_addr(&IR_var_temps[t])));
+	Jit_reloc(code, JIT_RELOC_TEMPS);
+}
+
+static void Jit_storeTemp(vect8* code, uint32 t, X86Emitter::X86Regs xreg) {
+	const X86Emitter& em = Jit_var_emitter;
+	em.Mov(code, X86Emitter::movToMemaddrDwordMode, xreg, em.insertDisp(Jit_addr(&IR_var_temps[t])));
+	Jit_reloc(code, JIT_RELOC_TEMPS);
+}
+
+// CPU_var_reg fields (addr is a host address inside *CPU_var_reg)
+static void Jit_loadReg(vect8* code, uint32 addr, X86Emitter::X86Regs xreg) {
+	const X86Emitter& em = Jit_var_emitter;
+	em.Mov(code, X86Emitter::movFromMemaddrDwordMode, xreg, em.insertDisp((uint32_t)addr));
+	Jit_reloc(code, JIT_RELOC_CPUREG);
+}
+
+static void Jit_storeReg(vect8* code, uint32 addr, X86Emitter::X86Regs xreg) {
+	const X86Emitter& em = Jit_var_emitter;
+	em.Mov(code, X86Emitter::movToMemaddrDwordMode, xreg, em.insertDisp((uint32_t)addr));
+	Jit_reloc(code, JIT_RELOC_CPUREG);
+}
+
+// operand b (temp or immediate) into xreg
+static void Jit_loadB(vect8* code, IR_inst* inst, X86Emitter::X86Regs xreg) {
+	const X86Emitter& em = Jit_var_emitter;
+	if (inst->bimm) {
+		em.Mov_imm(code, X86Emitter::movDwordImmToRegMode, xreg, em.insertDisp((uint32_t)inst->imm));
+	}
+	else {
+		Jit_loadTemp(code, inst->b, xreg);
+	}
+}
+
+static void Jit_pushImm(vect8* code, uint32 value) {
+	const X86Emitter& em = Jit_var_emitter;
+	em.Mov_imm(code, X86Emitter::movDwordImmToRegMode, X86Emitter::Areg, em.insertDisp((uint32_t)value));
+	em.Push(code, X86Emitter::pushDwordMode, X86Emitter::Areg);
+}
+
+static void Jit_pushTemp(vect8* code, uint32 t) {
+	const X86Emitter& em = Jit_var_emitter;
+	Jit_loadTemp(code, t, X86Emitter::Areg);
+	em.Push(code, X86Emitter::pushDwordMode, X86Emitter::Areg);
+}
+
+static void Jit_callHelper(vect8* code, uint32 symbol, uint32 nargs) {
+	const X86Emitter& em = Jit_var_emitter;
+	em.Mov_imm(code, X86Emitter::movDwordImmToRegMode, X86Emitter::Creg, em.insertDisp(Jit_symbol(symbol)));
+	Jit_reloc(code, symbol);
+	em.Call(code, X86Emitter::dwordCallMode, X86Emitter::Creg);
+	if (nargs != 0) {
+		em.Add_imm(code, X86Emitter::dwordAddImmToRegMode, em.insertDisp((uint32_t)(nargs * 4)), X86Emitter::illegal);
+	}
+}
+
+// leave the block returning the cycles spent, with the instructions retired (and their lsu cycles) in IR_var_retired
+static void Jit_emitExit(vect8* code, IR_inst* inst) {
+	const X86Emitter& em = Jit_var_emitter;
+	em.Mov_imm(code, X86Emitter::movDwordImmToRegMode, X86Emitter::Areg, em.insertDisp((uint32_t)IR_RETIRED(inst->instrs, inst->lsu)));
+	em.Mov(code, X86Emitter::movToMemaddrDwordMode, X86Emitter::Areg, em.insertDisp(Jit_addr(&IR_var_retired)));
+	Jit_reloc(code, JIT_RELOC_RETIRED);
+	em.Mov_imm(code, X86Emitter::movDwordImmToRegMode, X86Emitter::Areg, em.insertDisp((uint32_t)inst->cycles));
+	em.BlockFinisher(code);
+}
+
+/*
+* guest flags in host eflags
+*
+* ADDS / SUBS / CMP / CMN (no carry in) and the NZ of ANDS / MOVS / ... come straight out of the x86 alu op
+* (add / sub / or eax, eax) instead of an IR_setflags call:
+* - x86 SF, ZF, OF are arm N, Z, V. CF is arm C after add, and NOT C after sub (x86 sets it on borrow, arm clears it),
+*   so a sub gets a cmc when its flags are written out.
+* - they stay in eflags over the ops behind them that only move data (mov leaves eflags alone), and go into xPSR
+*   (Jit_spillFlags) right before anything else: an alu op, a helper call, a memory access, an exit.
+* - a bcond right behind them branches on eflags itself where one x86 condition is enough
+*   (eq / ne, cs / cc / hi / ls after a sub, cs / cc after an add). xPSR is still written first.
+*/
+static uint32 Jit_var_flagmask = 0;	// IR_FLAG_* live in eflags, not yet in xPSR
+static uint32 Jit_var_flagsub = 0;	// they came from a sub: CF is a borrow
+
+static uint32 Jit_isHostFlags(IR_inst* inst) {
+	switch (inst->op) {
+	case IR_FLAGS_ADD:
+	case IR_FLAGS_SUB:
+		return inst->c == IR_NOTEMP;
+	case IR_FLAGS_NZ:
+		return (inst->flags & ~IR_FLAG_NZ) == 0;
+	default:
+		return 0;
+	}
+}
+
+// write the live eflags into xPSR. clobbers eax, ecx, edx and eflags
+static void Jit_spillFlags(vect8* code) {
+	const X86Emitter& em = Jit_var_emitter;
+	static const uint8 hostbit[4] = { 11, 0, 6, 7 };	// eflags bit of V, C, Z, N (IR_FLAG_* order)
+	uint32 mask = Jit_var_flagmask;
+	uint32 xpsraddr = Jit_addr(&CPU_var_reg->xPSR.raw);
+
+	if (mask == 0) {
+		return;
+	}
+	Jit_var_flagmask = 0;
+
+	if (Jit_var_flagsub && (mask & IR_FLAG_C)) {
+		em.Cmc(code);	// borrow -> carry
+	}
+	em.Pushfd(code);
+	em.Pop(code, X86Emitter::popDwordMode, X86Emitter::Dreg);
+
+	// eax = the flags at xPSR bits 28 ~ 31, one bit at a time: up to bit 31, down to bit 0, up to its place
+	em.Mov_imm(code, X86Emitter::movDwordImmToRegMode, X86Emitter::Areg, em.insertDisp((uint32_t)0));
+	for (uint32 f = 0; f < 4; f++) {
+		if ((mask & (0x1 << f)) == 0) {
+			continue;
+		}
+		em.Mov(code, X86Emitter::movDwordRegToRegMode, X86Emitter::Dreg, X86Emitter::Creg);
+		if (hostbit[f] != 31) {
+			em.Shift(code, X86Emitter::dwordShiftLeftMode, em.insertDisp((uint8_t)(31 - hostbit[f])), X86Emitter::Creg);
+		}
+		em.Shift(code, X86Emitter::dwordShiftRightMode, em.insertDisp((uint8_t)31), X86Emitter::Creg);
+		em.Shift(code, X86Emitter::dwordShiftLeftMode, em.insertDisp((uint8_t)(28 + f)), X86Emitter::Creg);
+		em.Or(code, X86Emitter::dwordOrMode, X86Emitter::Creg, X86Emitter::Areg);
+	}
+
+	// xPSR = (xPSR & ~mask) | eax
+	Jit_loadReg(code, xpsraddr, X86Emitter::Creg);
+	em.Mov_imm(code, X86Emitter::movDwordImmToRegMode, X86Emitter::Dreg, em.insertDisp((uint32_t)~(mask << 28)));
+	em.And(code, X86Emitter::dwordAndMode, X86Emitter::Dreg, X86Emitter::Creg);
+	em.Or(code, X86Emitter::dwordOrMode, X86Emitter::Areg, X86Emitter::Creg);
+	Jit_storeReg(code, xpsraddr, X86Emitter::Creg);
+}
+
+// x86 jump that skips the taken path of bcond cond on the live eflags. 0 if it takes more than one
+static uint32 Jit_condSkip(uint32 cond, X86Emitter::OperandModes* mode) {
+	uint32 need = 0;
+
+	switch (cond) {
+	case 0x0: *mode = X86Emitter::byteRelJneMode; need = IR_FLAG_Z; break;	// eq
+	case 0x1: *mode = X86Emitter::byteRelJeMode; need = IR_FLAG_Z; break;	// ne
+	case 0x2: *mode = Jit_var_flagsub ? X86Emitter::byteRelJbMode : X86Emitter::byteRelJaeMode; need = IR_FLAG_C; break;	// cs
+	case 0x3: *mode = Jit_var_flagsub ? X86Emitter::byteRelJaeMode : X86Emitter::byteRelJbMode; need = IR_FLAG_C; break;	// cc
+	case 0x8: *mode = X86Emitter::byteRelJbeMode; need = IR_FLAG_C | IR_FLAG_Z; break;	// hi (sub only)
+	case 0x9: *mode = X86Emitter::byteRelJaMode; need = IR_FLAG_C | IR_FLAG_Z; break;	// ls (sub only)
+	default:
+		return 0;
+	}
+	if (cond >= 0x8 && !Jit_var_flagsub) {
+		return 0;
+	}
+	return (Jit_var_flagmask & need) == need;
+}
+
+static void Jit_emitJcc(vect8* code, X86Emitter::OperandModes mode) {
+	const X86Emitter& em = Jit_var_emitter;
+	if (mode == X86Emitter::byteRelJbMode || mode == X86Emitter::byteRelJaeMode) {
+		em.Jcc2(code, mode, em.insertDisp((uint8_t)0));
+	}
+	else {
+		em.Jcc(code, mode, em.insertDisp((uint8_t)0));
+	}
+}
+
+void Jit_compile(IR_block* block, vect8* code) {
+	const X86Emitter& em = Jit_var_emitter;
+	uint32 pcaddr = Jit_addr(&CPU_var_reg->R[15]);
+
+	Jit_var_nrelocs = 0;
+	Jit_var_flagmask = 0;
+	em.BlockInitializer(code);
+
+	for (uint32 i = 0; i < block->count; i++) {
+		IR_inst* inst = &block->inst[i];
+		uint32 regaddr = Jit_addr(&CPU_var_reg->R[inst->reg]);
+
+		// flags still in eflags survive plain moves only (a bcond writes them out itself)
+		switch (inst->op) {
+		case IR_NOP:
+		case IR_CONST:
+		case IR_GETREG:
+		case IR_SETREG:
+		case IR_SETREGI:
+		case IR_BCOND:
+			break;
+		default:
+			Jit_spillFlags(code);
+			break;
+		}
+
+		switch (inst->op) {
+		case IR_NOP:
+			break;
+		case IR_CONST:
+			em.Mov_imm(code, X86Emitter::movDwordImmToRegMode, X86Emitter::Areg, em.insertDisp((uint32_t)inst->imm));
+			Jit_storeTemp(code, inst->t, X86Emitter::Areg);
+			break;
+		case IR_GETREG:
+			Jit_loadReg(code, regaddr, X86Emitter::Areg);
+			Jit_storeTemp(code, inst->t, X86Emitter::Areg);
+			break;
+		case IR_SETREG:
+			Jit_loadTemp(code, inst->a, X86Emitter::Areg);
+			Jit_storeReg(code, regaddr, X86Emitter::Areg);
+			break;
+		case IR_SETREGI:
+			em.Mov_imm(code, X86Emitter::movDwordImmToRegMode, X86Emitter::Areg, em.insertDisp((uint32_t)inst->imm));
+			Jit_storeReg(code, regaddr, X86Emitter::Areg);
+			break;
+		case IR_ADDREGI:
+			Jit_loadReg(code, regaddr, X86Emitter::Areg);
+			em.Add_imm(code, X86Emitter::dwordAddImmToRegMode, em.insertDisp((uint32_t)inst->imm), X86Emitter::Areg);
+			Jit_storeReg(code, regaddr, X86Emitter::Areg);
+			break;
+
+		case IR_ADD:
+		case IR_SUB:
+		case IR_AND:
+		case IR_OR:
+		case IR_XOR:
+		case IR_BIC:
+			Jit_loadTemp(code, inst->a, X86Emitter::Areg);
+			Jit_loadB(code, inst, X86Emitter::Creg);
+			switch (inst->op) {
+			case IR_ADD: em.Add(code, X86Emitter::dwordAddMode, X86Emitter::Creg, X86Emitter::Areg); break;
+			case IR_SUB: em.Sub(code, X86Emitter::dwordSubMode, X86Emitter::Creg, X86Emitter::Areg); break;
+			case IR_AND: em.And(code, X86Emitter::dwordAndMode, X86Emitter::Creg, X86Emitter::Areg); break;
+			case IR_OR: em.Or(code, X86Emitter::dwordOrMode, X86Emitter::Creg, X86Emitter::Areg); break;
+			case IR_XOR: em.Xor(code, X86Emitter::dwordXorMode, X86Emitter::Creg, X86Emitter::Areg); break;
+			case IR_BIC:
+				em.Mov_imm(code, X86Emitter::movDwordImmToRegMode, X86Emitter::Dreg, em.insertDisp((uint32_t)0xFFFFFFFF));
+				em.Xor(code, X86Emitter::dwordXorMode, X86Emitter::Dreg, X86Emitter::Creg);
+				em.And(code, X86Emitter::dwordAndMode, X86Emitter::Creg, X86Emitter::Areg);
+				break;
+			}
+			Jit_storeTemp(code, inst->t, X86Emitter::Areg);
+			break;
+		case IR_NOT:
+			Jit_loadTemp(code, inst->a, X86Emitter::Areg);
+			em.Mov_imm(code, X86Emitter::movDwordImmToRegMode, X86Emitter::Creg, em.insertDisp((uint32_t)0xFFFFFFFF));
+			em.Xor(code, X86Emitter::dwordXorMode, X86Emitter::Creg, X86Emitter::Areg);
+			Jit_storeTemp(code, inst->t, X86Emitter::Areg);
+			break;
+		case IR_LSL:
+		case IR_LSR:
+		case IR_ASR:
+			if (inst->bimm && (inst->imm & 0xFF) < 32) {
+				// x86 masks the count to 5 bits, so only the short immediates map 1:1
+				Jit_loadTemp(code, inst->a, X86Emitter::Areg);
+				em.Shift(code, (inst->op == IR_LSL) ? X86Emitter::dwordShiftLeftMode : (inst->op == IR_LSR) ? X86Emitter::dwordShiftRightMode : X86Emitter::dwordShiftArithRightMode,
+					em.insertDisp((uint8_t)inst->imm), X86Emitter::Areg);
+				Jit_storeTemp(code, inst->t, X86Emitter::Areg);
+				break;
+			}
+			// fall through
+		case IR_MUL:
+		case IR_ROR:
+		case IR_ADC:
+		case IR_SBC:
+			// t = IR_alu(op, a, b, c)
+			if (inst->c != IR_NOTEMP) {
+				Jit_pushTemp(code, inst->c);
+			}
+			else {
+				Jit_pushImm(code, 0);
+			}
+			Jit_loadB(code, inst, X86Emitter::Areg);
+			em.Push(code, X86Emitter::pushDwordMode, X86Emitter::Areg);
+			Jit_pushTemp(code, inst->a);
+			Jit_pushImm(code, inst->op);
+			Jit_callHelper(code, JIT_RELOC_ALU, 4);
+			Jit_storeTemp(code, inst->t, X86Emitter::Areg);
+			break;
+		case IR_GETC:
+			Jit_loadReg(code, Jit_addr(&CPU_var_reg->xPSR.raw), X86Emitter::Areg);
+			em.Shift(code, X86Emitter::dwordShiftRightMode, em.insertDisp((uint8_t)29), X86Emitter::Areg);
+			em.Mov_imm(code, X86Emitter::movDwordImmToRegMode, X86Emitter::Creg, em.insertDisp((uint32_t)0x1));
+			em.And(code, X86Emitter::dwordAndMode, X86Emitter::Creg, X86Emitter::Areg);
+			Jit_storeTemp(code, inst->t, X86Emitter::Areg);
+			break;
+
+		case IR_FLAGS_ADD:
+		case IR_FLAGS_SUB:
+		case IR_FLAGS_NZ:
+		case IR_FLAGS_SHIFTC:
+			if (Jit_isHostFlags(inst)) {
+				if (inst->flags == 0) {
+					break;	// all dead
+				}
+				Jit_loadTemp(code, inst->a, X86Emitter::Areg);
+				if (inst->op == IR_FLAGS_NZ) {
+					em.Or(code, X86Emitter::dwordOrMode, X86Emitter::Areg, X86Emitter::Areg);
+				}
+				else {
+					Jit_loadB(code, inst, X86Emitter::Creg);
+					if (inst->op == IR_FLAGS_ADD) {
+						em.Add(code, X86Emitter::dwordAddMode, X86Emitter::Creg, X86Emitter::Areg);
+					}
+					else {
+						em.Sub(code, X86Emitter::dwordSubMode, X86Emitter::Creg, X86Emitter::Areg);
+					}
+				}
+				Jit_var_flagmask = inst->flags;
+				Jit_var_flagsub = (inst->op == IR_FLAGS_SUB);
+				break;
+			}
+			// IR_setflags(desc, a, b, c)
+			if (inst->c != IR_NOTEMP) {
+				Jit_pushTemp(code, inst->c);
+			}
+			else {
+				Jit_pushImm(code, (inst->op == IR_FLAGS_SUB) ? 1 : 0);
+			}
+			if (inst->bimm || inst->b != IR_NOTEMP) {
+				Jit_loadB(code, inst, X86Emitter::Areg);
+				em.Push(code, X86Emitter::pushDwordMode, X86Emitter::Areg);
+			}
+			else {
+				Jit_pushImm(code, 0);
+			}
+			Jit_pushTemp(code, inst->a);
+			Jit_pushImm(code, IR_FLAGDESC(inst->op, inst->flags, inst->size));
+			Jit_callHelper(code, JIT_RELOC_SETFLAGS, 4);
+			break;
+
+		case IR_LOAD:
+			Jit_loadTemp(code, inst->a, X86Emitter::Areg);
+			Jit_emitLoad(code, (Memory_enum_size)inst->size, MEMORY_ATTRIB_S_R, inst->pc, inst->cycles);
+			if (inst->sign) {
+				uint8 shift = (uint8)(32 - (8 << inst->size));
+				em.Shift(code, X86Emitter::dwordShiftLeftMode, em.insertDisp(shift), X86Emitter::Areg);
+				em.Shift(code, X86Emitter::dwordShiftArithRightMode, em.insertDisp(shift), X86Emitter::Areg);
+			}
+			Jit_storeTemp(code, inst->t, X86Emitter::Areg);
+			break;
+		case IR_STORE:
+			Jit_loadTemp(code, inst->a, X86Emitter::Areg);
+			Jit_loadTemp(code, inst->b, X86Emitter::Dreg);
+			Jit_emitStore(code, (Memory_enum_size)inst->size, MEMORY_ATTRIB_S_W, inst->pc, inst->cycles);
+			break;
+
+		case IR_EXIT:
+			em.Mov_imm(code, X86Emitter::movDwordImmToRegMode, X86Emitter::Areg, em.insertDisp((uint32_t)inst->imm));
+			Jit_storeReg(code, pcaddr, X86Emitter::Areg);
+			Jit_emitExit(code, inst);
+			break;
+		case IR_BRANCH:
+			Jit_loadTemp(code, inst->a, X86Emitter::Areg);
+			Jit_storeReg(code, pcaddr, X86Emitter::Areg);
+			Jit_emitExit(code, inst);
+			break;
+		case IR_BCOND: {
+			X86Emitter::OperandModes skipmode = X86Emitter::byteRelJeMode;
+			if (Jit_var_flagmask != 0 && Jit_condSkip(inst->size, &skipmode)) {
+				// branch on eflags, kept on the stack while xPSR is written
+				em.Pushfd(code);
+				Jit_spillFlags(code);
+				em.Popfd(code);
+			}
+			else {
+				skipmode = X86Emitter::byteRelJeMode;
+				Jit_spillFlags(code);
+				em.Push_imm(code, X86Emitter::pushByteImmMode, em.insertDisp((uint8_t)inst->size));
+				Jit_callHelper(code, JIT_RELOC_COND, 1);
+				em.Mov_imm(code, X86Emitter::movDwordImmToRegMode, X86Emitter::Creg, em.insertDisp((uint32_t)0));
+				em.Cmp(code, X86Emitter::cmpMode, X86Emitter::Areg, X86Emitter::Creg);
+			}
+			uint32 skip = code->size();
+			Jit_emitJcc(code, skipmode);
+			em.Mov_imm(code, X86Emitter::movDwordImmToRegMode, X86Emitter::Areg, em.insertDisp((uint32_t)inst->imm));
+			Jit_storeReg(code, pcaddr, X86Emitter::Areg);
+			Jit_emitExit(code, inst);
+			Jit_patch(code, skip, code->size(), X86Emitter::byteRelJeSize);
+			break;
+		}
+		case IR_INTERP:
+			// IR_interp(op, instr, pc, length)
+			Jit_emitElapsed(code, inst->cycles);
+			Jit_pushImm(code, inst->b);
+			Jit_pushImm(code, inst->pc);
+			Jit_pushImm(code, inst->imm);
+			Jit_pushImm(code, inst->a);
+			Jit_callHelper(code, JIT_RELOC_INTERP, 4);
+			Jit_emitExit(code, inst);
+			break;
+		}
+	}
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include "Proxy.hpp"
+#include "Memory.hpp"
+#include "JitCache.hpp"
+#include "X86Emitter.hpp"
+#include "IR.hpp"
+#include "MPU.hpp"
+
+// generated code only runs on a 32bit x86 host. elsewhere the IR interpreter is used
+#if defined(_M_IX86) || defined(__i386__)
+#define JIT_HOST_X86 1
+#else
+#define JIT_HOST_X86 0
+#endif
+
+/*
+* guest memory access from jit generated code
+*
+* calling Memory_read / Memory_write for every load and store means a call, a linked list walk
+* and an attribute check per access. most accesses hit code or sram which are plain arrays, so:
+*
+* fast path (emitted inline, per direct section):
+* - ecx = addr - section base
+* - unsigned compare against (section size - access width) -> one check covers both bounds
+* - load/store straight from/to section data (host pointer is baked into the instruction)
+* - stores also test the jit code pagemap with bt. a hit goes to the slow path so smc invalidation still happens
+* - while fuzzing a second bt tests the clean page map on the same page index, so the slow path marks the page dirty
+*
+* slow path (one helper call):
+* - peripherals, ppb, unmapped addresses, attribute faults and writes onto translated code
+* - Jit_slowRead / Jit_slowWrite go through Memory_read / Memory_write. a failed access raises the fault (Fault.hpp),
+*   so R[15] is set to the guest pc of the access before the call
+*
+* section layout is fixed after Memory_init, so the ranges are baked into the code as immediates.
+* anything that changes the map must JitCache_flush().
+* with the mpu enabled nothing is inlined, every access goes through the permission check in the slow path.
+*
+* register convention (host is 32bit x86, see X86Emitter.hpp):
+* - load: guest address in eax -> zero extended value in eax
+* - store: guest address in eax, value in edx
+* - eax, ecx, edx are clobbered
+*/
+
+// cdecl helpers called from generated code
+extern uint32 Jit_slowRead(uint32 addr, uint32 sizetype, uint32 attrib);
+extern void Jit_slowWrite(uint32 addr, uint32 data, uint32 sizetype, uint32 attrib);
+
+// emit an inline guest load/store of the guest instruction at pc
+extern void Jit_emitLoad(vect8* block, Memory_enum_size sizetype, uint32 attrib, uint32 pc, uint32 elapsed);
+extern void Jit_emitStore(vect8* block, Memory_enum_size sizetype, uint32 attrib, uint32 pc, uint32 elapsed);
+
+/*
+* IR backend
+*
+* a compiled block is a plain cdecl function: uint32 block(void), returning the guest cycles it spent.
+* temps live in IR_var_temps, guest registers in CPU_var_reg. both addresses are baked into the code,
+* so CPU_var_reg must not move after the first block is compiled.
+* alu ops without a short x86 form (mul, rotates, carry-in ops) and flag updates other than add / sub / nz call the IR helpers.
+* add / sub / nz flags come from host eflags (see Jit.cpp).
+*/
+typedef uint32 (*Jit_func)(void);
+
+extern void Jit_compile(IR_block* block, vect8* code);
+
+/*
+* relocations
+*
+* every host address the emitter bakes in is recorded as (offset in code, symbol) in Jit_var_relocs.
+* Jit_compile starts a fresh list, Jit_emitLoad / Jit_emitStore append to it.
+* the address is always the last 4 bytes of the instruction that carries it.
+*/
+enum Jit_reloc_enum {
+	JIT_RELOC_TEMPS,		// IR_var_temps
+	JIT_RELOC_CPUREG,		// *CPU_var_reg
+	JIT_RELOC_SLOWREAD,		// helpers
+	JIT_RELOC_SLOWWRITE,
+	JIT_RELOC_ALU,
+	JIT_RELOC_SETFLAGS,
+	JIT_RELOC_COND,
+	JIT_RELOC_INTERP,
+	JIT_RELOC_RETIRED,		// IR_var_retired
+	JIT_RELOC_ELAPSED,		// IR_var_elapsed
+	JIT_RELOC_SECTIONDATA,	// + section index: Memory_var_arr[i].data
+	JIT_RELOC_PAGEMAP = JIT_RELOC_SECTIONDATA + MEMORY_MAP_MAX_SECTIONS,	// + section index: jit pagemap
+	JIT_RELOC_FUZZMAP = JIT_RELOC_PAGEMAP + MEMORY_MAP_MAX_SECTIONS,	// + section index: fuzz clean pages (Fuzz.hpp)
+	JIT_RELOC_NUMBER_OF_SYMBOLS = JIT_RELOC_FUZZMAP + MEMORY_MAP_MAX_SECTIONS
+};
+
+#define JIT_MAX_RELOCS 1024
+
+extern JitCache_reloc Jit_var_relocs[JIT_MAX_RELOCS];
+extern uint32 Jit_var_nrelocs;
+
+// host address of a symbol in this process
+extern uint32_t Jit_symbol(uint32 symbol);
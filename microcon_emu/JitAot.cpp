@@ -0,0 +1,302 @@
+#include "JitAot.hpp"
+#include "Fuzz.hpp"
+#include <stdlib.h>	// getenv
+
+uint32 JitAot_var_loaded = 0;
+uint32 JitAot_var_rejected = 0;
+
+// mapping of the cache file the adopted blocks live in
+static uint8* JitAot_var_map = NULL;
+static uint32 JitAot_var_mapsize = 0;
+
+#define JITAOT_FNV32_BASIS 0x811C9DC5
+#define JITAOT_FNV32_PRIME 0x01000193
+#define JITAOT_FNV64_BASIS 0xCBF29CE484222325ULL
+#define JITAOT_FNV64_PRIME 0x00000100000001B3ULL
+
+static uint64_t JitAot_fnv64(uint64_t hash, const uint8* data, uint32 size) {
+	for (uint32 i = 0; i < size; i++) {
+		hash ^= data[i];
+		hash *= JITAOT_FNV64_PRIME;
+	}
+	return hash;
+}
+
+static uint64_t JitAot_fnv64_word(uint64_t hash, uint32_t value) {
+	uint8 bytes[4] = { (uint8)value, (uint8)(value >> 8), (uint8)(value >> 16), (uint8)(value >> 24) };
+	return JitAot_fnv64(hash, bytes, 4);
+}
+
+// fnv-1a of guest [start, end). 0 in *ok if the range is not plain memory
+static uint32_t JitAot_guesthash(uint32 start, uint32 end, uint32* ok) {
+	Memory_map_elem* thismap = Memory_getMap(start);
+	*ok = 0;
+	if (thismap == NULL || !MEMORY_IS_DIRECT(thismap) || end < start || end - thismap->base > thismap->size) {
+		return 0;
+	}
+	*ok = 1;
+
+	uint32_t hash = JITAOT_FNV32_BASIS;
+	for (uint32 offset = start - thismap->base; offset < end - thismap->base; offset++) {
+		hash ^= thismap->data[offset];
+		hash *= JITAOT_FNV32_PRIME;
+	}
+	return hash;
+}
+
+static void JitAot_path(char* path, uint32 size, const char* dir, uint64_t imagehash) {
+	snprintf(path, size, "%s/%08x%08x-%08x.jcache", dir, (uint32_t)(imagehash >> 32), (uint32_t)imagehash, (uint32_t)MICROCON_EMU_VERSION);
+}
+
+static uint32_t JitAot_read32(const uint8* p) {
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void JitAot_write32(uint8* p, uint32_t value) {
+	p[0] = (uint8)value;
+	p[1] = (uint8)(value >> 8);
+	p[2] = (uint8)(value >> 16);
+	p[3] = (uint8)(value >> 24);
+}
+
+const char* JitAot_dir() {
+	const char* dir = getenv(JITAOT_ENV);
+	if (dir == NULL || dir[0] == '\0') {
+		return NULL;
+	}
+	// fuzzing translates stores with the clean page test, those blocks don't mix with the others
+	if (Fuzz_var_enabled) {
+		return NULL;
+	}
+	return dir;
+}
+
+uint64_t JitAot_imagehash() {
+	uint64_t hash = JITAOT_FNV64_BASIS;
+
+	hash = JitAot_fnv64_word(hash, (uint32_t)Memory_var_endianness);
+	for (uint32 i = 0; i < Memory_var_arrlen; i++) {
+		Memory_map_elem* thismap = &Memory_var_arr[i];
+		hash = JitAot_fnv64_word(hash, (uint32_t)thismap->base);
+		hash = JitAot_fnv64_word(hash, (uint32_t)thismap->size);
+		hash = JitAot_fnv64_word(hash, (uint32_t)thismap->attrib);
+
+		// only what can be executed is part of the image
+		if (MEMORY_IS_DIRECT(thismap) && (thismap->attrib & (MEMORY_ATTRIB_U_X | MEMORY_ATTRIB_S_X)) != 0) {
+			hash = JitAot_fnv64(hash, thismap->data, thismap->size);
+		}
+	}
+	return hash;
+}
+
+uint32 JitAot_load(const char* dir) {
+	JitAot_var_loaded = 0;
+	JitAot_var_rejected = 0;
+
+	if (!JIT_HOST_X86 || dir == NULL) {
+		return 0;
+	}
+	// the hash is of the loaded image: nothing booted, nothing to match
+	if (CPU_var_reg == NULL) {
+		eprintf("jit cache: no image booted, not loading\n");
+		return 0;
+	}
+
+	uint64_t imagehash = JitAot_imagehash();
+	char path[512];
+	JitAot_path(path, sizeof(path), dir, imagehash);
+
+	uint32 size = 0;
+	uint8* map = (uint8*)map_file_exec(path, &size);
+	if (map == NULL) {
+		eprintf("jit cache: no cache file %s\n", path);
+		return 0;
+	}
+
+	JitAot_header* header = (JitAot_header*)map;
+	if (size < sizeof(JitAot_header) || header->magic != JITAOT_MAGIC || header->version != MICROCON_EMU_VERSION
+		|| header->abi != JITAOT_ABI || header->imagehash_lo != (uint32_t)imagehash || header->imagehash_hi != (uint32_t)(imagehash >> 32)
+		|| header->nblocks > JITCACHE_MAX_BLOCKS || header->nrelocs > JITCACHE_MAX_BLOCKS * JIT_MAX_RELOCS
+		|| size < sizeof(JitAot_header) + header->nblocks * sizeof(JitAot_record) + header->nrelocs * sizeof(JitCache_reloc)) {
+		printf("jit cache: %s does not belong to this image or build, ignored\n", path);
+		unmap_file(map, size);
+		return 0;
+	}
+
+	// the old mapping goes away, so nothing may point into it anymore
+	if (JitAot_var_map != NULL) {
+		JitCache_flush();
+		unmap_file(JitAot_var_map, JitAot_var_mapsize);
+	}
+	JitAot_var_map = map;
+	JitAot_var_mapsize = size;
+
+	JitAot_record* records = (JitAot_record*)(map + sizeof(JitAot_header));
+	JitCache_reloc* relocs = (JitCache_reloc*)(records + header->nblocks);
+
+	for (uint32 i = 0; i < header->nblocks; i++) {
+		JitAot_record* record = &records[i];
+		uint32 ok = 0;
+
+		// a damaged file must not take us down. everything is bounds checked
+		if (record->code_offset > size || record->host_size > size - record->code_offset
+			|| record->reloc_first > header->nrelocs || record->nrelocs > header->nrelocs - record->reloc_first) {
+			JitAot_var_rejected += 1;
+			continue;
+		}
+		if (JitAot_guesthash(record->guest_start, record->guest_end, &ok) != record->guest_hash || !ok) {
+			JitAot_var_rejected += 1;
+			continue;
+		}
+
+		uint8* code = map + record->code_offset;
+		JitCache_reloc* blockrelocs = &relocs[record->reloc_first];
+		uint32 j;
+		for (j = 0; j < record->nrelocs; j++) {
+			if (blockrelocs[j].offset + 4 > record->host_size || blockrelocs[j].symbol >= JIT_RELOC_NUMBER_OF_SYMBOLS) {
+				break;
+			}
+		}
+		if (j != record->nrelocs) {
+			JitAot_var_rejected += 1;
+			continue;
+		}
+
+		// offset from symbol -> address in this process
+		for (j = 0; j < record->nrelocs; j++) {
+			uint8* site = code + blockrelocs[j].offset;
+			JitAot_write32(site, JitAot_read32(site) + Jit_symbol(blockrelocs[j].symbol));
+		}
+
+		if (JitCache_adopt(record->guest_start, record->guest_end, code, record->host_size, blockrelocs, record->nrelocs) == NULL) {
+			JitAot_var_rejected += 1;
+			continue;
+		}
+		JitAot_var_loaded += 1;
+	}
+
+	eprintf("jit cache: %d blocks loaded, %d rejected from %s\n", (int)JitAot_var_loaded, (int)JitAot_var_rejected, path);
+	return JitAot_var_loaded;
+}
+
+uint32 JitAot_save(const char* dir) {
+	if (!JIT_HOST_X86 || dir == NULL) {
+		return 0;
+	}
+
+	JitAot_header header;
+	header.magic = JITAOT_MAGIC;
+	header.version = MICROCON_EMU_VERSION;
+	header.abi = JITAOT_ABI;
+	uint64_t imagehash = JitAot_imagehash();
+	header.imagehash_lo = (uint32_t)imagehash;
+	header.imagehash_hi = (uint32_t)(imagehash >> 32);
+	header.nblocks = 0;
+	header.nrelocs = 0;
+	header.code_size = 0;
+
+	// pass 1: pick the blocks and lay out the file
+	JitAot_record* records = (JitAot_record*)emalloc(JITCACHE_MAX_BLOCKS * sizeof(JitAot_record));
+	uint32 index[JITCACHE_MAX_BLOCKS];
+	for (uint32 i = 0; i < JITCACHE_MAX_BLOCKS; i++) {
+		JitCache_block* block = &JitCache_var_blocks[i];
+		uint32 ok = 0;
+		if (!block->valid) {
+			continue;
+		}
+		uint32_t guest_hash = JitAot_guesthash(block->guest_start, block->guest_end, &ok);
+		if (!ok) {
+			continue;
+		}
+
+		JitAot_record* record = &records[header.nblocks];
+		record->guest_start = (uint32_t)block->guest_start;
+		record->guest_end = (uint32_t)block->guest_end;
+		record->guest_hash = guest_hash;
+		record->host_size = (uint32_t)block->host_size;
+		record->reloc_first = header.nrelocs;
+		record->nrelocs = (uint32_t)block->nrelocs;
+		record->code_offset = header.code_size;	// relative for now
+		index[header.nblocks] = i;
+
+		header.nblocks += 1;
+		header.nrelocs += block->nrelocs;
+		header.code_size += (block->host_size + (JITAOT_CODE_ALIGN - 1)) & ~(JITAOT_CODE_ALIGN - 1);
+	}
+
+	if (header.nblocks == 0) {
+		efree(records);
+		return 0;
+	}
+
+	uint32 code_start = sizeof(JitAot_header) + header.nblocks * sizeof(JitAot_record) + header.nrelocs * sizeof(JitCache_reloc);
+	code_start = (code_start + (JITAOT_CODE_ALIGN - 1)) & ~(JITAOT_CODE_ALIGN - 1);
+	for (uint32 i = 0; i < header.nblocks; i++) {
+		records[i].code_offset += code_start;
+	}
+
+	// write to a temporary name and rename, a running emulator may have the old file mapped
+	char path[512];
+	char temppath[520];
+	JitAot_path(path, sizeof(path), dir, imagehash);
+	snprintf(temppath, sizeof(temppath), "%s.tmp", path);
+
+	FILE* outfile = fopen(temppath, "wb");
+	if (outfile == NULL) {
+		printf("jit cache: could not write %s\n", temppath);
+		efree(records);
+		return 0;
+	}
+
+	// pass 2: header, records, relocs, code
+	fwrite(&header, sizeof(JitAot_header), 1, outfile);
+	fwrite(records, sizeof(JitAot_record), header.nblocks, outfile);
+	for (uint32 i = 0; i < header.nblocks; i++) {
+		JitCache_block* block = &JitCache_var_blocks[index[i]];
+		if (block->nrelocs != 0) {
+			fwrite(block->relocs, sizeof(JitCache_reloc), block->nrelocs, outfile);
+		}
+	}
+
+	static const uint8 padding[JITAOT_CODE_ALIGN] = { 0 };
+	uint32 pos = sizeof(JitAot_header) + header.nblocks * sizeof(JitAot_record) + header.nrelocs * sizeof(JitCache_reloc);
+	uint8* scratch = (uint8*)emalloc(JITCACHE_GENERATION_SIZE);
+	for (uint32 i = 0; i < header.nblocks; i++) {
+		JitCache_block* block = &JitCache_var_blocks[index[i]];
+
+		fwrite(padding, 1, records[i].code_offset - pos, outfile);
+		pos = records[i].code_offset;
+
+		// address in this process -> offset from symbol
+		ememcpy(scratch, block->host_code, block->host_size);
+		for (uint32 j = 0; j < block->nrelocs; j++) {
+			uint8* site = scratch + block->relocs[j].offset;
+			JitAot_write32(site, JitAot_read32(site) - Jit_symbol(block->relocs[j].symbol));
+		}
+		fwrite(scratch, 1, block->host_size, outfile);
+		pos += block->host_size;
+	}
+	efree(scratch);
+
+	int failed = ferror(outfile);
+	fclose(outfile);
+	efree(records);
+
+	if (failed) {
+		printf("jit cache: write error on %s\n", temppath);
+		remove(temppath);
+		return 0;
+	}
+	if (rename(temppath, path) != 0) {
+		// windows does not replace on rename
+		remove(path);
+		if (rename(temppath, path) != 0) {
+			printf("jit cache: could not rename %s\n", temppath);
+			remove(temppath);
+			return 0;
+		}
+	}
+
+	eprintf("jit cache: %d blocks saved to %s\n", header.nblocks, path);
+	return header.nblocks;
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include "Proxy.hpp"
+#include "Memory.hpp"
+#include "JitCache.hpp"
+#include "Jit.hpp"
+
+/*
+* persistent translation cache
+*
+* the same firmware image gets booted over and over (ci runs it thousands of times a day),
+* and every boot used to translate the same hot blocks from scratch.
+* JitAot_save writes every cached block into a file, JitAot_load maps it back on the next run.
+*
+* key:
+* - file name and header carry the image hash and MICROCON_EMU_VERSION (plus a few struct sizes).
+* - the image hash covers the memory map and the contents of every executable direct section,
+*   so load right after the image is in memory and before the guest runs.
+* - every block also keeps a hash of its own guest bytes and is only used if they still match.
+*   (code a bootloader copies into sram at runtime is not there yet at boot, those blocks are just skipped)
+*
+* relocations:
+* - generated code bakes host addresses (temps, CPU_var_reg, section data, pagemaps, helpers), see Jit_reloc_enum.
+* - on save each one becomes an offset from its symbol, on load the symbol address of this process is added back.
+*
+* loading:
+* - the file is mapped copy-on-write and executable, blocks run straight out of the mapping (JitCache_adopt).
+* - nothing is read or copied up front. a page comes in when it is relocated or first executed,
+*   and only pages that carry relocations get a private copy.
+*
+* file layout (uint32_t, little endian, 4 byte aligned):
+* JitAot_header | JitAot_record[nblocks] | JitCache_reloc[nrelocs] | code (each block 16 byte aligned)
+*
+* the cache directory comes from the MICROCON_EMU_JITCACHE environment variable. unset -> disabled. off while fuzzing.
+* only a host that runs generated code (JIT_HOST_X86) reads or writes anything.
+*/
+
+#define JITAOT_MAGIC 0x434A434D	// "MCJC"
+#define JITAOT_ENV "MICROCON_EMU_JITCACHE"
+#define JITAOT_CODE_ALIGN 16
+
+struct JitAot_header {
+	uint32_t magic;
+	uint32_t version;	// MICROCON_EMU_VERSION
+	uint32_t abi;		// JITAOT_ABI
+	uint32_t imagehash_lo;
+	uint32_t imagehash_hi;
+	uint32_t nblocks;
+	uint32_t nrelocs;
+	uint32_t code_size;
+};
+
+struct JitAot_record {
+	uint32_t guest_start;
+	uint32_t guest_end;
+	uint32_t guest_hash;	// fnv-1a of the guest bytes the block was translated from
+	uint32_t code_offset;	// from the start of the file
+	uint32_t host_size;
+	uint32_t reloc_first;	// index into the reloc table
+	uint32_t nrelocs;
+};
+
+// anything whose layout the generated code depends on
+#define JITAOT_ABI ((uint32_t)((sizeof(CPU_struct_reg) << 16) | (JIT_RELOC_NUMBER_OF_SYMBOLS << 8) | sizeof(void*)))
+
+// telemetry of the last load
+extern uint32 JitAot_var_loaded;
+extern uint32 JitAot_var_rejected;
+
+// cache directory (NULL -> persistent cache disabled)
+extern const char* JitAot_dir();
+
+// hash of the memory map and executable memory contents
+extern uint64_t JitAot_imagehash();
+
+// adopt every still valid block of the cache file for this image. after the image is loaded and CPU_init
+// (0 before that). returns number of blocks loaded
+extern uint32 JitAot_load(const char* dir);
+
+// write every cached block. returns number of blocks written
+extern uint32 JitAot_save(const char* dir);
@@ -0,0 +1,335 @@
+#include "JitCache.hpp"
+
+struct JitCache_block JitCache_var_blocks[JITCACHE_MAX_BLOCKS];
+uint32 JitCache_var_hash[JITCACHE_HASH_SIZE];
+uint32 JitCache_var_pages[JITCACHE_PAGE_HASH_SIZE];
+
+uint8* JitCache_var_arena = NULL;
+uint32 JitCache_var_generation = 0;
+uint32 JitCache_var_genpos = 0;
+uint32 JitCache_var_blockcursor = 0;	// where to start looking for a free descriptor
+
+uint32 JitCache_var_hits = 0;
+uint32 JitCache_var_misses = 0;
+uint32 JitCache_var_invalidations = 0;
+uint32 JitCache_var_flushes = 0;
+uint32 JitCache_var_epoch = 0;
+
+// unlink a block from its hash and page buckets and mark the descriptor free
+static void JitCache_remove(uint32 idx) {
+	uint32 bucket = JITCACHE_HASH(JitCache_var_blocks[idx].guest_start);
+	uint32* link = &JitCache_var_hash[bucket];
+
+	while (*link != JITCACHE_NONE) {
+		if (*link == idx) {
+			*link = JitCache_var_blocks[idx].hashnext;
+			break;
+		}
+		link = &JitCache_var_blocks[*link].hashnext;
+	}
+
+	link = &JitCache_var_pages[JITCACHE_PAGE_HASH(JitCache_var_blocks[idx].guest_start)];
+	while (*link != JITCACHE_NONE) {
+		if (*link == idx) {
+			*link = JitCache_var_blocks[idx].pagenext;
+			break;
+		}
+		link = &JitCache_var_blocks[*link].pagenext;
+	}
+
+	// relocs of adopted blocks belong to the mapping
+	if (JitCache_var_blocks[idx].generation != JITCACHE_MAPPED && JitCache_var_blocks[idx].relocs != NULL) {
+		efree(JitCache_var_blocks[idx].relocs);
+	}
+	JitCache_var_blocks[idx].relocs = NULL;
+	JitCache_var_blocks[idx].nrelocs = 0;
+
+	JitCache_var_blocks[idx].valid = 0;
+	JitCache_var_blocks[idx].hashnext = JITCACHE_NONE;
+	JitCache_var_blocks[idx].pagenext = JITCACHE_NONE;
+}
+
+// drop every block of one arena slice
+static void JitCache_flush_generation(uint32 generation) {
+	for (uint32 i = 0; i < JITCACHE_MAX_BLOCKS; i++) {
+		if (JitCache_var_blocks[i].valid && JitCache_var_blocks[i].generation == generation) {
+			JitCache_remove(i);
+		}
+	}
+	JitCache_var_flushes += 1;
+}
+
+// move to the next slice, evicting whatever was left there from the last lap
+static void JitCache_next_generation() {
+	JitCache_var_generation += 1;
+	if (JitCache_var_generation == JITCACHE_GENERATIONS) {
+		JitCache_var_generation = 0;
+	}
+	JitCache_var_genpos = 0;
+	JitCache_flush_generation(JitCache_var_generation);
+}
+
+uint32* JitCache_pagemap(Memory_map_elem* thismap) {
+	if (thismap->jit_pagemap == NULL) {
+		// one bit per page
+		thismap->jit_pagemap = ecalloc(MEMORY_CODEPAGE_WORDS(thismap->size), sizeof(uint32));
+	}
+	return thismap->jit_pagemap;
+}
+
+// mark guest pages of [start, end) as containing translated code
+static void JitCache_mark_pages(uint32 start, uint32 end) {
+	Memory_map_elem* thismap = Memory_getMap(start);
+	if (thismap == NULL) {
+		return;
+	}
+
+	JitCache_pagemap(thismap);
+
+	for (uint32 offset = (start - thismap->base) & ~((0x1 << MEMORY_CODEPAGE_SHIFT) - 1);
+		offset < end - thismap->base; offset += (0x1 << MEMORY_CODEPAGE_SHIFT)) {
+		MEMORY_CODEPAGE_SET(thismap->jit_pagemap, offset);
+	}
+}
+
+void JitCache_init() {
+	if (JitCache_var_arena == NULL) {
+		JitCache_var_arena = (uint8*)make_exec_memory(JITCACHE_CODE_SIZE);
+		m_assert(JitCache_var_arena != NULL, "could not allocate executable memory for the jit\n");
+	}
+
+	for (uint32 i = 0; i < JITCACHE_HASH_SIZE; i++) {
+		JitCache_var_hash[i] = JITCACHE_NONE;
+	}
+	for (uint32 i = 0; i < JITCACHE_PAGE_HASH_SIZE; i++) {
+		JitCache_var_pages[i] = JITCACHE_NONE;
+	}
+	for (uint32 i = 0; i < JITCACHE_MAX_BLOCKS; i++) {
+		if (JitCache_var_blocks[i].valid && JitCache_var_blocks[i].generation != JITCACHE_MAPPED && JitCache_var_blocks[i].relocs != NULL) {
+			efree(JitCache_var_blocks[i].relocs);
+		}
+		JitCache_var_blocks[i].relocs = NULL;
+		JitCache_var_blocks[i].nrelocs = 0;
+		JitCache_var_blocks[i].valid = 0;
+		JitCache_var_blocks[i].hashnext = JITCACHE_NONE;
+		JitCache_var_blocks[i].pagenext = JITCACHE_NONE;
+	}
+
+	JitCache_var_generation = 0;
+	JitCache_var_genpos = 0;
+	JitCache_var_blockcursor = 0;
+
+	JitCache_var_hits = 0;
+	JitCache_var_misses = 0;
+	JitCache_var_invalidations = 0;
+	JitCache_var_flushes = 0;
+}
+
+// bucket walk without touching telemetry
+static uint32 JitCache_find(uint32 pc) {
+	uint32 idx = JitCache_var_hash[JITCACHE_HASH(pc)];
+
+	while (idx != JITCACHE_NONE) {
+		if (JitCache_var_blocks[idx].guest_start == pc) {
+			return idx;
+		}
+		idx = JitCache_var_blocks[idx].hashnext;
+	}
+	return JITCACHE_NONE;
+}
+
+JitCache_block* JitCache_lookup(uint32 pc) {
+	uint32 idx = JitCache_find(pc);
+
+	if (idx == JITCACHE_NONE) {
+		JitCache_var_misses += 1;
+		return NULL;
+	}
+
+	JitCache_var_hits += 1;
+	return &JitCache_var_blocks[idx];
+}
+
+// find a free descriptor, evicting the oldest slice if there is none
+static uint32 JitCache_alloc_descriptor() {
+	uint32 idx = JITCACHE_NONE;
+	for (uint32 tries = 0; tries < 2 && idx == JITCACHE_NONE; tries++) {
+		for (uint32 i = 0; i < JITCACHE_MAX_BLOCKS; i++) {
+			uint32 cand = (JitCache_var_blockcursor + i) & (JITCACHE_MAX_BLOCKS - 1);
+			if (!JitCache_var_blocks[cand].valid) {
+				idx = cand;
+				break;
+			}
+		}
+		if (idx == JITCACHE_NONE) {
+			// descriptors ran out before the arena did. evict the oldest slice anyway
+			JitCache_next_generation();
+		}
+	}
+	if (idx != JITCACHE_NONE) {
+		JitCache_var_blockcursor = idx + 1;
+	}
+	return idx;
+}
+
+// fill the descriptor and hook it into its bucket and the pagemap
+static JitCache_block* JitCache_link(uint32 idx, uint32 guest_start, uint32 guest_end, uint8* code, uint32 size, uint32 generation) {
+	JitCache_block* block = &JitCache_var_blocks[idx];
+	block->guest_start = guest_start;
+	block->guest_end = guest_end;
+	block->host_code = code;
+	block->host_size = size;
+	block->generation = generation;
+	block->relocs = NULL;
+	block->nrelocs = 0;
+	block->covered = 0;
+	block->exits = 0;
+	block->idiom = 0;
+	block->poll = 0;
+	block->valid = 1;
+
+	uint32 bucket = JITCACHE_HASH(guest_start);
+	block->hashnext = JitCache_var_hash[bucket];
+	JitCache_var_hash[bucket] = idx;
+
+	bucket = JITCACHE_PAGE_HASH(guest_start);
+	block->pagenext = JitCache_var_pages[bucket];
+	JitCache_var_pages[bucket] = idx;
+
+	JitCache_mark_pages(guest_start, guest_end);
+
+	return block;
+}
+
+JitCache_block* JitCache_insert(uint32 guest_start, uint32 guest_end, const uint8* code, uint32 size,
+	const JitCache_reloc* relocs, uint32 nrelocs) {
+	if (size > JITCACHE_GENERATION_SIZE) {
+		printf("jit block too big for the cache (%d bytes)\n", (int)size);
+		return NULL;
+	}
+
+	// a block for the same pc is replaced, not duplicated
+	uint32 old = JitCache_find(guest_start);
+	if (old != JITCACHE_NONE) {
+		JitCache_remove(old);
+	}
+
+	// room for the code
+	if (JitCache_var_genpos + size > JITCACHE_GENERATION_SIZE) {
+		JitCache_next_generation();
+	}
+
+	// room for the descriptor
+	uint32 idx = JitCache_alloc_descriptor();
+	if (idx == JITCACHE_NONE) {
+		return NULL;
+	}
+
+	uint8* dest = JitCache_var_arena + (JitCache_var_generation * JITCACHE_GENERATION_SIZE) + JitCache_var_genpos;
+	ememcpy(dest, code, size);
+	JitCache_var_genpos += size;
+
+	JitCache_block* block = JitCache_link(idx, guest_start, guest_end, dest, size, JitCache_var_generation);
+
+	if (nrelocs != 0) {
+		block->relocs = (JitCache_reloc*)emalloc(nrelocs * sizeof(JitCache_reloc));
+		ememcpy(block->relocs, relocs, nrelocs * sizeof(JitCache_reloc));
+		block->nrelocs = nrelocs;
+	}
+
+	return block;
+}
+
+JitCache_block* JitCache_adopt(uint32 guest_start, uint32 guest_end, uint8* code, uint32 size,
+	JitCache_reloc* relocs, uint32 nrelocs) {
+	uint32 old = JitCache_find(guest_start);
+	if (old != JITCACHE_NONE) {
+		JitCache_remove(old);
+	}
+
+	uint32 idx = JitCache_alloc_descriptor();
+	if (idx == JITCACHE_NONE) {
+		return NULL;
+	}
+
+	JitCache_block* block = JitCache_link(idx, guest_start, guest_end, code, size, JITCACHE_MAPPED);
+	block->relocs = relocs;
+	block->nrelocs = nrelocs;
+
+	return block;
+}
+
+void JitCache_invalidate(uint32 addr, uint32 size) {
+	Memory_map_elem* thismap = Memory_getMap(addr);
+	if (thismap == NULL || thismap->jit_pagemap == NULL) {
+		return;
+	}
+
+	uint32 end = addr + size;
+	uint32 pagemask = ~((0x1 << MEMORY_CODEPAGE_SHIFT) - 1);
+	uint32 firstpage = addr & pagemask;
+	uint32 lastpage = (end - 1) & pagemask;
+	uint32 keep_first = 0;
+	uint32 keep_last = 0;
+
+	// blocks starting on the written pages, or on the page before and running into them.
+	// past JITCACHE_PAGE_HASH_SIZE pages the buckets repeat, every one is walked once
+	uint32 from = (firstpage > thismap->base) ? firstpage - (0x1 << MEMORY_CODEPAGE_SHIFT) : firstpage;
+	uint32 pages = ((lastpage - from) >> MEMORY_CODEPAGE_SHIFT) + 1;
+	if (pages > JITCACHE_PAGE_HASH_SIZE) {
+		pages = JITCACHE_PAGE_HASH_SIZE;
+	}
+
+	for (uint32 p = 0; p < pages; p++) {
+		uint32 idx = JitCache_var_pages[JITCACHE_PAGE_HASH(from + (p << MEMORY_CODEPAGE_SHIFT))];
+		while (idx != JITCACHE_NONE) {
+			JitCache_block* block = &JitCache_var_blocks[idx];
+			uint32 next = block->pagenext;
+
+			if (block->guest_start < end && addr < block->guest_end) {
+				// stale
+				JitCache_remove(idx);
+				JitCache_var_invalidations += 1;
+				idx = next;
+				continue;
+			}
+
+			// survivor still sitting on the written pages -> keep their bits set
+			if (block->guest_start < firstpage + (0x1 << MEMORY_CODEPAGE_SHIFT) && firstpage < block->guest_end) {
+				keep_first = 1;
+			}
+			if (block->guest_start < lastpage + (0x1 << MEMORY_CODEPAGE_SHIFT) && lastpage < block->guest_end) {
+				keep_last = 1;
+			}
+			idx = next;
+		}
+	}
+
+	// nothing translated is left there, so the next writes go through without a scan
+	if (!keep_first) {
+		MEMORY_CODEPAGE_CLEAR(thismap->jit_pagemap, firstpage - thismap->base);
+	}
+	if (!keep_last) {
+		MEMORY_CODEPAGE_CLEAR(thismap->jit_pagemap, lastpage - thismap->base);
+	}
+}
+
+void JitCache_flush() {
+	for (uint32 i = 0; i < JITCACHE_MAX_BLOCKS; i++) {
+		if (JitCache_var_blocks[i].valid) {
+			JitCache_remove(i);
+		}
+	}
+
+	// every pagemap goes back to clean
+	for (uint32 i = 0; i < Memory_var_arrlen; i++) {
+		if (Memory_var_arr[i].jit_pagemap != NULL) {
+			memset(Memory_var_arr[i].jit_pagemap, 0, MEMORY_CODEPAGE_WORDS(Memory_var_arr[i].size) * sizeof(uint32));
+		}
+	}
+
+	JitCache_var_generation = 0;
+	JitCache_var_genpos = 0;
+	JitCache_var_flushes += 1;
+	JitCache_var_epoch += 1;
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include "Proxy.hpp"
+#include "Memory.hpp"
+
+/*
+* translation cache for the jit
+*
+* translated blocks are keyed by guest pc and their host code lives in one executable arena.
+*
+* self-modifying code:
+* - firmware copying code into sram, or bootloaders reprogramming flash, make translated blocks stale.
+* - every block marks the guest pages it covers in Memory_map_elem->jit_pagemap.
+* - Memory_write tests that bitmap and calls JitCache_invalidate only when the page has code on it.
+* - invalidation drops the blocks overlapping the written range and nothing else. blocks are also listed by the
+*   page they start on (JitCache_var_pages), a block is shorter than a page (IR_MAX_GUEST), so only the lists
+*   of the written pages and the one before them are walked, not every descriptor.
+* - bits are never cleared on eviction. a stale bit only costs one scan that finds nothing, and then the bit is cleared.
+*
+* eviction (generational flush):
+* - the arena is split into JITCACHE_GENERATIONS equal slices, filled one after another.
+* - when the current slice is full we move to the next one and flush only the blocks that were living there.
+* - so a full cache throws away the oldest 1/JITCACHE_GENERATIONS of the code, never everything.
+*
+* the host code of an invalidated block is not touched until its slice is reused, which can only happen inside
+* JitCache_insert. so invalidating the block that is currently running (it wrote to itself) is safe
+* as long as the dispatcher does not re-enter it.
+*
+* relocations:
+* - every host address baked into a block (temps, registers, section data, helpers) is listed in its relocs,
+*   so the code can be written out and patched for another process (JitAot.cpp).
+* - blocks loaded that way live in the mapped cache file, not in the arena. they are adopted with
+*   JITCACHE_MAPPED as generation, so eviction never touches them. invalidation and flush still do.
+*/
+
+#define JITCACHE_CODE_SIZE 0x100000	// 1MB of host code
+#define JITCACHE_GENERATIONS 4
+#define JITCACHE_GENERATION_SIZE (JITCACHE_CODE_SIZE / JITCACHE_GENERATIONS)
+#define JITCACHE_MAX_BLOCKS 4096
+#define JITCACHE_HASH_SIZE 4096	// power of 2
+#define JITCACHE_HASH(pc) (((pc) >> 1) & (JITCACHE_HASH_SIZE - 1))
+#define JITCACHE_PAGE_HASH_SIZE 1024	// power of 2
+#define JITCACHE_PAGE_HASH(addr) (((addr) >> MEMORY_CODEPAGE_SHIFT) & (JITCACHE_PAGE_HASH_SIZE - 1))
+#define JITCACHE_NONE 0xFFFFFFFF
+#define JITCACHE_MAPPED JITCACHE_GENERATIONS	// generation of adopted blocks
+
+// absolute host address inside a block: byte offset of the imm32/disp32, and what it points into (Jit_reloc_enum)
+// fixed width, this is also the on-disk format
+struct JitCache_reloc {
+	uint32_t offset;
+	uint32_t symbol;
+};
+
+struct JitCache_block {
+	uint32 guest_start;	// inclusive
+	uint32 guest_end;	// exclusive
+	uint8* host_code;
+	uint32 host_size;
+	uint32 generation;
+	struct JitCache_reloc* relocs;
+	uint32 nrelocs;
+	uint32 hashnext;	// next block index in the same bucket
+	uint32 pagenext;	// next block index in the same page bucket
+	uint32 covered;	// already marked in the coverage bitmap
+	uint32 exits;	// coverage paths: left after n guest instructions before, bit (n - 1) & 31
+	uint32 idiom;	// Idiom_match handle, 0: not a copy / fill / scan loop
+	uint32 poll;	// Poll_match: guest cycles of one round of a polling loop, 0: not one
+	uint32 valid;
+};
+
+extern struct JitCache_block JitCache_var_blocks[JITCACHE_MAX_BLOCKS];
+extern uint32 JitCache_var_hash[JITCACHE_HASH_SIZE];
+extern uint32 JitCache_var_pages[JITCACHE_PAGE_HASH_SIZE];	// blocks by the page of guest_start
+
+extern uint8* JitCache_var_arena;
+extern uint32 JitCache_var_generation;	// slice currently being filled
+extern uint32 JitCache_var_genpos;	// bump offset inside the current slice
+extern uint32 JitCache_var_epoch;	// bumped by JitCache_flush: code compiled before it is stale
+
+// telemetry
+extern uint32 JitCache_var_hits;
+extern uint32 JitCache_var_misses;
+extern uint32 JitCache_var_invalidations;
+extern uint32 JitCache_var_flushes;
+
+extern void JitCache_init();
+
+// find a valid block that starts at pc (NULL if none)
+extern JitCache_block* JitCache_lookup(uint32 pc);
+
+// copy host code into the arena and register it for guest range [guest_start, guest_end)
+// the code must not contain pc-relative references outside of itself. relocs are copied too
+extern JitCache_block* JitCache_insert(uint32 guest_start, uint32 guest_end, const uint8* code, uint32 size,
+	const JitCache_reloc* relocs, uint32 nrelocs);
+
+// register code that already sits in executable memory (a mapped cache file). nothing is copied,
+// code and relocs must stay valid until JitCache_flush
+extern JitCache_block* JitCache_adopt(uint32 guest_start, uint32 guest_end, uint8* code, uint32 size,
+	JitCache_reloc* relocs, uint32 nrelocs);
+
+// guest wrote [addr, addr + size): drop every block that overlaps it
+extern void JitCache_invalidate(uint32 addr, uint32 size);
+
+// drop everything (reset, image reload)
+extern void JitCache_flush();
+
+// code pagemap of a section, allocated on first use. the pointer never changes afterwards,
+// so generated code may embed it
+extern uint32* JitCache_pagemap(Memory_map_elem* thismap);
@@ -0,0 +1,122 @@
+#include "Loader.hpp"
+#include "Memory.hpp"
+#include "Board.hpp"
+#include "CPU.hpp"
+#include "Coverage.hpp"	// COVERAGE_ELF_ENV
+#include <stdlib.h>	// getenv
+#include <string.h>
+
+const char* Loader_var_path = NULL;
+
+static uint32 Loader_u16(const uint8* p) {
+	return p[0] | (p[1] << 8);
+}
+
+static uint32 Loader_u32(const uint8* p) {
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32)p[3] << 24);
+}
+
+static uint32 Loader_word(uint32 addr) {
+	uint8* data = (uint8*)Memory_read(addr, Memory_enum_size::u32, MEMORY_ATTRIB_S_R);
+	return (data == NULL) ? 0 : Loader_u32(data);
+}
+
+// size bytes of data (NULL: zeroes) to addr. 0 if some of it has no memory behind it
+static uint32 Loader_copy(uint32 addr, const uint8* data, uint32 size) {
+	for (uint32 i = 0; i < size; i++) {
+		if (Memory_getMap(addr + i) == NULL) {
+			printf("loader: nothing mapped at 0x%08x\n", (unsigned)(addr + i));
+			return 0;
+		}
+		Memory_write(addr + i, Memory_enum_size::u8, (data != NULL) ? data[i] : 0, MEMORY_ATTRIB_S_W);
+	}
+	return 1;
+}
+
+static uint32 Loader_elf(const uint8* elf, uint32 elfsize) {
+	if (elfsize < 0x34 || elf[4] != 1 || elf[5] != 1 || Loader_u16(elf + 0x12) != 40) {
+		printf("loader: not a 32 bit little endian arm elf\n");	// EM_ARM
+		return 0;
+	}
+	uint32 phoff = Loader_u32(elf + 0x1C);
+	uint32 phentsize = Loader_u16(elf + 0x2A);
+	uint32 phnum = Loader_u16(elf + 0x2C);
+	if (phentsize < 32 || phoff > elfsize || (uint64_t)phnum * phentsize > elfsize - phoff) {
+		printf("loader: bad program headers\n");
+		return 0;
+	}
+
+	uint32 loaded = 0;
+	for (uint32 i = 0; i < phnum; i++) {
+		const uint8* ph = elf + phoff + i * phentsize;
+		uint32 offset = Loader_u32(ph + 0x04);
+		uint32 paddr = Loader_u32(ph + 0x0C);
+		uint32 filesz = Loader_u32(ph + 0x10);
+		uint32 memsz = Loader_u32(ph + 0x14);
+		if (Loader_u32(ph) != 1 || memsz == 0) {	// PT_LOAD
+			continue;
+		}
+		if (offset > elfsize || filesz > elfsize - offset || filesz > memsz) {
+			printf("loader: segment %d is past the end of the file\n", (int)i);
+			return 0;
+		}
+		if (!Loader_copy(paddr, elf + offset, filesz) || !Loader_copy(paddr + filesz, NULL, memsz - filesz)) {
+			return 0;
+		}
+		loaded += 1;
+	}
+	if (loaded == 0) {
+		printf("loader: no loadable segments\n");
+	}
+	return loaded != 0;
+}
+
+const char* Loader_path() {
+	const char* path = Loader_var_path;
+	if (path == NULL || path[0] == '\0') {
+		path = getenv(LOADER_IMAGE_ENV);
+	}
+	if (path == NULL || path[0] == '\0') {
+		path = getenv(COVERAGE_ELF_ENV);
+	}
+	return (path == NULL || path[0] == '\0') ? NULL : path;
+}
+
+uint32 Loader_load(const char* path) {
+	uint32 size = 0;
+	uint8* image = (uint8*)map_file(path, &size);
+	if (image == NULL) {
+		printf("loader: can't open %s\n", path);
+		return 0;
+	}
+
+	uint32 ok;
+	if (size >= 4 && memcmp(image, "\x7F" "ELF", 4) == 0) {
+		ok = Loader_elf(image, size);
+	}
+	else if (size > Board_var_regions[0].size) {
+		printf("loader: %s is %d bytes, the code region is %d\n", path, (int)size, (int)Board_var_regions[0].size);
+		ok = 0;
+	}
+	else {
+		ok = Loader_copy(Board_var_regions[0].base, image, size);
+	}
+	unmap_file(image, size);
+	return ok;
+}
+
+uint32 Loader_boot() {
+	const char* path = Loader_path();
+	if (path == NULL || !Loader_load(path)) {
+		return 0;
+	}
+
+	uint32 sp = Loader_word(Board_var_regions[0].base);
+	uint32 pc = Loader_word(Board_var_regions[0].base + 4);
+	if ((pc & 0x1) == 0) {
+		printf("loader: reset vector 0x%08x is not a thumb address\n", (unsigned)pc);	// invstate on the part
+	}
+	CPU_init(pc & ~0x1, sp);
+	printf("loader: %s, sp 0x%08x, pc 0x%08x\n", path, (unsigned)sp, (unsigned)(pc & ~0x1));
+	return 1;
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include "Proxy.hpp"
+
+/*
+* image loader
+*
+* puts the firmware into guest memory and takes the cpu out of reset:
+* - the image is the first argument, or MICROCON_EMU_IMAGE=<file>, or else MICROCON_EMU_ELF (the elf coverage,
+*   hle and rtos read their symbols from).
+* - elf32 (arm, little endian): every PT_LOAD segment goes to its physical (load) address, the part the file
+*   doesn't cover (bss) is zeroed. initialized data is copied to ram by the startup code, like on the part.
+* - anything else is a raw binary for the start of the code region (Board_var_regions[0]).
+* - reset: the vector table is at the start of the code region (VTOR 0), sp from word 0, pc from word 1.
+*/
+
+#define LOADER_IMAGE_ENV "MICROCON_EMU_IMAGE"
+
+extern const char* Loader_var_path;	// main: the first argument, NULL if there is none
+
+// the image to boot, NULL if nothing names one
+extern const char* Loader_path();
+
+// image into memory, 1 if it loaded
+extern uint32 Loader_load(const char* path);
+
+// after Memory_init: Loader_load, then CPU_init from the vector table. 0 if there is no image
+extern uint32 Loader_boot();
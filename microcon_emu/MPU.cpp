@@ -0,0 +1,296 @@
+#include "MPU.hpp"
+#include "JitCache.hpp"
+
+struct MPU_region MPU_var_region[MPU_REGIONS];
+uint32 MPU_var_ctrl = 0;
+uint32 MPU_var_rnr = 0;
+
+uint32 MPU_var_active = 0;
+uint32 MPU_var_privileged = 1;
+uint32 MPU_var_rebuilds = 0;
+
+// regions changed while the mpu was off, rebuild when it gets enabled
+static uint32 MPU_var_dirty = 1;
+
+// per section permission caches: [section][0: unprivileged, 1: privileged]
+static uint8* MPU_var_cache[MEMORY_MAP_MAX_SECTIONS][2];
+
+// AP field -> access in U_ bit position (shift by 5 for the S_ bits)
+#define MPU_NA 0
+#define MPU_RO MEMORY_ATTRIB_U_R
+#define MPU_RW (MEMORY_ATTRIB_U_R | MEMORY_ATTRIB_U_W)
+#define MPU_SUPER_SHIFT 5
+
+static const uint32 MPU_var_ap_priv[8] = { MPU_NA, MPU_RW, MPU_RW, MPU_RW, MPU_NA, MPU_RO, MPU_RO, MPU_RO };
+static const uint32 MPU_var_ap_unpriv[8] = { MPU_NA, MPU_NA, MPU_RO, MPU_RW, MPU_NA, MPU_NA, MPU_RO, MPU_RO };
+
+// instruction fetch needs read access and no XN
+static uint32 MPU_exec(uint32 perm, uint32 xn) {
+	if ((perm & MEMORY_ATTRIB_U_R) && !xn) {
+		return perm | MEMORY_ATTRIB_U_X;
+	}
+	return perm;
+}
+
+// cache byte of a region, for the privileged or the unprivileged cache
+static uint32 MPU_region_perm(uint32 rasr, uint32 privileged) {
+	uint32 xn = rasr & MPU_RASR_XN;
+	uint32 user = MPU_exec(MPU_var_ap_unpriv[MPU_RASR_AP(rasr)], xn);
+	uint32 super = privileged ? MPU_exec(MPU_var_ap_priv[MPU_RASR_AP(rasr)], xn) : user;
+	return user | (super << MPU_SUPER_SHIFT);
+}
+
+// no region matched: default memory map for privileged code if PRIVDEFENA, fault otherwise
+static uint32 MPU_background(uint32 addr, uint32 privileged) {
+	if (!privileged || !(MPU_var_ctrl & MPU_CTRL_PRIVDEFENA)) {
+		return 0;
+	}
+	// code, sram and external ram are executable, peripherals and devices are XN
+	uint32 xn = !(addr < 0x40000000 || (addr >= 0x60000000 && addr < 0xA0000000));
+	return MPU_exec(MPU_RW, xn) << MPU_SUPER_SHIFT;
+}
+
+// region r covers addr (subregions included)
+static uint32 MPU_region_hit(uint32 r, uint32 addr) {
+	uint32 rasr = MPU_var_region[r].rasr;
+	uint32 sizelog = MPU_RASR_SIZE(rasr) + 1;
+	if (!(rasr & MPU_RASR_ENABLE) || sizelog < MPU_PAGE_SHIFT) {
+		return 0;
+	}
+
+	uint64_t size = (uint64_t)0x1 << sizelog;
+	uint64_t base = (uint64_t)(MPU_var_region[r].rbar & MPU_RBAR_ADDR) & ~(size - 1);
+	if ((uint64_t)addr < base || (uint64_t)addr >= base + size) {
+		return 0;
+	}
+
+	// subregions only exist from 256 bytes up
+	if (sizelog >= 8) {
+		uint32 sub = (uint32)(((uint64_t)addr - base) >> (sizelog - 3));
+		if (MPU_RASR_SRD(rasr) & (0x1 << sub)) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+uint32 MPU_resolve(uint32 addr) {
+	if (addr >= MPU_SYSTEM_BASE) {
+		return MEMORY_ATTRIB_CRITICAL;
+	}
+
+	// highest numbered region wins
+	for (uint32 r = MPU_REGIONS; r-- > 0;) {
+		if (MPU_region_hit(r, addr)) {
+			return MPU_region_perm(MPU_var_region[r].rasr, MPU_var_privileged);
+		}
+	}
+	return MPU_background(addr, MPU_var_privileged);
+}
+
+// point every section at the cache of the current privilege
+static void MPU_select() {
+	for (uint32 i = 0; i < Memory_var_arrlen; i++) {
+		Memory_var_arr[i].mpu_perm = MPU_var_cache[i][MPU_var_privileged];
+	}
+}
+
+// write [lo, hi) of region r into the caches of section i
+static void MPU_paint(uint32 i, uint64_t lo, uint64_t hi, uint32 rasr) {
+	Memory_map_elem* thismap = &Memory_var_arr[i];
+	uint64_t base = thismap->base;
+	uint64_t bound = base + thismap->size;
+
+	if (lo < base) {
+		lo = base;
+	}
+	if (hi > bound) {
+		hi = bound;
+	}
+	if (lo >= hi) {
+		return;
+	}
+
+	uint8 user = (uint8)MPU_region_perm(rasr, 0);
+	uint8 super = (uint8)MPU_region_perm(rasr, 1);
+	for (uint32 page = (uint32)((lo - base) >> MPU_PAGE_SHIFT); page <= (uint32)((hi - 1 - base) >> MPU_PAGE_SHIFT); page++) {
+		MPU_var_cache[i][0][page] = user;
+		MPU_var_cache[i][1][page] = super;
+	}
+}
+
+// flatten every region into the per page caches
+static void MPU_rebuild() {
+	MPU_var_rebuilds += 1;
+	MPU_var_dirty = 0;
+
+	for (uint32 i = 0; i < Memory_var_arrlen; i++) {
+		Memory_map_elem* thismap = &Memory_var_arr[i];
+		if (thismap->base >= MPU_SYSTEM_BASE || thismap->size > MPU_CACHE_LIMIT) {
+			continue;
+		}
+
+		uint32 pages = (thismap->size + (0x1 << MPU_PAGE_SHIFT) - 1) >> MPU_PAGE_SHIFT;
+		if (MPU_var_cache[i][0] == NULL) {
+			MPU_var_cache[i][0] = (uint8*)ecalloc(pages, sizeof(uint8));
+			MPU_var_cache[i][1] = (uint8*)ecalloc(pages, sizeof(uint8));
+		}
+
+		for (uint32 page = 0; page < pages; page++) {
+			MPU_var_cache[i][0][page] = 0;
+			MPU_var_cache[i][1][page] = (uint8)MPU_background(thismap->base + (page << MPU_PAGE_SHIFT), 1);
+		}
+
+		// lowest first, so higher numbered regions overwrite
+		for (uint32 r = 0; r < MPU_REGIONS; r++) {
+			uint32 rasr = MPU_var_region[r].rasr;
+			uint32 sizelog = MPU_RASR_SIZE(rasr) + 1;
+			if (!(rasr & MPU_RASR_ENABLE) || sizelog < MPU_PAGE_SHIFT) {
+				continue;
+			}
+
+			uint64_t size = (uint64_t)0x1 << sizelog;
+			uint64_t base = (uint64_t)(MPU_var_region[r].rbar & MPU_RBAR_ADDR) & ~(size - 1);
+			if (sizelog < 8) {
+				MPU_paint(i, base, base + size, rasr);
+				continue;
+			}
+			// disabled subregions let lower regions show through
+			uint64_t sub = size >> 3;
+			for (uint32 s = 0; s < 8; s++) {
+				if (!(MPU_RASR_SRD(rasr) & (0x1 << s))) {
+					MPU_paint(i, base + s * sub, base + (s + 1) * sub, rasr);
+				}
+			}
+		}
+	}
+
+	MPU_select();
+}
+
+// registers are kept in the ppb section so reads need no hook
+static void MPU_store32(uint32 addr, uint32 value) {
+	Memory_map_elem* thismap = Memory_getMap(addr);
+	if (thismap == NULL || addr + 4 > thismap->base + thismap->size) {
+		return;
+	}
+	uint8* data = &thismap->data[addr - thismap->base];
+	data[0] = (uint8)(value & 0xFF);
+	data[1] = (uint8)((value >> 8) & 0xFF);
+	data[2] = (uint8)((value >> 16) & 0xFF);
+	data[3] = (uint8)((value >> 24) & 0xFF);
+}
+
+static uint32 MPU_load32(uint32 addr) {
+	Memory_map_elem* thismap = Memory_getMap(addr);
+	if (thismap == NULL || addr + 4 > thismap->base + thismap->size) {
+		return 0;
+	}
+	uint8* data = &thismap->data[addr - thismap->base];
+	return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32)data[3] << 24);
+}
+
+// what a read of the registers returns
+static void MPU_mirror() {
+	MPU_store32(MPU_TYPE, MPU_REGIONS << 8);
+	MPU_store32(MPU_CTRL, MPU_var_ctrl);
+	MPU_store32(MPU_RNR, MPU_var_rnr);
+	for (uint32 alias = 0; alias < 4; alias++) {
+		MPU_store32(MPU_RBAR + alias * 8, MPU_var_region[MPU_var_rnr].rbar | MPU_var_rnr);
+		MPU_store32(MPU_RASR + alias * 8, MPU_var_region[MPU_var_rnr].rasr);
+	}
+}
+
+void MPU_init() {
+	for (uint32 r = 0; r < MPU_REGIONS; r++) {
+		MPU_var_region[r].rbar = 0;
+		MPU_var_region[r].rasr = 0;
+	}
+	MPU_var_ctrl = 0;
+	MPU_var_rnr = 0;
+	MPU_var_active = 0;
+	MPU_var_privileged = 1;
+	MPU_var_dirty = 1;
+	MPU_var_rebuilds = 0;
+
+	for (uint32 i = 0; i < MEMORY_MAP_MAX_SECTIONS; i++) {
+		MPU_var_cache[i][0] = NULL;
+		MPU_var_cache[i][1] = NULL;
+	}
+	MPU_select();
+	MPU_mirror();
+}
+
+// one aligned register written
+static void MPU_write_reg(uint32 addr) {
+	uint32 value = MPU_load32(addr);
+
+	switch (addr) {
+	case MPU_TYPE:
+		// read only
+		break;
+	case MPU_CTRL: {
+		uint32 was_enabled = MPU_var_ctrl & MPU_CTRL_ENABLE;
+		MPU_var_ctrl = value & (MPU_CTRL_ENABLE | MPU_CTRL_HFNMIENA | MPU_CTRL_PRIVDEFENA);
+		MPU_var_active = MPU_var_ctrl & MPU_CTRL_ENABLE;
+		if (MPU_var_active) {
+			// PRIVDEFENA changes the background
+			MPU_rebuild();
+		}
+		if (was_enabled != (MPU_var_ctrl & MPU_CTRL_ENABLE)) {
+			// jit code inlines accesses only while the mpu is off
+			JitCache_flush();
+		}
+		break;
+	}
+	case MPU_RNR:
+		MPU_var_rnr = value & (MPU_REGIONS - 1);
+		break;
+	default:
+		if (((addr - MPU_RBAR) & 0x7) == 0) {
+			// RBAR and aliases. VALID selects the region first
+			if (value & MPU_RBAR_VALID) {
+				MPU_var_rnr = value & MPU_RBAR_REGION & (MPU_REGIONS - 1);
+			}
+			MPU_var_region[MPU_var_rnr].rbar = value & MPU_RBAR_ADDR;
+		}
+		else {
+			// RASR and aliases
+			MPU_var_region[MPU_var_rnr].rasr = value;
+		}
+		if (MPU_var_ctrl & MPU_CTRL_ENABLE) {
+			MPU_rebuild();
+		}
+		else {
+			MPU_var_dirty = 1;
+		}
+		break;
+	}
+
+	if ((MPU_var_ctrl & MPU_CTRL_ENABLE) && MPU_var_dirty) {
+		MPU_rebuild();
+	}
+	MPU_mirror();
+}
+
+void MPU_write(uint32 addr, uint32 width) {
+	for (uint32 reg = addr & ~0x3; reg < addr + width; reg += 4) {
+		if (reg >= MPU_REG_BASE && reg < MPU_REG_BASE + MPU_REG_SIZE) {
+			MPU_write_reg(reg);
+		}
+	}
+}
+
+void MPU_sync(CPU_struct_reg* reg) {
+	uint32 exception = reg->xPSR.IPSR.exception;
+	uint32 privileged = (exception != 0 || !reg->CONTROL.nPRIV) ? 1 : 0;
+
+	// nmi, hardfault and FAULTMASK run with the mpu off unless HFNMIENA
+	uint32 bypass = (exception == 2 || exception == 3 || reg->FAULTMASK) && !(MPU_var_ctrl & MPU_CTRL_HFNMIENA);
+	MPU_var_active = (MPU_var_ctrl & MPU_CTRL_ENABLE) && !bypass;
+
+	if (privileged != MPU_var_privileged) {
+		MPU_var_privileged = privileged;
+		MPU_select();
+	}
+}
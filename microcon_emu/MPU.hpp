@@ -0,0 +1,94 @@
+#pragma once
+#include "Proxy.hpp"
+#include "Memory.hpp"
+#include "CPU.hpp"
+
+/*
+* armv7-m memory protection unit (pmsav7)
+*
+* registers (ppb, privileged only):
+* - 0xE000ED90 MPU_TYPE: DREGION = MPU_REGIONS, read only
+* - 0xE000ED94 MPU_CTRL: ENABLE(0), HFNMIENA(1), PRIVDEFENA(2)
+* - 0xE000ED98 MPU_RNR: selected region
+* - 0xE000ED9C MPU_RBAR: ADDR[31:5], VALID(4), REGION[3:0] (VALID=1 also selects the region)
+* - 0xE000EDA0 MPU_RASR: XN(28), AP[26:24], TEX/S/C/B, SRD[15:8], SIZE[5:1], ENABLE(0)
+* - 0xE000EDA4 ~ 0xE000EDB8: RBAR/RASR aliases 1~3
+* the registers live in the ppb section like everything else there. Memory_write calls MPU_write
+* after a store lands in this range, and MPU_write keeps the read side (RBAR/RASR of the selected region) mirrored.
+*
+* resolving a region per access means a priority search over every region (highest enabled match wins,
+* subregions fall through to lower regions). protected rtos firmware would pay that on every load and store, so:
+*
+* permission cache:
+* - regions are aligned to their size and the smallest region/subregion is 32 bytes.
+*   so with 32 byte pages the permission is constant inside a page, and flattening is exact.
+* - every section below the system region gets one byte per page, holding the allowed MEMORY_ATTRIB_*_R/W/X bits.
+*   the check in Memory_read / Memory_write is the same and-test as for the section attrib.
+* - two caches are built per section:
+*   privileged: S bits = privileged permission, U bits = unprivileged permission (LDRT/STRT pass U attribs)
+*   unprivileged: S and U bits both = unprivileged permission (the cpu passes S attribs while running unprivileged)
+* - Memory_map_elem->mpu_perm points at the one for the current privilege.
+* - both are rebuilt on MPU register writes only. a privilege change (CONTROL.nPRIV, exception entry/return)
+*   just swaps the pointers (MPU_sync, once per block from CPU_step).
+* - sections bigger than MPU_CACHE_LIMIT are not cached and resolve per access.
+*
+* while the mpu is off (or bypassed in hardfault/nmi/faultmask without HFNMIENA) nothing is checked.
+* the jit only inlines accesses while the mpu is off. turning it on or off flushes the translation cache.
+*/
+
+#define MPU_REGIONS 8		// 8 or 16
+#define MPU_PAGE_SHIFT 5	// 32 bytes: smallest region / subregion
+#define MPU_CACHE_LIMIT 0x1000000	// sections up to 16MB get a permission cache
+
+#define MPU_REG_BASE 0xE000ED90
+#define MPU_REG_SIZE 0x2C
+#define MPU_TYPE 0xE000ED90
+#define MPU_CTRL 0xE000ED94
+#define MPU_RNR 0xE000ED98
+#define MPU_RBAR 0xE000ED9C
+#define MPU_RASR 0xE000EDA0
+
+#define MPU_CTRL_ENABLE 0x1
+#define MPU_CTRL_HFNMIENA 0x2
+#define MPU_CTRL_PRIVDEFENA 0x4
+
+#define MPU_RBAR_ADDR 0xFFFFFFE0
+#define MPU_RBAR_VALID 0x10
+#define MPU_RBAR_REGION 0xF
+
+#define MPU_RASR_ENABLE 0x1
+#define MPU_RASR_SIZE(rasr) (((rasr) >> 1) & 0x1F)
+#define MPU_RASR_SRD(rasr) (((rasr) >> 8) & 0xFF)
+#define MPU_RASR_AP(rasr) (((rasr) >> 24) & 0x7)
+#define MPU_RASR_XN 0x10000000
+
+// the system region (ppb and vendor system space) always uses the default map
+#define MPU_SYSTEM_BASE 0xE0000000
+
+struct MPU_region {
+	uint32 rbar;
+	uint32 rasr;
+};
+
+extern struct MPU_region MPU_var_region[MPU_REGIONS];
+extern uint32 MPU_var_ctrl;
+extern uint32 MPU_var_rnr;
+
+extern uint32 MPU_var_active;		// checks are on (enabled and not bypassed)
+extern uint32 MPU_var_privileged;	// which cache the sections point at
+extern uint32 MPU_var_rebuilds;		// telemetry
+
+// reset state (mpu off) and publish MPU_TYPE
+extern void MPU_init();
+
+// a store landed on [addr, addr + width) inside the mpu registers
+extern void MPU_write(uint32 addr, uint32 width);
+
+// follow the cpu privilege / fault state. cheap when nothing changed
+extern void MPU_sync(CPU_struct_reg* reg);
+
+// permission bits (MEMORY_ATTRIB_*_R/W/X) at addr for the current privilege, by region search
+extern uint32 MPU_resolve(uint32 addr);
+
+// allowed attrib bits of one access at section offset (addr is the guest address)
+#define MPU_PERMISSION(map, addr, offset) ((map)->mpu_perm != NULL ? (uint32)(map)->mpu_perm[(offset) >> MPU_PAGE_SHIFT] : MPU_resolve(addr))
@@ -1,4 +1,9 @@
 #include "Memory.hpp"
+#include "JitCache.hpp"
+#include "MPU.hpp"
+#include "IrqStat.hpp"
+#include "Board.hpp"
+#include "Fuzz.hpp"
 
 Memory_map_elem Memory_var_arr[MEMORY_MAP_MAX_SECTIONS];
 uint32 Memory_var_arrlen = 0;
@@ -17,6 +22,10 @@ void Memory_addMap(uint32 base, uint32 size, uint32 attrib) {
 		Memory_var_arr[Memory_var_arrlen].attrib = attrib & MEMORY_ATTRIB_CRITICAL;
 		Memory_var_arr[Memory_var_arrlen].nd_attrib = attrib & MEMORY_ATTRIB_NONCRITICAL;
 		Memory_var_arr[Memory_var_arrlen].data = (uint8*)ecalloc(size, sizeof(uint8));
+		Memory_var_arr[Memory_var_arrlen].jit_pagemap = NULL;
+		Memory_var_arr[Memory_var_arrlen].mpu_perm = NULL;
+		Memory_var_arr[Memory_var_arrlen].coverage = NULL;
+		Memory_var_arr[Memory_var_arrlen].fuzz_clean = NULL;
 	
 	}
 	else if (Memory_var_arrlen == MEMORY_MAP_MAX_SECTIONS){
@@ -33,6 +42,10 @@ void Memory_addMap(uint32 base, uint32 size, uint32 attrib) {
 		Memory_var_arr[Memory_var_arrlen].attrib = attrib & MEMORY_ATTRIB_CRITICAL;
 		Memory_var_arr[Memory_var_arrlen].nd_attrib = attrib & MEMORY_ATTRIB_NONCRITICAL;
 		Memory_var_arr[Memory_var_arrlen].data = (uint8*)ecalloc(size, sizeof(uint8));
+		Memory_var_arr[Memory_var_arrlen].jit_pagemap = NULL;
+		Memory_var_arr[Memory_var_arrlen].mpu_perm = NULL;
+		Memory_var_arr[Memory_var_arrlen].coverage = NULL;
+		Memory_var_arr[Memory_var_arrlen].fuzz_clean = NULL;
 	
 	}
 
@@ -56,12 +69,10 @@ void Memory_init() {
 	* total 5 maps to produce
 	*/
 
-	// Code
-	Memory_addMap(0x0, 0x20000, MEMORY_ATTRIB_S_ALL);
-	// SRAM
-	Memory_addMap(0x20000000, 0x20000, MEMORY_ATTRIB_S_ALL);
-	// Peripheral
-	Memory_addMap(0xE0000000, 0x20000, MEMORY_ATTRIB_S_ALL);
+	// code, sram, ppb: the board says (Board.hpp)
+	for (uint32 i = 0; i < BOARD_REGIONS; i++) {
+		Memory_addMap(Board_var_regions[i].base, Board_var_regions[i].size, Board_var_regions[i].attrib);
+	}
 
 	Memory_init_peri(); // temporary. delete this later.
 
@@ -89,14 +100,18 @@ void Memory_addPeri(uint32 idx, struct peri_addr_t* peri_addr, void (*readcallba
 	
 }
 
-Memory_map_elem* Memory_getMap(uint32 addr) {
+// the section addr is in. with a fixed board the bounds are immediates (Board_map), no list walk
+static inline Memory_map_elem* Memory_findMap(uint32 addr) {
+#ifdef MICROCON_EMU_BOARD_FIXED
+	return Board_map<0>::get(addr);
+#else
 	if (Memory_var_arrlen > 0) {
 		Memory_map_elem* item = &Memory_var_arr[0];
 		do {
 			uint32 base = item->base;	// inclusive
 			uint32 bound = item->base + item->size;	// exclusive
 			
-			if (addr >= base && addr <= bound) {
+			if (addr >= base && addr < bound) {
 				return item;
 			}
 		
@@ -110,6 +125,11 @@ Memory_map_elem* Memory_getMap(uint32 addr) {
 	}
 
 	return NULL;	// no valid map exists
+#endif
+}
+
+Memory_map_elem* Memory_getMap(uint32 addr) {
+	return Memory_findMap(addr);
 }
 
 // memory read
@@ -120,7 +140,7 @@ void* Memory_read(uint32 addr, Memory_enum_size sizetype, uint32 attrib) {
 	Memory_var_access_err = 0;
 
 	// get memory section
-	if ((thismap = Memory_getMap(addr)) == NULL) {
+	if ((thismap = Memory_findMap(addr)) == NULL) {
 		// fail if NULL is returned (invalid address)
 		Memory_var_access_err = Memory_access_status_enum::section_err;
 		return NULL;
@@ -141,6 +161,21 @@ void* Memory_read(uint32 addr, Memory_enum_size sizetype, uint32 attrib) {
 
 	uint32 translated_addr = addr - thismap->base;
 
+	// mpu region permission of the first and the last byte (flattened per page, see MPU.hpp)
+	if (MPU_var_active) {
+		uint32 last = (1 << sizetype) - 1;
+		if ((MPU_PERMISSION(thismap, addr, translated_addr) & attrib & MEMORY_ATTRIB_CRITICAL) == 0
+			|| (MPU_PERMISSION(thismap, addr + last, translated_addr + last) & attrib & MEMORY_ATTRIB_CRITICAL) == 0) {
+			Memory_var_access_err = Memory_access_status_enum::mpu_err;
+			return NULL;
+		}
+	}
+
+	// registers worked out on demand (dwt counters): in place before the load sees them
+	if (!MEMORY_IS_DIRECT(thismap)) {
+		Board_read(addr, 1 << sizetype);
+	}
+
 	//little-endian
 	if (Memory_var_endianness == 0) {
 		return &thismap->data[translated_addr];
@@ -173,7 +208,7 @@ void Memory_write(uint32 addr, Memory_enum_size sizetype, uint32 data, uint32 at
 	Memory_var_access_err = 0;
 
 	// get memory section
-	if ((thismap = Memory_getMap(addr)) == NULL) {
+	if ((thismap = Memory_findMap(addr)) == NULL) {
 		// fail if NULL is returned (invalid address)
 		Memory_var_access_err = Memory_access_status_enum::section_err;
 		return;
@@ -193,6 +228,26 @@ void Memory_write(uint32 addr, Memory_enum_size sizetype, uint32 data, uint32 at
 	}
 
 	uint32 translated_addr = addr - thismap->base;
+
+	// mpu region permission of the first and the last byte (flattened per page, see MPU.hpp)
+	if (MPU_var_active) {
+		uint32 last = (1 << sizetype) - 1;
+		if ((MPU_PERMISSION(thismap, addr, translated_addr) & attrib & MEMORY_ATTRIB_CRITICAL) == 0
+			|| (MPU_PERMISSION(thismap, addr + last, translated_addr + last) & attrib & MEMORY_ATTRIB_CRITICAL) == 0) {
+			Memory_var_access_err = Memory_access_status_enum::mpu_err;
+			return;
+		}
+	}
+
+	// smc check: the write lands on a page with translated code -> drop only the blocks on it
+	if (thismap->jit_pagemap != NULL) {
+		uint32 last_addr = translated_addr + (1 << sizetype) - 1;
+		if (MEMORY_CODEPAGE_TEST(thismap->jit_pagemap, translated_addr) || MEMORY_CODEPAGE_TEST(thismap->jit_pagemap, last_addr)) {
+			JitCache_invalidate(addr, 1 << sizetype);
+		}
+	}
+	FUZZ_DIRTY(thismap, translated_addr, 1 << sizetype);
+
 	//little-endian
 	if (Memory_var_endianness == 0) {
 
@@ -219,6 +274,101 @@ void Memory_write(uint32 addr, Memory_enum_size sizetype, uint32 data, uint32 at
 		
 	}
 
+	// register hooks (mpu, software pends...): the store is in place, let the peripheral pick it up
+	Board_write(addr, 1 << sizetype, data);
+
+
+}
+
+/*
+* block transfer (ldm / stm / push / pop / exception frames)
+* the section, the attribute, the mpu pages and the smc pages are resolved once for the whole range,
+* then the words are moved in one loop. peripheral sections and ranges that leave the section go word by word,
+* so peripheral queues and register hooks still see every access.
+*/
+static Memory_map_elem* Memory_blockMap(uint32 addr, uint32 count, uint32 attrib) {
+	Memory_map_elem* thismap = Memory_findMap(addr);
+	uint32 size = count << 2;
+
+	if (thismap == NULL || !MEMORY_IS_DIRECT(thismap) || Memory_var_endianness != 0
+		|| size > thismap->size || addr - thismap->base > thismap->size - size
+		|| (thismap->attrib & (attrib & MEMORY_ATTRIB_CRITICAL)) == 0) {
+		return NULL;
+	}
+
+	// every 32 byte mpu page the range touches (a 16 word transfer touches at most 3)
+	if (MPU_var_active) {
+		uint32 translated_addr = addr - thismap->base;
+		for (uint32 page = translated_addr >> MPU_PAGE_SHIFT; page <= (translated_addr + size - 1) >> MPU_PAGE_SHIFT; page++) {
+			uint32 offset = (page << MPU_PAGE_SHIFT) < translated_addr ? translated_addr : (page << MPU_PAGE_SHIFT);
+			if ((MPU_PERMISSION(thismap, thismap->base + offset, offset) & attrib & MEMORY_ATTRIB_CRITICAL) == 0) {
+				return NULL;	// let the word path report it at the right word
+			}
+		}
+	}
+	return thismap;
+}
+
+void Memory_readWords(uint32 addr, uint32* words, uint32 count, uint32 attrib) {
+	Memory_map_elem* thismap;
+
+	Memory_var_access_err = 0;
+	if (count == 0) {
+		return;
+	}
+
+	if ((thismap = Memory_blockMap(addr, count, attrib)) != NULL) {
+		uint8* data = &thismap->data[addr - thismap->base];
+		for (uint32 i = 0; i < count; i++, data += 4) {
+			words[i] = data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32)data[3] << 24);
+		}
+		return;
+	}
 
+	// slow path: stop at the first word that fails, Memory_var_access_err tells why
+	for (uint32 i = 0; i < count; i++) {
+		uint8* data = (uint8*)Memory_read(addr + (i << 2), Memory_enum_size::u32, attrib);
+		if (data == NULL) {
+			return;
+		}
+		words[i] = data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32)data[3] << 24);
+	}
 }
 
+void Memory_writeWords(uint32 addr, const uint32* words, uint32 count, uint32 attrib) {
+	Memory_map_elem* thismap;
+
+	Memory_var_access_err = 0;
+	if (count == 0) {
+		return;
+	}
+
+	if ((thismap = Memory_blockMap(addr, count, attrib)) != NULL) {
+		uint32 translated_addr = addr - thismap->base;
+
+		// smc check: first and last 1KB page (a transfer is at most 64 bytes)
+		if (thismap->jit_pagemap != NULL) {
+			uint32 last_addr = translated_addr + (count << 2) - 1;
+			if (MEMORY_CODEPAGE_TEST(thismap->jit_pagemap, translated_addr) || MEMORY_CODEPAGE_TEST(thismap->jit_pagemap, last_addr)) {
+				JitCache_invalidate(addr, count << 2);
+			}
+		}
+		FUZZ_DIRTY(thismap, translated_addr, count << 2);
+
+		uint8* data = &thismap->data[translated_addr];
+		for (uint32 i = 0; i < count; i++, data += 4) {
+			data[0] = (uint8)(words[i] & 0xFF);
+			data[1] = (uint8)((words[i] >> 8) & 0xFF);
+			data[2] = (uint8)((words[i] >> 16) & 0xFF);
+			data[3] = (uint8)((words[i] >> 24) & 0xFF);
+		}
+		return;
+	}
+
+	for (uint32 i = 0; i < count; i++) {
+		Memory_write(addr + (i << 2), Memory_enum_size::u32, words[i], attrib);
+		if (Memory_var_access_err != 0) {
+			return;
+		}
+	}
+}
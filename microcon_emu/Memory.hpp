@@ -57,8 +57,27 @@ struct Memory_map_elem {
 	struct Memory_map_elem* next;
 	// opqueue
 	struct opqueue_t* opqueuehead;
+	// jit: bitmap of pages that contain translated code (NULL until something is translated here)
+	uint32* jit_pagemap;
+	// mpu: allowed attrib bits per 32 byte page for the current privilege (NULL if not cached, see MPU.hpp)
+	uint8* mpu_perm;
+	// coverage: one bit per executed halfword (NULL unless coverage is on and the section is executable, see Coverage.hpp)
+	uint32* coverage;
+	// fuzz: one bit per 1KB page not written since the snapshot (NULL unless fuzzing, see Fuzz.hpp)
+	uint32* fuzz_clean;
 };
 
+/*
+* self-modifying code detection
+* every section keeps a bitmap of 1KB pages. a set bit means the jit translated something on that page,
+* so a write there must invalidate the affected blocks. the test is one shift and one load on the write path.
+*/
+#define MEMORY_CODEPAGE_SHIFT 10
+#define MEMORY_CODEPAGE_WORDS(size) (((((size) + (0x1 << MEMORY_CODEPAGE_SHIFT) - 1) >> MEMORY_CODEPAGE_SHIFT) + 31) >> 5)	// bitmap of a section
+#define MEMORY_CODEPAGE_TEST(pagemap, offset) (((pagemap)[(offset) >> (MEMORY_CODEPAGE_SHIFT + 5)] >> (((offset) >> MEMORY_CODEPAGE_SHIFT) & 0x1F)) & 0x1)
+#define MEMORY_CODEPAGE_SET(pagemap, offset) ((pagemap)[(offset) >> (MEMORY_CODEPAGE_SHIFT + 5)] |= (0x1 << (((offset) >> MEMORY_CODEPAGE_SHIFT) & 0x1F)))
+#define MEMORY_CODEPAGE_CLEAR(pagemap, offset) ((pagemap)[(offset) >> (MEMORY_CODEPAGE_SHIFT + 5)] &= ~(0x1 << (((offset) >> MEMORY_CODEPAGE_SHIFT) & 0x1F)))
+
 /*
 * section for peripheral memory access
 *
@@ -145,10 +164,11 @@ extern uint32 Memory_var_endianness;	// 0: big(0x1234 -> 0:0x12, 1:0x34), 1: lit
 #define MEMORY_ATTRIB_CRITICAL 0xE7
 #define MEMORY_ATTRIB_NONCRITICAL 0x318
 
-enum Memory_access_status_enum {none = 0, section_err, attribute_err, reserved};
+enum Memory_access_status_enum {none = 0, section_err, attribute_err, mpu_err, reserved};
 // value is 0 by default
 // if value is 1, no section found
 // if value is 2, attribute error
+// if value is 3, mpu region does not allow it (memmanage)
 // always reverts to 0 on re-query
 extern uint32 Memory_var_access_err;
 
@@ -200,6 +220,12 @@ extern void* Memory_read_peri(uint32 addr, Memory_enum_size sizetype);
 // size -> 8/16/32 bit
 extern void Memory_write(uint32 addr, Memory_enum_size sizetype, uint32 data, uint32 attrib);
 
+// block transfer of count words from / to ascending addresses (ldm, stm, push, pop, exception frames)
+// one lookup and one bounds check for plain memory, word by word otherwise.
+// stops at the first failing word with Memory_var_access_err set
+extern void Memory_readWords(uint32 addr, uint32* words, uint32 count, uint32 attrib);
+extern void Memory_writeWords(uint32 addr, const uint32* words, uint32 count, uint32 attrib);
+
 // register peripheral map
 
 extern void Memory_write_peri(uint32 addr, Memory_enum_size sizetype);
@@ -210,3 +236,8 @@ extern void Memory_handle_writequeue_peri(uint32 idx, void (*writecallback)(void
 
 // get memory map
 extern Memory_map_elem* Memory_getMap(uint32 addr);
+
+// code and sram sit below the peripheral region and are plain arrays with no side effects on access.
+// the jit touches these directly and sends everything else through Memory_read / Memory_write
+#define MEMORY_DIRECT_LIMIT 0x40000000
+#define MEMORY_IS_DIRECT(map) ((map)->base + (map)->size <= MEMORY_DIRECT_LIMIT)
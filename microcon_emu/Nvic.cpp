@@ -0,0 +1,203 @@
+#include "Nvic.hpp"
+#include "Memory.hpp"
+#include "Fault.hpp"	// Fault_priority, Fault_execPriority
+#include "IrqStat.hpp"
+#include <string.h>
+
+Nvic_state Nvic_var_state;
+
+uint32 Nvic_var_taken = 0;
+
+static uint8* Nvic_reg(uint32 addr) {
+	Memory_map_elem* thismap = Memory_getMap(addr);
+	if (thismap == NULL || addr + 4 > thismap->base + thismap->size) {
+		return NULL;
+	}
+	return &thismap->data[addr - thismap->base];
+}
+
+static void Nvic_store32(uint32 addr, uint32 value) {
+	uint8* data = Nvic_reg(addr);
+	if (data != NULL) {
+		data[0] = (uint8)(value & 0xFF);
+		data[1] = (uint8)((value >> 8) & 0xFF);
+		data[2] = (uint8)((value >> 16) & 0xFF);
+		data[3] = (uint8)((value >> 24) & 0xFF);
+	}
+}
+
+static void Nvic_update() {
+	uint32 any = Nvic_var_state.system;
+	for (uint32 w = 0; w < NVIC_WORDS; w++) {
+		any |= Nvic_var_state.pending[w];
+	}
+	Nvic_var_state.any = (any != 0);
+}
+
+// the pending exception that would be taken first, 0 if none. its priority in prio
+static uint32 Nvic_best(int32_t* prio) {
+	uint32 best = 0;
+	int32_t bestprio = 0x7FFFFFFF;
+
+	for (uint32 exception = 0; exception < 16; exception++) {
+		if ((Nvic_var_state.system >> exception) & 0x1) {
+			int32_t p = Fault_priority(exception);
+			if (p < bestprio) {
+				best = exception;
+				bestprio = p;
+			}
+		}
+	}
+	for (uint32 w = 0; w < NVIC_WORDS; w++) {
+		uint32 bits = Nvic_var_state.pending[w] & Nvic_var_state.enabled[w];
+		for (uint32 bit = 0; bits != 0 && bit < 32; bit++) {
+			if ((bits >> bit) & 0x1) {
+				int32_t p = Fault_priority(16 + w * 32 + bit);
+				if (p < bestprio) {
+					best = 16 + w * 32 + bit;
+					bestprio = p;
+				}
+			}
+		}
+	}
+	*prio = bestprio;
+	return best;
+}
+
+static void Nvic_unpend(uint32 exception) {
+	if (exception >= 16) {
+		Nvic_var_state.pending[(exception - 16) >> 5] &= ~(0x1 << ((exception - 16) & 0x1F));
+	}
+	else {
+		Nvic_var_state.system &= ~(0x1 << exception);
+	}
+	Nvic_update();
+}
+
+static uint32 Nvic_icsr() {
+	uint32 icsr = 0;
+	int32_t prio;
+	uint32 pending = Nvic_best(&prio);
+
+	if (Nvic_var_state.system & (0x1 << FAULT_NMI)) {
+		icsr |= NVIC_ICSR_NMIPENDSET;
+	}
+	if (Nvic_var_state.system & (0x1 << NVIC_PENDSV)) {
+		icsr |= NVIC_ICSR_PENDSVSET;
+	}
+	if (Nvic_var_state.system & (0x1 << NVIC_SYSTICK)) {
+		icsr |= NVIC_ICSR_PENDSTSET;
+	}
+	for (uint32 w = 0; w < NVIC_WORDS; w++) {
+		if (Nvic_var_state.pending[w] != 0) {
+			icsr |= NVIC_ICSR_ISRPENDING;
+		}
+	}
+	icsr |= (pending & 0x1FF) << 12;	// VECTPENDING
+	if (CPU_var_reg != NULL) {
+		icsr |= CPU_var_reg->xPSR.IPSR.exception;	// VECTACTIVE
+	}
+	return icsr;
+}
+
+void Nvic_init() {
+	memset(&Nvic_var_state, 0, sizeof(Nvic_var_state));
+	Nvic_var_taken = 0;
+}
+
+void Nvic_pend(uint32 exception) {
+	if (exception >= 16 + NVIC_WORDS * 32) {
+		return;
+	}
+	if (exception >= 16) {
+		Nvic_var_state.pending[(exception - 16) >> 5] |= 0x1 << ((exception - 16) & 0x1F);
+	}
+	else {
+		Nvic_var_state.system |= 0x1 << exception;
+	}
+	Nvic_var_state.any = 1;
+	IrqStat_assert(exception);
+}
+
+void Nvic_read(uint32 addr, uint32 width) {
+	for (uint32 reg = addr & ~0x3; reg < addr + width; reg += 4) {
+		if (reg >= NVIC_ISER && reg < NVIC_ISER + NVIC_REGS_SIZE) {
+			uint32 w = (reg >> 2) & 0x1F;
+			if (w < NVIC_WORDS) {
+				Nvic_store32(reg, (reg < NVIC_ISPR) ? Nvic_var_state.enabled[w] : Nvic_var_state.pending[w]);
+			}
+		}
+		else if (reg == NVIC_ICSR) {
+			Nvic_store32(reg, Nvic_icsr());
+		}
+	}
+}
+
+void Nvic_write(uint32 addr, uint32 width, uint32 data) {
+	uint32 reg = addr & ~0x3;
+	uint32 value = (data << ((addr & 0x3) * 8)) & 0xFFFFFFFF;	// sub word stores land at their byte lane
+	if (width < 4) {
+		value &= ((0x1 << (width * 8)) - 1) << ((addr & 0x3) * 8);
+	}
+
+	if (reg >= NVIC_ISER && reg < NVIC_ISER + NVIC_REGS_SIZE) {
+		uint32 w = (reg >> 2) & 0x1F;
+		if (w >= NVIC_WORDS) {
+			Nvic_store32(reg, 0);
+			return;
+		}
+		if (reg < NVIC_ICER) {
+			Nvic_var_state.enabled[w] |= value;
+		}
+		else if (reg < NVIC_ISPR) {
+			Nvic_var_state.enabled[w] &= ~value;
+		}
+		else if (reg < NVIC_ICPR) {
+			for (uint32 bit = 0; bit < 32; bit++) {
+				if ((value >> bit) & 0x1) {
+					Nvic_pend(16 + w * 32 + bit);
+				}
+			}
+		}
+		else {
+			Nvic_var_state.pending[w] &= ~value;
+			Nvic_update();
+		}
+		Nvic_store32(reg, (reg < NVIC_ISPR) ? Nvic_var_state.enabled[w] : Nvic_var_state.pending[w]);
+	}
+	else if (reg == NVIC_STIR) {
+		Nvic_pend(16 + (value & 0x1FF));
+		Nvic_store32(reg, 0);	// write only
+	}
+	else if (reg == NVIC_ICSR) {
+		if (value & NVIC_ICSR_NMIPENDSET) {
+			Nvic_pend(FAULT_NMI);
+		}
+		if (value & NVIC_ICSR_PENDSVSET) {
+			Nvic_pend(NVIC_PENDSV);
+		}
+		else if (value & NVIC_ICSR_PENDSVCLR) {
+			Nvic_unpend(NVIC_PENDSV);
+		}
+		if (value & NVIC_ICSR_PENDSTSET) {
+			Nvic_pend(NVIC_SYSTICK);
+		}
+		else if (value & NVIC_ICSR_PENDSTCLR) {
+			Nvic_unpend(NVIC_SYSTICK);
+		}
+		Nvic_store32(reg, Nvic_icsr());
+	}
+}
+
+uint32 Nvic_step(CPU_struct_reg* reg) {
+	int32_t prio;
+	uint32 exception = Nvic_best(&prio);
+
+	// nothing enabled, or not above what runs now: stays pending
+	if (exception == 0 || prio >= Fault_execPriority(reg)) {
+		return 0;
+	}
+	Nvic_unpend(exception);
+	Nvic_var_taken += 1;
+	return CPU_exceptionEntry(reg, exception, reg->R[15]);
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include "Proxy.hpp"
+#include "CPU.hpp"
+
+/*
+* nvic: pending exceptions and their delivery
+*
+* the pend and enable state is kept here, guest loads of the registers work it out on demand (Board_read):
+* - NVIC_ISER / NVIC_ICER (0xE000E100 / 0xE000E180): enable of the external interrupts, write ones to set / clear.
+* - NVIC_ISPR / NVIC_ICPR (0xE000E200 / 0xE000E280): pending, write ones to set / clear. STIR (0xE000EF00) pends one.
+* - ICSR (0xE000ED04): NMIPENDSET, PENDSVSET / PENDSVCLR, PENDSTSET / PENDSTCLR. a load sees the pend bits,
+*   ISRPENDING, VECTPENDING and VECTACTIVE (IPSR).
+* - peripherals raise their line with Nvic_pend. every pend goes to IrqStat_assert too.
+* - SVC pends SVCall, taken right after it. when it can't preempt it escalates to hardfault instead.
+*
+* delivery (Nvic_step, CPU_step before each block, only while something is pending): the pending exception with
+* the lowest priority value (SHPR / NVIC_IPR, ties: lowest number), external ones only while enabled, is taken when
+* it is below the execution priority (Fault.hpp: active exception, BASEPRI, PRIMASK, FAULTMASK). its pend bit clears
+* and the handler starts from the vector table with the next instruction as return address. blocks are the
+* boundary: an exception pended by a store is taken after the block that stored it, barriers end blocks,
+* so the usual store; dsb; isb takes it right there.
+* tail chaining is a full exception return and entry (unstack, stack again). AIRCR.PRIGROUP is not applied: the whole
+* priority byte preempts.
+*/
+
+#define NVIC_ISER 0xE000E100
+#define NVIC_ICER 0xE000E180
+#define NVIC_ISPR 0xE000E200
+#define NVIC_ICPR 0xE000E280
+#define NVIC_REGS_SIZE 0x200	// ISER ~ ICPR
+#define NVIC_ICSR 0xE000ED04
+#define NVIC_STIR 0xE000EF00
+
+#define NVIC_ICSR_NMIPENDSET 0x80000000
+#define NVIC_ICSR_PENDSVSET 0x10000000
+#define NVIC_ICSR_PENDSVCLR 0x08000000
+#define NVIC_ICSR_PENDSTSET 0x04000000
+#define NVIC_ICSR_PENDSTCLR 0x02000000
+#define NVIC_ICSR_ISRPENDING 0x00400000
+
+#define NVIC_SVCALL 11
+#define NVIC_PENDSV 14
+#define NVIC_SYSTICK 15
+
+#define NVIC_WORDS 16	// 496 external interrupts, one bit each
+
+struct Nvic_state {
+	uint32 enabled[NVIC_WORDS];	// external interrupts
+	uint32 pending[NVIC_WORDS];	// external interrupts
+	uint32 system;	// pending system exceptions, one bit per exception number
+	uint32 any;	// some bit is set in pending / system
+};
+
+extern Nvic_state Nvic_var_state;
+
+// telemetry
+extern uint32 Nvic_var_taken;
+
+// after Memory_init
+extern void Nvic_init();
+
+// exception becomes pending (exception number: 16 + irq for external interrupts)
+extern void Nvic_pend(uint32 exception);
+
+// Memory_read, before a load from the registers: put the current state in place
+extern void Nvic_read(uint32 addr, uint32 width);
+
+// Memory_write, the store is in place: set / clear / pend
+extern void Nvic_write(uint32 addr, uint32 width, uint32 data);
+
+// CPU_step, before the block: take the pending exception if it preempts. returns the guest cycles of the entry
+#define NVIC_STEP(reg) (Nvic_var_state.any ? Nvic_step(reg) : 0)
+extern uint32 Nvic_step(CPU_struct_reg* reg);
@@ -0,0 +1,168 @@
+#include "Poll.hpp"
+#include "Board.hpp"	// Board_readHooked
+#include <stdlib.h>	// getenv
+#include <string.h>
+
+uint32 Poll_var_enabled = 1;
+uint32 Poll_var_budget = 0;
+uint32 Poll_var_hooked = 0;
+
+uint32 Poll_var_skips = 0;
+uint64_t Poll_var_skipped = 0;
+
+void Poll_init() {
+	const char* env = getenv(POLL_ENV);
+	Poll_var_enabled = !(env != NULL && strcmp(env, "0") == 0);
+	Poll_var_budget = 0;
+	Poll_var_hooked = 0;
+}
+
+uint32 Poll_match(IR_block* block) {
+	static uint8 pure[IR_MAX_INST];	// temp is the same in every iteration
+	static uint8 isconst[IR_MAX_INST];
+	static uint32 value[IR_MAX_INST];
+	uint8 written[16] = { 0 };
+	uint8 regpure[16];
+	uint32 end = block->count;
+	uint32 loads = 0;
+	IR_inst* bcond = NULL;
+
+	if (!Poll_var_enabled || block->guest_count > POLL_MAX_GUEST) {
+		return 0;
+	}
+
+	// where the iteration ends: at a bcond back to the start, or at the block end
+	for (uint32 i = 0; i < block->count; i++) {
+		IR_inst* inst = &block->inst[i];
+		if (inst->op == IR_BCOND) {
+			if (bcond != NULL) {
+				return 0;
+			}
+			bcond = inst;
+			if (inst->imm == block->guest_start) {
+				end = i + 1;
+				break;
+			}
+		}
+	}
+	if (bcond == NULL) {
+		return 0;
+	}
+	IR_inst* last = &block->inst[end - 1];
+	if (last->op != IR_BCOND && !(last->op == IR_EXIT && last->imm == block->guest_start)) {
+		return 0;
+	}
+
+	memset(isconst, 0, block->ntemps);
+
+	// registers the iteration writes can't be read before it wrote them
+	for (uint32 i = 0; i < end; i++) {
+		IR_inst* inst = &block->inst[i];
+		if (inst->op == IR_SETREG || inst->op == IR_SETREGI || inst->op == IR_ADDREGI) {
+			written[inst->reg] = 1;
+		}
+	}
+	for (uint32 r = 0; r < 16; r++) {
+		regpure[r] = !written[r];
+	}
+
+	for (uint32 i = 0; i < end; i++) {
+		IR_inst* inst = &block->inst[i];
+		uint32 a = (inst->a != IR_NOTEMP) ? pure[inst->a] : 1;
+		uint32 b = (inst->bimm || inst->b == IR_NOTEMP) ? 1 : pure[inst->b];
+
+		switch (inst->op) {
+		case IR_NOP:
+			break;
+		case IR_CONST:
+			pure[inst->t] = 1;
+			isconst[inst->t] = 1;
+			value[inst->t] = inst->imm;
+			break;
+		case IR_GETREG:
+			pure[inst->t] = regpure[inst->reg];
+			break;
+		case IR_SETREG:
+			regpure[inst->reg] = (uint8)a;
+			break;
+		case IR_SETREGI:
+			regpure[inst->reg] = 1;
+			break;
+		case IR_ADDREGI:
+			break;	// pure only if it was set earlier in this iteration
+
+		case IR_ADD:
+		case IR_SUB:
+		case IR_AND:
+		case IR_OR:
+		case IR_XOR:
+		case IR_BIC:
+		case IR_MUL:
+		case IR_LSL:
+		case IR_LSR:
+		case IR_ASR:
+		case IR_ROR:
+		case IR_NOT:
+			pure[inst->t] = (uint8)(a && b);
+			break;
+
+		case IR_FLAGS_ADD:
+		case IR_FLAGS_SUB:
+		case IR_FLAGS_NZ:
+		case IR_FLAGS_SHIFTC:
+			// flags from anything else would count down to an exit
+			if (!a || !b || inst->c != IR_NOTEMP) {
+				return 0;
+			}
+			break;
+
+		case IR_LOAD:
+			if (!a) {
+				return 0;	// walks memory, not a poll
+			}
+			if (isconst[inst->a] && Board_readHooked(value[inst->a], 1 << inst->size)) {
+				return 0;	// a counter or state worked out on demand: changes by itself
+			}
+			pure[inst->t] = 1;
+			loads += 1;
+			break;
+
+		case IR_BCOND:
+		case IR_EXIT:
+			break;
+		default:	// carry in, stores, branches, handlers
+			return 0;
+		}
+	}
+
+	for (uint32 r = 0; r < 16; r++) {
+		if (written[r] && !regpure[r]) {
+			return 0;	// a counter: the loop ends by itself
+		}
+	}
+	if (loads == 0) {
+		return 0;
+	}
+	return last->cycles;
+}
+
+uint32 Poll_skip(uint32 iteration, uint32 cycles) {
+	uint32 hooked = Poll_var_hooked;
+	Poll_var_hooked = 0;
+	if (iteration == 0 || hooked || Poll_var_budget <= cycles) {
+		return 0;
+	}
+	uint32 skip = (Poll_var_budget - cycles) / iteration * iteration;
+	if (skip != 0) {
+		Poll_var_skips += 1;
+		Poll_var_skipped += skip;
+	}
+	return skip;
+}
+
+void Poll_dump() {
+	if (Poll_var_skips == 0) {
+		return;
+	}
+	printf("poll: %d waits skipped, %llu guest cycles\n", (int)Poll_var_skips, (unsigned long long)Poll_var_skipped);
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include "Proxy.hpp"
+#include "IR.hpp"
+
+/*
+* busy-wait polling loops: while (!(UART->SR & TXE));
+*
+* Poll_match takes a block that loops to itself (same shapes as Idiom.hpp) and checks that one iteration
+* - loads only from addresses that don't change (a status register, or a flag an isr sets)
+* - stores nothing and runs no handler
+* - leaves every register and flag as a function of those loads and of registers it never writes
+* so once it went round, every further round with the same loaded values leaves the exact same state.
+* only time passes until something else (a peripheral, an interrupt) changes what it reads.
+*
+* CPU_step then skips whole iterations up to Poll_var_budget, the cycles left until the next scheduled event,
+* after a round that looped back. the skipped rounds cost their guest cycles, the registers stay as they are.
+* Poll_var_budget is 0 (never skip) unless the cpu runs under CPU_slice.
+*
+* registers with a read hook (Board_var_peris: dwt counters, nvic / itm state, the fuzz fifo) change without a store:
+* - Poll_match turns down a loop that loads from one at a constant address.
+* - through a register (the usual ldr r3, =REG hoisted out of the loop) it can't tell, so a hook that fires sets
+*   Poll_var_hooked and Poll_skip doesn't skip after that round.
+*
+* limits:
+* - loads with read side effects (fifo pops, read-to-clear) of plain memory are skipped too: such loops wait on
+*   a status register first in practice.
+* - up to POLL_MAX_GUEST instructions, the point is short spins.
+* - MICROCON_EMU_POLL=0 turns it off.
+*/
+
+#define POLL_ENV "MICROCON_EMU_POLL"
+#define POLL_MAX_GUEST 8
+
+extern uint32 Poll_var_enabled;
+extern uint32 Poll_var_budget;	// guest cycles until the next event (0: no skipping)
+extern uint32 Poll_var_hooked;	// a read hook fired since the last Poll_skip
+
+// telemetry
+extern uint32 Poll_var_skips;
+extern uint64_t Poll_var_skipped;	// guest cycles skipped
+
+extern void Poll_init();
+
+// guest cycles of one iteration if block is a polling loop, 0 otherwise
+extern uint32 Poll_match(IR_block* block);
+
+// a polling loop of 'iteration' cycles just went round in 'cycles': guest cycles to skip
+extern uint32 Poll_skip(uint32 iteration, uint32 cycles);
+
+// telemetry at exit
+extern void Poll_dump();
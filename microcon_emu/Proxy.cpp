@@ -92,3 +92,134 @@ void Clock_sleep(uint32 msec) {
 	nanosleep(&ts, NULL);
 #endif
 }
+
+// Allocate read/write/execute memory for translated code
+void* make_exec_memory(uint32 size) {
+#if defined(_MSC_VER) && defined(PLATFORM_WINDOWS)
+	// Windows MSVC
+	return VirtualAlloc(NULL, size, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE);
+#else
+	// POSIX (Cygwin, Linux, macOS)
+	void* ptr = mmap(NULL, size, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (ptr == MAP_FAILED) {
+		return NULL;
+	}
+	return ptr;
+#endif
+}
+
+// Release memory from make_exec_memory
+void free_exec_memory(void* ptr, uint32 size) {
+#if defined(_MSC_VER) && defined(PLATFORM_WINDOWS)
+	// Windows MSVC
+	VirtualFree(ptr, 0, MEM_RELEASE);
+#else
+	// POSIX (Cygwin, Linux, macOS)
+	munmap(ptr, size);
+#endif
+}
+
+// Map a file copy-on-write with execute permission (writes stay private to this process)
+void* map_file_exec(const char* path, uint32* size) {
+#if defined(_MSC_VER) && defined(PLATFORM_WINDOWS)
+	// Windows MSVC
+	HANDLE file = CreateFileA(path, GENERIC_READ | GENERIC_EXECUTE, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		return NULL;
+	}
+	LARGE_INTEGER filesize;
+	if (!GetFileSizeEx(file, &filesize) || filesize.QuadPart == 0 || filesize.QuadPart > 0xFFFFFFFF) {
+		CloseHandle(file);
+		return NULL;
+	}
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_EXECUTE_WRITECOPY, 0, 0, NULL);
+	CloseHandle(file);
+	if (mapping == NULL) {
+		return NULL;
+	}
+	void* ptr = MapViewOfFile(mapping, FILE_MAP_COPY | FILE_MAP_EXECUTE, 0, 0, 0);
+	CloseHandle(mapping);	// the view keeps the mapping alive
+	if (ptr == NULL) {
+		return NULL;
+	}
+	*size = (uint32)filesize.QuadPart;
+	return ptr;
+#else
+	// POSIX (Cygwin, Linux, macOS)
+	FILE* file = fopen(path, "rb");
+	if (file == NULL) {
+		return NULL;
+	}
+	fseek(file, 0, SEEK_END);
+	long filesize = ftell(file);
+	if (filesize <= 0) {
+		fclose(file);
+		return NULL;
+	}
+	void* ptr = mmap(NULL, (size_t)filesize, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE, fileno(file), 0);
+	fclose(file);	// the mapping keeps the file alive
+	if (ptr == MAP_FAILED) {
+		return NULL;
+	}
+	*size = (uint32)filesize;
+	return ptr;
+#endif
+}
+
+// Map a file read only
+void* map_file(const char* path, uint32* size) {
+#if defined(_MSC_VER) && defined(PLATFORM_WINDOWS)
+	// Windows MSVC
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		return NULL;
+	}
+	LARGE_INTEGER filesize;
+	if (!GetFileSizeEx(file, &filesize) || filesize.QuadPart == 0 || filesize.QuadPart > 0xFFFFFFFF) {
+		CloseHandle(file);
+		return NULL;
+	}
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(file);
+	if (mapping == NULL) {
+		return NULL;
+	}
+	void* ptr = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);	// the view keeps the mapping alive
+	if (ptr == NULL) {
+		return NULL;
+	}
+	*size = (uint32)filesize.QuadPart;
+	return ptr;
+#else
+	// POSIX (Cygwin, Linux, macOS)
+	FILE* file = fopen(path, "rb");
+	if (file == NULL) {
+		return NULL;
+	}
+	fseek(file, 0, SEEK_END);
+	long filesize = ftell(file);
+	if (filesize <= 0) {
+		fclose(file);
+		return NULL;
+	}
+	void* ptr = mmap(NULL, (size_t)filesize, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+	fclose(file);	// the mapping keeps the file alive
+	if (ptr == MAP_FAILED) {
+		return NULL;
+	}
+	*size = (uint32)filesize;
+	return ptr;
+#endif
+}
+
+// Release a mapping from map_file_exec / map_file
+void unmap_file(void* ptr, uint32 size) {
+#if defined(_MSC_VER) && defined(PLATFORM_WINDOWS)
+	// Windows MSVC
+	UnmapViewOfFile(ptr);
+#else
+	// POSIX (Cygwin, Linux, macOS)
+	munmap(ptr, size);
+#endif
+}
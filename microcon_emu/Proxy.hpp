@@ -36,6 +36,7 @@
     #include <unistd.h>
     #include <time.h>
     #include <sys/time.h>
+    #include <sys/mman.h>
     #ifdef PLATFORM_WINDOWS
         #include <windows.h>  // For Sleep on Cygwin
     #endif
@@ -66,6 +67,9 @@ struct Thread_data {
 
 #define UINT24_MAX 0xFFFFFF
 
+// emulator version. bump whenever generated code or saved state changes shape (it keys the jit cache file)
+#define MICROCON_EMU_VERSION 0x00010005
+
 // Platform-independent thread functions
 extern thread_return_t THREAD_CALL ThreadFunc(void* data);
 extern thread_handle_t make_thread(Thread_data* mydata);
@@ -75,6 +79,16 @@ extern void wait_thread(thread_handle_t thread);
 extern uint32 Clock_gettime_msec();
 extern void Clock_sleep(uint32 msec);
 
+// Platform-independent executable memory (for jit code cache)
+extern void* make_exec_memory(uint32 size);
+extern void free_exec_memory(void* ptr, uint32 size);
+
+// map a whole file private (copy-on-write), readable, writable and executable. NULL if it can't be opened
+extern void* map_file_exec(const char* path, uint32* size);
+// same, read only
+extern void* map_file(const char* path, uint32* size);
+extern void unmap_file(void* ptr, uint32 size);
+
 #ifndef NULL
 #define NULL 0
 #endif
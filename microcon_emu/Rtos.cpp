@@ -0,0 +1,175 @@
+#include "Rtos.hpp"
+#include "Memory.hpp"
+#include "Coverage.hpp"	// Coverage_elf_symbols, COVERAGE_ELF_ENV
+#include <stdlib.h>	// getenv
+#include <string.h>
+
+uint32 Rtos_var_enabled = 0;
+Rtos_task* Rtos_var_cur = NULL;
+
+uint32 Rtos_var_switches = 0;
+
+static Rtos_task Rtos_var_main;	// thread mode on msp
+static Rtos_task Rtos_var_handlers;
+static Rtos_task Rtos_var_tasks[RTOS_MAX_TASKS];
+static uint32 Rtos_var_count = 0;
+static Rtos_task* Rtos_var_last = NULL;	// task thread mode ran last
+
+static uint32 Rtos_var_tcb = 0;	// address of the current tcb pointer, 0: tell tasks by psp
+static const char* Rtos_var_kernel = NULL;
+
+static uint64_t Rtos_var_cycles = 0;	// charged up to here
+static uint64_t Rtos_var_instrs = 0;
+
+static void Rtos_task_init(Rtos_task* task, uint32 key) {
+	memset(task, 0, sizeof(Rtos_task));
+	task->key = key;
+	task->lo = task->hi = key;
+	task->low = 0xFFFFFFFF;
+}
+
+static void Rtos_symbol(void*, const char* name, uint32 value, uint32 info) {
+	if ((info & 0xF) != 1) {	// STT_OBJECT
+		return;
+	}
+	if (strcmp(name, "pxCurrentTCB") == 0) {
+		Rtos_var_tcb = value;
+		Rtos_var_kernel = "freertos";
+	}
+	else if (strcmp(name, "_kernel") == 0) {
+		Rtos_var_tcb = value + RTOS_ZEPHYR_CURRENT;
+		Rtos_var_kernel = "zephyr";
+	}
+}
+
+void Rtos_init() {
+	const char* env = getenv(RTOS_ENV);
+	Rtos_var_enabled = (env != NULL && env[0] != '\0' && strcmp(env, "0") != 0);
+	Rtos_var_count = 0;
+	Rtos_var_switches = 0;
+	Rtos_var_tcb = 0;
+	Rtos_var_kernel = NULL;
+	Rtos_var_cycles = 0;
+	Rtos_var_instrs = 0;
+	Rtos_task_init(&Rtos_var_main, 0);
+	Rtos_task_init(&Rtos_var_handlers, 0);
+	Rtos_var_cur = &Rtos_var_main;
+	Rtos_var_last = &Rtos_var_main;
+	if (!Rtos_var_enabled) {
+		return;
+	}
+
+	const char* elfpath = getenv(COVERAGE_ELF_ENV);
+	if (elfpath != NULL && elfpath[0] != '\0') {
+		uint32 elfsize = 0;
+		uint8* elf = (uint8*)map_file(elfpath, &elfsize);
+		if (elf == NULL) {
+			eprintf("rtos: can't open %s\n", elfpath);
+		}
+		else {
+			Coverage_elf_symbols(elf, elfsize, Rtos_symbol, NULL);
+			unmap_file(elf, elfsize);
+		}
+	}
+	if (Rtos_var_tcb != 0) {
+		printf("rtos: %s, current task at 0x%08x\n", Rtos_var_kernel, (unsigned)Rtos_var_tcb);
+	}
+	else {
+		printf("rtos: no current tcb symbol, tasks told by their psp\n");
+	}
+}
+
+void Rtos_sp(uint32 sp) {
+	Rtos_task* task = Rtos_var_cur;
+	if (sp < task->low) {
+		task->low = sp;
+	}
+	if (sp > task->high) {
+		task->high = sp;
+	}
+}
+
+// everything since the last switch went to the one running
+static void Rtos_charge(Rtos_task* next) {
+	Rtos_var_cur->cycles += CPU_var_cycles - Rtos_var_cycles;
+	Rtos_var_cur->instrs += CPU_var_instrs - Rtos_var_instrs;
+	Rtos_var_cycles = CPU_var_cycles;
+	Rtos_var_instrs = CPU_var_instrs;
+	Rtos_var_cur = next;
+}
+
+static Rtos_task* Rtos_find(uint32 psp) {
+	uint32 key = psp;
+	if (Rtos_var_tcb != 0) {
+		uint8* data = (uint8*)Memory_read(Rtos_var_tcb, Memory_enum_size::u32, MEMORY_ATTRIB_S_R);
+		key = (data != NULL) ? (data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32)data[3] << 24)) : 0;
+	}
+
+	for (uint32 i = 0; i < Rtos_var_count; i++) {
+		Rtos_task* task = &Rtos_var_tasks[i];
+		if (Rtos_var_tcb != 0) {
+			if (task->key == key) {
+				return task;
+			}
+		}
+		else if (psp + RTOS_PSP_SLACK >= task->lo && psp <= task->hi + RTOS_PSP_SLACK) {
+			task->lo = (psp < task->lo) ? psp : task->lo;
+			task->hi = (psp > task->hi) ? psp : task->hi;
+			return task;
+		}
+	}
+	if (Rtos_var_count == RTOS_MAX_TASKS) {
+		return &Rtos_var_tasks[RTOS_MAX_TASKS - 1];	// the rest pile up in the last one
+	}
+	Rtos_task* task = &Rtos_var_tasks[Rtos_var_count++];
+	Rtos_task_init(task, key);
+	task->lo = task->hi = psp;
+	return task;
+}
+
+void Rtos_entry(CPU_struct_reg* reg) {
+	// the frame went on the stack of whatever was interrupted
+	Rtos_sp((Rtos_var_cur == &Rtos_var_main) ? reg->R[13] : reg->PSP);
+	Rtos_charge(&Rtos_var_handlers);
+	Rtos_sp(reg->R[13]);
+}
+
+void Rtos_return(CPU_struct_reg* reg) {
+	Rtos_task* task = reg->CONTROL.SPSEL ? Rtos_find(reg->R[13]) : &Rtos_var_main;
+
+	Rtos_charge(task);
+	if (task != Rtos_var_last) {
+		task->switches += 1;
+		Rtos_var_switches += 1;
+		Rtos_var_last = task;
+	}
+	Rtos_sp(reg->R[13]);
+}
+
+static void Rtos_print(const char* name, Rtos_task* task) {
+	double share = (CPU_var_cycles != 0) ? 100.0 * task->cycles / CPU_var_cycles : 0.0;
+	if (task->low == 0xFFFFFFFF) {
+		printf("rtos: %-12s %12llu %6.2f%% %12llu %8d\n", name, (unsigned long long)task->cycles, share,
+			(unsigned long long)task->instrs, (int)task->switches);
+		return;
+	}
+	printf("rtos: %-12s %12llu %6.2f%% %12llu %8d   0x%08x %6d\n", name, (unsigned long long)task->cycles, share,
+		(unsigned long long)task->instrs, (int)task->switches, (unsigned)task->low, (int)(task->high - task->low));
+}
+
+void Rtos_dump() {
+	if (!Rtos_var_enabled) {
+		return;
+	}
+	Rtos_charge(Rtos_var_cur);
+
+	printf("rtos: %-12s %12s %7s %12s %8s   %-10s %6s\n", "task", "cycles", "", "instrs", "switches", "lowest sp", "depth");
+	Rtos_print("main", &Rtos_var_main);
+	Rtos_print("handlers", &Rtos_var_handlers);
+	for (uint32 i = 0; i < Rtos_var_count; i++) {
+		char name[16];
+		snprintf(name, sizeof(name), "%s%08x", (Rtos_var_tcb != 0) ? "tcb " : "psp ", (unsigned)Rtos_var_tasks[i].key);
+		Rtos_print(name, &Rtos_var_tasks[i]);
+	}
+	printf("rtos: %d switches between %d tasks\n", (int)Rtos_var_switches, (int)Rtos_var_count);
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include "Proxy.hpp"
+#include "CPU.hpp"
+
+/*
+* per task profiling of FreeRTOS / Zephyr images
+*
+* both kernels switch tasks in an exception handler (PendSV, and SVC for the first task of FreeRTOS) that returns
+* to thread mode on the psp of another task. so the running task is only looked up at exception return
+* to thread mode (CPU_exceptionReturn), never per block:
+* - current tcb: MICROCON_EMU_ELF names pxCurrentTCB (FreeRTOS) or _kernel (Zephyr, the current thread
+*   of cpu 0 at RTOS_ZEPHYR_CURRENT). the task is the value of that pointer, which the handler has just written.
+* - no such symbol: the task is told by its stack. the psp returned to is matched against the psp ranges seen
+*   so far, RTOS_PSP_SLACK around them, anything else is a new task. a guess: tasks with tiny adjacent stacks can merge.
+* thread mode on msp (before the scheduler starts) is "main", all handler mode time is "handlers".
+*
+* per task, charged at every switch between thread and handler mode:
+* - cycles (CPU_var_cycles) and instructions retired (CPU_var_instrs).
+* - switches: times it was switched in.
+* - stack: the lowest sp seen while it ran, checked after every block and after every exception frame pushed
+*   on its stack, and how far that is below the highest one.
+*
+* MICROCON_EMU_RTOS=1 turns it on, the table is printed at exit.
+*/
+
+#define RTOS_ENV "MICROCON_EMU_RTOS"
+#define RTOS_MAX_TASKS 64
+#define RTOS_PSP_SLACK 0x100
+#define RTOS_ZEPHYR_CURRENT 8	// _kernel.cpus[0].current: after nested and irq_stack
+
+struct Rtos_task {
+	uint32 key;	// tcb address, or the first psp seen
+	uint32 lo, hi;	// psp range seen at switches (no tcb symbol)
+	uint32 low;	// lowest sp
+	uint32 high;	// highest sp
+	uint64_t cycles;
+	uint64_t instrs;
+	uint32 switches;
+};
+
+extern uint32 Rtos_var_enabled;
+extern Rtos_task* Rtos_var_cur;	// what cycles go to right now
+
+// telemetry
+extern uint32 Rtos_var_switches;
+
+// after Memory_init. finds the current tcb symbol in MICROCON_EMU_ELF
+extern void Rtos_init();
+
+// CPU_step, after the block: stack depth of whatever runs
+#define RTOS_STEP(reg) if (Rtos_var_enabled) Rtos_sp((reg)->R[13])
+extern void Rtos_sp(uint32 sp);
+
+// CPU_exceptionEntry, frame pushed: from thread mode, the interrupted task stops here
+#define RTOS_ENTRY(reg, thread) if (Rtos_var_enabled && (thread)) Rtos_entry(reg)
+extern void Rtos_entry(CPU_struct_reg* reg);
+
+// CPU_exceptionReturn, frame popped: back in thread mode, on which task
+#define RTOS_RETURN(reg) if (Rtos_var_enabled && (reg)->xPSR.IPSR.exception == 0) Rtos_return(reg)
+extern void Rtos_return(CPU_struct_reg* reg);
+
+// charge what is left and print the table
+extern void Rtos_dump();
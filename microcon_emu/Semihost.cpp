@@ -0,0 +1,384 @@
+#include "Semihost.hpp"
+#include "JitCache.hpp"
+#include "Clock.hpp"
+#include "Fuzz.hpp"
+#include <string.h>
+
+struct Semihost_file Semihost_var_files[SEMIHOST_MAX_FILES];
+
+uint32 Semihost_var_exited = 0;
+uint32 Semihost_var_exitcode = 0;
+
+uint32 Semihost_var_calls = 0;
+uint32 Semihost_var_hostwrites = 0;
+
+#define SEMIHOST_ERROR 0xFFFFFFFF
+
+static const char* Semihost_var_modes[12] = { "r", "rb", "r+", "r+b", "w", "wb", "w+", "w+b", "a", "ab", "a+", "a+b" };
+
+/*
+* guest memory
+*/
+
+// host pointer to guest [addr, addr + size) if it is plain memory inside one section
+static uint8* Semihost_direct(uint32 addr, uint32 size) {
+	Memory_map_elem* thismap = Memory_getMap(addr);
+	if (thismap == NULL || !MEMORY_IS_DIRECT(thismap) || addr + size > thismap->base + thismap->size || addr + size < addr) {
+		return NULL;
+	}
+	return &thismap->data[addr - thismap->base];
+}
+
+static void Semihost_copyin(uint8* dest, uint32 addr, uint32 size) {
+	uint8* src = Semihost_direct(addr, size);
+	if (src != NULL) {
+		memcpy(dest, src, size);
+		return;
+	}
+	for (uint32 i = 0; i < size; i++) {
+		uint8* data = (uint8*)Memory_read(addr + i, Memory_enum_size::u8, MEMORY_ATTRIB_S_R);
+		dest[i] = (data != NULL) ? *data : 0;
+	}
+}
+
+static void Semihost_copyout(uint32 addr, const uint8* src, uint32 size) {
+	uint8* dest = Semihost_direct(addr, size);
+	if (dest != NULL) {
+		Memory_map_elem* thismap = Memory_getMap(addr);
+		if (thismap->jit_pagemap != NULL) {
+			JitCache_invalidate(addr, size);
+		}
+		FUZZ_DIRTY(thismap, addr - thismap->base, size);
+		memcpy(dest, src, size);
+		return;
+	}
+	for (uint32 i = 0; i < size; i++) {
+		Memory_write(addr + i, Memory_enum_size::u8, src[i], MEMORY_ATTRIB_S_W);
+	}
+}
+
+static uint32 Semihost_word(uint32 addr) {
+	uint8 bytes[4];
+	Semihost_copyin(bytes, addr, 4);
+	return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32)bytes[3] << 24);
+}
+
+/*
+* handles
+*/
+
+static Semihost_file* Semihost_get(uint32 handle) {
+	if (handle == 0 || handle >= SEMIHOST_MAX_FILES || !Semihost_var_files[handle].used) {
+		return NULL;
+	}
+	return &Semihost_var_files[handle];
+}
+
+static void Semihost_flush_file(Semihost_file* file) {
+	if (file->buflen == 0) {
+		return;
+	}
+	fwrite(file->buf, 1, file->buflen, file->file);
+	fflush(file->file);
+	file->buflen = 0;
+	Semihost_var_hostwrites += 1;
+}
+
+static void Semihost_out(Semihost_file* file, const uint8* data, uint32 size) {
+	if (file->buflen + size > SEMIHOST_BUFFER_SIZE) {
+		Semihost_flush_file(file);
+	}
+	if (size >= SEMIHOST_BUFFER_SIZE) {
+		// bigger than the buffer anyway, one write straight from the source
+		fwrite(data, 1, size, file->file);
+		Semihost_var_hostwrites += 1;
+		return;
+	}
+	memcpy(file->buf + file->buflen, data, size);
+	file->buflen += size;
+}
+
+// copy guest [addr, addr + size) into the output buffer of file
+static void Semihost_out_guest(Semihost_file* file, uint32 addr, uint32 size) {
+	uint8* src = Semihost_direct(addr, size);
+	if (src != NULL) {
+		Semihost_out(file, src, size);
+		return;
+	}
+	uint8 chunk[256];
+	while (size > 0) {
+		uint32 len = (size > sizeof(chunk)) ? sizeof(chunk) : size;
+		Semihost_copyin(chunk, addr, len);
+		Semihost_out(file, chunk, len);
+		addr += len;
+		size -= len;
+	}
+}
+
+static void Semihost_console(uint32 handle, FILE* stream, uint32 writable) {
+	Semihost_file* file = &Semihost_var_files[handle];
+	file->used = 1;
+	file->file = stream;
+	file->map = NULL;
+	file->size = 0;
+	file->pos = 0;
+	file->buf = writable ? (uint8*)emalloc(SEMIHOST_BUFFER_SIZE) : NULL;
+	file->buflen = 0;
+}
+
+void Semihost_init() {
+	for (uint32 i = 0; i < SEMIHOST_MAX_FILES; i++) {
+		Semihost_var_files[i].used = 0;
+	}
+	Semihost_console(SEMIHOST_STDIN, stdin, 0);
+	Semihost_console(SEMIHOST_STDOUT, stdout, 1);
+	Semihost_console(SEMIHOST_STDERR, stderr, 1);
+
+	Semihost_var_exited = 0;
+	Semihost_var_exitcode = 0;
+	Semihost_var_calls = 0;
+	Semihost_var_hostwrites = 0;
+}
+
+/*
+* operations
+*/
+
+static uint32 Semihost_open(uint32 args) {
+	uint32 nameaddr = Semihost_word(args);
+	uint32 mode = Semihost_word(args + 4);
+	uint32 namelen = Semihost_word(args + 8);
+	char name[512];
+
+	if (mode >= 12 || namelen >= sizeof(name)) {
+		return SEMIHOST_ERROR;
+	}
+	Semihost_copyin((uint8*)name, nameaddr, namelen);
+	name[namelen] = '\0';
+
+	// console: modes r* -> stdin, w* -> stdout, a* -> stderr
+	if (strcmp(name, ":tt") == 0) {
+		return (mode < 4) ? SEMIHOST_STDIN : (mode < 8) ? SEMIHOST_STDOUT : SEMIHOST_STDERR;
+	}
+
+	uint32 handle = 0;
+	for (uint32 i = SEMIHOST_STDERR + 1; i < SEMIHOST_MAX_FILES; i++) {
+		if (!Semihost_var_files[i].used) {
+			handle = i;
+			break;
+		}
+	}
+	if (handle == 0) {
+		printf("semihosting: out of file handles\n");
+		return SEMIHOST_ERROR;
+	}
+
+	Semihost_file* file = &Semihost_var_files[handle];
+	file->file = NULL;
+	file->map = NULL;
+	file->size = 0;
+	file->pos = 0;
+	file->buf = NULL;
+	file->buflen = 0;
+
+	if (mode < 2) {
+		// read only: map it, reads become memcpy
+		file->map = (uint8*)map_file(name, &file->size);
+		if (file->map == NULL) {
+			// empty files can't be mapped, but they still exist
+			FILE* probe = fopen(name, "rb");
+			if (probe == NULL) {
+				return SEMIHOST_ERROR;
+			}
+			fclose(probe);
+			file->size = 0;
+		}
+	}
+	else {
+		file->file = fopen(name, Semihost_var_modes[mode]);
+		if (file->file == NULL) {
+			return SEMIHOST_ERROR;
+		}
+		file->buf = (uint8*)emalloc(SEMIHOST_BUFFER_SIZE);
+	}
+
+	file->used = 1;
+	return handle;
+}
+
+static uint32 Semihost_close(uint32 args) {
+	uint32 handle = Semihost_word(args);
+	Semihost_file* file = Semihost_get(handle);
+	if (file == NULL) {
+		return SEMIHOST_ERROR;
+	}
+	if (handle <= SEMIHOST_STDERR) {
+		// the console stays open
+		if (file->buf != NULL) {
+			Semihost_flush_file(file);
+		}
+		return 0;
+	}
+
+	if (file->buf != NULL) {
+		Semihost_flush_file(file);
+		efree(file->buf);
+	}
+	if (file->file != NULL) {
+		fclose(file->file);
+	}
+	if (file->map != NULL) {
+		unmap_file(file->map, file->size);
+	}
+	file->used = 0;
+	return 0;
+}
+
+static uint32 Semihost_write(uint32 args) {
+	Semihost_file* file = Semihost_get(Semihost_word(args));
+	uint32 addr = Semihost_word(args + 4);
+	uint32 size = Semihost_word(args + 8);
+
+	if (file == NULL || file->buf == NULL) {
+		return size;
+	}
+	Semihost_out_guest(file, addr, size);
+	return 0;
+}
+
+static uint32 Semihost_read(uint32 args) {
+	Semihost_file* file = Semihost_get(Semihost_word(args));
+	uint32 addr = Semihost_word(args + 4);
+	uint32 size = Semihost_word(args + 8);
+
+	if (file == NULL) {
+		return size;
+	}
+
+	if (file->file == NULL) {
+		// mapped
+		uint32 avail = file->size - file->pos;
+		uint32 len = (size < avail) ? size : avail;
+		if (len != 0) {
+			Semihost_copyout(addr, file->map + file->pos, len);
+			file->pos += len;
+		}
+		return size - len;
+	}
+
+	// whoever is reading the console should see the prompt first
+	if (file->file == stdin) {
+		Semihost_flush();
+	}
+	else if (file->buf != NULL) {
+		Semihost_flush_file(file);
+	}
+
+	uint32 done = 0;
+	uint8 chunk[1024];
+	while (done < size) {
+		uint32 want = (size - done > sizeof(chunk)) ? sizeof(chunk) : size - done;
+		uint32 got = (uint32)fread(chunk, 1, want, file->file);
+		Semihost_copyout(addr + done, chunk, got);
+		done += got;
+		if (got != want) {
+			break;
+		}
+	}
+	return size - done;
+}
+
+static void Semihost_exit(uint32 code) {
+	Semihost_var_exited = 1;
+	Semihost_var_exitcode = code;
+	Semihost_flush();
+	Clock_halt();
+}
+
+void Semihost_call(CPU_struct_reg* reg) {
+	uint32 op = reg->R[0] & 0xFFFFFFFF;
+	uint32 arg = reg->R[1] & 0xFFFFFFFF;
+	uint32 result = 0;
+
+	Semihost_var_calls += 1;
+
+	switch (op) {
+	case SYS_OPEN:
+		result = Semihost_open(arg);
+		break;
+	case SYS_CLOSE:
+		result = Semihost_close(arg);
+		break;
+	case SYS_WRITEC:
+		Semihost_out_guest(&Semihost_var_files[SEMIHOST_STDOUT], arg, 1);
+		result = reg->R[0];	// r0 is corrupted per spec, keep it
+		break;
+	case SYS_WRITE0: {
+		// scan for the nul in place when the string is in plain memory
+		Memory_map_elem* thismap = Memory_getMap(arg);
+		if (thismap != NULL && MEMORY_IS_DIRECT(thismap) && arg < thismap->base + thismap->size) {
+			uint8* start = &thismap->data[arg - thismap->base];
+			uint32 remaining = thismap->base + thismap->size - arg;
+			uint8* end = (uint8*)memchr(start, 0, remaining);
+			Semihost_out(&Semihost_var_files[SEMIHOST_STDOUT], start, (end != NULL) ? (uint32)(end - start) : remaining);
+		}
+		else {
+			for (uint32 addr = arg;; addr++) {
+				uint8 c;
+				Semihost_copyin(&c, addr, 1);
+				if (c == 0) {
+					break;
+				}
+				Semihost_out(&Semihost_var_files[SEMIHOST_STDOUT], &c, 1);
+			}
+		}
+		result = reg->R[0];
+		break;
+	}
+	case SYS_WRITE:
+		result = Semihost_write(arg);
+		break;
+	case SYS_READ:
+		result = Semihost_read(arg);
+		break;
+	case SYS_EXIT:
+		Semihost_exit((arg == SEMIHOST_ADP_STOPPED_APPLICATIONEXIT) ? 0 : 1);
+		break;
+	case SYS_EXIT_EXTENDED:
+		Semihost_exit((Semihost_word(arg) == SEMIHOST_ADP_STOPPED_APPLICATIONEXIT) ? Semihost_word(arg + 4) : 1);
+		break;
+	default:
+		eprintf("semihosting: unsupported operation 0x%x\n", (int)op);
+		result = SEMIHOST_ERROR;
+		break;
+	}
+
+	reg->R[0] = result;
+}
+
+void Semihost_flush() {
+	for (uint32 i = 0; i < SEMIHOST_MAX_FILES; i++) {
+		if (Semihost_var_files[i].used && Semihost_var_files[i].buf != NULL) {
+			Semihost_flush_file(&Semihost_var_files[i]);
+		}
+	}
+}
+
+void Semihost_shutdown() {
+	Semihost_flush();
+	for (uint32 i = SEMIHOST_STDERR + 1; i < SEMIHOST_MAX_FILES; i++) {
+		if (!Semihost_var_files[i].used) {
+			continue;
+		}
+		if (Semihost_var_files[i].buf != NULL) {
+			efree(Semihost_var_files[i].buf);
+		}
+		if (Semihost_var_files[i].file != NULL) {
+			fclose(Semihost_var_files[i].file);
+		}
+		if (Semihost_var_files[i].map != NULL) {
+			unmap_file(Semihost_var_files[i].map, Semihost_var_files[i].size);
+		}
+		Semihost_var_files[i].used = 0;
+	}
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include "Proxy.hpp"
+#include "Memory.hpp"
+#include "CPU.hpp"
+
+/*
+* arm semihosting
+*
+* the guest traps with BKPT 0xAB (or SVC 0xAB), r0 = operation, r1 = argument or pointer to an argument block.
+* the result goes back into r0 and execution continues after the trap.
+*
+* supported:
+* - SYS_OPEN (0x01): block {name, mode 0~11 (fopen "r" ~ "a+b"), name length}. ":tt" is the console
+* - SYS_CLOSE (0x02)
+* - SYS_WRITEC (0x03): r1 -> one char
+* - SYS_WRITE0 (0x04): r1 -> nul terminated string
+* - SYS_WRITE (0x05): block {handle, buffer, length}, returns bytes NOT written
+* - SYS_READ (0x06): block {handle, buffer, length}, returns bytes NOT read (length on eof)
+* - SYS_EXIT (0x18): r1 = reason. ADP_Stopped_ApplicationExit -> exit code 0, anything else -> 1
+* - SYS_EXIT_EXTENDED (0x20): block {reason, exit code}
+* anything else returns -1.
+*
+* output:
+* - test firmware prints a lot, often one char or one short string per trap. a host write per trap dominates.
+* - every writable handle (console included) collects output in its own SEMIHOST_BUFFER_SIZE buffer,
+*   and the host only sees one large write when it fills up, on close, on a console read and at exit.
+* - guest buffers are copied straight out of the section data when they sit in plain memory.
+*
+* input:
+* - files opened read only ("r", "rb") are mapped, SYS_READ is a memcpy from the mapping into guest memory.
+* - other modes go through stdio.
+*
+* accesses are made on behalf of the debugger: no attribute or mpu checks. writes into guest memory still
+* invalidate translated code.
+*/
+
+#define SEMIHOST_IMM 0xAB		// BKPT / SVC immediate
+#define SEMIHOST_MAX_FILES 16
+#define SEMIHOST_BUFFER_SIZE 0x10000
+
+// console handles, returned for ":tt"
+#define SEMIHOST_STDIN 1
+#define SEMIHOST_STDOUT 2
+#define SEMIHOST_STDERR 3
+
+enum Semihost_op_enum {
+	SYS_OPEN = 0x01,
+	SYS_CLOSE = 0x02,
+	SYS_WRITEC = 0x03,
+	SYS_WRITE0 = 0x04,
+	SYS_WRITE = 0x05,
+	SYS_READ = 0x06,
+	SYS_EXIT = 0x18,
+	SYS_EXIT_EXTENDED = 0x20
+};
+
+#define SEMIHOST_ADP_STOPPED_APPLICATIONEXIT 0x20026
+
+struct Semihost_file {
+	uint32 used;
+	FILE* file;		// NULL for mapped files
+	uint8* map;		// read only files
+	uint32 size;
+	uint32 pos;
+	uint8* buf;		// pending output (writable handles)
+	uint32 buflen;
+};
+
+extern struct Semihost_file Semihost_var_files[SEMIHOST_MAX_FILES];
+
+extern uint32 Semihost_var_exited;
+extern uint32 Semihost_var_exitcode;
+
+// telemetry
+extern uint32 Semihost_var_calls;
+extern uint32 Semihost_var_hostwrites;
+
+extern void Semihost_init();
+
+// one trap. r0/r1 in, r0 out
+extern void Semihost_call(CPU_struct_reg* reg);
+
+// push out everything buffered
+extern void Semihost_flush();
+
+// flush and close every handle (end of run)
+extern void Semihost_shutdown();
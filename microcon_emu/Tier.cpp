@@ -0,0 +1,189 @@
+#include "Tier.hpp"
+#include "Jit.hpp"
+#include "Idiom.hpp"
+#include "Poll.hpp"
+#include <stdlib.h>	// getenv, atoi
+#include <string.h>
+
+// a queued compile: the IR and the guest bytes it came from in, host code and relocs out
+struct Tier_job {
+	std::atomic<uint32_t> state;	// Tier_state_enum
+	uint32 epoch;	// JitCache_var_epoch at submit
+	uint32 nbytes;
+	uint8 guest[TIER_MAX_GUEST_BYTES];
+	IR_block block;
+	vect8 code;
+	JitCache_reloc relocs[JIT_MAX_RELOCS];
+	uint32 nrelocs;
+};
+
+struct Tier_counter {
+	uint32 pc;
+	uint32 count;	// executions, TIER_QUEUED while its job is in flight
+};
+
+uint32 Tier_var_enabled = 0;
+uint32 Tier_var_threshold = TIER_THRESHOLD;
+std::atomic<uint32_t> Tier_var_ready(0);
+uint32 Tier_var_seen = 0;
+
+uint32 Tier_var_submitted = 0;
+uint32 Tier_var_installed = 0;
+uint32 Tier_var_stale = 0;
+
+static Tier_counter Tier_var_counters[TIER_HASH_SIZE];
+static Tier_job* Tier_var_jobs = NULL;	// host heap: vectors inside, and too big for the emu pool
+static uint32 Tier_var_head = 0;	// next slot to fill (cpu thread)
+
+static std::atomic<uint32_t> Tier_var_stop(0);
+static Thread_data Tier_var_thread_data;
+static thread_handle_t Tier_var_thread;
+
+// compile thread: jobs in slot order, sleeps when there is nothing to do
+static void Tier_worker() {
+	uint32 tail = 0;
+
+	while (!Tier_var_stop.load(std::memory_order_acquire)) {
+		Tier_job* job = &Tier_var_jobs[tail];
+		if (job->state.load(std::memory_order_acquire) != TIER_WAITING) {
+			Clock_sleep(1);
+			continue;
+		}
+		job->state.store(TIER_COMPILING, std::memory_order_relaxed);
+
+		job->code.clear();
+		Jit_compile(&job->block, &job->code);
+		memcpy(job->relocs, Jit_var_relocs, Jit_var_nrelocs * sizeof(JitCache_reloc));
+		job->nrelocs = Jit_var_nrelocs;
+
+		job->state.store(TIER_DONE, std::memory_order_release);
+		Tier_var_ready.fetch_add(1, std::memory_order_release);
+		tail = (tail + 1) % TIER_QUEUE_SIZE;
+	}
+}
+
+void Tier_init() {
+	const char* env = getenv(TIER_ENV);
+	Tier_var_threshold = (env != NULL && env[0] != '\0') ? (uint32)atoi(env) : TIER_THRESHOLD;
+	Tier_var_enabled = JIT_HOST_X86 && Tier_var_threshold != 0;
+	Tier_var_ready.store(0);
+	Tier_var_seen = 0;
+	Tier_var_head = 0;
+	Tier_var_submitted = 0;
+	Tier_var_installed = 0;
+	Tier_var_stale = 0;
+	for (uint32 i = 0; i < TIER_HASH_SIZE; i++) {
+		Tier_var_counters[i].pc = JITCACHE_NONE;
+		Tier_var_counters[i].count = 0;
+	}
+	if (!Tier_var_enabled) {
+		return;
+	}
+
+	// Jit_compile must not allocate from the compile thread
+	for (uint32 i = 0; i < Memory_var_arrlen; i++) {
+		if (MEMORY_IS_DIRECT(&Memory_var_arr[i])) {
+			JitCache_pagemap(&Memory_var_arr[i]);
+		}
+	}
+
+	Tier_var_jobs = new Tier_job[TIER_QUEUE_SIZE];
+	for (uint32 i = 0; i < TIER_QUEUE_SIZE; i++) {
+		Tier_var_jobs[i].state.store(TIER_FREE);
+	}
+	Tier_var_stop.store(0);
+	Tier_var_thread_data.func = Tier_worker;
+	Tier_var_thread_data.param1 = 0;
+	Tier_var_thread_data.param2 = 0;
+	Tier_var_thread = make_thread(&Tier_var_thread_data);
+}
+
+void Tier_shutdown() {
+	if (!Tier_var_enabled) {
+		return;
+	}
+	Tier_var_stop.store(1, std::memory_order_release);
+	wait_thread(Tier_var_thread);
+	delete[] Tier_var_jobs;
+	Tier_var_jobs = NULL;
+	Tier_var_enabled = 0;
+	printf("tier: %d blocks compiled, %d dropped as stale\n", (int)Tier_var_installed, (int)Tier_var_stale);
+}
+
+uint32 Tier_hot(uint32 pc) {
+	Tier_counter* counter = &Tier_var_counters[TIER_HASH(pc)];
+	if (counter->pc != pc) {
+		if (counter->count == TIER_QUEUED) {
+			return 0;	// keep the slot until its job is installed
+		}
+		counter->pc = pc;
+		counter->count = 0;
+	}
+	if (counter->count == TIER_QUEUED || ++counter->count < Tier_var_threshold) {
+		return 0;
+	}
+	counter->count = TIER_QUEUED;
+	return 1;
+}
+
+// the block at pc starts counting from scratch
+static void Tier_reset(uint32 pc) {
+	Tier_counter* counter = &Tier_var_counters[TIER_HASH(pc)];
+	if (counter->pc == pc) {
+		counter->count = 0;
+	}
+}
+
+uint32 Tier_submit(IR_block* block) {
+	Tier_job* job = &Tier_var_jobs[Tier_var_head];
+	uint32 nbytes = block->guest_end - block->guest_start;
+	Memory_map_elem* thismap = Memory_getMap(block->guest_start);
+
+	if (job->state.load(std::memory_order_acquire) != TIER_FREE || nbytes > TIER_MAX_GUEST_BYTES
+		|| thismap == NULL || !MEMORY_IS_DIRECT(thismap) || block->guest_end > thismap->base + thismap->size) {
+		Tier_reset(block->guest_start);
+		return 0;
+	}
+
+	job->epoch = JitCache_var_epoch;
+	job->nbytes = nbytes;
+	memcpy(job->guest, &thismap->data[block->guest_start - thismap->base], nbytes);
+	memcpy(&job->block, block, sizeof(IR_block));
+	job->state.store(TIER_WAITING, std::memory_order_release);
+
+	Tier_var_head = (Tier_var_head + 1) % TIER_QUEUE_SIZE;
+	Tier_var_submitted += 1;
+	return 1;
+}
+
+void Tier_install() {
+	Tier_var_seen = Tier_var_ready.load(std::memory_order_acquire);
+
+	for (uint32 i = 0; i < TIER_QUEUE_SIZE; i++) {
+		Tier_job* job = &Tier_var_jobs[i];
+		if (job->state.load(std::memory_order_acquire) != TIER_DONE) {
+			continue;
+		}
+		IR_block* block = &job->block;
+		Memory_map_elem* thismap = Memory_getMap(block->guest_start);
+		Tier_reset(block->guest_start);
+
+		// written over or flushed while it was compiling: it counts up again from the new code
+		if (job->epoch != JitCache_var_epoch || thismap == NULL
+			|| memcmp(job->guest, &thismap->data[block->guest_start - thismap->base], job->nbytes) != 0
+			|| JitCache_lookup(block->guest_start) != NULL) {
+			Tier_var_stale += 1;
+			job->state.store(TIER_FREE, std::memory_order_release);
+			continue;
+		}
+
+		JitCache_block* cached = JitCache_insert(block->guest_start, block->guest_end, job->code.data(), job->code.size(),
+			job->relocs, job->nrelocs);
+		if (cached != NULL) {
+			cached->idiom = Idiom_match(block);
+			cached->poll = Poll_match(block);
+			Tier_var_installed += 1;
+		}
+		job->state.store(TIER_FREE, std::memory_order_release);
+	}
+}
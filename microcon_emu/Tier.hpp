@@ -0,0 +1,77 @@
+#pragma once
+#include "Proxy.hpp"
+#include "Memory.hpp"
+#include "JitCache.hpp"
+#include "IR.hpp"
+#include <atomic>
+
+/*
+* tiering: interpreter first, jit for hot blocks, compiled on a background thread
+*
+* compiling every block on first sight spends most of a short run translating init code that runs once,
+* interpreting everything leaves hot loops slow. so on a jit host:
+* - a block that isn't in the cache runs in the IR interpreter and counts one execution (Tier_hot),
+*   in a direct mapped table keyed by pc.
+* - at TIER_THRESHOLD executions its lowered, optimized IR is copied into a job slot (Tier_submit) together with
+*   the guest bytes it was lowered from, and it keeps running in the interpreter.
+* - the compile thread turns queued jobs into host code and relocs (Jit_compile) and marks them done.
+* - the cpu thread installs done jobs between blocks (TIER_INSTALL): JitCache_insert, after which the next
+*   dispatch of that pc runs the host code.
+*
+* threads:
+* - a job slot belongs to whoever its state says (free: the cpu thread fills it, waiting / compiling: the compile
+*   thread, done: the cpu thread again). every state change is an atomic store with release, every check an acquire load,
+*   so the slot contents travel with the state. Tier_var_ready counts done jobs, so the cpu thread
+*   only looks at the slots when there is something to install.
+* - the cache, the arena and the hash stay on the cpu thread. the compile thread only writes its job.
+* - with tiering on, Jit_compile only ever runs on the compile thread (it has static state).
+*   pagemaps, which Jit_compile may allocate, are all made up front in Tier_init.
+*
+* stale jobs (dropped at install, the block starts counting again):
+* - the guest wrote over the code meanwhile: the bytes are compared with the copy in the job.
+* - the cache was flushed meanwhile (mpu toggled, image reload): JitCache_var_epoch moved.
+*
+* MICROCON_EMU_TIER=<n> sets the threshold, MICROCON_EMU_TIER=0 compiles every block on first sight, on the cpu thread.
+* tiering only exists where the jit does (JIT_HOST_X86).
+*/
+
+#define TIER_ENV "MICROCON_EMU_TIER"
+#define TIER_THRESHOLD 32	// default executions before a block is compiled
+#define TIER_HASH_SIZE 4096	// power of 2
+#define TIER_HASH(pc) (((pc) >> 1) & (TIER_HASH_SIZE - 1))
+#define TIER_QUEUE_SIZE 16
+#define TIER_MAX_GUEST_BYTES (IR_MAX_GUEST * 4)
+#define TIER_QUEUED 0xFFFFFFFF	// counter value: a job for this pc is in flight
+
+enum Tier_state_enum {
+	TIER_FREE = 0,
+	TIER_WAITING,	// filled, for the compile thread
+	TIER_COMPILING,
+	TIER_DONE	// code and relocs ready, for the cpu thread
+};
+
+extern uint32 Tier_var_enabled;
+extern uint32 Tier_var_threshold;
+extern std::atomic<uint32_t> Tier_var_ready;	// jobs done by the compile thread
+extern uint32 Tier_var_seen;	// Tier_var_ready the cpu thread has installed up to
+
+// telemetry
+extern uint32 Tier_var_submitted;
+extern uint32 Tier_var_installed;
+extern uint32 Tier_var_stale;
+
+// after Memory_init and JitCache_init. starts the compile thread
+extern void Tier_init();
+
+// stop the compile thread, before JitAot_save
+extern void Tier_shutdown();
+
+// count one execution of the uncached block at pc. 1 exactly once when it gets hot
+extern uint32 Tier_hot(uint32 pc);
+
+// queue a lowered, optimized block for the compile thread. 0 if it can't be (queue full, code not in plain memory)
+extern uint32 Tier_submit(IR_block* block);
+
+// install done jobs into the cache
+#define TIER_INSTALL() if (Tier_var_ready.load(std::memory_order_relaxed) != Tier_var_seen) Tier_install()
+extern void Tier_install();
@@ -354,11 +354,25 @@ public:
 		dwordCallSize = 2,
 		retSize = 1,
 		nopSize = 1,
+		pushfdSize = 1,
+		popfdSize = 1,
+		cmcSize = 1,
 
 		pushWordSize = 2,
 		pushDwordSize = 1,
 		popWordSize = 2,
 		popDwordSize = 1,
+		pushByteImmSize = 2,
+
+		dwordSubImmToRegSize = 6,
+		dwordCmpImmToRegSize = 6,
+		movDwordMemDispToRegSize = 6,
+		movDwordRegToMemDispSize = 6,
+		movWordRegToMemDispSize = 7,
+		movByteRegToMemDispSize = 6,
+		movzxByteMemDispToDwordSize = 7,
+		movzxWordMemDispToDwordSize = 7,
+		btMemaddrSize = 7,
 
 		/*shortcuts!*/
 		loadByteShortcutSize = movFromMemaddrByteSize + movzxByteToDwordSize,
@@ -442,6 +456,17 @@ public:
 		pushDwordMode,
 		popWordMode,
 		popDwordMode,
+		pushByteImmMode,
+
+		dwordSubImmToRegMode,
+		dwordCmpImmToRegMode,
+		movDwordMemDispToRegMode,
+		movDwordRegToMemDispMode,
+		movWordRegToMemDispMode,
+		movByteRegToMemDispMode,
+		movzxByteMemDispToDwordMode,
+		movzxWordMemDispToDwordMode,
+		btMemaddrMode,
 
 		/*shortcuts!*/
 		loadByteShortcutMode,
@@ -482,6 +507,16 @@ public:
 		return none;
 	}
 
+	//push sign extended imm8 (helper call arguments)
+	OperandSizes Push_imm(vect8* memoryBlock, OperandModes opmode, Disp disp) const{
+		uint8_t opcode = 0x68;	//01101000
+		switch (opmode){
+		case pushByteImmMode: init(memoryBlock, pushByteImmSize); addOpcode(opcode, destToSrc, byteOnly); addByte(disp.byte); return pushByteImmSize;
+		default: opmodeError("push_imm");
+		}
+		return none;
+	}
+
 	//no need for the opposite(use only for zeroing out high area)
 	OperandSizes Movzx(vect8* memoryBlock, OperandModes opmode, X86Regs src, X86Regs dest) const{
 		uint8_t opcode = 0xB4; //10110100
@@ -498,6 +533,18 @@ public:
 	
 	//ex) convert word to dword
 	//Movzx(memoryBlock, movzxWordToDwordMode, Areg, Areg);
+
+	//movzx from [base + disp32]
+	//00001111 101101 1 0 10 000 001 disp32 -> movzx eax, byte ptr [ecx + disp32]
+	OperandSizes Movzx_disp(vect8* memoryBlock, OperandModes opmode, X86Regs dest, X86Regs base, Disp disp) const{
+		uint8_t opcode = 0xB4; //10110100
+		switch (opmode){
+		case movzxByteMemDispToDwordMode: init(memoryBlock, movzxByteMemDispToDwordSize); addExtension(); addOpcode(opcode, destToSrc, byteOnly); addModrm(dwordSignedDisp, dest, base); addDword(disp.dword); return movzxByteMemDispToDwordSize;
+		case movzxWordMemDispToDwordMode: init(memoryBlock, movzxWordMemDispToDwordSize); addExtension(); addOpcode(opcode, destToSrc, wordAndDword); addModrm(dwordSignedDisp, dest, base); addDword(disp.dword); return movzxWordMemDispToDwordSize;
+		default: opmodeError("movzx_disp");
+		}
+		return none;
+	}
 	
 
 	//memoryaddr must always be dword!
@@ -526,6 +573,21 @@ public:
 	//for memaddr
 	OperandSizes Mov(vect8* memoryBlock, OperandModes opmode, X86Regs src, Disp disp = Disp()) const{ return Mov(memoryBlock, opmode, src, Areg, disp); }
 
+	//mov with [base + disp32] (base must not be esp)
+	//100010 1 1 10 000 001 disp32 -> mov eax, [ecx + disp32]
+	//100010 0 1 10 010 001 disp32 -> mov [ecx + disp32], edx
+	OperandSizes Mov_disp(vect8* memoryBlock, OperandModes opmode, X86Regs reg, X86Regs base, Disp disp) const{
+		uint8_t opcode = 0x88; //10001000
+		switch (opmode){
+		case movDwordMemDispToRegMode: init(memoryBlock, movDwordMemDispToRegSize); addOpcode(opcode, destToSrc, wordAndDword); addModrm(dwordSignedDisp, reg, base); addDword(disp.dword); return movDwordMemDispToRegSize;
+		case movDwordRegToMemDispMode: init(memoryBlock, movDwordRegToMemDispSize); addOpcode(opcode, srcToDest, wordAndDword); addModrm(dwordSignedDisp, reg, base); addDword(disp.dword); return movDwordRegToMemDispSize;
+		case movWordRegToMemDispMode: init(memoryBlock, movWordRegToMemDispSize); addPrefix(); addOpcode(opcode, srcToDest, wordAndDword); addModrm(dwordSignedDisp, reg, base); addDword(disp.dword); return movWordRegToMemDispSize;
+		case movByteRegToMemDispMode: init(memoryBlock, movByteRegToMemDispSize); addOpcode(opcode, srcToDest, byteOnly); addModrm(dwordSignedDisp, reg, base); addDword(disp.dword); return movByteRegToMemDispSize;
+		default: opmodeError("mov_disp");
+		}
+		return none;
+	}
+
 
 
 	//kinda different - use Direction and Bitsize to point reg
@@ -614,6 +676,17 @@ public:
 	//sub dword (AB <-> CD)
 	//001010 0 1 11 000 011
 
+	//sub imm dword
+	//100000 0 1 11 101 001 imm32 -> sub ecx, imm32
+	OperandSizes Sub_imm(vect8* memoryBlock, OperandModes opmode, X86Regs dest, Disp disp) const{
+		uint8_t opcode = 0x80;
+		switch (opmode){
+		case dwordSubImmToRegMode: init(memoryBlock, dwordSubImmToRegSize); addOpcode(opcode, srcToDest, wordAndDword); addModrm(forReg, memaddr, dest); addDword(disp.dword); return dwordSubImmToRegSize;
+		default: opmodeError("sub_imm");
+		}
+		return none;
+	}
+
 
 	//dword and
 	OperandSizes And(vect8* memoryBlock, OperandModes opmode, X86Regs src, X86Regs dest) const{
@@ -673,6 +746,28 @@ public:
 	}
 
 
+	//cmp imm dword
+	//100000 0 1 11 111 001 imm32 -> cmp ecx, imm32
+	OperandSizes Cmp_imm(vect8* memoryBlock, OperandModes opmode, X86Regs dest, Disp disp) const{
+		uint8_t opcode = 0x80;
+		switch (opmode){
+		case dwordCmpImmToRegMode: init(memoryBlock, dwordCmpImmToRegSize); addOpcode(opcode, srcToDest, wordAndDword); addModrm(forReg, Didx, dest); addDword(disp.dword); return dwordCmpImmToRegSize;
+		default: opmodeError("cmp_imm");
+		}
+		return none;
+	}
+
+	//bit test on a bit string in memory, bit offset in reg (can go past the first dword). result in CF
+	//00001111 101000 1 1 00 000 101 disp32 -> bt dword ptr [disp32], eax
+	OperandSizes Bt(vect8* memoryBlock, OperandModes opmode, X86Regs src, Disp addr) const{
+		uint8_t opcode = 0xA0;	//10100000
+		switch (opmode){
+		case btMemaddrMode: init(memoryBlock, btMemaddrSize); addExtension(); addOpcode(opcode, destToSrc, wordAndDword); addModrm(forDisp, src, memaddr); addDword(addr.dword); return btMemaddrSize;
+		default: opmodeError("bt");
+		}
+		return none;
+	}
+
 	//jmp	jump
 	OperandSizes Jmp(vect8* memoryBlock, OperandModes opmode, Disp disp) const{
 		uint8_t opcode = 0xE8; //111010
@@ -728,6 +823,13 @@ public:
 	//nop
 	OperandSizes Nop(vect8* memoryBlock) const{ init(memoryBlock, nopSize); addByte(0x90); return nopSize; }
 
+	//push / pop eflags (host flags of the last alu op, see Jit.cpp)
+	OperandSizes Pushfd(vect8* memoryBlock) const{ init(memoryBlock, pushfdSize); addByte(0x9C); return pushfdSize; }
+	OperandSizes Popfd(vect8* memoryBlock) const{ init(memoryBlock, popfdSize); addByte(0x9D); return popfdSize; }
+
+	//complement carry flag
+	OperandSizes Cmc(vect8* memoryBlock) const{ init(memoryBlock, cmcSize); addByte(0xF5); return cmcSize; }
+
 	//load effective address - lea <- shift + add
 	//bse -> memaddr: some dword immediate(disp32) you can add along with main(multiplcation)
 	//bse -> not memaddr: some reg(any reg) you can add along with main(multiplcation)
@@ -0,0 +1,325 @@
+#include "Core.hpp"
+#include <string.h>
+#include <chrono>
+#include <vector>
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+/*
+* interpreter dispatch benchmark (./build.sh bench -> bench_dispatch.exe [image.bin])
+*
+* what hello_opt() in Core.cpp used to try once at startup, measured: the same op stream through
+* - switch: one switch in a loop (what IR_execute does)
+* - table: an array of handler pointers, called per op (CPU_op_vect style)
+* - goto: computed goto, every handler jumps to the next one itself (gcc / clang)
+* - tail: every handler tail calls the next one through the table (musttail, or a build that optimizes)
+* every handler does a different bit of arithmetic on one accumulator, so the compiler can't merge them
+* and all strategies must end with the same value.
+*
+* streams, BENCH_LEN ops each:
+* - cyclic: hello_opt's six ops in a loop. the predictor learns it
+* - uniform: random over BENCH_OPS handlers. close to every indirect branch missing
+* - ir: the IR ops (IR_op_enum) of a real thumb image, every block lowered and optimized in address order.
+*   the image is a raw binary at 0 (argument), a few built-in routines (crc, copy, sum) without one
+*
+* reported per strategy: best of BENCH_ROUNDS in ns per dispatch, and branch misses per dispatch
+* (perf counters, linux only)
+*/
+
+#define BENCH_OPS 32	// handlers, >= IR_NUMBER_OF_OPS
+#define BENCH_LEN (0x1 << 22)
+#define BENCH_ROUNDS 5
+#define BENCH_END BENCH_OPS	// stream terminator for goto / tail
+
+static_assert(IR_NUMBER_OF_OPS <= BENCH_OPS, "bench: an IR op without a handler");
+
+#if defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 15)
+#define BENCH_MUSTTAIL __attribute__((musttail))
+#define BENCH_HAS_TAIL 1
+#elif defined(__OPTIMIZE__)
+#define BENCH_MUSTTAIL	// sibling call optimization does it
+#define BENCH_HAS_TAIL 1
+#else
+#define BENCH_HAS_TAIL 0	// every op would be a real call, the stack runs out
+#endif
+
+#if defined(__GNUC__)
+#define BENCH_NOINLINE __attribute__((noinline))
+#else
+#define BENCH_NOINLINE __declspec(noinline)
+#endif
+
+#define BENCH_FOR_OPS(X) \
+	X(0) X(1) X(2) X(3) X(4) X(5) X(6) X(7) X(8) X(9) X(10) X(11) X(12) X(13) X(14) X(15) \
+	X(16) X(17) X(18) X(19) X(20) X(21) X(22) X(23) X(24) X(25) X(26) X(27) X(28) X(29) X(30) X(31)
+
+// four shapes of work, so no two handlers are the same code with other constants
+#define BENCH_OP(acc, k) \
+	(((k) & 0x3) == 0 ? (acc) + (k) * 0x9E3779B9u : \
+	((k) & 0x3) == 1 ? (acc) * (2 * (k) + 1) : \
+	((k) & 0x3) == 2 ? (acc) ^ ((acc) >> ((k) % 13 + 1)) : \
+	((acc) << ((k) % 7 + 1)) | ((acc) >> (31 - (k) % 7)))
+
+/*
+* strategies
+*/
+
+static uint32_t Bench_switch(const uint8* ops, uint32 n) {
+	uint32_t acc = 1;
+	for (uint32 i = 0; i < n; i++) {
+		switch (ops[i]) {
+#define BENCH_CASE(k) case k: acc = BENCH_OP(acc, k); break;
+		BENCH_FOR_OPS(BENCH_CASE)
+#undef BENCH_CASE
+		default:
+			break;
+		}
+	}
+	return acc;
+}
+
+typedef uint32_t (*Bench_handler)(uint32_t acc);
+#define BENCH_HANDLER(k) static BENCH_NOINLINE uint32_t Bench_op##k(uint32_t acc) { return BENCH_OP(acc, k); }
+BENCH_FOR_OPS(BENCH_HANDLER)
+#undef BENCH_HANDLER
+
+static Bench_handler Bench_var_table[BENCH_OPS] = {
+#define BENCH_ENTRY(k) Bench_op##k,
+	BENCH_FOR_OPS(BENCH_ENTRY)
+#undef BENCH_ENTRY
+};
+
+static uint32_t Bench_table(const uint8* ops, uint32 n) {
+	uint32_t acc = 1;
+	for (uint32 i = 0; i < n; i++) {
+		acc = Bench_var_table[ops[i]](acc);
+	}
+	return acc;
+}
+
+#if defined(__GNUC__)
+static uint32_t Bench_goto(const uint8* ops, uint32) {
+	static void* labels[BENCH_OPS + 1] = {
+#define BENCH_LABEL(k) &&op##k,
+		BENCH_FOR_OPS(BENCH_LABEL)
+#undef BENCH_LABEL
+		&&end
+	};
+	uint32_t acc = 1;
+	const uint8* ip = ops;
+
+	goto *labels[*ip++];
+#define BENCH_BODY(k) op##k: acc = BENCH_OP(acc, k); goto *labels[*ip++];
+	BENCH_FOR_OPS(BENCH_BODY)
+#undef BENCH_BODY
+end:
+	return acc;
+}
+#endif
+
+#if BENCH_HAS_TAIL
+typedef uint32_t (*Bench_tail_fn)(uint32_t acc, const uint8* ip);
+static Bench_tail_fn Bench_var_tail[BENCH_OPS + 1];
+
+#define BENCH_TAIL(k) static uint32_t Bench_tail##k(uint32_t acc, const uint8* ip) { \
+	acc = BENCH_OP(acc, k); \
+	BENCH_MUSTTAIL return Bench_var_tail[*ip](acc, ip + 1); \
+}
+BENCH_FOR_OPS(BENCH_TAIL)
+#undef BENCH_TAIL
+
+static uint32_t Bench_tail_end(uint32_t acc, const uint8*) {
+	return acc;
+}
+
+static uint32_t Bench_tail(const uint8* ops, uint32) {
+	return Bench_var_tail[ops[0]](1, ops + 1);
+}
+#endif
+
+struct Bench_strategy {
+	const char* name;
+	uint32_t (*run)(const uint8* ops, uint32 n);
+};
+
+static const Bench_strategy Bench_var_strategies[] = {
+	{ "switch", Bench_switch },
+	{ "table", Bench_table },
+#if defined(__GNUC__)
+	{ "goto", Bench_goto },
+#endif
+#if BENCH_HAS_TAIL
+	{ "tail", Bench_tail },
+#endif
+};
+
+/*
+* branch miss counter
+*/
+
+#if defined(__linux__)
+static int Bench_var_perf = -1;
+
+static void Bench_perf_open() {
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.size = sizeof(attr);
+	attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	Bench_var_perf = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static void Bench_perf_start() {
+	if (Bench_var_perf >= 0) {
+		ioctl(Bench_var_perf, PERF_EVENT_IOC_RESET, 0);
+		ioctl(Bench_var_perf, PERF_EVENT_IOC_ENABLE, 0);
+	}
+}
+
+// -1 if there is no counter
+static int64_t Bench_perf_stop() {
+	uint64_t count = 0;
+	if (Bench_var_perf < 0) {
+		return -1;
+	}
+	ioctl(Bench_var_perf, PERF_EVENT_IOC_DISABLE, 0);
+	return (read(Bench_var_perf, &count, sizeof(count)) == sizeof(count)) ? (int64_t)count : -1;
+}
+#else
+static void Bench_perf_open() {}
+static void Bench_perf_start() {}
+static int64_t Bench_perf_stop() { return -1; }
+#endif
+
+/*
+* streams
+*/
+
+// crc, copy, sum and a main calling them (thumb-2, assembled at 0)
+static const uint16 Bench_var_builtin[] = {
+	0xB530, 0x2300, 0x2200, 0x5CC4, 0x4062, 0x0055, 0xBF28, 0xF085, 0x051D, 0x462A, 0x3301, 0x428B, 0xD1F5, 0x4610,
+	0xBD30, 0xB12A, 0xF851, 0x3B04, 0xF840, 0x3B04, 0x3A01, 0xD1F9, 0x4770, 0x2200, 0x6803, 0xEB02, 0x0243, 0x3004,
+	0x3901, 0xDCF9, 0xB290, 0x4770, 0xB580, 0xF04F, 0x5000, 0x2140, 0xF7FF, 0xFFDA, 0x4607, 0x4806, 0xF04F, 0x5100,
+	0x2210, 0xF7FF, 0xFFE2, 0x4803, 0x2110, 0xF7FF, 0xFFE6, 0x4438, 0xBD80, 0x0000, 0x0100, 0x2000
+};
+
+static void Bench_cyclic(std::vector<uint8>& ops) {
+	for (uint32 i = 0; i < BENCH_LEN; i++) {
+		ops.push_back((uint8)(i % 6));
+	}
+}
+
+static void Bench_uniform(std::vector<uint8>& ops) {
+	uint32_t x = 0x12345678;
+	for (uint32 i = 0; i < BENCH_LEN; i++) {
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		ops.push_back((uint8)(x % BENCH_OPS));
+	}
+}
+
+// every block of [0, size) lowered in address order, repeated up to BENCH_LEN
+static void Bench_ir(std::vector<uint8>& ops, uint32 size) {
+	static IR_block block;
+	std::vector<uint8> image;
+
+	for (uint32 pc = 0; pc < size;) {
+		IR_lower(&block, pc, 0);
+		IR_optimize(&block);
+		for (uint32 i = 0; i < block.count; i++) {
+			image.push_back(block.inst[i].op);
+		}
+		pc = (block.guest_end > pc) ? block.guest_end : pc + 2;
+	}
+	while (!image.empty() && ops.size() < BENCH_LEN) {
+		ops.insert(ops.end(), image.begin(), image.end());
+	}
+	ops.resize(BENCH_LEN);
+}
+
+static void Bench_stream(const char* name, std::vector<uint8>& ops) {
+	uint32 n = (uint32)ops.size();
+	uint32_t expect = 0;
+
+	ops.push_back(BENCH_END);
+	printf("bench: %s, %d ops\n", name, (int)n);
+	for (uint32 s = 0; s < sizeof(Bench_var_strategies) / sizeof(Bench_var_strategies[0]); s++) {
+		const Bench_strategy* strategy = &Bench_var_strategies[s];
+		double best = 0;
+		int64_t misses = -1;
+		uint32_t acc = 0;
+
+		for (uint32 round = 0; round < BENCH_ROUNDS; round++) {
+			Bench_perf_start();
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			acc = strategy->run(ops.data(), n);
+			double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+			int64_t count = Bench_perf_stop();
+			if (round == 0 || ns < best) {
+				best = ns;
+				misses = count;
+			}
+		}
+		if (s == 0) {
+			expect = acc;
+		}
+
+		if (misses >= 0) {
+			printf("bench:   %-8s %7.3f ns/dispatch %7.3f misses/dispatch%s\n", strategy->name, best / n, (double)misses / n,
+				(acc != expect) ? "   WRONG RESULT" : "");
+		}
+		else {
+			printf("bench:   %-8s %7.3f ns/dispatch       n/a%s\n", strategy->name, best / n, (acc != expect) ? "   WRONG RESULT" : "");
+		}
+	}
+}
+
+int main(int argc, char** argv) {
+	logalloc_init();
+	Memory_init();
+	Fastmem_init();
+
+	uint32 size = sizeof(Bench_var_builtin);
+	if (argc > 1) {
+		uint8* data = (uint8*)map_file(argv[1], &size);
+		if (data == NULL) {
+			eprintf("bench: can't open %s\n", argv[1]);
+			return 1;
+		}
+		for (uint32 i = 0; i < size; i++) {
+			Memory_write(i, Memory_enum_size::u8, data[i], MEMORY_ATTRIB_S_W);
+		}
+		unmap_file(data, size);
+	}
+	else {
+		for (uint32 i = 0; i < size / 2; i++) {
+			Memory_write(i * 2, Memory_enum_size::u16, Bench_var_builtin[i], MEMORY_ATTRIB_S_W);
+		}
+	}
+
+#if BENCH_HAS_TAIL
+#define BENCH_TAIL_ENTRY(k) Bench_var_tail[k] = Bench_tail##k;
+	BENCH_FOR_OPS(BENCH_TAIL_ENTRY)
+#undef BENCH_TAIL_ENTRY
+	Bench_var_tail[BENCH_END] = Bench_tail_end;
+#endif
+	Bench_perf_open();
+
+	std::vector<uint8> ops;
+	Bench_cyclic(ops);
+	Bench_stream("cyclic", ops);
+	ops.clear();
+	Bench_uniform(ops);
+	Bench_stream("uniform", ops);
+	ops.clear();
+	Bench_ir(ops, size);
+	Bench_stream((argc > 1) ? argv[1] : "ir (built-in routines)", ops);
+	return 0;
+}
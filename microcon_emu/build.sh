@@ -9,9 +9,24 @@ CXX="g++"
 CXXFLAGS="-Wall -Wextra -g -fpermissive"
 LDFLAGS="-lpthread"
 
-SOURCES=(main.cpp Proxy.cpp Core.cpp CPU.cpp CPU_Instructions.cpp Memory.cpp Clock.cpp EmuPool.cpp X86Emitter.cpp)
+SOURCES=(main.cpp Proxy.cpp Core.cpp CPU.cpp CPU_Instructions.cpp Memory.cpp Clock.cpp EmuPool.cpp X86Emitter.cpp JitCache.cpp Jit.cpp IR.cpp JitAot.cpp MPU.cpp Semihost.cpp IrqStat.cpp Coverage.cpp Fastmem.cpp Batch.cpp Idiom.cpp Poll.cpp Hle.cpp Tier.cpp Fault.cpp Callprof.cpp Rtos.cpp Board.cpp Dwt.cpp Itm.cpp Fuzz.cpp Loader.cpp Nvic.cpp)
 TARGET="microcon_emu.exe"
 
+# ./build.sh bench: the interpreter dispatch benchmark (bench_dispatch.cpp), optimized, instead of the emulator
+if [ "$1" = "bench" ]; then
+    BENCH_SOURCES=(bench_dispatch.cpp "${SOURCES[@]:1}")	# everything but main.cpp
+    echo "Compiling bench_dispatch..."
+    rm -f bench_dispatch.exe
+    "$CXX" $CXXFLAGS -O2 -o bench_dispatch.exe "${BENCH_SOURCES[@]}" $LDFLAGS
+    echo "Build successful: bench_dispatch.exe"
+    exit 0
+fi
+
+# ./build.sh board: specialized for the board in Board.hpp (immediate region bounds, tape built by the compiler)
+if [ "$1" = "board" ]; then
+    CXXFLAGS="$CXXFLAGS -O2 -DMICROCON_EMU_BOARD_FIXED"
+fi
+
 echo "Compiling microcon_emu..."
 
 # Clean old objects
@@ -2,11 +2,10 @@
 
 int main(int argc, char** argv) {
 
-	/*if (argc < 2) {
-		printf("needs a bin file to launch");
-
-		return 1;
-	}*/
+	// the image (bin or elf) to boot, or MICROCON_EMU_IMAGE / MICROCON_EMU_ELF (Loader.hpp)
+	if (argc >= 2) {
+		Loader_var_path = argv[1];
+	}
 
 	Thread_data mydata;
 
@@ -32,5 +31,6 @@ int main(int argc, char** argv) {
 		wait_thread(thread);
 	}
 
-	return 0;
+	// firmware that exits through semihosting decides the exit code
+	return (int)Semihost_var_exitcode;
 }
\ No newline at end of file